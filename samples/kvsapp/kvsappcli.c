@@ -114,6 +114,33 @@ static int onMkvSent(uint8_t *pData, size_t uDataLen, void *pAppData)
 }
 #endif
 
+static void printLatencyStats(KvsAppHandle kvsAppHandle)
+{
+    KvsAppLatencyStats_t xStats = {0};
+
+    if (KvsApp_getLatencyStats(kvsAppHandle, &xStats) == 0 && xStats.xEnqueueToPersisted.uCount > 0)
+    {
+        printf("Enqueue to PERSISTED p50/p99/max: %" PRIu64 "/%" PRIu64 "/%" PRIu64 " ms, enqueue to send p99: %" PRIu64 " ms\n",
+               LatencyHistogram_getPercentile(&xStats.xEnqueueToPersisted, 50), LatencyHistogram_getPercentile(&xStats.xEnqueueToPersisted, 99),
+               xStats.xEnqueueToPersisted.uMaxMs, LatencyHistogram_getPercentile(&xStats.xEnqueueToSendStart, 99));
+    }
+}
+
+#if ENABLE_SENDER_THREAD
+static void onFragmentAck(ePutMediaFragmentAckEventType eAckEventType, uint64_t uFragmentTimecode, unsigned int uErrorId, void *pAppData)
+{
+    if (eAckEventType == eError)
+    {
+        printf("Fragment %" PRIu64 " error:%u\n", uFragmentTimecode, uErrorId);
+    }
+}
+
+static void onSenderError(int xErrCode, void *pAppData)
+{
+    printf("Sender err:-%X\n", -xErrCode);
+}
+#endif /* ENABLE_SENDER_THREAD */
+
 static void *videoThread(void *arg)
 {
     int res = ERRNO_NONE;
@@ -295,6 +322,13 @@ static int setKvsAppOptions(KvsAppHandle kvsAppHandle)
     }
 #endif /* ENABLE_RING_BUFFER_MEM_LIMIT */
 
+#if ENABLE_ENDPOINT_CACHE
+    if (KvsApp_setoption(kvsAppHandle, OPTION_KVS_ENDPOINT_CACHE_FILE, (const char *)ENDPOINT_CACHE_FILE) != 0)
+    {
+        printf("Failed to set endpoint cache file\n");
+    }
+#endif /* ENABLE_ENDPOINT_CACHE */
+
 #if DEBUG_STORE_MEDIA_TO_FILE
     if (KvsApp_setOnMkvSentCallback(kvsAppHandle, onMkvSent, NULL) != 0)
     {
@@ -315,6 +349,9 @@ int main(int argc, char *argv[])
     unsigned int uErrorId = 0;
     const char *pKvsStreamName = NULL;
     DoWorkExParamter_t xDoWorkExParamter = {0};
+#if ENABLE_SENDER_THREAD
+    SenderCallbacks_t xSenderCallbacks = {onFragmentAck, onSenderError, NULL};
+#endif /* ENABLE_SENDER_THREAD */
 
 #ifdef KVS_USE_POOL_ALLOCATOR
     poolAllocatorInit((void *)pMemPool, sizeof(pMemPool));
@@ -382,6 +419,24 @@ int main(int argc, char *argv[])
     {
         printf("Failed to set options\n");
     }
+#if ENABLE_SENDER_THREAD
+    else if ((res = KvsApp_startSender(kvsAppHandle, &xSenderCallbacks)) != 0)
+    {
+        printf("Failed to start sender, err:-%X\n", -res);
+    }
+    else
+    {
+        /* The sender thread opens, streams and re-opens, so the main thread only monitors. */
+        while (!gStopRunning)
+        {
+            printf("Buffer memory used: %zu\n", KvsApp_getStreamMemStatTotal(kvsAppHandle));
+            printLatencyStats(kvsAppHandle);
+            sleepInMs(1000);
+        }
+
+        KvsApp_stopSender(kvsAppHandle, SENDER_DRAIN_TIMEOUT_MS);
+    }
+#else
     else
     {
         while (true)
@@ -422,6 +477,7 @@ int main(int argc, char *argv[])
                 if (getEpochTimestampInMs() > uLastPrintMemStatTimestamp + 1000)
                 {
                     printf("Buffer memory used: %zu\n", KvsApp_getStreamMemStatTotal(kvsAppHandle));
+                    printLatencyStats(kvsAppHandle);
                     uLastPrintMemStatTimestamp = getEpochTimestampInMs();
 #ifdef KVS_USE_POOL_ALLOCATOR
                     PoolStats_t stats = {0};
@@ -463,6 +519,7 @@ int main(int argc, char *argv[])
             }
         }
     }
+#endif /* ENABLE_SENDER_THREAD */
 
     KvsApp_close(kvsAppHandle);
     gStopRunning = true;
@@ -34,6 +34,8 @@
 #define ENABLE_AUDIO_TRACK              1
 #define ENABLE_IOT_CREDENTIAL           0
 #define ENABLE_RING_BUFFER_MEM_LIMIT    1
+#define ENABLE_SENDER_THREAD            0
+#define ENABLE_ENDPOINT_CACHE           0
 #define DEBUG_STORE_MEDIA_TO_FILE       0
 /* Video configuration */
 #define VIDEO_TRACK_NAME                "kvs video track"
@@ -89,6 +91,16 @@
 #define RING_BUFFER_MEM_LIMIT           (2 * 1024 * 1024)
 #endif /* ENABLE_RING_BUFFER_MEM_LIMIT */
 
+#if ENABLE_ENDPOINT_CACHE
+/* The data endpoint is cached in this file, so a restart skips the control plane requests */
+#define ENDPOINT_CACHE_FILE             "kvs_endpoint_cache.json"
+#endif /* ENABLE_ENDPOINT_CACHE */
+
+#if ENABLE_SENDER_THREAD
+/* The longest time to send out buffered frames when the sample stops */
+#define SENDER_DRAIN_TIMEOUT_MS         (3 * 1000)
+#endif /* ENABLE_SENDER_THREAD */
+
 #ifdef KVS_USE_POOL_ALLOCATOR
 
 /**
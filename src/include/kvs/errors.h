@@ -48,6 +48,8 @@ typedef enum KvsModule {
 #define KVS_ERROR_C_UTIL_UNABLE_TO_CREATE_BUFFER        (-(KVS_ERROR_COMMON_BASE + 0x0006))
 #define KVS_ERROR_C_UTIL_UNABLE_TO_ENLARGE_BUFFER       (-(KVS_ERROR_COMMON_BASE + 0x0007))
 #define KVS_ERROR_TLSF_FAILED_TO_CREATE_POOL            (-(KVS_ERROR_COMMON_BASE + 0x0008))
+#define KVS_ERROR_CONDITION_ERROR                       (-(KVS_ERROR_COMMON_BASE + 0x0009))
+#define KVS_ERROR_THREAD_ERROR                          (-(KVS_ERROR_COMMON_BASE + 0x000A))
 
 /* Transport layer errors */
 #define KVS_ERROR_NETIO_SEND_MORE_THAN_REMAINING_DATA   (-(KVS_ERROR_COMMON_BASE + 0x0041))
@@ -79,6 +81,9 @@ typedef enum KvsModule {
 #define KVS_ERROR_FAIL_TO_CREATE_PUT_MEDIA_HANDLE       (-(KVS_ERROR_COMMON_BASE + 0x0114))
 #define KVS_ERROR_NO_PUTMEDIA_FRAGMENT_ACK_AVAILABLE    (-(KVS_ERROR_COMMON_BASE + 0x0115))
 #define KVS_ERROR_NO_AWS_ACCESS_KEY_OR_SECRET_KEY       (-(KVS_ERROR_COMMON_BASE + 0x0116))
+#define KVS_ERROR_HTTP_RSP_TIMEOUT                      (-(KVS_ERROR_COMMON_BASE + 0x0117))
+#define KVS_ERROR_FAIL_TO_CREATE_HTTP_PARSER            (-(KVS_ERROR_COMMON_BASE + 0x0118))
+#define KVS_ERROR_HTTP_RSP_BODY_TOO_LARGE               (-(KVS_ERROR_COMMON_BASE + 0x0119))
 
 /* MKV errors */
 #define KVS_ERROR_MKV_UNKNOWN_CLUSTER_TYPE              (-(KVS_ERROR_COMMON_BASE + 0x0201))
@@ -102,6 +107,10 @@ typedef enum KvsModule {
 
 /* KVS application errors */
 #define KVS_ERROR_KVSAPP_UNKNOWN_DO_WORK_TYPE           (-(KVS_ERROR_COMMON_BASE + 0x0341))
+#define KVS_ERROR_KVSAPP_SENDER_IS_RUNNING              (-(KVS_ERROR_COMMON_BASE + 0x0342))
+#define KVS_ERROR_KVSAPP_SENDER_IS_NOT_RUNNING          (-(KVS_ERROR_COMMON_BASE + 0x0343))
+#define KVS_ERROR_ENDPOINT_CACHE_MISS                   (-(KVS_ERROR_COMMON_BASE + 0x0344))
+#define KVS_ERROR_FAIL_TO_STORE_ENDPOINT_CACHE          (-(KVS_ERROR_COMMON_BASE + 0x0345))
 
 #define KVS_ERRNO_NONE      0
 #define KVS_ERRNO_FAIL      KVS_ERROR_GENERIC
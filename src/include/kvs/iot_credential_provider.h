@@ -16,6 +16,10 @@
 #ifndef _AWS_IOT_CREDENTIAL_PROVIDER_H_
 #define _AWS_IOT_CREDENTIAL_PROVIDER_H_
 
+#include <inttypes.h>
+
+#include "kvs/tls_context.h"
+
 typedef struct
 {
     char *pCredentialHost;
@@ -24,6 +28,9 @@ typedef struct
     char *pRootCA;
     char *pCertificate;
     char *pPrivateKey;
+
+    /* The shared TLS context for the connection, or NULL if the connection sets up its own. */
+    TlsContextHandle xTlsContext;
 } IotCredentialRequest_t;
 
 typedef struct
@@ -31,6 +38,9 @@ typedef struct
     char *pAccessKeyId;
     char *pSecretAccessKey;
     char *pSessionToken;
+
+    /* The epoch time in milliseconds when the credential expires, or 0 if it's unknown. */
+    uint64_t uExpirationMs;
 } IotCredentialToken_t;
 
 /**
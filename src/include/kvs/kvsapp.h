@@ -20,6 +20,7 @@
 #include "kvs/mkv_generator.h"
 #include "kvs/restapi.h"
 #include "kvs/errors.h"
+#include "kvs/latency_histogram.h"
 #include <inttypes.h>
 
 typedef struct KvsApp *KvsAppHandle;
@@ -82,18 +83,73 @@ typedef enum DoWorkExType
     DO_WORK_DEFAULT = 0,
 
     /* It's similar to doWork, except that it also sends out the end of frames. */
-    DO_WORK_SEND_END_OF_FRAMES = 1
+    DO_WORK_SEND_END_OF_FRAMES = 1,
+
+    /* It's similar to doWork, except that it keeps sending frames until the stream is drained or the budget runs out. */
+    DO_WORK_SEND_BATCH = 2
 } DoWorkExType_t;
 
 typedef struct DoWorkExParamter
 {
     DoWorkExType_t eType;
+
+    /* Budget of DO_WORK_SEND_BATCH. A zero value means no limit. */
+    size_t uMaxSendFrames;
+    size_t uMaxSendBytes;
+    unsigned int uTimeBudgetMs;
 } DoWorkExParamter_t;
 
+/**
+ * This callback is called by the sender thread for each fragment ACK.
+ *
+ * @param[in] eAckEventType The fragment ACK event type
+ * @param[in] uFragmentTimecode The fragment timecode
+ * @param[in] uErrorId The error ID if the event type is eError
+ * @param[in] pAppData Pointer of application data that is assigned in function KvsApp_startSender()
+ */
+typedef void (*OnFragmentAckCallback_t)(ePutMediaFragmentAckEventType eAckEventType, uint64_t uFragmentTimecode, unsigned int uErrorId, void *pAppData);
+
+/**
+ * This callback is called by the sender thread when opening or streaming fails. The sender thread closes the connection
+ * and opens it again afterwards.
+ *
+ * @param[in] xErrCode The error code
+ * @param[in] pAppData Pointer of application data that is assigned in function KvsApp_startSender()
+ */
+typedef void (*OnSenderErrorCallback_t)(int xErrCode, void *pAppData);
+
+typedef struct SenderCallbacks
+{
+    OnFragmentAckCallback_t onFragmentAck;
+    OnSenderErrorCallback_t onSenderError;
+    void *pAppData;
+} SenderCallbacks_t;
+
+typedef struct KvsAppLatencyStats
+{
+    /* Per frame: from KvsApp_addFrame() to the frame being sent, and the time spent in sending it */
+    LatencyHistogram_t xEnqueueToSendStart;
+    LatencyHistogram_t xSendDuration;
+
+    /* Per fragment: from KvsApp_addFrame() of its first frame to each fragment ACK */
+    LatencyHistogram_t xEnqueueToBuffering;
+    LatencyHistogram_t xEnqueueToReceived;
+    LatencyHistogram_t xEnqueueToPersisted;
+
+    /* Fragments that got an ERROR ACK */
+    uint32_t uErrorFragmentCount;
+
+    /* Fragments that are no longer tracked before PERSISTED, because too many fragments are waiting for ACKs */
+    uint32_t uUntrackedFragmentCount;
+
+    /* Fragment ACKs whose timecode doesn't match any tracked fragment */
+    uint32_t uUnmatchedAckCount;
+} KvsAppLatencyStats_t;
+
 /**
  * Create a KVS application.
  *
- * @param[in] pcHost KVS hostname
+ * @param[in] pcHost KVS hostname, optionally followed by a port like "localhost:8443"
  * @param[in] pcRegion Region to be used
  * @param[in] pcService Service name, it should always be "kinesisvideo"
  * @param[in] pcStreamName KVS stream name
@@ -122,6 +178,14 @@ int KvsApp_setoption(KvsAppHandle handle, const char *pcOptionName, const char *
  * Open KVS application. It includes validating if stream exist, getting PUT_MEDIA data endpoint, and setup PUT_MEDIA
  * connection. It also tries to setup stream buffer if track info are already set.
  *
+ * If OPTION_KVS_ENDPOINT_CACHE_FILE is set, a cached data endpoint that is not expired is used without validating the
+ * stream or getting the endpoint. The cache is revalidated only if PUT MEDIA cannot reach the endpoint or the stream.
+ *
+ * If IoT certificates are set, the IoT credential is fetched only if there is none or it's about to expire. A background
+ * thread refreshes it OPTION_IOT_CREDENTIAL_REFRESH_MARGIN seconds before it expires, until KvsApp_terminate(). The
+ * margin is at most half of the credential lifetime, and a credential without known expiration is refreshed after 10
+ * minutes.
+ *
  * @param[in] handle KVS application handle.
  * @return 0 on success, non-zero value otherwise
  */
@@ -139,6 +203,9 @@ int KvsApp_close(KvsAppHandle handle);
  * Add a frame to KVS application. If the stream buffer is not allocated yet, then it'll try to parse decode information
  * and then setup stream buffer.
  *
+ * Video frames are H.264 unless OPTION_KVS_VIDEO_CODEC is set to a VideoCodec_t of VIDEO_CODEC_H265 before the first
+ * frame. Both codecs can be in Annex-B or length prefixed format, and Annex-B frames are converted in place.
+ *
  * @param[in] handle KVS application handle
  * @param[in] pData Data buffer pointer
  * @param[in] uDataLen Data length
@@ -167,6 +234,12 @@ int KvsApp_addFrameWithCallbacks(KvsAppHandle handle, uint8_t *pData, size_t uDa
 /**
  * Let KVS application do works. It will try to send out frames, and check if any messages from server.
  *
+ * If OPTION_RECONNECT_AUTO is set, a failed PUT MEDIA session is closed and re-opened after an exponential backoff with
+ * jitter, and the failure is not returned. Frames keep buffering in the stream in the meantime.  If
+ * OPTION_RECONNECT_ROTATION_INTERVAL is set, the next session is opened by a helper thread when the interval expires
+ * while the current one keeps streaming, and the sessions are switched on the next cluster boundary. The previous
+ * session is kept open until the ACK of its last fragment arrives, for up to 10 seconds.
+ *
  * @param[in] handle KVS application handle
  * @return 0 on success, non-zero value otherwise
  */
@@ -186,6 +259,7 @@ int KvsApp_doWorkEx(KvsAppHandle handle, DoWorkExParamter_t *pPara);
  *
  * When KvsApp_doWork() is called, it will check if any incoming fragment ACKs, and clear fragment ACKs that buffered in the previous Kvs_putMediaDoWork() call.
  * Use KvsApp_readFragmentAck() to read one fragment ACK and the return value would be 0. If there is no fragment ACK available, then the return value would be non-zero value.
+ * After a session rotation, the ACKs of the previous session are read before those of the current one.
  *
  * @param[in] handle The handle of PUT MEDIA
  * @param[out] peAckEventType Pointer to the fragment ACK event type
@@ -195,6 +269,31 @@ int KvsApp_doWorkEx(KvsAppHandle handle, DoWorkExParamter_t *pPara);
  */
 int KvsApp_readFragmentAck(KvsAppHandle handle, ePutMediaFragmentAckEventType *peAckEventType, uint64_t *puFragmentTimecode, unsigned int *puErrorId);
 
+/**
+ * Start a sender thread that is owned by KVS application.
+ *
+ * The sender thread opens the connection, sends frames as soon as they are added, delivers fragment ACKs and errors
+ * through callbacks, and re-opens the connection after errors with the backoff of the OPTION_RECONNECT_* options.
+ * While it's running, the application only adds frames, and must not call KvsApp_open(), KvsApp_close(),
+ * KvsApp_doWork(), KvsApp_doWorkEx() or KvsApp_readFragmentAck().
+ *
+ * @param[in] handle KVS application handle
+ * @param[in] pCallbacks Callbacks, or NULL if the application doesn't need them
+ * @return 0 on success, non-zero value otherwise
+ */
+int KvsApp_startSender(KvsAppHandle handle, SenderCallbacks_t *pCallbacks);
+
+/**
+ * Stop the sender thread and close the connection.
+ *
+ * Frames in the stream buffer keep being sent until the stream is drained or the drain timeout expires.
+ *
+ * @param[in] handle KVS application handle
+ * @param[in] uDrainTimeoutMs The longest time to drain the stream buffer, or 0 to stop without draining
+ * @return 0 on success, non-zero value otherwise
+ */
+int KvsApp_stopSender(KvsAppHandle handle, unsigned int uDrainTimeoutMs);
+
 /**
  * Get the memory used in the stream buffer.
  *
@@ -203,6 +302,31 @@ int KvsApp_readFragmentAck(KvsAppHandle handle, ePutMediaFragmentAckEventType *p
  */
 size_t KvsApp_getStreamMemStatTotal(KvsAppHandle handle);
 
+/**
+ * Get the TLS handshake statistics of connections, including the handshakes that resumed a cached TLS session.
+ *
+ * The TLS context is shared process-wide by applications with the same certificates, so the statistics include their
+ * connections too.
+ *
+ * @param handle KVS application handle
+ * @param pxStats The TLS handshake statistics
+ * @return 0 on success, non-zero value otherwise
+ */
+int KvsApp_getTlsStats(KvsAppHandle handle, TlsContextStats_t *pxStats);
+
+/**
+ * Get the latency statistics of the stream since the KVS application is created.
+ *
+ * Frames are stamped when they're added, sent and done sending, and fragments are matched to fragment ACKs by their
+ * timecode. Fragment ACKs are only counted if they are read by KvsApp_readFragmentAck() or the sender thread. All
+ * statistics are kept in fixed memory.
+ *
+ * @param handle KVS application handle
+ * @param pxStats The latency statistics
+ * @return 0 on success, non-zero value otherwise
+ */
+int KvsApp_getLatencyStats(KvsAppHandle handle, KvsAppLatencyStats_t *pxStats);
+
 /**
  * Set onMkvSentCallback. Whenever a data has been sent to PUT MEDIA endpoint, it'll invoke this callback.
  *
@@ -33,16 +33,27 @@ static const char * const OPTION_IOT_THING_NAME = "Iot_thingName";
 static const char * const OPTION_IOT_X509_ROOTCA = "Iot_x509RootCa";
 static const char * const OPTION_IOT_X509_CERT = "Iot_x509Certificate";
 static const char * const OPTION_IOT_X509_KEY = "Iot_x509PrivateKey";
+static const char * const OPTION_IOT_CREDENTIAL_REFRESH_MARGIN = "Iot_credentialRefreshMarginSec";
 
 static const char * const OPTION_KVS_DATA_RETENTION_IN_HOURS = "Kvs_dataRetentionInHours";
+static const char * const OPTION_KVS_VIDEO_CODEC = "Kvs_videoCodec";
 static const char * const OPTION_KVS_VIDEO_TRACK_INFO = "Kvs_videoTrackInfo";
 static const char * const OPTION_KVS_AUDIO_TRACK_INFO = "Kvs_audioTrackInfo";
+static const char * const OPTION_KVS_ENDPOINT_CACHE_FILE = "Kvs_endpointCacheFile";
+static const char * const OPTION_KVS_ENDPOINT_CACHE_TTL = "Kvs_endpointCacheTtlSec";
 
 static const char * const OPTION_STREAM_POLICY = "Stream_policy";
 static const char * const OPTION_STREAM_POLICY_RING_BUFFER_MEM_LIMIT = "Stream_RbMemlimit";
+static const char * const OPTION_STREAM_POLICY_RING_BUFFER_DURATION_LIMIT = "Stream_RbDurationLimit";
 
 static const char * const OPTION_NETIO_CONNECTION_TIMEOUT = "NetIo_connTimeout";
 static const char * const OPTION_NETIO_STREAMING_RECV_TIMEOUT = "NetIo_recvTimeout";
 static const char * const OPTION_NETIO_STREAMING_SEND_TIMEOUT = "NetIo_sendTimeout";
 
+static const char * const OPTION_RECONNECT_AUTO = "Reconnect_auto";
+static const char * const OPTION_RECONNECT_BASE_DELAY = "Reconnect_baseDelayMs";
+static const char * const OPTION_RECONNECT_MAX_DELAY = "Reconnect_maxDelayMs";
+static const char * const OPTION_RECONNECT_JITTER = "Reconnect_jitterPercent";
+static const char * const OPTION_RECONNECT_ROTATION_INTERVAL = "Reconnect_rotationIntervalSec";
+
 #endif
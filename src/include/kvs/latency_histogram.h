@@ -0,0 +1,75 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#ifndef KVS_LATENCY_HISTOGRAM_H
+#define KVS_LATENCY_HISTOGRAM_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/* Latencies below 4ms have a bucket each, and every power of 2 above is split into 4 buckets, so a bucket is at most
+ * 25% wider than its lower bound. Latencies beyond the last bucket are counted in the last bucket. */
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS (2)
+#define LATENCY_HISTOGRAM_BUCKET_COUNT (64)
+
+typedef struct LatencyHistogram
+{
+    /* The number of recorded latencies */
+    uint32_t uCount;
+
+    /* The sum, min and max of recorded latencies in milliseconds */
+    uint64_t uSumMs;
+    uint64_t uMinMs;
+    uint64_t uMaxMs;
+
+    /* The number of recorded latencies in each bucket. Use LatencyHistogram_getBucketLowerBound() for the range. */
+    uint32_t puBuckets[LATENCY_HISTOGRAM_BUCKET_COUNT];
+} LatencyHistogram_t;
+
+/**
+ * @brief Clear all recorded latencies of a histogram
+ *
+ * @param[in] pxHistogram The histogram
+ */
+void LatencyHistogram_reset(LatencyHistogram_t *pxHistogram);
+
+/**
+ * @brief Record a latency into a histogram
+ *
+ * @param[in] pxHistogram The histogram
+ * @param[in] uLatencyMs The latency in milliseconds
+ */
+void LatencyHistogram_record(LatencyHistogram_t *pxHistogram, uint64_t uLatencyMs);
+
+/**
+ * @brief Get the smallest latency that is counted in a bucket
+ *
+ * @param[in] uIndex The bucket index
+ * @return The lower bound of the bucket in milliseconds
+ */
+uint64_t LatencyHistogram_getBucketLowerBound(size_t uIndex);
+
+/**
+ * @brief Estimate a percentile of recorded latencies
+ *
+ * The estimation is the upper bound of the bucket where the percentile falls in, and it never exceeds the max latency.
+ *
+ * @param[in] pxHistogram The histogram
+ * @param[in] uPercentile The percentile from 0 to 100
+ * @return The estimated latency in milliseconds, or 0 if nothing is recorded
+ */
+uint64_t LatencyHistogram_getPercentile(const LatencyHistogram_t *pxHistogram, unsigned int uPercentile);
+
+#endif /* KVS_LATENCY_HISTOGRAM_H */
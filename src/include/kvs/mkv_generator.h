@@ -150,10 +150,15 @@ void Mkv_terminateHeaders(MkvHeader_t *pMkvHeader);
 
 /**
  * @brief Return the header length of MKV cluster or simple block
+ *
+ * The SimpleBlock size is encoded in the shortest EBML form, so the length depends on the frame size. A frame size of
+ * SIZE_MAX gives the longest header of the type.
+ *
  * @param[in] xType MKV cluster type
+ * @param[in] uFrameSize the size of data frame
  * @return the length of MKV header
  */
-size_t Mkv_getClusterHdrLen(MkvClusterType_t xType);
+size_t Mkv_getClusterHdrLen(MkvClusterType_t xType, size_t uFrameSize);
 
 /**
  * @brief Initialize a MKV header of either MKV cluster or simple block
@@ -205,6 +210,33 @@ int Mkv_generateH264CodecPrivateDataFromAvccNalus(uint8_t *pAvccBuf, size_t uAvc
  */
 int Mkv_generateH264CodecPrivateDataFromSpsPps(uint8_t *pSps, size_t uSpsLen, uint8_t *pPps, size_t uPpsLen, uint8_t **ppCodecPrivateData, size_t *puCodecPrivateDataLen);
 
+/**
+ * @brief Generate H265 codec private data, which is a HEVCDecoderConfigurationRecord, from VPS, SPS and PPS
+ *
+ * @param[in] pVps The VPS buffer
+ * @param[in] uVpsLen The length of VPS
+ * @param[in] pSps The SPS buffer
+ * @param[in] uSpsLen The length of SPS
+ * @param[in] pPps The PPS buffer
+ * @param[in] uPpsLen The length of PPS
+ * @param[out] ppCodecPrivateData the generated codec private data that is memory allocated
+ * @param[out] puCodecPrivateDataLen the length of generated codec private data
+ * @return 0 on success, non-zero value otherwise
+ */
+int Mkv_generateH265CodecPrivateDataFromVpsSpsPps(
+    uint8_t *pVps, size_t uVpsLen, uint8_t *pSps, size_t uSpsLen, uint8_t *pPps, size_t uPpsLen, uint8_t **ppCodecPrivateData, size_t *puCodecPrivateDataLen);
+
+/**
+ * @brief Create MKV codec private data for H265 from Annex-B or length prefixed NALUs that have VPS, SPS and PPS
+ *
+ * @param[in] pBuf The Annex-B or length prefixed NALUs
+ * @param[in] uLen the length of NALUs
+ * @param[out] ppCodecPrivateData the generated codec private data that is memory allocated
+ * @param[out] puCodecPrivateDataLen the length of generated codec private data
+ * @return 0 on success, non-zero value otherwise
+ */
+int Mkv_generateH265CodecPrivateDataFromNalus(uint8_t *pBuf, size_t uLen, uint8_t **ppCodecPrivateData, size_t *puCodecPrivateDataLen);
+
 /**
  * @brief Create MKV codec private data for AAC
  *
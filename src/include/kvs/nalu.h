@@ -34,6 +34,55 @@
 #define NALU_TYPE_SPS               (7)
 #define NALU_TYPE_PPS               (8)
 
+/* H.265 IRAP pictures, which are key frames, have NALU types from 16 to 23 */
+#define NALU_TYPE_HEVC_IRAP_MIN     (16)
+#define NALU_TYPE_HEVC_IRAP_MAX     (23)
+
+/* H.265 non-VCL */
+#define NALU_TYPE_HEVC_VPS          (32)
+#define NALU_TYPE_HEVC_SPS          (33)
+#define NALU_TYPE_HEVC_PPS          (34)
+
+typedef enum VideoCodec
+{
+    VIDEO_CODEC_H264 = 0,
+    VIDEO_CODEC_H265
+} VideoCodec_t;
+
+/* The number of NALUs that can be indexed without a caller provided table or memory allocation */
+#define NALU_INDEX_INLINE_COUNT     (16)
+
+typedef struct NaluIndexEntry
+{
+    /* The offset of the NALU header from the beginning of the frame, which is after the start code or the length */
+    uint32_t uOffset;
+
+    /* The length of the NALU without the start code or the length */
+    uint32_t uLen;
+
+    /* The NALU type of the indexed codec, or NALU_TYPE_UNKNOWN if the forbidden bit is set */
+    uint8_t uType;
+} NaluIndexEntry_t;
+
+typedef struct NaluIndex
+{
+    /* The codec that decides how NALU headers are parsed */
+    VideoCodec_t xCodec;
+
+    /* true if the frame is in Annex-B format, or false if it's in AVCC format */
+    bool bIsAnnexB;
+
+    /* The number of indexed NALUs */
+    size_t uCount;
+
+    /* The NALU table. It's the inline table, a caller provided table, or an allocated table once the others are full. */
+    NaluIndexEntry_t *pxNalus;
+    size_t uCapacity;
+    bool bIsTableAllocated;
+
+    NaluIndexEntry_t xInlineNalus[NALU_INDEX_INLINE_COUNT];
+} NaluIndex_t;
+
 /**
  * @brief Check if the frame is key frame
  *
@@ -98,6 +147,83 @@ bool NALU_isAnnexBFrame(uint8_t *pAnnexbBuf, uint32_t uAnnexbBufLen);
  */
 int NALU_convertAnnexBToAvccInPlace(uint8_t *pAnnexbBuf, uint32_t uAnnexbBufLen, uint32_t uAnnexbBufSize, uint32_t *pAvccLen);
 
+/**
+ * @brief Initialize a NALU index
+ *
+ * The index uses the caller provided table if there is one, or its inline table otherwise. When a frame has more NALUs
+ * than the table can hold, a larger table is allocated and kept for the following frames until NALU_deinitIndex().
+ *
+ * @param[out] pxIndex The NALU index
+ * @param[in] pxTable The caller provided table, or NULL to use the inline table
+ * @param[in] uCapacity The number of entries of the caller provided table
+ */
+void NALU_initIndex(NaluIndex_t *pxIndex, NaluIndexEntry_t *pxTable, size_t uCapacity);
+
+/**
+ * @brief Release the allocated table of a NALU index
+ *
+ * @param[in] pxIndex The NALU index
+ */
+void NALU_deinitIndex(NaluIndex_t *pxIndex);
+
+/**
+ * @brief Walk the NALUs of a frame once and record their type, offset and length in an index
+ *
+ * The frame can be in Annex-B or AVCC format. Key frame detection, parameter set extraction and AVCC conversion can use
+ * the index afterwards instead of scanning the frame again.
+ *
+ * @param[in] pBuf The Annex-B or AVCC buffer
+ * @param[in] uLen The length of buffer
+ * @param[in,out] pxIndex The NALU index that is initialized by NALU_initIndex()
+ * @return 0 on success, non-zero value otherwise
+ */
+int NALU_buildIndex(uint8_t *pBuf, size_t uLen, NaluIndex_t *pxIndex);
+
+/**
+ * @brief Walk the NALUs of a H.264 or H.265 frame once and record them in an index
+ *
+ * @param[in] pBuf The Annex-B or length prefixed buffer
+ * @param[in] uLen The length of buffer
+ * @param[in] xCodec The video codec of the frame
+ * @param[in,out] pxIndex The NALU index that is initialized by NALU_initIndex()
+ * @return 0 on success, non-zero value otherwise
+ */
+int NALU_buildIndexWithCodec(uint8_t *pBuf, size_t uLen, VideoCodec_t xCodec, NaluIndex_t *pxIndex);
+
+/**
+ * @brief Check if an indexed frame is key frame, which has an IDR picture in H.264 or an IRAP picture in H.265
+ *
+ * @param[in] pxIndex The NALU index
+ * @return true if it's key-frame, or false otherwise
+ */
+bool NALU_isKeyFrameInIndex(const NaluIndex_t *pxIndex);
+
+/**
+ * @brief Get the first NALU of specific type from an indexed frame
+ *
+ * @param[in] pxIndex The NALU index
+ * @param[in] pBuf The buffer that is indexed
+ * @param[in] uNaluType The NALU type of the indexed codec to be query
+ * @param[out] ppNalu The address of queried NALU type that is not memory allocated
+ * @param[out] puNaluLen The length of queried NALU type
+ * @return 0 on success, non-zero value otherwise
+ */
+int NALU_getNaluFromIndex(const NaluIndex_t *pxIndex, uint8_t *pBuf, uint8_t uNaluType, uint8_t **ppNalu, size_t *puNaluLen);
+
+/**
+ * @brief Convert an indexed Annex-B frame into AVCC in place
+ *
+ * The NALUs are moved without scanning the frame again, and the index is updated to the AVCC frame. It does nothing if
+ * the indexed frame is already in AVCC format.
+ *
+ * @param[in,out] pBuf The buffer that is indexed
+ * @param[in] uBufSize The size of the buffer
+ * @param[in,out] pxIndex The NALU index
+ * @param[out] pAvccLen The converted AVCC frame length
+ * @return 0 on success, non-zero value otherwise
+ */
+int NALU_convertAnnexBToAvccInPlaceWithIndex(uint8_t *pBuf, uint32_t uBufSize, NaluIndex_t *pxIndex, uint32_t *pAvccLen);
+
 /**
  * @brief Parse the video resolution from a SPS NALU
  *
@@ -109,4 +235,15 @@ int NALU_convertAnnexBToAvccInPlace(uint8_t *pAnnexbBuf, uint32_t uAnnexbBufLen,
  */
 int NALU_getH264VideoResolutionFromSps(uint8_t *pSps, size_t uSpsLen, uint16_t *puWidth, uint16_t *puHeight);
 
+/**
+ * @brief Parse the video resolution from a H.265 SPS NALU
+ *
+ * @param[in] pSps The SPS NALU including its 2 bytes NALU header
+ * @param[in] uSpsLen The length of SPS NALU
+ * @param[out] puWidth The width of video
+ * @param[out] puHeight The height of video
+ * @return 0 on success, non-zero value otherwise
+ */
+int NALU_getH265VideoResolutionFromSps(uint8_t *pSps, size_t uSpsLen, uint16_t *puWidth, uint16_t *puHeight);
+
 #endif /* KVS_NALU_H */
\ No newline at end of file
@@ -26,6 +26,8 @@ typedef struct PoolStats
     size_t uSumOfFreeMemory;
     size_t uSizeOfLargestUsedBlock;
     size_t uSizeOfLargestFreeBlock;
+    size_t uNumberOfAllocations; /* The number of successful malloc, calloc and realloc since the pool is initialized */
+    size_t uNumberOfFrees;       /* The number of free, including old blocks of realloc, since the pool is initialized */
 } PoolStats_t;
 
 /**
@@ -66,6 +68,8 @@ void *poolAllocatorCalloc(size_t num, size_t bytes);
 /**
  * Free memory from memory pool.
  *
+ * A small block may be kept in the cache of the calling thread, and it's returned to the pool in batches.
+ *
  * @param[in] ptr Pointer to be freed
  */
 void poolAllocatorFree(void *ptr);
@@ -78,6 +82,9 @@ void poolAllocatorDeinit(void);
 /**
  * Get statistics of pool allocator.
  *
+ * Small blocks that are freed are kept in a per-thread cache for reuse. They are returned to the pool before collecting
+ * statistics, so the statistics are exact.
+ *
  * @param[in] pPoolStats Pool statistics
  */
 void poolAllocatorGetStats(PoolStats_t *pPoolStats);
@@ -17,6 +17,10 @@
 #define KVS_REST_API_H
 
 #include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "kvs/tls_context.h"
 
 typedef struct
 {
@@ -32,6 +36,9 @@ typedef struct
 
     unsigned int uRecvTimeoutMs;
     unsigned int uSendTimeoutMs;
+
+    /* The shared TLS context for connections, or NULL if each connection sets up its own. */
+    TlsContextHandle xTlsContext;
 } KvsServiceParameter_t;
 
 typedef struct
@@ -140,6 +147,31 @@ int Kvs_putMediaStart(KvsServiceParameter_t *pServPara, KvsPutMediaParameter_t *
  */
 int Kvs_putMediaUpdate(PutMediaHandle xPutMediaHandle, uint8_t *pMkvHeader, size_t uMkvHeaderLen, uint8_t *pData, size_t uDataLen);
 
+/**
+ * @brief Update MKV header and frame data by using PUT MEDIA handle, and optionally keep it in the send buffer
+ *
+ * The chunk of a data frame is gathered into a send buffer, so small data frames don't cost one TLS record per piece.
+ * If bFlush is false, the chunk may stay in the send buffer and share a TLS record with the following data frames. Use
+ * Kvs_putMediaFlush() to send them out.
+ *
+ * @param[in] xPutMediaHandle The handle of PUT MEDIA
+ * @param[in] pMkvHeader The MKV header
+ * @param[in] uMkvHeaderLen The length of MKV header
+ * @param[in] pData The data frame, or NULL if it's not available
+ * @param[in] uDataLen The length of the data frame
+ * @param[in] bFlush true to send out the send buffer before return, false otherwise
+ * @return 0 on success, non-zero value otherwise
+ */
+int Kvs_putMediaUpdateEx(PutMediaHandle xPutMediaHandle, uint8_t *pMkvHeader, size_t uMkvHeaderLen, uint8_t *pData, size_t uDataLen, bool bFlush);
+
+/**
+ * @brief Send out data frames that are kept in the send buffer of PUT MEDIA handle
+ *
+ * @param[in] xPutMediaHandle The handle of PUT MEDIA
+ * @return 0 on success, non-zero value otherwise
+ */
+int Kvs_putMediaFlush(PutMediaHandle xPutMediaHandle);
+
 /**
  * @brief Update raw data by using PUT MEDIA handle
  *
@@ -158,6 +190,18 @@ int Kvs_putMediaUpdateRaw(PutMediaHandle xPutMediaHandle, uint8_t *pBuf, size_t
  */
 int Kvs_putMediaDoWork(PutMediaHandle xPutMediaHandle);
 
+/**
+ * @brief End the body of PUT MEDIA, so the server completes the last fragment
+ *
+ * No more data can be sent after the body ends, but fragment ACKs of the data that has been sent still arrive. Keep
+ * calling Kvs_putMediaDoWork() and Kvs_putMediaReadFragmentAck() until the ACK of the last fragment, then call
+ * Kvs_putMediaFinish().
+ *
+ * @param[in] xPutMediaHandle The handle of PUT MEDIA
+ * @return 0 on success, non-zero value otherwise
+ */
+int Kvs_putMediaEnd(PutMediaHandle xPutMediaHandle);
+
 /**
  * @brief Terminate the handle of PUT MEDIA
  *
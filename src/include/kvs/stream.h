@@ -33,6 +33,16 @@ typedef struct DataFrame *DataFrameHandle;
 
 typedef struct Stream *StreamHandle;
 
+/**
+ * @brief Callback of a data frame that has been evicted from a stream
+ *
+ * The data frame is no longer in the stream, so the callback owns it and should terminate it.
+ *
+ * @param[in] xDataFrameHandle The evicted data frame handle
+ * @param[in] pAppData The application data that is passed to the evict function
+ */
+typedef void (*OnDataFrameEvicted_t)(DataFrameHandle xDataFrameHandle, void *pAppData);
+
 /**
  * @brief Create a stream
  *
@@ -59,6 +69,18 @@ void Kvs_streamTermintate(StreamHandle xStreamHandle);
  */
 int Kvs_streamGetMkvEbmlSegHdr(StreamHandle xStreamHandle, uint8_t **ppMkvHeader, size_t *puMkvHeaderLen);
 
+/**
+ * @brief Reserve data frame handles of a stream in a fixed-size slab
+ *
+ * Data frame handles are allocated from the slab afterwards, and from the heap only if the slab runs out.  It can be
+ * reserved only once, and all data frame handles must be terminated before the stream is terminated.
+ *
+ * @param xStreamHandle[in] The stream handle
+ * @param uDataFrameCount[in] The number of data frame handles to reserve
+ * @return 0 on success, non-zero value otherwise
+ */
+int Kvs_streamReserveDataFrames(StreamHandle xStreamHandle, size_t uDataFrameCount);
+
 /**
  * @brief Add a data Frame to a stream
  *
@@ -120,6 +142,38 @@ bool Kvs_streamAvailOnTrack(StreamHandle xStreamHandle, TrackType_t xTrackType);
  */
 int Kvs_streamMemStatTotal(StreamHandle xStreamHandle, size_t *puMemTotal);
 
+/**
+ * @brief Evict the headless data frames at the head of a stream
+ *
+ * If the head data frame is not a cluster, all data frames in front of the first cluster are evicted at once. They
+ * cannot be decoded on a new connection without their key frame.
+ *
+ * @param xStreamHandle[in] The stream handle
+ * @param onDataFrameEvicted[in] The callback that takes over each evicted data frame
+ * @param pAppData[in] The application data that is passed to the callback
+ * @return 0 on success, non-zero value otherwise
+ */
+int Kvs_streamEvictHeadless(StreamHandle xStreamHandle, OnDataFrameEvicted_t onDataFrameEvicted, void *pAppData);
+
+/**
+ * @brief Evict the oldest GOPs of a stream until it fits the limits
+ *
+ * A GOP is a cluster data frame and the data frames that follow it until the next cluster.  GOPs are evicted whole,
+ * so the remaining data frames always start from a key frame.  A headless run at the head is evicted as one GOP.
+ *
+ * The memory limit is compared with the total memory from Kvs_streamMemStatTotal.  A GOP is evicted for duration
+ * only if the GOPs after it still cover the duration limit up to the latest timestamp in the stream, so the newest
+ * GOP is never evicted for duration.
+ *
+ * @param xStreamHandle[in] The stream handle
+ * @param uMemLimit[in] The memory limit in bytes, or 0 for no limit so that the duration limit can be used alone
+ * @param uDurationLimitMs[in] The duration limit in milliseconds, or 0 for no limit
+ * @param onDataFrameEvicted[in] The callback that takes over each evicted data frame
+ * @param pAppData[in] The application data that is passed to the callback
+ * @return 0 on success, non-zero value otherwise
+ */
+int Kvs_streamEvictGops(StreamHandle xStreamHandle, size_t uMemLimit, uint64_t uDurationLimitMs, OnDataFrameEvicted_t onDataFrameEvicted, void *pAppData);
+
 /**
  * @brief Get MKV header and data from a data frame
  *
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#ifndef KVS_TLS_CONTEXT_H
+#define KVS_TLS_CONTEXT_H
+
+#include <inttypes.h>
+
+typedef struct TlsContext *TlsContextHandle;
+
+typedef struct TlsContextStats
+{
+    /* The number of handshakes that are done in full */
+    uint32_t uFullHandshakeCount;
+
+    /* The number of handshakes that resumed a cached session. Each of them saves one round trip and the public key
+     * operations of a full handshake. */
+    uint32_t uResumedHandshakeCount;
+
+    /* The accumulated time of full handshakes in milliseconds */
+    uint64_t uFullHandshakeTimeMs;
+
+    /* The accumulated time of resumed handshakes in milliseconds */
+    uint64_t uResumedHandshakeTimeMs;
+} TlsContextStats_t;
+
+/**
+ * @brief Create a TLS context that can be shared by network connections
+ *
+ * The TLS context seeds a random generator once, and parses the X509 certificates once if they are given. Connections
+ * that are created with this context use them instead of setting up their own, so it saves the cost of entropy
+ * gathering and PEM parsing on every connection.
+ *
+ * The TLS context also keeps the sessions of a few recent connections keyed by host and port. A connection to the same
+ * host and port resumes the cached session with an abbreviated handshake if the server accepts it.
+ *
+ * The X509 certificates are optional. Pass NULL to all of them if the context is only used for connections without
+ * client certificates.
+ *
+ * @param[in] pcRootCA The X509 root CA, or NULL
+ * @param[in] pcCert The X509 client certificate, or NULL
+ * @param[in] pcPrivKey The private key of the client certificate, or NULL
+ * @return The TLS context handle on success, or NULL otherwise
+ */
+TlsContextHandle TlsContext_create(const char *pcRootCA, const char *pcCert, const char *pcPrivKey);
+
+/**
+ * @brief Acquire the process-wide TLS context for a set of X509 certificates
+ *
+ * The first call creates the context, and later calls with the same certificates (or with no certificates) return the
+ * same context with its reference count increased. So every stream and credential refresh in the process shares one
+ * seeded random generator, one parsed copy of the certificates and one session cache.
+ *
+ * @param[in] pcRootCA The X509 root CA, or NULL
+ * @param[in] pcCert The X509 client certificate, or NULL
+ * @param[in] pcPrivKey The private key of the client certificate, or NULL
+ * @return The TLS context handle on success, or NULL otherwise
+ */
+TlsContextHandle TlsContext_acquire(const char *pcRootCA, const char *pcCert, const char *pcPrivKey);
+
+/**
+ * @brief Release a TLS context that is acquired by TlsContext_acquire
+ *
+ * The context is terminated when the last reference is released. The connections that are using this reference must
+ * be terminated before releasing it.
+ *
+ * @param[in] xTlsContext The TLS context handle
+ */
+void TlsContext_release(TlsContextHandle xTlsContext);
+
+/**
+ * @brief Terminate a TLS context
+ *
+ * All connections that are using this context must be terminated before terminating the context. Contexts that are
+ * acquired by TlsContext_acquire are released by TlsContext_release instead.
+ *
+ * @param[in] xTlsContext The TLS context handle
+ */
+void TlsContext_terminate(TlsContextHandle xTlsContext);
+
+/**
+ * @brief Get the handshake statistics of a TLS context
+ *
+ * The time saved by session resumption can be estimated by the difference of the average full handshake time and the
+ * average resumed handshake time.
+ *
+ * @param[in] xTlsContext The TLS context handle
+ * @param[out] pxStats The handshake statistics
+ * @return 0 on success, non-zero value otherwise
+ */
+int TlsContext_getStats(TlsContextHandle xTlsContext, TlsContextStats_t *pxStats);
+
+#endif /* KVS_TLS_CONTEXT_H */
@@ -17,8 +17,10 @@
 #include <string.h>
 
 /* Third-party headers */
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/xlogging.h"
 
 /* KVS headers */
@@ -28,14 +30,18 @@
 #include "kvs/port.h"
 #include "kvs/restapi.h"
 #include "kvs/stream.h"
+#include "kvs/tls_context.h"
 
 #include "kvs/kvsapp.h"
 #include "kvs/kvsapp_options.h"
 
 /* Internal headers */
+#include "misc/endpoint_cache.h"
 #include "os/allocator.h"
+#include "os/slab.h"
 
-#define VIDEO_CODEC_NAME "V_MPEG4/ISO/AVC"
+#define VIDEO_CODEC_NAME_H264 "V_MPEG4/ISO/AVC"
+#define VIDEO_CODEC_NAME_H265 "V_MPEGH/ISO/HEVC"
 #define VIDEO_TRACK_NAME "kvs video track"
 
 #define DEFAULT_CONNECTION_TIMEOUT_MS (10 * 1000)
@@ -43,10 +49,47 @@
 #define DEFAULT_PUT_MEDIA_RECV_TIMEOUT_MS (1 * 1000)
 #define DEFAULT_PUT_MEDIA_SEND_TIMEOUT_MS (1 * 1000)
 #define DEFAULT_RING_BUFFER_MEM_LIMIT (1 * 1024 * 1024)
+#define DEFAULT_ENDPOINT_CACHE_TTL_SEC (24 * 60 * 60)
+
+/* The IoT credential is refreshed in the background this long before it expires. */
+#define DEFAULT_IOT_CREDENTIAL_REFRESH_MARGIN_SEC (5 * 60)
+#define IOT_CREDENTIAL_RETRY_INTERVAL_MS (10 * 1000)
+#define IOT_CREDENTIAL_MAX_WAIT_MS (60 * 1000)
+
+/* The refresh margin is at most half of the credential lifetime, so a short-lived credential is not refreshed as soon as
+ * it's fetched. */
+#define IOT_CREDENTIAL_MAX_MARGIN_DIVISOR (2)
+
+/* A credential without known expiration is refreshed after this time. It's shorter than the shortest credential duration
+ * of the IoT credential provider, which is 15 minutes. */
+#define IOT_CREDENTIAL_UNKNOWN_EXPIRATION_TTL_MS (10 * 60 * 1000)
+
+/* Per-frame records are reserved for every this many bytes of the ring buffer memory limit. */
+#define DATA_FRAME_SLAB_BYTES_PER_FRAME (2 * 1024)
+#define DEFAULT_DATA_FRAME_SLAB_COUNT (256)
+
+/* The longest time that the sender waits for a new data frame, so incoming fragment ACKs still get handled. */
+#define SEND_WAKEUP_TIMEOUT_MS (50)
+
+/* The reconnect backoff. The delay doubles on every failure up to the max delay, and the jitter is a percentage of it. */
+#define DEFAULT_RECONNECT_BASE_DELAY_MS (1 * 1000)
+#define DEFAULT_RECONNECT_MAX_DELAY_MS (60 * 1000)
+#define DEFAULT_RECONNECT_JITTER_PERCENT (50)
+#define RECONNECT_MAX_BACKOFF_SHIFT (16)
+
+/* The longest time that the previous session is kept open after a rotation, waiting for the ACK of its last fragment */
+#define PUT_MEDIA_DRAIN_TIMEOUT_MS (10 * 1000)
+
+/* Fragments that wait for fragment ACKs are tracked up to this count for the latency statistics. */
+#define LATENCY_PENDING_FRAGMENT_COUNT (32)
+
+/* A batch flushes the written data frames when this many of them wait for the flush. */
+#define SEND_BATCH_UNFLUSHED_FRAME_COUNT (32)
 
 typedef struct PolicyRingBufferParameter
 {
     size_t uMemLimit;
+    unsigned int uDurationLimitSec;
 } PolicyRingBufferParameter_t;
 
 typedef struct StreamStrategy
@@ -58,6 +101,44 @@ typedef struct StreamStrategy
     };
 } StreamStrategy_t;
 
+typedef struct ReconnectPolicy
+{
+    bool bAutoReconnect;
+    unsigned int uBaseDelayMs;
+    unsigned int uMaxDelayMs;
+    unsigned int uJitterPercent;
+    unsigned int uRotationIntervalSec;
+
+    /* Runtime states */
+    bool bReconnectPending;
+    unsigned int uFailureCount;
+    uint64_t uNextAttemptTimestamp;
+    uint32_t uRandomState;
+} ReconnectPolicy_t;
+
+typedef struct UnflushedFrame
+{
+    DataFrameHandle xDataFrameHandle;
+    uint64_t uSendStartTimestamp;
+} UnflushedFrame_t;
+
+typedef struct PendingFragment
+{
+    uint64_t uFragmentTimecode;
+    uint64_t uEnqueueTimestamp;
+} PendingFragment_t;
+
+typedef struct LatencyTracker
+{
+    LOCK_HANDLE xLock;
+    KvsAppLatencyStats_t xStats;
+
+    /* A ring of fragments that wait for fragment ACKs, from the oldest to the latest */
+    PendingFragment_t xPendingFragments[LATENCY_PENDING_FRAGMENT_COUNT];
+    size_t uPendingHead;
+    size_t uPendingCount;
+} LatencyTracker_t;
+
 typedef struct OnMkvSentCallbackInfo
 {
     OnMkvSentCallback_t onMkvSentCallback;
@@ -74,6 +155,11 @@ typedef struct KvsApp
     char *pStreamName;
     char *pDataEndpoint;
 
+    /* The data endpoint is loaded from the cache file if it's set, and it's revalidated only if PUT MEDIA fails. */
+    char *pEndpointCacheFile;
+    unsigned int uEndpointCacheTtlSec;
+    bool bEndpointFromCache;
+
     /* AWS access key, access secret and session token */
     char *pAwsAccessKeyId;
     char *pAwsSecretAccessKey;
@@ -87,6 +173,20 @@ typedef struct KvsApp
     char *pIotX509Certificate;
     char *pIotX509PrivateKey;
     IotCredentialToken_t *pToken;
+    uint64_t uTokenFetchTimestamp;
+
+    /* The IoT credential is reused until the refresh margin before it expires, and a background thread refreshes it.
+     * pToken and the credential in xServicePara are protected by xCredentialLock. */
+    LOCK_HANDLE xCredentialLock;
+    COND_HANDLE xCredentialCond;
+    THREAD_HANDLE xCredentialThread;
+    bool bCredentialThreadStopping;
+    unsigned int uCredentialRefreshMarginSec;
+
+    /* A reference to the process-wide TLS context that is shared by all connections. It's re-acquired on open if the
+     * certificates have changed. */
+    TlsContextHandle xTlsContext;
+    bool bTlsContextStale;
 
     /* Restful request parameters */
     KvsServiceParameter_t xServicePara;
@@ -100,17 +200,60 @@ typedef struct KvsApp
     /* KVS streaming variables */
     uint64_t uEarliestTimestamp;
     StreamHandle xStreamHandle;
+    SlabHandle xUserDataSlab;
     PutMediaHandle xPutMediaHandle;
     bool isEbmlHeaderUpdated;
     StreamStrategy_t xStrategy;
 
+    /* The replacement PUT MEDIA session is opened by a helper thread ahead of a planned rotation, so its handshake
+     * doesn't stall the current session. xNextPutMediaHandle and bNextPutMediaDone are protected by xLock. */
+    THREAD_HANDLE xNextPutMediaThread;
+    bool bNextPutMediaDone;
+    PutMediaHandle xNextPutMediaHandle;
+    uint64_t uPutMediaStartTimestamp;
+    ReconnectPolicy_t xReconnect;
+
+    /* The previous session after a rotation. Its body is ended, and it's kept open until the ACK of its last fragment
+     * arrives or the drain deadline passes, so the fragments in flight still get persisted and their ACKs delivered. */
+    PutMediaHandle xDrainingPutMediaHandle;
+    uint64_t uDrainDeadline;
+    uint64_t uDrainLastFragmentTimecode;
+    bool bDrainComplete;
+
+    /* The timecode of the last fragment that is started on the current session */
+    uint64_t uLastSentFragmentTimecode;
+
+    /* Latency statistics from adding frames to fragment ACKs */
+    LatencyTracker_t xLatency;
+
+    /* Data frames that are written in a batch but not flushed yet. They are released after the flush. */
+    UnflushedFrame_t xUnflushedFrames[SEND_BATCH_UNFLUSHED_FRAME_COUNT];
+    size_t uUnflushedFrameCount;
+
+    /* Wake up the sender when a data frame is added */
+    LOCK_HANDLE xSendWakeupLock;
+    COND_HANDLE xSendWakeupCond;
+    bool bSendWakeupPending;
+
+    /* The sender thread that is started by KvsApp_startSender(). The stop flag and drain timeout are protected by xSendWakeupLock. */
+    THREAD_HANDLE xSenderThread;
+    bool bSenderStopping;
+    unsigned int uSenderDrainTimeoutMs;
+    SenderCallbacks_t xSenderCallbacks;
+
     /* Track information */
+    VideoCodec_t xVideoCodec;
     VideoTrackInfo_t *pVideoTrackInfo;
+    uint8_t *pVps;
+    size_t uVpsLen;
     uint8_t *pSps;
     size_t uSpsLen;
     uint8_t *pPps;
     size_t uPpsLen;
 
+    /* The NALU index of video frames. It's kept across frames, so a table grown for a frame with many NALUs is reused. */
+    NaluIndex_t xNaluIndex;
+
     bool isAudioTrackPresent;
     AudioTrackInfo_t *pAudioTrackInfo;
 
@@ -121,6 +264,9 @@ typedef struct KvsApp
 typedef struct DataFrameUserData
 {
     DataFrameCallbacks_t xCallbacks;
+
+    /* The time when the frame is added, for the latency statistics */
+    uint64_t uEnqueueTimestamp;
 } DataFrameUserData_t;
 
 /**
@@ -163,6 +309,19 @@ static void prvCallOnDataFrameTerminate(DataFrameIn_t *pDataFrameIn)
     }
 }
 
+static void prvOnDataFrameEvicted(DataFrameHandle xDataFrameHandle, void *pAppData)
+{
+    KvsApp_t *pKvs = (KvsApp_t *)pAppData;
+    DataFrameIn_t *pDataFrameIn = (DataFrameIn_t *)xDataFrameHandle;
+
+    prvCallOnDataFrameTerminate(pDataFrameIn);
+    if (pDataFrameIn->pUserData != NULL)
+    {
+        Slab_free(pKvs->xUserDataSlab, pDataFrameIn->pUserData);
+    }
+    Kvs_dataFrameTerminate(xDataFrameHandle);
+}
+
 static void prvVideoTrackInfoTerminate(VideoTrackInfo_t *pVideoTrackInfo)
 {
     if (pVideoTrackInfo != NULL)
@@ -274,7 +433,7 @@ static void prvStreamFlush(KvsApp_t *pKvs)
         prvCallOnDataFrameTerminate(pDataFrameIn);
         if (pDataFrameIn->pUserData != NULL)
         {
-            kvsFree(pDataFrameIn->pUserData);
+            Slab_free(pKvs->xUserDataSlab, pDataFrameIn->pUserData);
         }
         Kvs_dataFrameTerminate(xDataFrameHandle);
     }
@@ -285,61 +444,34 @@ static int prvStreamFlushToNextCluster(KvsApp_t *pKvs)
     int res = KVS_ERRNO_NONE;
     StreamHandle xStreamHandle = pKvs->xStreamHandle;
     DataFrameHandle xDataFrameHandle = NULL;
-    DataFrameIn_t *pDataFrameIn = NULL;
 
-    while (1)
+    if (xStreamHandle == NULL)
     {
-        if (xStreamHandle == NULL)
-        {
-            res = KVS_ERROR_INVALID_ARGUMENT;
-            break;
-        }
-        else if ((xDataFrameHandle = Kvs_streamPeek(xStreamHandle)) == NULL)
-        {
-            res = KVS_ERROR_STREAM_NO_AVAILABLE_DATA_FRAME;
-            break;
-        }
-        else
-        {
-            pDataFrameIn = (DataFrameIn_t *)xDataFrameHandle;
-            if (pDataFrameIn->xClusterType == MKV_CLUSTER)
-            {
-                pKvs->uEarliestTimestamp = pDataFrameIn->uTimestampMs;
-                break;
-            }
-            else
-            {
-                xDataFrameHandle = Kvs_streamPop(xStreamHandle);
-                pDataFrameIn = (DataFrameIn_t *)xDataFrameHandle;
-                prvCallOnDataFrameTerminate(pDataFrameIn);
-                if (pDataFrameIn->pUserData != NULL)
-                {
-                    kvsFree(pDataFrameIn->pUserData);
-                }
-                Kvs_dataFrameTerminate(xDataFrameHandle);
-            }
-        }
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else if ((res = Kvs_streamEvictHeadless(xStreamHandle, prvOnDataFrameEvicted, pKvs)) != KVS_ERRNO_NONE)
+    {
+        /* Propagate the res error */
+    }
+    else if ((xDataFrameHandle = Kvs_streamPeek(xStreamHandle)) == NULL)
+    {
+        res = KVS_ERROR_STREAM_NO_AVAILABLE_DATA_FRAME;
+    }
+    else
+    {
+        pKvs->uEarliestTimestamp = ((DataFrameIn_t *)xDataFrameHandle)->uTimestampMs;
     }
 
     return res;
 }
 
-static void prvStreamFlushHeadUntilMem(KvsApp_t *pKvs, size_t uMemLimit)
+static void prvStreamEvictGops(KvsApp_t *pKvs)
 {
-    StreamHandle xStreamHandle = pKvs->xStreamHandle;
-    DataFrameHandle xDataFrameHandle = NULL;
-    DataFrameIn_t *pDataFrameIn = NULL;
-    size_t uMemTotal = 0;
+    PolicyRingBufferParameter_t *pxRingBufferPara = &(pKvs->xStrategy.xRingBufferPara);
 
-    while (Kvs_streamMemStatTotal(xStreamHandle, &uMemTotal) == 0 && uMemTotal > uMemLimit && (xDataFrameHandle = Kvs_streamPop(xStreamHandle)) != NULL)
+    if (Kvs_streamEvictGops(pKvs->xStreamHandle, pxRingBufferPara->uMemLimit, (uint64_t)(pxRingBufferPara->uDurationLimitSec) * 1000, prvOnDataFrameEvicted, pKvs) != KVS_ERRNO_NONE)
     {
-        pDataFrameIn = (DataFrameIn_t *)xDataFrameHandle;
-        prvCallOnDataFrameTerminate(pDataFrameIn);
-        if (pDataFrameIn->pUserData != NULL)
-        {
-            kvsFree(pDataFrameIn->pUserData);
-        }
-        Kvs_dataFrameTerminate(xDataFrameHandle);
+        LogError("Failed to evict GOPs");
     }
 }
 
@@ -439,33 +571,216 @@ static bool isIotCertAvailable(KvsApp_t *pKvs)
     }
 }
 
-static void updateIotCredential(KvsApp_t *pKvs)
+static void prvTlsContextRelease(KvsApp_t *pKvs)
+{
+    if (pKvs->xTlsContext != NULL)
+    {
+        TlsContext_release(pKvs->xTlsContext);
+        pKvs->xTlsContext = NULL;
+    }
+}
+
+static void setupTlsContext(KvsApp_t *pKvs)
+{
+    if (pKvs->bTlsContextStale)
+    {
+        prvTlsContextRelease(pKvs);
+        pKvs->bTlsContextStale = false;
+    }
+
+    if (pKvs->xTlsContext == NULL)
+    {
+        if (isIotCertAvailable(pKvs))
+        {
+            pKvs->xTlsContext = TlsContext_acquire(pKvs->pIotX509RootCa, pKvs->pIotX509Certificate, pKvs->pIotX509PrivateKey);
+        }
+        else
+        {
+            pKvs->xTlsContext = TlsContext_acquire(NULL, NULL, NULL);
+        }
+
+        if (pKvs->xTlsContext == NULL)
+        {
+            /* It's not fatal. Connections set up their own TLS context if there is no shared one. */
+            LogInfo("Failed to create shared TLS context");
+        }
+    }
+}
+
+static uint64_t prvIotCredentialRefreshTimestamp(KvsApp_t *pKvs)
+{
+    uint64_t uMarginMs = (uint64_t)(pKvs->uCredentialRefreshMarginSec) * 1000;
+    uint64_t uLifetimeMs = 0;
+
+    if (pKvs->pToken == NULL)
+    {
+        return 0;
+    }
+    else if (pKvs->pToken->uExpirationMs == 0)
+    {
+        /* The expiration is unknown, so it's refreshed after a fixed time. */
+        return pKvs->uTokenFetchTimestamp + IOT_CREDENTIAL_UNKNOWN_EXPIRATION_TTL_MS;
+    }
+    else
+    {
+        /* A margin longer than the lifetime would refresh the credential on every retry. */
+        uLifetimeMs = (pKvs->pToken->uExpirationMs > pKvs->uTokenFetchTimestamp) ? (pKvs->pToken->uExpirationMs - pKvs->uTokenFetchTimestamp) : 0;
+        if (uMarginMs > uLifetimeMs / IOT_CREDENTIAL_MAX_MARGIN_DIVISOR)
+        {
+            uMarginMs = uLifetimeMs / IOT_CREDENTIAL_MAX_MARGIN_DIVISOR;
+        }
+        return pKvs->pToken->uExpirationMs - uMarginMs;
+    }
+}
+
+static bool prvIsIotCredentialFresh(KvsApp_t *pKvs)
+{
+    bool bFresh = false;
+
+    if (Lock(pKvs->xCredentialLock) != LOCK_OK)
+    {
+        LogError("Failed to lock");
+    }
+    else
+    {
+        bFresh = getEpochTimestampInMs() < prvIotCredentialRefreshTimestamp(pKvs);
+        Unlock(pKvs->xCredentialLock);
+    }
+
+    return bFresh;
+}
+
+/**
+ * Get a new IoT credential, and replace the current one on success. The current one is kept on failure, because it may
+ * still be valid until it expires.
+ *
+ * @param[in] pKvs KVS application
+ * @param[in] xTlsContext The TLS context for the connection, or NULL if the connection sets up its own
+ */
+static void updateIotCredential(KvsApp_t *pKvs, TlsContextHandle xTlsContext)
 {
     IotCredentialToken_t *pToken = NULL;
+    uint64_t uFetchTimestamp = getEpochTimestampInMs();
     IotCredentialRequest_t xIotCredentialReq = {
         .pCredentialHost = pKvs->pIotCredentialHost,
         .pRoleAlias = pKvs->pIotRoleAlias,
         .pThingName = pKvs->pIotThingName,
         .pRootCA = pKvs->pIotX509RootCa,
         .pCertificate = pKvs->pIotX509Certificate,
-        .pPrivateKey = pKvs->pIotX509PrivateKey};
+        .pPrivateKey = pKvs->pIotX509PrivateKey,
+        .xTlsContext = xTlsContext};
 
     if (isIotCertAvailable(pKvs))
     {
-        Iot_credentialTerminate(pKvs->pToken);
-        pKvs->pToken = NULL;
-
         if ((pToken = Iot_getCredential(&xIotCredentialReq)) == NULL)
         {
             LogError("Failed to get Iot credential");
         }
+        else if (Lock(pKvs->xCredentialLock) != LOCK_OK)
+        {
+            LogError("Failed to lock");
+            Iot_credentialTerminate(pToken);
+        }
         else
         {
+            Iot_credentialTerminate(pKvs->pToken);
             pKvs->pToken = pToken;
+            pKvs->uTokenFetchTimestamp = uFetchTimestamp;
+            Unlock(pKvs->xCredentialLock);
+        }
+    }
+}
+
+static int prvCredentialThread(void *pArg)
+{
+    KvsApp_t *pKvs = (KvsApp_t *)pArg;
+    uint64_t uNow = 0;
+    uint64_t uRefreshTimestamp = 0;
+    uint64_t uRetryTimestamp = 0;
+    uint64_t uWaitMs = 0;
+    TlsContextHandle xTlsContext = NULL;
+
+    /* The thread holds its own reference to the process-wide TLS context for its lifetime, so a refresh neither parses
+     * the certificates nor seeds a random generator again, and it resumes the TLS session of the previous refresh. */
+    if ((xTlsContext = TlsContext_acquire(pKvs->pIotX509RootCa, pKvs->pIotX509Certificate, pKvs->pIotX509PrivateKey)) == NULL)
+    {
+        LogInfo("Failed to acquire TLS context for IoT credential refresh");
+    }
+
+    if (Lock(pKvs->xCredentialLock) != LOCK_OK)
+    {
+        LogError("Failed to lock");
+        TlsContext_release(xTlsContext);
+        return 0;
+    }
+
+    while (!pKvs->bCredentialThreadStopping)
+    {
+        uNow = getEpochTimestampInMs();
+        uRefreshTimestamp = prvIotCredentialRefreshTimestamp(pKvs);
+        if (uRefreshTimestamp < uRetryTimestamp)
+        {
+            uRefreshTimestamp = uRetryTimestamp;
+        }
+
+        if (uNow < uRefreshTimestamp)
+        {
+            uWaitMs = uRefreshTimestamp - uNow;
+            Condition_Wait(pKvs->xCredentialCond, pKvs->xCredentialLock, (int)((uWaitMs < IOT_CREDENTIAL_MAX_WAIT_MS) ? uWaitMs : IOT_CREDENTIAL_MAX_WAIT_MS));
+        }
+        else
+        {
+            /* The request runs without the lock, so opening and reconnecting are not blocked by it. */
+            Unlock(pKvs->xCredentialLock);
+            LogInfo("Refresh IoT credential");
+            updateIotCredential(pKvs, xTlsContext);
+            if (Lock(pKvs->xCredentialLock) != LOCK_OK)
+            {
+                LogError("Failed to lock");
+                TlsContext_release(xTlsContext);
+                return 0;
+            }
+
+            /* Retry later if the credential is not refreshed. */
+            uRetryTimestamp = getEpochTimestampInMs() + IOT_CREDENTIAL_RETRY_INTERVAL_MS;
+        }
+    }
+
+    Unlock(pKvs->xCredentialLock);
+    TlsContext_release(xTlsContext);
+
+    return 0;
+}
+
+static void prvStartCredentialThread(KvsApp_t *pKvs)
+{
+    if (pKvs->xCredentialThread == NULL && isIotCertAvailable(pKvs) && pKvs->uCredentialRefreshMarginSec > 0)
+    {
+        pKvs->bCredentialThreadStopping = false;
+        if (ThreadAPI_Create(&(pKvs->xCredentialThread), prvCredentialThread, pKvs) != THREADAPI_OK)
+        {
+            /* It's not fatal. The credential is refreshed on open when it's about to expire. */
+            LogInfo("Failed to create IoT credential thread");
+            pKvs->xCredentialThread = NULL;
         }
     }
 }
 
+static void prvStopCredentialThread(KvsApp_t *pKvs)
+{
+    int xThreadRes = 0;
+
+    if (pKvs->xCredentialThread != NULL && Lock(pKvs->xCredentialLock) == LOCK_OK)
+    {
+        pKvs->bCredentialThreadStopping = true;
+        Condition_Post(pKvs->xCredentialCond);
+        Unlock(pKvs->xCredentialLock);
+
+        ThreadAPI_Join(pKvs->xCredentialThread, &xThreadRes);
+        pKvs->xCredentialThread = NULL;
+    }
+}
+
 static int updateAndVerifyRestfulReqParameters(KvsApp_t *pKvs)
 {
     int res = KVS_ERRNO_NONE;
@@ -475,6 +790,7 @@ static int updateAndVerifyRestfulReqParameters(KvsApp_t *pKvs)
     pKvs->xServicePara.pcService = pKvs->pService;
     pKvs->xServicePara.uRecvTimeoutMs = DEFAULT_CONNECTION_TIMEOUT_MS;
     pKvs->xServicePara.uSendTimeoutMs = DEFAULT_CONNECTION_TIMEOUT_MS;
+    pKvs->xServicePara.xTlsContext = pKvs->xTlsContext;
 
     if (pKvs->pToken != NULL)
     {
@@ -519,6 +835,7 @@ static int setupDataEndpoint(KvsApp_t *pKvs)
 {
     int res = KVS_ERRNO_NONE;
     unsigned int uHttpStatusCode = 0;
+    char *pcCachedEndpoint = NULL;
 
     if (pKvs == NULL)
     {
@@ -530,6 +847,18 @@ static int setupDataEndpoint(KvsApp_t *pKvs)
         {
             /* Since we already have the endpoint, we needn't update it again. */
         }
+        else if (pKvs->pEndpointCacheFile != NULL && EndpointCache_load(pKvs->pEndpointCacheFile, pKvs->pHost, pKvs->pStreamName, &pcCachedEndpoint) == KVS_ERRNO_NONE)
+        {
+            /* The stream exists if its endpoint is cached, so describing and creating stream are skipped as well. */
+            LogInfo("Use cached data endpoint");
+            if (pKvs->pDataEndpoint != NULL)
+            {
+                kvsFree(pKvs->pDataEndpoint);
+            }
+            pKvs->pDataEndpoint = pcCachedEndpoint;
+            pKvs->xServicePara.pcPutMediaEndpoint = pKvs->pDataEndpoint;
+            pKvs->bEndpointFromCache = true;
+        }
         else
         {
             LogInfo("Try to describe stream");
@@ -571,6 +900,14 @@ static int setupDataEndpoint(KvsApp_t *pKvs)
                 else
                 {
                     pKvs->xServicePara.pcPutMediaEndpoint = pKvs->pDataEndpoint;
+                    pKvs->bEndpointFromCache = false;
+
+                    if (pKvs->pEndpointCacheFile != NULL &&
+                        EndpointCache_store(pKvs->pEndpointCacheFile, pKvs->pHost, pKvs->pStreamName, pKvs->pDataEndpoint, pKvs->uEndpointCacheTtlSec) != KVS_ERRNO_NONE)
+                    {
+                        /* It's not fatal. The endpoint is fetched again on the next start. */
+                        LogInfo("Failed to store data endpoint cache");
+                    }
                 }
             }
         }
@@ -619,28 +956,59 @@ static int updateEbmlHeader(KvsApp_t *pKvs)
     return res;
 }
 
+static size_t prvGetDataFrameSlabCount(KvsApp_t *pKvs)
+{
+    size_t uDataFrameCount = DEFAULT_DATA_FRAME_SLAB_COUNT;
+
+    if (pKvs->xStrategy.xPolicy == STREAM_POLICY_RING_BUFFER && pKvs->xStrategy.xRingBufferPara.uMemLimit > 0)
+    {
+        uDataFrameCount = pKvs->xStrategy.xRingBufferPara.uMemLimit / DATA_FRAME_SLAB_BYTES_PER_FRAME;
+        if (uDataFrameCount == 0)
+        {
+            uDataFrameCount = 1;
+        }
+    }
+
+    return uDataFrameCount;
+}
+
+static bool prvHasParameterSets(KvsApp_t *pKvs)
+{
+    return pKvs->pSps != NULL && pKvs->pPps != NULL && (pKvs->xVideoCodec != VIDEO_CODEC_H265 || pKvs->pVps != NULL);
+}
+
 static int createStream(KvsApp_t *pKvs)
 {
     int res = KVS_ERRNO_NONE;
     VideoTrackInfo_t xVideoTrackInfo = {0};
     uint8_t *pCodecPrivateData = NULL;
     size_t uCodecPrivateDataLen = 0;
+    size_t uDataFrameCount = 0;
 
     if (pKvs->xStreamHandle == NULL)
     {
-        if (pKvs->pVideoTrackInfo == NULL && pKvs->pSps != NULL && pKvs->pPps != NULL)
+        if (pKvs->pVideoTrackInfo == NULL && prvHasParameterSets(pKvs))
         {
-            /* We don't have video track info, but we have SPS & PPS to generate video track info from it. */
-            if ((res = NALU_getH264VideoResolutionFromSps(pKvs->pSps, pKvs->uSpsLen, &(xVideoTrackInfo.uWidth), &(xVideoTrackInfo.uHeight))) != KVS_ERRNO_NONE ||
-                (res = Mkv_generateH264CodecPrivateDataFromSpsPps(pKvs->pSps, pKvs->uSpsLen, pKvs->pPps, pKvs->uPpsLen, &pCodecPrivateData, &uCodecPrivateDataLen)) != KVS_ERRNO_NONE)
+            /* We don't have video track info, but we have parameter sets to generate video track info from it. */
+            if (pKvs->xVideoCodec == VIDEO_CODEC_H265 &&
+                ((res = NALU_getH265VideoResolutionFromSps(pKvs->pSps, pKvs->uSpsLen, &(xVideoTrackInfo.uWidth), &(xVideoTrackInfo.uHeight))) != KVS_ERRNO_NONE ||
+                 (res = Mkv_generateH265CodecPrivateDataFromVpsSpsPps(
+                      pKvs->pVps, pKvs->uVpsLen, pKvs->pSps, pKvs->uSpsLen, pKvs->pPps, pKvs->uPpsLen, &pCodecPrivateData, &uCodecPrivateDataLen)) != KVS_ERRNO_NONE))
+            {
+                LogError("Failed to generate video track info");
+                /* Propagate the res error */
+            }
+            else if (pKvs->xVideoCodec == VIDEO_CODEC_H264 &&
+                ((res = NALU_getH264VideoResolutionFromSps(pKvs->pSps, pKvs->uSpsLen, &(xVideoTrackInfo.uWidth), &(xVideoTrackInfo.uHeight))) != KVS_ERRNO_NONE ||
+                 (res = Mkv_generateH264CodecPrivateDataFromSpsPps(pKvs->pSps, pKvs->uSpsLen, pKvs->pPps, pKvs->uPpsLen, &pCodecPrivateData, &uCodecPrivateDataLen)) != KVS_ERRNO_NONE))
             {
                 LogError("Failed to generate video track info");
                 /* Propagate the res error */
             }
             else
             {
+                xVideoTrackInfo.pCodecName = (pKvs->xVideoCodec == VIDEO_CODEC_H265) ? VIDEO_CODEC_NAME_H265 : VIDEO_CODEC_NAME_H264;
                 xVideoTrackInfo.pTrackName = VIDEO_TRACK_NAME;
-                xVideoTrackInfo.pCodecName = VIDEO_CODEC_NAME;
                 xVideoTrackInfo.pCodecPrivate = pCodecPrivateData;
                 xVideoTrackInfo.uCodecPrivateLen = uCodecPrivateDataLen;
                 pKvs->pVideoTrackInfo = prvCopyVideoTrackInfo(&xVideoTrackInfo);
@@ -662,6 +1030,14 @@ static int createStream(KvsApp_t *pKvs)
             {
                 LogInfo("KVS stream buffer created");
 
+                /* Without the slabs, per-frame records fall back to the heap. */
+                uDataFrameCount = prvGetDataFrameSlabCount(pKvs);
+                if (Kvs_streamReserveDataFrames(pKvs->xStreamHandle, uDataFrameCount) != KVS_ERRNO_NONE ||
+                    (pKvs->xUserDataSlab = Slab_create(sizeof(DataFrameUserData_t), uDataFrameCount)) == NULL)
+                {
+                    LogInfo("Failed to reserve %u data frames", (unsigned int)uDataFrameCount);
+                }
+
                 pKvs->isAudioTrackPresent = (pKvs->pAudioTrackInfo != NULL);
             }
         }
@@ -670,9 +1046,39 @@ static int createStream(KvsApp_t *pKvs)
     return res;
 }
 
-static int checkAndBuildStream(KvsApp_t *pKvs, uint8_t *pData, size_t uDataLen, TrackType_t xTrackType)
+static int prvIndexVideoFrame(VideoCodec_t xCodec, uint8_t *pData, size_t *puDataLen, size_t uDataSize, NaluIndex_t *pxNaluIndex)
+{
+    int res = KVS_ERRNO_NONE;
+    uint32_t uAvccLen = 0;
+
+    /* The frame is walked only once, and everything afterwards uses the index. */
+    if ((res = NALU_buildIndexWithCodec(pData, *puDataLen, xCodec, pxNaluIndex)) != KVS_ERRNO_NONE)
+    {
+        LogError("Failed to parse NALUs");
+        /* Propagate the res error */
+    }
+    else if (pxNaluIndex->bIsAnnexB)
+    {
+        if ((res = NALU_convertAnnexBToAvccInPlaceWithIndex(pData, (uDataSize > UINT32_MAX) ? UINT32_MAX : (uint32_t)uDataSize, pxNaluIndex, &uAvccLen)) != KVS_ERRNO_NONE)
+        {
+            LogError("Failed to convert Annex-B to Avcc in place");
+            /* Propagate the res error */
+        }
+        else
+        {
+            *puDataLen = uAvccLen;
+        }
+    }
+
+    return res;
+}
+
+static int checkAndBuildStream(KvsApp_t *pKvs, uint8_t *pData, const NaluIndex_t *pxNaluIndex, TrackType_t xTrackType)
 {
     int res = KVS_ERRNO_NONE;
+    bool bIsH265 = (pKvs->xVideoCodec == VIDEO_CODEC_H265);
+    uint8_t *pVps = NULL;
+    size_t uVpsLen = 0;
     uint8_t *pSps = NULL;
     size_t uSpsLen = 0;
     uint8_t *pPps = NULL;
@@ -683,7 +1089,19 @@ static int checkAndBuildStream(KvsApp_t *pKvs, uint8_t *pData, size_t uDataLen,
         /* Try to build video track info from frames. */
         if (pKvs->pVideoTrackInfo == NULL && xTrackType == TRACK_VIDEO)
         {
-            if (pKvs->pSps == NULL && NALU_getNaluFromAvccNalus(pData, uDataLen, NALU_TYPE_SPS, &pSps, &uSpsLen) == KVS_ERRNO_NONE)
+            if (bIsH265 && pKvs->pVps == NULL && NALU_getNaluFromIndex(pxNaluIndex, pData, NALU_TYPE_HEVC_VPS, &pVps, &uVpsLen) == KVS_ERRNO_NONE)
+            {
+                LogInfo("VPS is found");
+                if ((res = prvBufMallocAndCopy(&(pKvs->pVps), &(pKvs->uVpsLen), pVps, uVpsLen)) != KVS_ERRNO_NONE)
+                {
+                    /* Propagate the res error */
+                }
+                else
+                {
+                    LogInfo("VPS is set");
+                }
+            }
+            if (pKvs->pSps == NULL && NALU_getNaluFromIndex(pxNaluIndex, pData, bIsH265 ? NALU_TYPE_HEVC_SPS : NALU_TYPE_SPS, &pSps, &uSpsLen) == KVS_ERRNO_NONE)
             {
                 LogInfo("SPS is found");
                 if ((res = prvBufMallocAndCopy(&(pKvs->pSps), &(pKvs->uSpsLen), pSps, uSpsLen)) != KVS_ERRNO_NONE)
@@ -695,7 +1113,7 @@ static int checkAndBuildStream(KvsApp_t *pKvs, uint8_t *pData, size_t uDataLen,
                     LogInfo("SPS is set");
                 }
             }
-            if (pKvs->pPps == NULL && NALU_getNaluFromAvccNalus(pData, uDataLen, NALU_TYPE_PPS, &pPps, &uPpsLen) == KVS_ERRNO_NONE)
+            if (pKvs->pPps == NULL && NALU_getNaluFromIndex(pxNaluIndex, pData, bIsH265 ? NALU_TYPE_HEVC_PPS : NALU_TYPE_PPS, &pPps, &uPpsLen) == KVS_ERRNO_NONE)
             {
                 LogInfo("PPS is found");
                 if ((res = prvBufMallocAndCopy(&(pKvs->pPps), &(pKvs->uPpsLen), pPps, uPpsLen)) != KVS_ERRNO_NONE)
@@ -709,7 +1127,7 @@ static int checkAndBuildStream(KvsApp_t *pKvs, uint8_t *pData, size_t uDataLen,
             }
         }
 
-        if (pKvs->pSps != NULL && pKvs->pPps != NULL)
+        if (prvHasParameterSets(pKvs))
         {
             res = createStream(pKvs);
         }
@@ -748,49 +1166,202 @@ static int prvCheckOnDataFrameToBeSent(DataFrameHandle xDataFrameHandle)
     return res;
 }
 
-static int prvPutMediaSendData(KvsApp_t *pKvs, int *pxSendCnt, bool bForceSend)
+static uint64_t prvElapsedMs(uint64_t uFromTimestamp, uint64_t uToTimestamp)
 {
-    int res = KVS_ERRNO_NONE;
-    int retVal = 0;
-    DataFrameHandle xDataFrameHandle = NULL;
-    DataFrameIn_t *pDataFrameIn = NULL;
-    uint8_t *pData = NULL;
-    size_t uDataLen = 0;
-    uint8_t *pMkvHeader = NULL;
-    size_t uMkvHeaderLen = 0;
-    int xSendCnt = 0;
+    /* The wall clock may be adjusted backwards. */
+    return (uToTimestamp > uFromTimestamp) ? (uToTimestamp - uFromTimestamp) : 0;
+}
 
-    if (pKvs->xStreamHandle != NULL &&
-        pKvs->isEbmlHeaderUpdated == true &&
-        Kvs_streamAvailOnTrack(pKvs->xStreamHandle, TRACK_VIDEO) &&
-        (!bForceSend || !pKvs->isAudioTrackPresent || Kvs_streamAvailOnTrack(pKvs->xStreamHandle, TRACK_AUDIO)))
+static void prvLatencyOnFrameSent(KvsApp_t *pKvs, DataFrameIn_t *pDataFrameIn, uint64_t uSendStartTimestamp, uint64_t uSendEndTimestamp)
+{
+    LatencyTracker_t *pxLatency = &(pKvs->xLatency);
+    DataFrameUserData_t *pUserData = (DataFrameUserData_t *)pDataFrameIn->pUserData;
+    PendingFragment_t *pxFragment = NULL;
+
+    if (pUserData != NULL && Lock(pxLatency->xLock) == LOCK_OK)
     {
-        if ((xDataFrameHandle = Kvs_streamPop(pKvs->xStreamHandle)) == NULL)
+        LatencyHistogram_record(&(pxLatency->xStats.xEnqueueToSendStart), prvElapsedMs(pUserData->uEnqueueTimestamp, uSendStartTimestamp));
+        LatencyHistogram_record(&(pxLatency->xStats.xSendDuration), prvElapsedMs(uSendStartTimestamp, uSendEndTimestamp));
+
+        /* A cluster is a fragment, and its timecode is the timestamp of its first frame. */
+        if (pDataFrameIn->xClusterType == MKV_CLUSTER)
         {
-            res = KVS_ERROR_STREAM_NO_AVAILABLE_DATA_FRAME;
-            LogError("Failed to get data frame");
+            if (pxLatency->uPendingCount == LATENCY_PENDING_FRAGMENT_COUNT)
+            {
+                pxLatency->uPendingHead = (pxLatency->uPendingHead + 1) % LATENCY_PENDING_FRAGMENT_COUNT;
+                pxLatency->uPendingCount--;
+                pxLatency->xStats.uUntrackedFragmentCount++;
+            }
+            pxFragment = &(pxLatency->xPendingFragments[(pxLatency->uPendingHead + pxLatency->uPendingCount) % LATENCY_PENDING_FRAGMENT_COUNT]);
+            pxFragment->uFragmentTimecode = pDataFrameIn->uTimestampMs;
+            pxFragment->uEnqueueTimestamp = pUserData->uEnqueueTimestamp;
+            pxLatency->uPendingCount++;
         }
-        else if ((res = prvCheckOnDataFrameToBeSent(xDataFrameHandle)) != KVS_ERRNO_NONE)
+
+        Unlock(pxLatency->xLock);
+    }
+}
+
+static void prvLatencyOnFragmentAck(KvsApp_t *pKvs, ePutMediaFragmentAckEventType eAckEventType, uint64_t uFragmentTimecode)
+{
+    LatencyTracker_t *pxLatency = &(pKvs->xLatency);
+    PendingFragment_t *pxFragment = NULL;
+    uint64_t uLatencyMs = 0;
+    size_t i = 0;
+
+    if ((eAckEventType == eBuffering || eAckEventType == eReceived || eAckEventType == ePersisted || eAckEventType == eError) &&
+        Lock(pxLatency->xLock) == LOCK_OK)
+    {
+        for (i = 0; i < pxLatency->uPendingCount; i++)
         {
-            LogInfo("Failed to check OnDataFrameToBeSent");
-            /* Propagate the res error */
+            pxFragment = &(pxLatency->xPendingFragments[(pxLatency->uPendingHead + i) % LATENCY_PENDING_FRAGMENT_COUNT]);
+            if (pxFragment->uFragmentTimecode == uFragmentTimecode)
+            {
+                break;
+            }
         }
-        else if ((res = Kvs_dataFrameGetContent(xDataFrameHandle, &pMkvHeader, &uMkvHeaderLen, &pData, &uDataLen)) != KVS_ERRNO_NONE)
+
+        if (i == pxLatency->uPendingCount)
         {
-            LogError("Failed to get data and mkv header to send");
-            /* Propagate the res error */
+            pxLatency->xStats.uUnmatchedAckCount++;
         }
-        else if ((res = Kvs_putMediaUpdate(pKvs->xPutMediaHandle, pMkvHeader, uMkvHeaderLen, pData, uDataLen)) != KVS_ERRNO_NONE)
+        else
         {
-            LogError("Failed to update");
-            /* Propagate the res error */
+            uLatencyMs = prvElapsedMs(pxFragment->uEnqueueTimestamp, getEpochTimestampInMs());
+            if (eAckEventType == eBuffering)
+            {
+                LatencyHistogram_record(&(pxLatency->xStats.xEnqueueToBuffering), uLatencyMs);
+            }
+            else if (eAckEventType == eReceived)
+            {
+                LatencyHistogram_record(&(pxLatency->xStats.xEnqueueToReceived), uLatencyMs);
+            }
+            else
+            {
+                if (eAckEventType == ePersisted)
+                {
+                    LatencyHistogram_record(&(pxLatency->xStats.xEnqueueToPersisted), uLatencyMs);
+                }
+                else
+                {
+                    pxLatency->xStats.uErrorFragmentCount++;
+                }
+
+                /* Fragments are acknowledged in order, so the fragments before this one won't get their ACKs. */
+                pxLatency->xStats.uUntrackedFragmentCount += (uint32_t)i;
+                pxLatency->uPendingHead = (pxLatency->uPendingHead + i + 1) % LATENCY_PENDING_FRAGMENT_COUNT;
+                pxLatency->uPendingCount -= i + 1;
+            }
+        }
+
+        Unlock(pxLatency->xLock);
+    }
+}
+
+static void prvReleaseDataFrame(KvsApp_t *pKvs, DataFrameHandle xDataFrameHandle)
+{
+    DataFrameIn_t *pDataFrameIn = (DataFrameIn_t *)xDataFrameHandle;
+
+    prvCallOnDataFrameTerminate(pDataFrameIn);
+    if (pDataFrameIn->pUserData != NULL)
+    {
+        Slab_free(pKvs->xUserDataSlab, pDataFrameIn->pUserData);
+    }
+    Kvs_dataFrameTerminate(xDataFrameHandle);
+}
+
+/**
+ * Release the data frames that are written in a batch.
+ *
+ * @param[in] pKvs KVS application
+ * @param[in] bFlushed true if they are flushed, so their send latency is recorded
+ */
+static void prvReleaseUnflushedFrames(KvsApp_t *pKvs, bool bFlushed)
+{
+    uint64_t uSendEndTimestamp = getEpochTimestampInMs();
+    UnflushedFrame_t *pxFrame = NULL;
+    size_t i = 0;
+
+    for (i = 0; i < pKvs->uUnflushedFrameCount; i++)
+    {
+        pxFrame = &(pKvs->xUnflushedFrames[i]);
+        if (bFlushed)
+        {
+            prvLatencyOnFrameSent(pKvs, (DataFrameIn_t *)(pxFrame->xDataFrameHandle), pxFrame->uSendStartTimestamp, uSendEndTimestamp);
+        }
+        prvReleaseDataFrame(pKvs, pxFrame->xDataFrameHandle);
+    }
+    pKvs->uUnflushedFrameCount = 0;
+}
+
+static int prvPutMediaFlushUnflushedFrames(KvsApp_t *pKvs)
+{
+    int res = KVS_ERRNO_NONE;
+
+    if (pKvs->uUnflushedFrameCount > 0)
+    {
+        res = Kvs_putMediaFlush(pKvs->xPutMediaHandle);
+        prvReleaseUnflushedFrames(pKvs, res == KVS_ERRNO_NONE);
+    }
+
+    return res;
+}
+
+static int prvPutMediaSendData(KvsApp_t *pKvs, int *pxSendCnt, size_t *puSendBytes, bool bForceSend, bool bFlush)
+{
+    int res = KVS_ERRNO_NONE;
+    int retVal = 0;
+    DataFrameHandle xDataFrameHandle = NULL;
+    DataFrameIn_t *pDataFrameIn = NULL;
+    uint8_t *pData = NULL;
+    size_t uDataLen = 0;
+    uint8_t *pMkvHeader = NULL;
+    size_t uMkvHeaderLen = 0;
+    int xSendCnt = 0;
+    size_t uSendBytes = 0;
+    uint64_t uSendStartTimestamp = 0;
+
+    if (pKvs->xStreamHandle != NULL &&
+        pKvs->isEbmlHeaderUpdated == true &&
+        Kvs_streamAvailOnTrack(pKvs->xStreamHandle, TRACK_VIDEO) &&
+        (!bForceSend || !pKvs->isAudioTrackPresent || Kvs_streamAvailOnTrack(pKvs->xStreamHandle, TRACK_AUDIO)))
+    {
+        uSendStartTimestamp = getEpochTimestampInMs();
+        if ((xDataFrameHandle = Kvs_streamPop(pKvs->xStreamHandle)) == NULL)
+        {
+            res = KVS_ERROR_STREAM_NO_AVAILABLE_DATA_FRAME;
+            LogError("Failed to get data frame");
+        }
+        else if ((res = prvCheckOnDataFrameToBeSent(xDataFrameHandle)) != KVS_ERRNO_NONE)
+        {
+            LogInfo("Failed to check OnDataFrameToBeSent");
+            /* Propagate the res error */
+        }
+        else if ((res = Kvs_dataFrameGetContent(xDataFrameHandle, &pMkvHeader, &uMkvHeaderLen, &pData, &uDataLen)) != KVS_ERRNO_NONE)
+        {
+            LogError("Failed to get data and mkv header to send");
+            /* Propagate the res error */
+        }
+        else if ((res = Kvs_putMediaUpdateEx(pKvs->xPutMediaHandle, pMkvHeader, uMkvHeaderLen, pData, uDataLen, bFlush)) != KVS_ERRNO_NONE)
+        {
+            LogError("Failed to update");
+            /* Propagate the res error */
         }
         else
         {
             pDataFrameIn = (DataFrameIn_t *)xDataFrameHandle;
             pKvs->uEarliestTimestamp = pDataFrameIn->uTimestampMs;
+            if (pDataFrameIn->xClusterType == MKV_CLUSTER)
+            {
+                pKvs->uLastSentFragmentTimecode = pDataFrameIn->uTimestampMs;
+            }
+            if (bFlush)
+            {
+                prvLatencyOnFrameSent(pKvs, pDataFrameIn, uSendStartTimestamp, getEpochTimestampInMs());
+            }
 
             xSendCnt++;
+            uSendBytes = uMkvHeaderLen + uDataLen;
 
             if (pKvs->onMkvSentCallbackInfo.onMkvSentCallback != NULL)
             {
@@ -812,13 +1383,17 @@ static int prvPutMediaSendData(KvsApp_t *pKvs, int *pxSendCnt, bool bForceSend)
 
         if (xDataFrameHandle != NULL)
         {
-            pDataFrameIn = (DataFrameIn_t *)xDataFrameHandle;
-            prvCallOnDataFrameTerminate(pDataFrameIn);
-            if (pDataFrameIn->pUserData != NULL)
+            if (res == KVS_ERRNO_NONE && !bFlush)
             {
-                kvsFree(pDataFrameIn->pUserData);
+                /* The frame is not on the wire until the flush, so it's released after that. */
+                pKvs->xUnflushedFrames[pKvs->uUnflushedFrameCount].xDataFrameHandle = xDataFrameHandle;
+                pKvs->xUnflushedFrames[pKvs->uUnflushedFrameCount].uSendStartTimestamp = uSendStartTimestamp;
+                pKvs->uUnflushedFrameCount++;
+            }
+            else
+            {
+                prvReleaseDataFrame(pKvs, xDataFrameHandle);
             }
-            Kvs_dataFrameTerminate(xDataFrameHandle);
         }
     }
 
@@ -827,9 +1402,512 @@ static int prvPutMediaSendData(KvsApp_t *pKvs, int *pxSendCnt, bool bForceSend)
         *pxSendCnt = xSendCnt;
     }
 
+    if (puSendBytes != NULL)
+    {
+        *puSendBytes = uSendBytes;
+    }
+
+    return res;
+}
+
+static void prvSendWakeupSignal(KvsApp_t *pKvs)
+{
+    if (Lock(pKvs->xSendWakeupLock) != LOCK_OK)
+    {
+        LogError("Failed to lock");
+    }
+    else
+    {
+        pKvs->bSendWakeupPending = true;
+        Condition_Post(pKvs->xSendWakeupCond);
+        Unlock(pKvs->xSendWakeupLock);
+    }
+}
+
+static void prvSendWakeupWait(KvsApp_t *pKvs, int xTimeoutMs)
+{
+    if (Lock(pKvs->xSendWakeupLock) != LOCK_OK)
+    {
+        LogError("Failed to lock");
+        sleepInMs(xTimeoutMs);
+    }
+    else
+    {
+        if (!pKvs->bSendWakeupPending)
+        {
+            Condition_Wait(pKvs->xSendWakeupCond, pKvs->xSendWakeupLock, xTimeoutMs);
+        }
+        pKvs->bSendWakeupPending = false;
+        Unlock(pKvs->xSendWakeupLock);
+    }
+}
+
+static uint32_t prvReconnectRandom(KvsApp_t *pKvs)
+{
+    uint32_t x = pKvs->xReconnect.uRandomState;
+    const char *pc = pKvs->pStreamName;
+    int i = 0;
+
+    if (x == 0)
+    {
+        /* Seed with the platform random source, the stream name and the time, so devices that fail together don't retry
+         * together. */
+        x = 2166136261U ^ (uint32_t)getEpochTimestampInMs();
+        for (i = 0; i < 4; i++)
+        {
+            x = (x ^ getRandomNumber()) * 16777619U;
+        }
+        while (pc != NULL && *pc != '\0')
+        {
+            x = (x ^ (uint8_t)(*pc++)) * 16777619U;
+        }
+        x = (x == 0) ? 1 : x;
+    }
+
+    /* xorshift32 */
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pKvs->xReconnect.uRandomState = x;
+
+    return x;
+}
+
+static unsigned int prvReconnectNextDelayMs(KvsApp_t *pKvs)
+{
+    ReconnectPolicy_t *pxReconnect = &(pKvs->xReconnect);
+    unsigned int uShift = (pxReconnect->uFailureCount > 0) ? pxReconnect->uFailureCount - 1 : 0;
+    uint64_t uDelayMs = 0;
+    uint64_t uJitterMs = 0;
+
+    if (uShift > RECONNECT_MAX_BACKOFF_SHIFT)
+    {
+        uShift = RECONNECT_MAX_BACKOFF_SHIFT;
+    }
+
+    uDelayMs = (uint64_t)(pxReconnect->uBaseDelayMs) << uShift;
+    if (uDelayMs > pxReconnect->uMaxDelayMs)
+    {
+        uDelayMs = pxReconnect->uMaxDelayMs;
+    }
+
+    uJitterMs = uDelayMs * pxReconnect->uJitterPercent / 100;
+    if (uJitterMs > 0)
+    {
+        uDelayMs -= prvReconnectRandom(pKvs) % (uJitterMs + 1);
+    }
+
+    return (unsigned int)uDelayMs;
+}
+
+static void prvReconnectOnFailure(KvsApp_t *pKvs)
+{
+    unsigned int uDelayMs = 0;
+
+    pKvs->xReconnect.uFailureCount++;
+    uDelayMs = prvReconnectNextDelayMs(pKvs);
+    pKvs->xReconnect.uNextAttemptTimestamp = getEpochTimestampInMs() + uDelayMs;
+    LogInfo("Reconnect attempt %u in %u ms", pKvs->xReconnect.uFailureCount, uDelayMs);
+}
+
+static void prvReconnectOnSuccess(KvsApp_t *pKvs)
+{
+    pKvs->xReconnect.uFailureCount = 0;
+    pKvs->xReconnect.uNextAttemptTimestamp = 0;
+}
+
+static unsigned int prvReconnectWaitMs(KvsApp_t *pKvs)
+{
+    uint64_t uNow = getEpochTimestampInMs();
+
+    return (uNow < pKvs->xReconnect.uNextAttemptTimestamp) ? (unsigned int)(pKvs->xReconnect.uNextAttemptTimestamp - uNow) : 0;
+}
+
+static int prvPutMediaStart(KvsApp_t *pKvs, PutMediaHandle *pxPutMediaHandle)
+{
+    int res = KVS_ERRNO_NONE;
+    unsigned int uHttpStatusCode = 0;
+
+    if ((res = Kvs_putMediaStart(&(pKvs->xServicePara), &(pKvs->xPutMediaPara), &uHttpStatusCode, pxPutMediaHandle)) != KVS_ERRNO_NONE)
+    {
+        LogError("Failed to setup PUT MEDIA");
+        /* Propagate the res error */
+    }
+    else if (uHttpStatusCode != 200)
+    {
+        res = KVS_GENERATE_RESTFUL_ERROR(uHttpStatusCode);
+        LogError("PUT MEDIA http status code:%d\n", uHttpStatusCode);
+    }
+
+    return res;
+}
+
+/**
+ * Join the helper thread that opens the next PUT MEDIA session. The send path only joins it after it's done, so it
+ * never waits for the handshake.
+ *
+ * @param[in] pKvs KVS application
+ * @param[in] bWait true to wait for the thread even if it's still opening the session
+ */
+static void prvPutMediaJoinNextThread(KvsApp_t *pKvs, bool bWait)
+{
+    bool bDone = bWait;
+    int xThreadRes = KVS_ERRNO_NONE;
+
+    if (pKvs->xNextPutMediaThread != NULL)
+    {
+        if (!bDone && Lock(pKvs->xLock) == LOCK_OK)
+        {
+            bDone = pKvs->bNextPutMediaDone;
+            Unlock(pKvs->xLock);
+        }
+
+        if (bDone)
+        {
+            if (ThreadAPI_Join(pKvs->xNextPutMediaThread, &xThreadRes) != THREADAPI_OK)
+            {
+                LogError("Failed to join thread");
+            }
+            pKvs->xNextPutMediaThread = NULL;
+
+            if (!bWait && xThreadRes != KVS_ERRNO_NONE)
+            {
+                LogInfo("Failed to open the next PUT MEDIA session");
+                prvReconnectOnFailure(pKvs);
+            }
+        }
+    }
+}
+
+static void prvPutMediaClose(KvsApp_t *pKvs)
+{
+    prvPutMediaJoinNextThread(pKvs, true);
+
+    if (pKvs->xPutMediaHandle != NULL || pKvs->xNextPutMediaHandle != NULL || pKvs->xDrainingPutMediaHandle != NULL)
+    {
+        if (Lock(pKvs->xLock) != LOCK_OK)
+        {
+            LogError("Failed to lock");
+        }
+        else
+        {
+            Kvs_putMediaFinish(pKvs->xPutMediaHandle);
+            pKvs->xPutMediaHandle = NULL;
+            Kvs_putMediaFinish(pKvs->xNextPutMediaHandle);
+            pKvs->xNextPutMediaHandle = NULL;
+            Kvs_putMediaFinish(pKvs->xDrainingPutMediaHandle);
+            pKvs->xDrainingPutMediaHandle = NULL;
+            pKvs->isEbmlHeaderUpdated = false;
+            Unlock(pKvs->xLock);
+        }
+    }
+}
+
+static bool prvIsEndpointOrStreamError(int xErrCode)
+{
+    /* Either the endpoint is unreachable, or the stream is not found there. */
+    return KVS_GET_ERROR_MODULE_TYPE(xErrCode) != KVS_MODULE_RESTFUL || KVS_GET_ERROR_MODULE_CODE(xErrCode) == 404;
+}
+
+static int prvPutMediaStartWithRevalidation(KvsApp_t *pKvs)
+{
+    int res = KVS_ERRNO_NONE;
+
+    if ((res = prvPutMediaStart(pKvs, &(pKvs->xPutMediaHandle))) != KVS_ERRNO_NONE && pKvs->bEndpointFromCache && prvIsEndpointOrStreamError(res))
+    {
+        LogInfo("Revalidate cached data endpoint");
+        EndpointCache_invalidate(pKvs->pEndpointCacheFile);
+        Kvs_putMediaFinish(pKvs->xPutMediaHandle);
+        pKvs->xPutMediaHandle = NULL;
+        pKvs->xServicePara.pcPutMediaEndpoint = NULL;
+        pKvs->bEndpointFromCache = false;
+
+        if ((res = setupDataEndpoint(pKvs)) != KVS_ERRNO_NONE)
+        {
+            LogError("Failed to setup data endpoint");
+            /* Propagate the res error */
+        }
+        else
+        {
+            res = prvPutMediaStart(pKvs, &(pKvs->xPutMediaHandle));
+        }
+    }
+
+    return res;
+}
+
+static int prvOpen(KvsApp_t *pKvs)
+{
+    int res = KVS_ERRNO_NONE;
+
+    setupTlsContext(pKvs);
+    if (isIotCertAvailable(pKvs) && !prvIsIotCredentialFresh(pKvs))
+    {
+        /* The credential is fetched here only if it's not there yet, or the background refresh hasn't made it. */
+        updateIotCredential(pKvs, pKvs->xTlsContext);
+    }
+    prvStartCredentialThread(pKvs);
+
+    if (Lock(pKvs->xCredentialLock) != LOCK_OK)
+    {
+        res = KVS_ERROR_LOCK_ERROR;
+        LogError("Failed to lock");
+    }
+    else
+    {
+        if ((res = updateAndVerifyRestfulReqParameters(pKvs)) != KVS_ERRNO_NONE)
+        {
+            LogError("Failed to setup KVS");
+            /* Propagate the res error */
+        }
+        else if ((res = setupDataEndpoint(pKvs)) != KVS_ERRNO_NONE)
+        {
+            LogError("Failed to setup data endpoint");
+            /* Propagate the res error */
+        }
+        else if ((res = prvPutMediaStartWithRevalidation(pKvs)) != KVS_ERRNO_NONE)
+        {
+            /* Propagate the res error */
+        }
+        else if ((res = createStream(pKvs)) != KVS_ERRNO_NONE)
+        {
+            LogError("Failed to setup KVS stream");
+            /* Propagate the res error */
+        }
+        else
+        {
+            pKvs->uPutMediaStartTimestamp = getEpochTimestampInMs();
+        }
+
+        Unlock(pKvs->xCredentialLock);
+    }
+
+    if (res == KVS_ERRNO_NONE)
+    {
+        prvReconnectOnSuccess(pKvs);
+    }
+    else
+    {
+        prvReconnectOnFailure(pKvs);
+    }
+
+    return res;
+}
+
+static void prvPutMediaReconnect(KvsApp_t *pKvs)
+{
+    unsigned int uWaitMs = prvReconnectWaitMs(pKvs);
+
+    if (uWaitMs > 0)
+    {
+        /* Frames keep buffering in the stream until the next attempt. */
+        prvSendWakeupWait(pKvs, (uWaitMs < SEND_WAKEUP_TIMEOUT_MS) ? (int)uWaitMs : SEND_WAKEUP_TIMEOUT_MS);
+    }
+    else if (prvOpen(pKvs) != KVS_ERRNO_NONE)
+    {
+        prvPutMediaClose(pKvs);
+    }
+    else
+    {
+        LogInfo("PUT MEDIA reconnected");
+        pKvs->xReconnect.bReconnectPending = false;
+    }
+}
+
+static int prvPutMediaStartNext(KvsApp_t *pKvs, PutMediaHandle *pxPutMediaHandle)
+{
+    int res = KVS_ERRNO_NONE;
+
+    if (Lock(pKvs->xCredentialLock) != LOCK_OK)
+    {
+        res = KVS_ERROR_LOCK_ERROR;
+        LogError("Failed to lock");
+    }
+    else
+    {
+        /* The credential may have been refreshed since the current session started. */
+        if ((res = updateAndVerifyRestfulReqParameters(pKvs)) == KVS_ERRNO_NONE)
+        {
+            res = prvPutMediaStart(pKvs, pxPutMediaHandle);
+        }
+        Unlock(pKvs->xCredentialLock);
+    }
+
+    return res;
+}
+
+static int prvNextPutMediaThread(void *pArg)
+{
+    int res = KVS_ERRNO_NONE;
+    KvsApp_t *pKvs = (KvsApp_t *)pArg;
+    PutMediaHandle xPutMediaHandle = NULL;
+
+    if ((res = prvPutMediaStartNext(pKvs, &xPutMediaHandle)) != KVS_ERRNO_NONE)
+    {
+        /* A session that is rejected by the server is not switched to. */
+        Kvs_putMediaFinish(xPutMediaHandle);
+        xPutMediaHandle = NULL;
+    }
+
+    if (Lock(pKvs->xLock) != LOCK_OK)
+    {
+        res = KVS_ERROR_LOCK_ERROR;
+        LogError("Failed to lock");
+        Kvs_putMediaFinish(xPutMediaHandle);
+    }
+    else
+    {
+        pKvs->xNextPutMediaHandle = xPutMediaHandle;
+        pKvs->bNextPutMediaDone = true;
+        Unlock(pKvs->xLock);
+    }
+
+    return res;
+}
+
+/**
+ * Keep the previous session receiving until the ACK of its last fragment is read, or the drain deadline passes.
+ *
+ * @param[in] pKvs KVS application
+ */
+static void prvPutMediaDrainPrevious(KvsApp_t *pKvs)
+{
+    bool bFinish = false;
+
+    if (pKvs->xDrainingPutMediaHandle != NULL)
+    {
+        if (pKvs->bDrainComplete || getEpochTimestampInMs() >= pKvs->uDrainDeadline)
+        {
+            bFinish = true;
+        }
+        else if (Kvs_putMediaDoWork(pKvs->xDrainingPutMediaHandle) != KVS_ERRNO_NONE)
+        {
+            /* The ACKs that are received before the failure are still read until the session is finished. */
+            pKvs->uDrainDeadline = 0;
+        }
+        else
+        {
+            /* nop */
+        }
+
+        if (bFinish)
+        {
+            if (Lock(pKvs->xLock) != LOCK_OK)
+            {
+                LogError("Failed to lock");
+            }
+            else
+            {
+                Kvs_putMediaFinish(pKvs->xDrainingPutMediaHandle);
+                pKvs->xDrainingPutMediaHandle = NULL;
+                Unlock(pKvs->xLock);
+
+                if (!pKvs->bDrainComplete)
+                {
+                    LogInfo("Previous PUT MEDIA session closed before its last fragment ACK");
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Read a fragment ACK of the draining session first, because its fragments are older than those of the current one.
+ *
+ * @param[in] pKvs KVS application
+ * @param[out] peAckEventType The event type of the ACK
+ * @param[out] puFragmentTimecode The fragment timecode of the ACK
+ * @param[out] puErrorId The error ID of the ACK
+ * @return 0 on success, non-zero value otherwise
+ */
+static int prvPutMediaReadFragmentAck(KvsApp_t *pKvs, ePutMediaFragmentAckEventType *peAckEventType, uint64_t *puFragmentTimecode, unsigned int *puErrorId)
+{
+    int res = KVS_ERROR_NO_PUTMEDIA_FRAGMENT_ACK_AVAILABLE;
+
+    if (pKvs->xDrainingPutMediaHandle != NULL && (res = Kvs_putMediaReadFragmentAck(pKvs->xDrainingPutMediaHandle, peAckEventType, puFragmentTimecode, puErrorId)) == KVS_ERRNO_NONE)
+    {
+        /* ACKs arrive in order, so the last fragment is done once it's persisted or failed. */
+        if (*peAckEventType == eError || (*peAckEventType == ePersisted && *puFragmentTimecode >= pKvs->uDrainLastFragmentTimecode))
+        {
+            pKvs->bDrainComplete = true;
+        }
+    }
+    else
+    {
+        res = Kvs_putMediaReadFragmentAck(pKvs->xPutMediaHandle, peAckEventType, puFragmentTimecode, puErrorId);
+    }
+
     return res;
 }
 
+static void prvPutMediaRotate(KvsApp_t *pKvs)
+{
+    uint64_t uNow = getEpochTimestampInMs();
+    DataFrameIn_t *pDataFrameIn = NULL;
+    bool bNextReady = false;
+
+    prvPutMediaDrainPrevious(pKvs);
+    prvPutMediaJoinNextThread(pKvs, false);
+
+    if (pKvs->xReconnect.uRotationIntervalSec > 0 && pKvs->xPutMediaHandle != NULL && pKvs->isEbmlHeaderUpdated &&
+        uNow >= pKvs->uPutMediaStartTimestamp + (uint64_t)(pKvs->xReconnect.uRotationIntervalSec) * 1000)
+    {
+        bNextReady = pKvs->xNextPutMediaThread == NULL && pKvs->xNextPutMediaHandle != NULL;
+
+        if (pKvs->xNextPutMediaThread == NULL && pKvs->xNextPutMediaHandle == NULL)
+        {
+            /* Handshake the replacement session in the helper thread while the current one keeps streaming. */
+            if (prvReconnectWaitMs(pKvs) == 0)
+            {
+                pKvs->bNextPutMediaDone = false;
+                if (ThreadAPI_Create(&(pKvs->xNextPutMediaThread), prvNextPutMediaThread, pKvs) != THREADAPI_OK)
+                {
+                    LogError("Failed to create thread");
+                    pKvs->xNextPutMediaThread = NULL;
+                    prvReconnectOnFailure(pKvs);
+                }
+            }
+        }
+        else if (bNextReady && (pDataFrameIn = (DataFrameIn_t *)Kvs_streamPeek(pKvs->xStreamHandle)) != NULL && pDataFrameIn->xClusterType == MKV_CLUSTER)
+        {
+            /* Switch on a cluster boundary, so the next session starts with a complete fragment. The previous session
+             * ends its body, so the server completes its last fragment, and it's drained in the background. */
+            if (Lock(pKvs->xLock) != LOCK_OK)
+            {
+                LogError("Failed to lock");
+            }
+            else
+            {
+                Kvs_putMediaFinish(pKvs->xDrainingPutMediaHandle);
+                pKvs->xDrainingPutMediaHandle = NULL;
+                if (Kvs_putMediaEnd(pKvs->xPutMediaHandle) != KVS_ERRNO_NONE)
+                {
+                    Kvs_putMediaFinish(pKvs->xPutMediaHandle);
+                }
+                else
+                {
+                    pKvs->xDrainingPutMediaHandle = pKvs->xPutMediaHandle;
+                    pKvs->uDrainDeadline = uNow + PUT_MEDIA_DRAIN_TIMEOUT_MS;
+                    pKvs->uDrainLastFragmentTimecode = pKvs->uLastSentFragmentTimecode;
+                    pKvs->bDrainComplete = false;
+                }
+                pKvs->xPutMediaHandle = pKvs->xNextPutMediaHandle;
+                pKvs->xNextPutMediaHandle = NULL;
+                pKvs->isEbmlHeaderUpdated = false;
+                pKvs->uPutMediaStartTimestamp = uNow;
+                Unlock(pKvs->xLock);
+
+                prvReconnectOnSuccess(pKvs);
+                LogInfo("PUT MEDIA session rotated");
+            }
+        }
+        else
+        {
+            /* Wait for the next session to be opened, or for the next cluster. */
+        }
+    }
+}
+
 static int prvPutMediaDoWorkDefault(KvsApp_t *pKvs)
 {
     int res = KVS_ERRNO_NONE;
@@ -849,7 +1927,7 @@ static int prvPutMediaDoWorkDefault(KvsApp_t *pKvs)
             break;
         }
 
-        if ((res = prvPutMediaSendData(pKvs, &xSendCnt, false)) != KVS_ERRNO_NONE)
+        if ((res = prvPutMediaSendData(pKvs, &xSendCnt, NULL, false, true)) != KVS_ERRNO_NONE)
         {
             /* Propagate the res error */
             break;
@@ -858,7 +1936,7 @@ static int prvPutMediaDoWorkDefault(KvsApp_t *pKvs)
 
     if (xSendCnt == 0)
     {
-        sleepInMs(50);
+        prvSendWakeupWait(pKvs, SEND_WAKEUP_TIMEOUT_MS);
     }
 
     return res;
@@ -883,14 +1961,226 @@ static int prvPutMediaDoWorkSendEndOfFrames(KvsApp_t *pKvs)
             break;
         }
 
-        if ((res = prvPutMediaSendData(pKvs, &xSendCnt, true)) != KVS_ERRNO_NONE)
+        if ((res = prvPutMediaSendData(pKvs, &xSendCnt, NULL, true, true)) != KVS_ERRNO_NONE)
         {
             /* Propagate the res error */
             break;
         }
     } while (xSendCnt > 0);
 
-    return res;
+    return res;
+}
+
+static int prvPutMediaDoWorkSendBatch(KvsApp_t *pKvs, DoWorkExParamter_t *pPara)
+{
+    int res = KVS_ERRNO_NONE;
+    int xSendCnt = 0;
+    size_t uSendBytes = 0;
+    size_t uTotalSendCnt = 0;
+    size_t uTotalSendBytes = 0;
+    uint64_t uDeadline = 0;
+
+    if (pPara->uTimeBudgetMs > 0)
+    {
+        uDeadline = getEpochTimestampInMs() + pPara->uTimeBudgetMs;
+    }
+
+    do
+    {
+        if ((res = updateEbmlHeader(pKvs)) != KVS_ERRNO_NONE)
+        {
+            /* Propagate the res error */
+            break;
+        }
+
+        if ((res = Kvs_putMediaDoWork(pKvs->xPutMediaHandle)) != KVS_ERRNO_NONE)
+        {
+            /* Propagate the res error */
+            break;
+        }
+
+        do
+        {
+            /* Consecutive data frames can share TLS records, and they are flushed after the batch or when too many of them wait. */
+            if (pKvs->uUnflushedFrameCount == SEND_BATCH_UNFLUSHED_FRAME_COUNT && (res = prvPutMediaFlushUnflushedFrames(pKvs)) != KVS_ERRNO_NONE)
+            {
+                /* Propagate the res error */
+                break;
+            }
+
+            if ((res = prvPutMediaSendData(pKvs, &xSendCnt, &uSendBytes, false, false)) != KVS_ERRNO_NONE)
+            {
+                /* Propagate the res error */
+                break;
+            }
+
+            uTotalSendCnt += xSendCnt;
+            uTotalSendBytes += uSendBytes;
+
+            if ((pPara->uMaxSendFrames > 0 && uTotalSendCnt >= pPara->uMaxSendFrames) ||
+                (pPara->uMaxSendBytes > 0 && uTotalSendBytes >= pPara->uMaxSendBytes) ||
+                (uDeadline > 0 && getEpochTimestampInMs() >= uDeadline))
+            {
+                break;
+            }
+        } while (xSendCnt > 0);
+
+        if (res == KVS_ERRNO_NONE && (res = prvPutMediaFlushUnflushedFrames(pKvs)) != KVS_ERRNO_NONE)
+        {
+            /* Propagate the res error */
+            break;
+        }
+    } while (false);
+
+    /* Frames that are left by an error never made it to the wire. */
+    prvReleaseUnflushedFrames(pKvs, false);
+
+    if (uTotalSendCnt == 0)
+    {
+        prvSendWakeupWait(pKvs, SEND_WAKEUP_TIMEOUT_MS);
+    }
+
+    return res;
+}
+
+static bool prvSenderIsStopping(KvsApp_t *pKvs)
+{
+    bool bStopping = true;
+
+    if (Lock(pKvs->xSendWakeupLock) != LOCK_OK)
+    {
+        LogError("Failed to lock");
+    }
+    else
+    {
+        bStopping = pKvs->bSenderStopping;
+        Unlock(pKvs->xSendWakeupLock);
+    }
+
+    return bStopping;
+}
+
+static void prvSenderWait(KvsApp_t *pKvs, unsigned int uWaitMs)
+{
+    uint64_t uDeadline = getEpochTimestampInMs() + uWaitMs;
+    uint64_t uNow = 0;
+
+    /* Frame arrival also wakes up the wait, so keep waiting until the deadline unless the sender is stopping. */
+    while (!prvSenderIsStopping(pKvs) && (uNow = getEpochTimestampInMs()) < uDeadline)
+    {
+        prvSendWakeupWait(pKvs, (int)(uDeadline - uNow));
+    }
+}
+
+static void prvSenderDeliverFragmentAcks(KvsApp_t *pKvs)
+{
+    ePutMediaFragmentAckEventType eAckEventType = eUnknown;
+    uint64_t uFragmentTimecode = 0;
+    unsigned int uErrorId = 0;
+
+    while (prvPutMediaReadFragmentAck(pKvs, &eAckEventType, &uFragmentTimecode, &uErrorId) == KVS_ERRNO_NONE)
+    {
+        prvLatencyOnFragmentAck(pKvs, eAckEventType, uFragmentTimecode);
+        if (pKvs->xSenderCallbacks.onFragmentAck != NULL)
+        {
+            pKvs->xSenderCallbacks.onFragmentAck(eAckEventType, uFragmentTimecode, uErrorId, pKvs->xSenderCallbacks.pAppData);
+        }
+    }
+}
+
+static void prvSenderOnError(KvsApp_t *pKvs, int xErrCode)
+{
+    LogError("Sender error:-%X", -xErrCode);
+    if (pKvs->xSenderCallbacks.onSenderError != NULL)
+    {
+        pKvs->xSenderCallbacks.onSenderError(xErrCode, pKvs->xSenderCallbacks.pAppData);
+    }
+}
+
+static void prvSenderDrain(KvsApp_t *pKvs, unsigned int uDrainTimeoutMs)
+{
+    int res = KVS_ERRNO_NONE;
+    DoWorkExParamter_t xPara = {0};
+    uint64_t uDeadline = getEpochTimestampInMs() + uDrainTimeoutMs;
+    uint64_t uNow = 0;
+
+    xPara.eType = DO_WORK_SEND_BATCH;
+    while (res == KVS_ERRNO_NONE && pKvs->xStreamHandle != NULL && !Kvs_streamIsEmpty(pKvs->xStreamHandle) && (uNow = getEpochTimestampInMs()) < uDeadline)
+    {
+        xPara.uTimeBudgetMs = (unsigned int)(uDeadline - uNow);
+        res = prvPutMediaDoWorkSendBatch(pKvs, &xPara);
+        prvSenderDeliverFragmentAcks(pKvs);
+    }
+
+    if (res == KVS_ERRNO_NONE && pKvs->isEbmlHeaderUpdated)
+    {
+        /* Frames that wait for the other track are sent too. */
+        res = prvPutMediaDoWorkSendEndOfFrames(pKvs);
+        prvSenderDeliverFragmentAcks(pKvs);
+    }
+
+    if (res != KVS_ERRNO_NONE && res != KVS_ERROR_STREAM_NO_AVAILABLE_DATA_FRAME)
+    {
+        prvSenderOnError(pKvs, res);
+    }
+}
+
+static int prvSenderThread(void *pArg)
+{
+    int res = KVS_ERRNO_NONE;
+    KvsApp_t *pKvs = (KvsApp_t *)pArg;
+    bool bOpened = false;
+    unsigned int uWaitMs = 0;
+
+    while (!prvSenderIsStopping(pKvs))
+    {
+        if (!bOpened)
+        {
+            if ((uWaitMs = prvReconnectWaitMs(pKvs)) > 0)
+            {
+                prvSenderWait(pKvs, uWaitMs);
+            }
+            else if ((res = prvOpen(pKvs)) != KVS_ERRNO_NONE)
+            {
+                prvSenderOnError(pKvs, res);
+                prvPutMediaClose(pKvs);
+            }
+            else
+            {
+                bOpened = true;
+            }
+        }
+        else if (!pKvs->isEbmlHeaderUpdated && (pKvs->xStreamHandle == NULL || Kvs_streamIsEmpty(pKvs->xStreamHandle)))
+        {
+            /* Nothing can be sent before the first frame arrives. */
+            prvSendWakeupWait(pKvs, SEND_WAKEUP_TIMEOUT_MS);
+        }
+        else
+        {
+            /* Deliver the ACKs of the current session before it's rotated or closed. */
+            prvSenderDeliverFragmentAcks(pKvs);
+            prvPutMediaRotate(pKvs);
+            if ((res = prvPutMediaDoWorkDefault(pKvs)) != KVS_ERRNO_NONE && res != KVS_ERROR_STREAM_NO_AVAILABLE_DATA_FRAME)
+            {
+                prvSenderDeliverFragmentAcks(pKvs);
+                prvSenderOnError(pKvs, res);
+                prvPutMediaClose(pKvs);
+                prvReconnectOnFailure(pKvs);
+                bOpened = false;
+            }
+        }
+    }
+
+    if (bOpened)
+    {
+        if (pKvs->uSenderDrainTimeoutMs > 0)
+        {
+            prvSenderDrain(pKvs, pKvs->uSenderDrainTimeoutMs);
+        }
+    }
+    prvPutMediaClose(pKvs);
+
+    return 0;
 }
 
 KvsAppHandle KvsApp_create(const char *pcHost, const char *pcRegion, const char *pcService, const char *pcStreamName)
@@ -911,12 +2201,19 @@ KvsAppHandle KvsApp_create(const char *pcHost, const char *pcRegion, const char
     else
     {
         memset(pKvs, 0, sizeof(KvsApp_t));
+        NALU_initIndex(&(pKvs->xNaluIndex), NULL, 0);
 
-        if ((pKvs->xLock = Lock_Init()) == NULL)
+        if ((pKvs->xLock = Lock_Init()) == NULL || (pKvs->xSendWakeupLock = Lock_Init()) == NULL || (pKvs->xCredentialLock = Lock_Init()) == NULL ||
+            (pKvs->xLatency.xLock = Lock_Init()) == NULL)
         {
             res = KVS_ERROR_LOCK_ERROR;
             LogError("Failed to init lock");
         }
+        else if ((pKvs->xSendWakeupCond = Condition_Init()) == NULL || (pKvs->xCredentialCond = Condition_Init()) == NULL)
+        {
+            res = KVS_ERROR_CONDITION_ERROR;
+            LogError("Failed to init condition");
+        }
         else if (
             (res = prvMallocAndStrcpyHelper(&(pKvs->pHost), pcHost)) != KVS_ERRNO_NONE ||
             (res = prvMallocAndStrcpyHelper(&(pKvs->pRegion), pcRegion)) != KVS_ERRNO_NONE ||
@@ -929,6 +2226,9 @@ KvsAppHandle KvsApp_create(const char *pcHost, const char *pcRegion, const char
         else
         {
             pKvs->pDataEndpoint = NULL;
+            pKvs->pEndpointCacheFile = NULL;
+            pKvs->uEndpointCacheTtlSec = DEFAULT_ENDPOINT_CACHE_TTL_SEC;
+            pKvs->bEndpointFromCache = false;
             pKvs->pAwsAccessKeyId = NULL;
             pKvs->pAwsSecretAccessKey = NULL;
             pKvs->pIotCredentialHost = NULL;
@@ -938,6 +2238,9 @@ KvsAppHandle KvsApp_create(const char *pcHost, const char *pcRegion, const char
             pKvs->pIotX509Certificate = NULL;
             pKvs->pIotX509PrivateKey = NULL;
             pKvs->pToken = NULL;
+            pKvs->uCredentialRefreshMarginSec = DEFAULT_IOT_CREDENTIAL_REFRESH_MARGIN_SEC;
+            pKvs->xTlsContext = NULL;
+            pKvs->bTlsContextStale = false;
 
             pKvs->uDataRetentionInHours = DEFAULT_DATA_RETENTION_IN_HOURS;
 
@@ -947,6 +2250,15 @@ KvsAppHandle KvsApp_create(const char *pcHost, const char *pcRegion, const char
             pKvs->isEbmlHeaderUpdated = false;
             pKvs->xStrategy.xPolicy = STREAM_POLICY_NONE;
 
+            pKvs->xNextPutMediaThread = NULL;
+            pKvs->xNextPutMediaHandle = NULL;
+            pKvs->xDrainingPutMediaHandle = NULL;
+            pKvs->xReconnect.bAutoReconnect = false;
+            pKvs->xReconnect.uBaseDelayMs = DEFAULT_RECONNECT_BASE_DELAY_MS;
+            pKvs->xReconnect.uMaxDelayMs = DEFAULT_RECONNECT_MAX_DELAY_MS;
+            pKvs->xReconnect.uJitterPercent = DEFAULT_RECONNECT_JITTER_PERCENT;
+            pKvs->xReconnect.uRotationIntervalSec = 0;
+
             pKvs->pVideoTrackInfo = NULL;
             pKvs->isAudioTrackPresent = false;
             pKvs->pAudioTrackInfo = NULL;
@@ -966,6 +2278,17 @@ void KvsApp_terminate(KvsAppHandle handle)
 {
     KvsApp_t *pKvs = (KvsApp_t *)handle;
 
+    if (pKvs != NULL && pKvs->xSenderThread != NULL)
+    {
+        KvsApp_stopSender(pKvs, 0);
+    }
+
+    if (pKvs != NULL)
+    {
+        prvStopCredentialThread(pKvs);
+        prvPutMediaClose(pKvs);
+    }
+
     if (pKvs != NULL && Lock(pKvs->xLock) == LOCK_OK)
     {
         if (pKvs->xStreamHandle != NULL)
@@ -974,6 +2297,11 @@ void KvsApp_terminate(KvsAppHandle handle)
             Kvs_streamTermintate(pKvs->xStreamHandle);
             pKvs->xStreamHandle = NULL;
         }
+        if (pKvs->xUserDataSlab != NULL)
+        {
+            Slab_terminate(pKvs->xUserDataSlab);
+            pKvs->xUserDataSlab = NULL;
+        }
         if (pKvs->pHost != NULL)
         {
             kvsFree(pKvs->pHost);
@@ -999,6 +2327,11 @@ void KvsApp_terminate(KvsAppHandle handle)
             kvsFree(pKvs->pDataEndpoint);
             pKvs->pDataEndpoint = NULL;
         }
+        if (pKvs->pEndpointCacheFile != NULL)
+        {
+            kvsFree(pKvs->pEndpointCacheFile);
+            pKvs->pEndpointCacheFile = NULL;
+        }
         if (pKvs->pAwsAccessKeyId != NULL)
         {
             kvsFree(pKvs->pAwsAccessKeyId);
@@ -1044,6 +2377,12 @@ void KvsApp_terminate(KvsAppHandle handle)
             kvsFree(pKvs->pIotX509PrivateKey);
             pKvs->pIotX509PrivateKey = NULL;
         }
+        if (pKvs->pToken != NULL)
+        {
+            Iot_credentialTerminate(pKvs->pToken);
+            pKvs->pToken = NULL;
+        }
+        prvTlsContextRelease(pKvs);
         if (pKvs->pVideoTrackInfo != NULL)
         {
             prvVideoTrackInfoTerminate(pKvs->pVideoTrackInfo);
@@ -1052,6 +2391,11 @@ void KvsApp_terminate(KvsAppHandle handle)
         {
             prvAudioTrackInfoTerminate(pKvs->pAudioTrackInfo);
         }
+        if (pKvs->pVps != NULL)
+        {
+            kvsFree(pKvs->pVps);
+            pKvs->pVps = NULL;
+        }
         if (pKvs->pSps != NULL)
         {
             kvsFree(pKvs->pSps);
@@ -1062,10 +2406,31 @@ void KvsApp_terminate(KvsAppHandle handle)
             kvsFree(pKvs->pPps);
             pKvs->pPps = NULL;
         }
+        NALU_deinitIndex(&(pKvs->xNaluIndex));
 
         Unlock(pKvs->xLock);
 
         Lock_Deinit(pKvs->xLock);
+        if (pKvs->xSendWakeupCond != NULL)
+        {
+            Condition_Deinit(pKvs->xSendWakeupCond);
+        }
+        if (pKvs->xSendWakeupLock != NULL)
+        {
+            Lock_Deinit(pKvs->xSendWakeupLock);
+        }
+        if (pKvs->xCredentialCond != NULL)
+        {
+            Condition_Deinit(pKvs->xCredentialCond);
+        }
+        if (pKvs->xCredentialLock != NULL)
+        {
+            Lock_Deinit(pKvs->xCredentialLock);
+        }
+        if (pKvs->xLatency.xLock != NULL)
+        {
+            Lock_Deinit(pKvs->xLatency.xLock);
+        }
 
         memset(pKvs, 0, sizeof(KvsApp_t));
         kvsFree(pKvs);
@@ -1146,6 +2511,10 @@ int KvsApp_setoption(KvsAppHandle handle, const char *pcOptionName, const char *
                 LogError("Failed to set pIotX509RootCa");
                 /* Propagate the res error */
             }
+            else
+            {
+                pKvs->bTlsContextStale = true;
+            }
         }
         else if (strcmp(pcOptionName, (const char *)OPTION_IOT_X509_CERT) == 0)
         {
@@ -1154,6 +2523,10 @@ int KvsApp_setoption(KvsAppHandle handle, const char *pcOptionName, const char *
                 LogError("Failed to set pIotX509Certificate");
                 /* Propagate the res error */
             }
+            else
+            {
+                pKvs->bTlsContextStale = true;
+            }
         }
         else if (strcmp(pcOptionName, (const char *)OPTION_IOT_X509_KEY) == 0)
         {
@@ -1162,6 +2535,22 @@ int KvsApp_setoption(KvsAppHandle handle, const char *pcOptionName, const char *
                 LogError("Failed to set pIotX509PrivateKey");
                 /* Propagate the res error */
             }
+            else
+            {
+                pKvs->bTlsContextStale = true;
+            }
+        }
+        else if (strcmp(pcOptionName, (const char *)OPTION_IOT_CREDENTIAL_REFRESH_MARGIN) == 0)
+        {
+            if (pValue == NULL)
+            {
+                res = KVS_ERROR_INVALID_ARGUMENT;
+                LogError("Invalid value for IoT credential refresh margin");
+            }
+            else
+            {
+                pKvs->uCredentialRefreshMarginSec = *((unsigned int *)(pValue));
+            }
         }
         else if (strcmp(pcOptionName, (const char *)OPTION_KVS_DATA_RETENTION_IN_HOURS) == 0)
         {
@@ -1175,6 +2564,46 @@ int KvsApp_setoption(KvsAppHandle handle, const char *pcOptionName, const char *
                 pKvs->uDataRetentionInHours = *((unsigned int *)(pValue));
             }
         }
+        else if (strcmp(pcOptionName, (const char *)OPTION_KVS_ENDPOINT_CACHE_FILE) == 0)
+        {
+            if (pValue == NULL)
+            {
+                if (pKvs->pEndpointCacheFile != NULL)
+                {
+                    kvsFree(pKvs->pEndpointCacheFile);
+                }
+                pKvs->pEndpointCacheFile = NULL;
+            }
+            else if ((res = prvMallocAndStrcpyHelper(&(pKvs->pEndpointCacheFile), pValue)) != 0)
+            {
+                LogError("Failed to set pEndpointCacheFile");
+                /* Propagate the res error */
+            }
+        }
+        else if (strcmp(pcOptionName, (const char *)OPTION_KVS_ENDPOINT_CACHE_TTL) == 0)
+        {
+            if (pValue == NULL)
+            {
+                res = KVS_ERROR_INVALID_ARGUMENT;
+                LogError("Invalid value for endpoint cache TTL");
+            }
+            else
+            {
+                pKvs->uEndpointCacheTtlSec = *((unsigned int *)(pValue));
+            }
+        }
+        else if (strcmp(pcOptionName, (const char *)OPTION_KVS_VIDEO_CODEC) == 0)
+        {
+            if (pValue == NULL || (*((VideoCodec_t *)pValue) != VIDEO_CODEC_H264 && *((VideoCodec_t *)pValue) != VIDEO_CODEC_H265))
+            {
+                res = KVS_ERROR_INVALID_ARGUMENT;
+                LogError("Invalid value set to KVS video codec");
+            }
+            else
+            {
+                pKvs->xVideoCodec = *((VideoCodec_t *)pValue);
+            }
+        }
         else if (strcmp(pcOptionName, (const char *)OPTION_KVS_VIDEO_TRACK_INFO) == 0)
         {
             if (pValue == NULL)
@@ -1222,6 +2651,7 @@ int KvsApp_setoption(KvsAppHandle handle, const char *pcOptionName, const char *
                     if (pKvs->xStrategy.xPolicy == STREAM_POLICY_RING_BUFFER)
                     {
                         pKvs->xStrategy.xRingBufferPara.uMemLimit = DEFAULT_RING_BUFFER_MEM_LIMIT;
+                        pKvs->xStrategy.xRingBufferPara.uDurationLimitSec = 0;
                     }
                 }
             }
@@ -1244,6 +2674,24 @@ int KvsApp_setoption(KvsAppHandle handle, const char *pcOptionName, const char *
                 pKvs->xStrategy.xRingBufferPara.uMemLimit = uMemLimit;
             }
         }
+        else if (strcmp(pcOptionName, (const char *)OPTION_STREAM_POLICY_RING_BUFFER_DURATION_LIMIT) == 0)
+        {
+            if (pValue == NULL)
+            {
+                res = KVS_ERROR_INVALID_ARGUMENT;
+                LogError("Invalid value set to parameter of ring buffer policy");
+            }
+            else if (pKvs->xStrategy.xPolicy != STREAM_POLICY_RING_BUFFER)
+            {
+                res = KVS_ERROR_INVALID_ARGUMENT;
+                LogError("Cannot set parameter to policy: %d ", (int)(pKvs->xStrategy.xPolicy));
+            }
+            else
+            {
+                unsigned int uDurationLimitSec = *((unsigned int *)pValue);
+                pKvs->xStrategy.xRingBufferPara.uDurationLimitSec = uDurationLimitSec;
+            }
+        }
         else if (strcmp(pcOptionName, (const char *)OPTION_NETIO_CONNECTION_TIMEOUT) == 0)
         {
             if (pValue == NULL)
@@ -1290,6 +2738,66 @@ int KvsApp_setoption(KvsAppHandle handle, const char *pcOptionName, const char *
                 Kvs_putMediaUpdateSendTimeout(pKvs->xPutMediaHandle, uSendTimeoutMs);
             }
         }
+        else if (strcmp(pcOptionName, (const char *)OPTION_RECONNECT_AUTO) == 0)
+        {
+            if (pValue == NULL)
+            {
+                res = KVS_ERROR_INVALID_ARGUMENT;
+                LogError("Invalid value set to auto reconnect");
+            }
+            else
+            {
+                pKvs->xReconnect.bAutoReconnect = *((bool *)pValue);
+            }
+        }
+        else if (strcmp(pcOptionName, (const char *)OPTION_RECONNECT_BASE_DELAY) == 0)
+        {
+            if (pValue == NULL || *((unsigned int *)pValue) == 0)
+            {
+                res = KVS_ERROR_INVALID_ARGUMENT;
+                LogError("Invalid value set to reconnect base delay");
+            }
+            else
+            {
+                pKvs->xReconnect.uBaseDelayMs = *((unsigned int *)pValue);
+            }
+        }
+        else if (strcmp(pcOptionName, (const char *)OPTION_RECONNECT_MAX_DELAY) == 0)
+        {
+            if (pValue == NULL)
+            {
+                res = KVS_ERROR_INVALID_ARGUMENT;
+                LogError("Invalid value set to reconnect max delay");
+            }
+            else
+            {
+                pKvs->xReconnect.uMaxDelayMs = *((unsigned int *)pValue);
+            }
+        }
+        else if (strcmp(pcOptionName, (const char *)OPTION_RECONNECT_JITTER) == 0)
+        {
+            if (pValue == NULL || *((unsigned int *)pValue) > 100)
+            {
+                res = KVS_ERROR_INVALID_ARGUMENT;
+                LogError("Invalid value set to reconnect jitter");
+            }
+            else
+            {
+                pKvs->xReconnect.uJitterPercent = *((unsigned int *)pValue);
+            }
+        }
+        else if (strcmp(pcOptionName, (const char *)OPTION_RECONNECT_ROTATION_INTERVAL) == 0)
+        {
+            if (pValue == NULL)
+            {
+                res = KVS_ERROR_INVALID_ARGUMENT;
+                LogError("Invalid value set to rotation interval");
+            }
+            else
+            {
+                pKvs->xReconnect.uRotationIntervalSec = *((unsigned int *)pValue);
+            }
+        }
         else
         {
             /* TODO: Propagate this option to KVS stream. */
@@ -1303,7 +2811,6 @@ int KvsApp_open(KvsAppHandle handle)
 {
     int res = KVS_ERRNO_NONE;
     KvsApp_t *pKvs = (KvsApp_t *)handle;
-    unsigned int uHttpStatusCode = 0;
 
     if (pKvs == NULL)
     {
@@ -1311,35 +2818,8 @@ int KvsApp_open(KvsAppHandle handle)
     }
     else
     {
-        updateIotCredential(pKvs);
-        if ((res = updateAndVerifyRestfulReqParameters(pKvs)) != KVS_ERRNO_NONE)
-        {
-            LogError("Failed to setup KVS");
-            /* Propagate the res error */
-        }
-        else if ((res = setupDataEndpoint(pKvs)) != KVS_ERRNO_NONE)
-        {
-            LogError("Failed to setup data endpoint");
-            /* Propagate the res error */
-        }
-        else if ((res = Kvs_putMediaStart(&(pKvs->xServicePara), &(pKvs->xPutMediaPara), &uHttpStatusCode, &(pKvs->xPutMediaHandle))) != KVS_ERRNO_NONE)
-        {
-            LogError("Failed to setup PUT MEDIA");
-            /* Propagate the res error */
-        }
-        else if (uHttpStatusCode != 200)
-        {
-            res = KVS_GENERATE_RESTFUL_ERROR(uHttpStatusCode);
-            LogError("PUT MEDIA http status code:%d\n", uHttpStatusCode);
-        }
-        else
-        {
-            if ((res = createStream(pKvs)) != KVS_ERRNO_NONE)
-            {
-                LogError("Failed to setup KVS stream");
-                /* Propagate the res error */
-            }
-        }
+        pKvs->xReconnect.bReconnectPending = false;
+        res = prvOpen(pKvs);
     }
 
     return res;
@@ -1359,7 +2839,9 @@ int KvsApp_close(KvsAppHandle handle)
     }
     else
     {
-        if (pKvs->xPutMediaHandle != NULL)
+        pKvs->xReconnect.bReconnectPending = false;
+        prvPutMediaJoinNextThread(pKvs, true);
+        if (pKvs->xPutMediaHandle != NULL || pKvs->xNextPutMediaHandle != NULL || pKvs->xDrainingPutMediaHandle != NULL)
         {
             if (Lock(pKvs->xLock) != LOCK_OK)
             {
@@ -1370,6 +2852,10 @@ int KvsApp_close(KvsAppHandle handle)
             {
                 Kvs_putMediaFinish(pKvs->xPutMediaHandle);
                 pKvs->xPutMediaHandle = NULL;
+                Kvs_putMediaFinish(pKvs->xNextPutMediaHandle);
+                pKvs->xNextPutMediaHandle = NULL;
+                Kvs_putMediaFinish(pKvs->xDrainingPutMediaHandle);
+                pKvs->xDrainingPutMediaHandle = NULL;
                 pKvs->isEbmlHeaderUpdated = false;
                 Unlock(pKvs->xLock);
             }
@@ -1400,14 +2886,12 @@ int KvsApp_addFrameWithCallbacks(KvsAppHandle handle, uint8_t *pData, size_t uDa
     {
         res = KVS_ERROR_ADD_FRAME_WHOSE_TIMESTAMP_GOES_BACK;
     }
-    else if (
-        xTrackType == TRACK_VIDEO && NALU_isAnnexBFrame(pData, uDataLen) &&
-        (res = NALU_convertAnnexBToAvccInPlace(pData, uDataLen, uDataSize, (uint32_t *)&uDataLen)) != KVS_ERRNO_NONE)
+    else if (xTrackType == TRACK_VIDEO && (res = prvIndexVideoFrame(pKvs->xVideoCodec, pData, &uDataLen, uDataSize, &(pKvs->xNaluIndex))) != KVS_ERRNO_NONE)
     {
-        LogError("Failed to convert Annex-B to Avcc in place");
+        LogError("Failed to index video frame");
         /* Propagate the res error */
     }
-    else if ((res = checkAndBuildStream(pKvs, pData, uDataLen, xTrackType)) != KVS_ERRNO_NONE)
+    else if ((res = checkAndBuildStream(pKvs, pData, (xTrackType == TRACK_VIDEO) ? &(pKvs->xNaluIndex) : NULL, xTrackType)) != KVS_ERRNO_NONE)
     {
         LogError("Failed to build stream buffer");
         /* Propagate the res error */
@@ -1416,7 +2900,7 @@ int KvsApp_addFrameWithCallbacks(KvsAppHandle handle, uint8_t *pData, size_t uDa
     {
         res = KVS_ERROR_STREAM_NOT_READY;
     }
-    else if ((pUserData = (DataFrameUserData_t *)kvsMalloc(sizeof(DataFrameUserData_t))) == NULL)
+    else if ((pUserData = (DataFrameUserData_t *)((pKvs->xUserDataSlab != NULL) ? Slab_alloc(pKvs->xUserDataSlab) : kvsMalloc(sizeof(DataFrameUserData_t)))) == NULL)
     {
         res = KVS_ERROR_OUT_OF_MEMORY;
         LogError("OOM: pUserData");
@@ -1425,7 +2909,7 @@ int KvsApp_addFrameWithCallbacks(KvsAppHandle handle, uint8_t *pData, size_t uDa
     {
         xDataFrameIn.pData = (char *)pData;
         xDataFrameIn.uDataLen = uDataLen;
-        xDataFrameIn.bIsKeyFrame = (xTrackType == TRACK_VIDEO) ? isKeyFrame(pData, uDataLen) : false;
+        xDataFrameIn.bIsKeyFrame = (xTrackType == TRACK_VIDEO) ? NALU_isKeyFrameInIndex(&(pKvs->xNaluIndex)) : false;
         xDataFrameIn.uTimestampMs = uTimestamp;
         xDataFrameIn.xTrackType = xTrackType;
         xDataFrameIn.xClusterType = (xDataFrameIn.bIsKeyFrame) ? MKV_CLUSTER : MKV_SIMPLE_BLOCK;
@@ -1443,11 +2927,12 @@ int KvsApp_addFrameWithCallbacks(KvsAppHandle handle, uint8_t *pData, size_t uDa
         {
             memcpy(&(pUserData->xCallbacks), pCallbacks, sizeof(DataFrameCallbacks_t));
         }
+        pUserData->uEnqueueTimestamp = getEpochTimestampInMs();
         xDataFrameIn.pUserData = pUserData;
 
         if (pKvs->xStrategy.xPolicy == STREAM_POLICY_RING_BUFFER)
         {
-            prvStreamFlushHeadUntilMem(pKvs, pKvs->xStrategy.xRingBufferPara.uMemLimit);
+            prvStreamEvictGops(pKvs);
         }
 
         if (Kvs_streamAddDataFrame(pKvs->xStreamHandle, &xDataFrameIn) == NULL)
@@ -1455,6 +2940,10 @@ int KvsApp_addFrameWithCallbacks(KvsAppHandle handle, uint8_t *pData, size_t uDa
             res = KVS_ERROR_FAIL_TO_ADD_DATA_FRAME_TO_STREAM;
             LogError("Failed to add data frame");
         }
+        else
+        {
+            prvSendWakeupSignal(pKvs);
+        }
     }
 
     if (res != KVS_ERRNO_NONE)
@@ -1476,7 +2965,7 @@ int KvsApp_addFrameWithCallbacks(KvsAppHandle handle, uint8_t *pData, size_t uDa
         }
         if (pUserData != NULL)
         {
-            kvsFree(pUserData);
+            Slab_free(pKvs->xUserDataSlab, pUserData);
         }
     }
 
@@ -1484,6 +2973,11 @@ int KvsApp_addFrameWithCallbacks(KvsAppHandle handle, uint8_t *pData, size_t uDa
 }
 
 int KvsApp_doWork(KvsAppHandle handle)
+{
+    return KvsApp_doWorkEx(handle, NULL);
+}
+
+int KvsApp_doWorkEx(KvsAppHandle handle, DoWorkExParamter_t *pPara)
 {
     int res = KVS_ERRNO_NONE;
     KvsApp_t *pKvs = (KvsApp_t *)handle;
@@ -1492,54 +2986,152 @@ int KvsApp_doWork(KvsAppHandle handle)
     {
         res = KVS_ERROR_INVALID_ARGUMENT;
     }
+    else if (pKvs->xReconnect.bReconnectPending)
+    {
+        prvPutMediaReconnect(pKvs);
+    }
     else
     {
-        res = prvPutMediaDoWorkDefault(pKvs);
+        if (pPara == NULL || pPara->eType == DO_WORK_DEFAULT)
+        {
+            prvPutMediaRotate(pKvs);
+            res = prvPutMediaDoWorkDefault(pKvs);
+        }
+        else if (pPara->eType == DO_WORK_SEND_END_OF_FRAMES)
+        {
+            res = prvPutMediaDoWorkSendEndOfFrames(pKvs);
+        }
+        else if (pPara->eType == DO_WORK_SEND_BATCH)
+        {
+            prvPutMediaRotate(pKvs);
+            res = prvPutMediaDoWorkSendBatch(pKvs, pPara);
+        }
+        else
+        {
+            res = KVS_ERROR_KVSAPP_UNKNOWN_DO_WORK_TYPE;
+        }
+
+        if (res != KVS_ERRNO_NONE && res != KVS_ERROR_STREAM_NO_AVAILABLE_DATA_FRAME && res != KVS_ERROR_KVSAPP_UNKNOWN_DO_WORK_TYPE &&
+            pKvs->xReconnect.bAutoReconnect && pKvs->xPutMediaHandle != NULL)
+        {
+            /* The frames stay in the stream, and the session is re-opened after the backoff. */
+            LogError("PUT MEDIA failed:-%X, reconnecting", -res);
+            prvPutMediaClose(pKvs);
+            prvReconnectOnFailure(pKvs);
+            pKvs->xReconnect.bReconnectPending = true;
+            res = KVS_ERRNO_NONE;
+        }
     }
 
     return res;
 }
 
-int KvsApp_doWorkEx(KvsAppHandle handle, DoWorkExParamter_t *pPara)
+int KvsApp_readFragmentAck(KvsAppHandle handle, ePutMediaFragmentAckEventType *peAckEventType, uint64_t *puFragmentTimecode, unsigned int *puErrorId)
 {
     int res = KVS_ERRNO_NONE;
     KvsApp_t *pKvs = (KvsApp_t *)handle;
+    ePutMediaFragmentAckEventType eAckEventType = eUnknown;
+    uint64_t uFragmentTimecode = 0;
+    unsigned int uErrorId = 0;
 
     if (pKvs == NULL)
     {
         res = KVS_ERROR_INVALID_ARGUMENT;
     }
+    else if ((res = prvPutMediaReadFragmentAck(pKvs, &eAckEventType, &uFragmentTimecode, &uErrorId)) != KVS_ERRNO_NONE)
+    {
+        /* Propagate the res error */
+    }
     else
     {
-        if (pPara == NULL || pPara->eType == DO_WORK_DEFAULT)
+        prvLatencyOnFragmentAck(pKvs, eAckEventType, uFragmentTimecode);
+        if (peAckEventType != NULL)
         {
-            res = prvPutMediaDoWorkDefault(pKvs);
+            *peAckEventType = eAckEventType;
         }
-        else if (pPara->eType == DO_WORK_SEND_END_OF_FRAMES)
+        if (puFragmentTimecode != NULL)
         {
-            res = prvPutMediaDoWorkSendEndOfFrames(pKvs);
+            *puFragmentTimecode = uFragmentTimecode;
+        }
+        if (puErrorId != NULL)
+        {
+            *puErrorId = uErrorId;
+        }
+    }
+
+    return res;
+}
+
+int KvsApp_startSender(KvsAppHandle handle, SenderCallbacks_t *pCallbacks)
+{
+    int res = KVS_ERRNO_NONE;
+    KvsApp_t *pKvs = (KvsApp_t *)handle;
+
+    if (pKvs == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else if (pKvs->xSenderThread != NULL)
+    {
+        res = KVS_ERROR_KVSAPP_SENDER_IS_RUNNING;
+    }
+    else
+    {
+        if (pCallbacks != NULL)
+        {
+            memcpy(&(pKvs->xSenderCallbacks), pCallbacks, sizeof(SenderCallbacks_t));
         }
         else
         {
-            res = KVS_ERROR_KVSAPP_UNKNOWN_DO_WORK_TYPE;
+            memset(&(pKvs->xSenderCallbacks), 0, sizeof(SenderCallbacks_t));
+        }
+        pKvs->bSenderStopping = false;
+        pKvs->uSenderDrainTimeoutMs = 0;
+
+        if (ThreadAPI_Create(&(pKvs->xSenderThread), prvSenderThread, pKvs) != THREADAPI_OK)
+        {
+            res = KVS_ERROR_THREAD_ERROR;
+            LogError("Failed to create sender thread");
+            pKvs->xSenderThread = NULL;
         }
     }
 
     return res;
 }
 
-int KvsApp_readFragmentAck(KvsAppHandle handle, ePutMediaFragmentAckEventType *peAckEventType, uint64_t *puFragmentTimecode, unsigned int *puErrorId)
+int KvsApp_stopSender(KvsAppHandle handle, unsigned int uDrainTimeoutMs)
 {
     int res = KVS_ERRNO_NONE;
     KvsApp_t *pKvs = (KvsApp_t *)handle;
+    int xThreadRes = 0;
 
     if (pKvs == NULL)
     {
         res = KVS_ERROR_INVALID_ARGUMENT;
     }
+    else if (pKvs->xSenderThread == NULL)
+    {
+        res = KVS_ERROR_KVSAPP_SENDER_IS_NOT_RUNNING;
+    }
+    else if (Lock(pKvs->xSendWakeupLock) != LOCK_OK)
+    {
+        res = KVS_ERROR_LOCK_ERROR;
+        LogError("Failed to lock");
+    }
     else
     {
-        res = Kvs_putMediaReadFragmentAck(pKvs->xPutMediaHandle, peAckEventType, puFragmentTimecode, puErrorId);
+        pKvs->uSenderDrainTimeoutMs = uDrainTimeoutMs;
+        pKvs->bSenderStopping = true;
+        pKvs->bSendWakeupPending = true;
+        Condition_Post(pKvs->xSendWakeupCond);
+        Unlock(pKvs->xSendWakeupLock);
+
+        if (ThreadAPI_Join(pKvs->xSenderThread, &xThreadRes) != THREADAPI_OK)
+        {
+            res = KVS_ERROR_THREAD_ERROR;
+            LogError("Failed to join sender thread");
+        }
+        pKvs->xSenderThread = NULL;
     }
 
     return res;
@@ -1560,6 +3152,50 @@ size_t KvsApp_getStreamMemStatTotal(KvsAppHandle handle)
     }
 }
 
+int KvsApp_getTlsStats(KvsAppHandle handle, TlsContextStats_t *pxStats)
+{
+    int res = KVS_ERRNO_NONE;
+    KvsApp_t *pKvs = (KvsApp_t *)handle;
+
+    if (pKvs == NULL || pxStats == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else if (pKvs->xTlsContext == NULL)
+    {
+        memset(pxStats, 0, sizeof(TlsContextStats_t));
+    }
+    else
+    {
+        res = TlsContext_getStats(pKvs->xTlsContext, pxStats);
+    }
+
+    return res;
+}
+
+int KvsApp_getLatencyStats(KvsAppHandle handle, KvsAppLatencyStats_t *pxStats)
+{
+    int res = KVS_ERRNO_NONE;
+    KvsApp_t *pKvs = (KvsApp_t *)handle;
+
+    if (pKvs == NULL || pxStats == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else if (Lock(pKvs->xLatency.xLock) != LOCK_OK)
+    {
+        res = KVS_ERROR_LOCK_ERROR;
+        LogError("Failed to lock");
+    }
+    else
+    {
+        memcpy(pxStats, &(pKvs->xLatency.xStats), sizeof(KvsAppLatencyStats_t));
+        Unlock(pKvs->xLatency.xLock);
+    }
+
+    return res;
+}
+
 int KvsApp_setOnMkvSentCallback(KvsAppHandle handle, OnMkvSentCallback_t onMkvSentCallback, void *pAppData)
 {
     int res = KVS_ERRNO_NONE;
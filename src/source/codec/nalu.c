@@ -15,25 +15,88 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <string.h>
 
 /* Third party headers */
 #include "azure_c_shared_utility/xlogging.h"
 
+/* Start codes are searched with SIMD if the target has it, unless KVS_NALU_SCAN_SCALAR is defined. */
+#if !defined(KVS_NALU_SCAN_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define NALU_SCAN_SSE2
+#include <emmintrin.h>
+#elif !defined(KVS_NALU_SCAN_SCALAR) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define NALU_SCAN_NEON
+#include <arm_neon.h>
+#endif
+
 /* Public headers */
 #include "kvs/errors.h"
 #include "kvs/nalu.h"
 
 /* Internal headers */
 #include "codec/sps_decode.h"
+#include "os/allocator.h"
 #include "os/endian.h"
 
-#define MAX_NALU_COUNT_IN_A_FRAME ( 16 )
+#define AVCC_NALU_LENGTH_SIZE ( 4 )
+
+/* The number of bytes that are checked at once by SIMD */
+#define NALU_SCAN_VECTOR_SIZE ( 16 )
 
-typedef struct Nal
+/**
+ * Find the first two zero bytes in a row, which is where a start code could begin.
+ *
+ * Both start codes begin with two zero bytes, and they are rare in the payload because of emulation prevention, so most
+ * of a frame is skipped here without checking byte by byte. The byte at uEnd must be readable.
+ *
+ * @param[in] pBuf The Annex-B buffer
+ * @param[in] uIdx The index to start from
+ * @param[in] uEnd The index to stop at
+ * @return The index of the first zero byte pair, or uEnd if there is none
+ */
+static size_t prvFindZeroBytePair(const uint8_t *pBuf, size_t uIdx, size_t uEnd)
 {
-    uint32_t uNalBeginIdx;
-    uint32_t uNalLen;
-} Nal_t;
+#if defined(NALU_SCAN_SSE2)
+    const __m128i xZero = _mm_setzero_si128();
+    __m128i xCurr;
+    __m128i xNext;
+
+    while (uIdx + NALU_SCAN_VECTOR_SIZE <= uEnd)
+    {
+        /* Compare the bytes and their next bytes to zero, so a match is a zero byte followed by a zero byte. */
+        xCurr = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(pBuf + uIdx)), xZero);
+        xNext = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(pBuf + uIdx + 1)), xZero);
+        if (_mm_movemask_epi8(_mm_and_si128(xCurr, xNext)) != 0)
+        {
+            break;
+        }
+        uIdx += NALU_SCAN_VECTOR_SIZE;
+    }
+#elif defined(NALU_SCAN_NEON)
+    uint8x16_t xMatch;
+    uint64x2_t xMatch64;
+
+    while (uIdx + NALU_SCAN_VECTOR_SIZE <= uEnd)
+    {
+        /* Compare the bytes and their next bytes to zero, so a match is a zero byte followed by a zero byte. */
+        xMatch = vandq_u8(vceqq_u8(vld1q_u8(pBuf + uIdx), vdupq_n_u8(0)), vceqq_u8(vld1q_u8(pBuf + uIdx + 1), vdupq_n_u8(0)));
+        xMatch64 = vreinterpretq_u64_u8(xMatch);
+        if ((vgetq_lane_u64(xMatch64, 0) | vgetq_lane_u64(xMatch64, 1)) != 0)
+        {
+            break;
+        }
+        uIdx += NALU_SCAN_VECTOR_SIZE;
+    }
+#endif
+
+    /* The rest, and the vector that has a match, are checked byte by byte. */
+    while (uIdx < uEnd && (pBuf[uIdx] != 0x00 || pBuf[uIdx + 1] != 0x00))
+    {
+        uIdx++;
+    }
+
+    return uIdx;
+}
 
 bool isKeyFrame(uint8_t *pBuf, size_t uLen)
 {
@@ -126,7 +189,8 @@ int NALU_getNaluFromAvccNalus(uint8_t *pAvccBuf, size_t uAvccLen, uint8_t uNaluT
 int NALU_getNaluFromAnnexBNalus(uint8_t *pAnnexBBuf, size_t uAnnexBLen, uint8_t uNaluType, uint8_t **ppNalu, size_t *puNaluLen)
 {
     int res = KVS_ERRNO_NONE;
-    uint8_t *pIdx = pAnnexBBuf;
+    size_t uIdx = 0;
+    uint8_t *pIdx = NULL;
     uint8_t *pNalu = NULL;
     size_t uNaluLen = 0;
 
@@ -137,60 +201,44 @@ int NALU_getNaluFromAnnexBNalus(uint8_t *pAnnexBBuf, size_t uAnnexBLen, uint8_t
     }
     else
     {
-        while (pIdx - pAnnexBBuf < uAnnexBLen - 4)
+        /* Bytes before two zero bytes in a row can't be a start code, so they are skipped at once. */
+        while ((uIdx = prvFindZeroBytePair(pAnnexBBuf, uIdx, uAnnexBLen - 4)) < uAnnexBLen - 4)
         {
-            if (pIdx[0] == 0x00)
+            pIdx = pAnnexBBuf + uIdx;
+            if (pIdx[2] == 0x00)
             {
-                if (pIdx[1] == 0x00)
+                if (pIdx[3] == 0x01)
                 {
-                    if (pIdx[2] == 0x00)
-                    {
-                        if (pIdx[3] == 0x01)
-                        {
-                            /* It's a valid NALU here. */
-                            if (pNalu != NULL)
-                            {
-                                uNaluLen = pIdx - pNalu;
-                                break;
-                            }
-                            else if ((pIdx[4] & 0x80) == 0 && (pIdx[4] & 0x1F) == uNaluType)
-                            {
-                                pNalu = pIdx + 4;
-                            }
-                            pIdx += 4;
-                        }
-                        else
-                        {
-                            pIdx += 4;
-                        }
-                    }
-                    else if (pIdx[2] == 0x01)
+                    /* It's a valid NALU here. */
+                    if (pNalu != NULL)
                     {
-                        /* It's a valid NALU here. */
-                        if (pNalu != NULL)
-                        {
-                            uNaluLen = pIdx - pNalu;
-                            break;
-                        }
-                        else if ((pIdx[3] & 0x80) == 0 && (pIdx[3] & 0x1F) == uNaluType)
-                        {
-                            pNalu = pIdx + 3;
-                        }
-                        pIdx += 3;
+                        uNaluLen = pIdx - pNalu;
+                        break;
                     }
-                    else
+                    else if ((pIdx[4] & 0x80) == 0 && (pIdx[4] & 0x1F) == uNaluType)
                     {
-                        pIdx += 3;
+                        pNalu = pIdx + 4;
                     }
                 }
-                else
+                uIdx += 4;
+            }
+            else if (pIdx[2] == 0x01)
+            {
+                /* It's a valid NALU here. */
+                if (pNalu != NULL)
+                {
+                    uNaluLen = pIdx - pNalu;
+                    break;
+                }
+                else if ((pIdx[3] & 0x80) == 0 && (pIdx[3] & 0x1F) == uNaluType)
                 {
-                    pIdx += 2;
+                    pNalu = pIdx + 3;
                 }
+                uIdx += 3;
             }
             else
             {
-                pIdx++;
+                uIdx += 3;
             }
         }
 
@@ -238,11 +286,9 @@ bool NALU_isAnnexBFrame(uint8_t *pAnnexbBuf, uint32_t uAnnexbBufLen)
 int NALU_convertAnnexBToAvccInPlace(uint8_t *pAnnexbBuf, uint32_t uAnnexbBufLen, uint32_t uAnnexbBufSize, uint32_t *pAvccLen)
 {
     int res = KVS_ERRNO_NONE;
-    uint32_t i = 0;
-    Nal_t xNals[ MAX_NALU_COUNT_IN_A_FRAME ];
-    uint32_t uNalRbspCount = 0;
-    uint32_t uAvccTotalLen = 0;
-    uint32_t uAvccIdx = 0;
+    NaluIndex_t xIndex;
+
+    NALU_initIndex(&xIndex, NULL, 0);
 
     if (pAnnexbBuf == NULL || uAnnexbBufLen <= 4 || uAnnexbBufSize < uAnnexbBufLen || pAvccLen == NULL)
     {
@@ -253,129 +299,345 @@ int NALU_convertAnnexBToAvccInPlace(uint8_t *pAnnexbBuf, uint32_t uAnnexbBufLen,
     {
         LogInfo("It's not a Annex-B frame, skip convert");
     }
+    else if ((res = NALU_buildIndex(pAnnexbBuf, uAnnexbBufLen, &xIndex)) != KVS_ERRNO_NONE)
+    {
+        /* Propagate the res error */
+    }
+    else
+    {
+        res = NALU_convertAnnexBToAvccInPlaceWithIndex(pAnnexbBuf, uAnnexbBufSize, &xIndex, pAvccLen);
+    }
+
+    NALU_deinitIndex(&xIndex);
+
+    return res;
+}
+
+void NALU_initIndex(NaluIndex_t *pxIndex, NaluIndexEntry_t *pxTable, size_t uCapacity)
+{
+    if (pxIndex != NULL)
+    {
+        memset(pxIndex, 0, sizeof(NaluIndex_t));
+        if (pxTable != NULL && uCapacity > 0)
+        {
+            pxIndex->pxNalus = pxTable;
+            pxIndex->uCapacity = uCapacity;
+        }
+        else
+        {
+            pxIndex->pxNalus = pxIndex->xInlineNalus;
+            pxIndex->uCapacity = NALU_INDEX_INLINE_COUNT;
+        }
+    }
+}
+
+void NALU_deinitIndex(NaluIndex_t *pxIndex)
+{
+    if (pxIndex != NULL)
+    {
+        if (pxIndex->bIsTableAllocated)
+        {
+            kvsFree(pxIndex->pxNalus);
+        }
+        NALU_initIndex(pxIndex, NULL, 0);
+    }
+}
+
+static int prvIndexGrow(NaluIndex_t *pxIndex)
+{
+    int res = KVS_ERRNO_NONE;
+    NaluIndexEntry_t *pxNalus = NULL;
+    size_t uCapacity = pxIndex->uCapacity * 2;
+
+    if (uCapacity <= pxIndex->uCapacity || uCapacity > SIZE_MAX / sizeof(NaluIndexEntry_t))
+    {
+        res = KVS_ERROR_EXCEED_MAX_NALU_COUNT_LIMIT;
+        LogError("NAL RBSP count exceeds max count");
+    }
+    else if ((pxNalus = (NaluIndexEntry_t *)kvsMalloc(uCapacity * sizeof(NaluIndexEntry_t))) == NULL)
+    {
+        res = KVS_ERROR_OUT_OF_MEMORY;
+        LogError("OOM: NALU table");
+    }
+    else
+    {
+        memcpy(pxNalus, pxIndex->pxNalus, pxIndex->uCount * sizeof(NaluIndexEntry_t));
+        if (pxIndex->bIsTableAllocated)
+        {
+            kvsFree(pxIndex->pxNalus);
+        }
+        pxIndex->pxNalus = pxNalus;
+        pxIndex->uCapacity = uCapacity;
+        pxIndex->bIsTableAllocated = true;
+    }
+
+    return res;
+}
+
+static int prvIndexAddNalu(NaluIndex_t *pxIndex, uint8_t *pBuf, uint32_t uOffset, uint32_t uLen)
+{
+    int res = KVS_ERRNO_NONE;
+    NaluIndexEntry_t *pxNalu = NULL;
+
+    if (pxIndex->uCount == pxIndex->uCapacity && (res = prvIndexGrow(pxIndex)) != KVS_ERRNO_NONE)
+    {
+        /* Propagate the res error */
+    }
     else
     {
-        /* Go through all Annex-B buffer and record all RBSP begin and length first. */
-        while (i < uAnnexbBufLen - 4)
+        pxNalu = &(pxIndex->pxNalus[pxIndex->uCount++]);
+        pxNalu->uOffset = uOffset;
+        pxNalu->uLen = uLen;
+        if (uLen == 0 || (pBuf[uOffset] & 0x80) != 0 || (pxIndex->xCodec == VIDEO_CODEC_H265 && uLen < 2))
+        {
+            pxNalu->uType = NALU_TYPE_UNKNOWN;
+        }
+        else if (pxIndex->xCodec == VIDEO_CODEC_H265)
+        {
+            /* The H.265 NALU header is 2 bytes, and the type is the 6 bits after the forbidden bit. */
+            pxNalu->uType = (pBuf[uOffset] >> 1) & 0x3F;
+        }
+        else
+        {
+            pxNalu->uType = pBuf[uOffset] & 0x1F;
+        }
+    }
+
+    return res;
+}
+
+static int prvBuildAnnexBIndex(uint8_t *pBuf, uint32_t uLen, NaluIndex_t *pxIndex)
+{
+    int res = KVS_ERRNO_NONE;
+    uint32_t i = 0;
+    uint32_t uStartCodeLen = 0;
+    uint32_t uNaluBegin = 0;
+    bool bHasNalu = false;
+
+    /* Bytes before two zero bytes in a row can't be a start code, so they are skipped at once. */
+    while ((i = (uint32_t)prvFindZeroBytePair(pBuf, i, uLen - 4)) < uLen - 4)
+    {
+        uStartCodeLen = 0;
+        if (pBuf[i+2] == 0x00)
         {
-            if (uNalRbspCount > MAX_NALU_COUNT_IN_A_FRAME)
+            if (pBuf[i+3] == 0x01)
             {
-                break;
+                /* 0x00000001 is start code of NAL. */
+                uStartCodeLen = 4;
             }
-
-            if (pAnnexbBuf[i] == 0x00)
+            else if (pBuf[i+3] == 0x00)
             {
-                if (pAnnexbBuf[i+1] == 0x00)
-                {
-                    if (pAnnexbBuf[i+2] == 0x00)
-                    {
-                        if (pAnnexbBuf[i+3] == 0x01)
-                        {
-                            /* 0x00000001 is start code of NAL. */
-                            if (uNalRbspCount > 0)
-                            {
-                                xNals[uNalRbspCount-1].uNalLen = i - xNals[uNalRbspCount-1].uNalBeginIdx;
-                            }
-
-                            i += 4;
-                            xNals[uNalRbspCount++].uNalBeginIdx = i;
-                        }
-                        else if (pAnnexbBuf[i + 3] == 0x00)
-                        {
-                            /* 0x00000000 is not allowed. */
-                            LogInfo("Invalid NALU format");
-                            res = KVS_ERROR_INVALID_NALU_FORMAT;
-                            break;
-                        }
-                        else
-                        {
-                            /* 0x000000XX is acceptable. */
-                            i += 4;
-                        }
-                    }
-                    else if (pAnnexbBuf[i+2] == 0x01)
-                    {
-                        /* 0x000001 is start code of NAL */
-                        if (uNalRbspCount > 0)
-                        {
-                            xNals[uNalRbspCount-1].uNalLen = i - xNals[uNalRbspCount-1].uNalBeginIdx;
-                        }
-
-                        i += 3;
-                        xNals[uNalRbspCount++].uNalBeginIdx = i;
-                    }
-                    else
-                    {
-                        /* 0x0000XX is acceptable. It includes EPB case and we reserve EPB byte. */
-                        i += 3;
-                    }
-                }
-                else
-                {
-                    /* 0x00XX is acceptable. */
-                    i += 2;
-                }
+                /* 0x00000000 is not allowed. */
+                LogInfo("Invalid NALU format");
+                res = KVS_ERROR_INVALID_NALU_FORMAT;
+                break;
             }
             else
             {
-                /* 0xXX is acceptable. */
-                i++;
+                /* 0x000000XX is acceptable. */
+                i += 4;
             }
         }
+        else if (pBuf[i+2] == 0x01)
+        {
+            /* 0x000001 is start code of NAL */
+            uStartCodeLen = 3;
+        }
+        else
+        {
+            /* 0x0000XX is acceptable. It includes EPB case and we reserve EPB byte. */
+            i += 3;
+        }
 
-        if (uNalRbspCount == 0)
+        if (uStartCodeLen > 0)
         {
-            res = KVS_ERROR_MISSING_NALU;
-            LogInfo("No NALU is found in Annex-B frame");
+            /* The previous NALU ends at this start code. */
+            if (bHasNalu && (res = prvIndexAddNalu(pxIndex, pBuf, uNaluBegin, i - uNaluBegin)) != KVS_ERRNO_NONE)
+            {
+                break;
+            }
+
+            i += uStartCodeLen;
+            uNaluBegin = i;
+            bHasNalu = true;
+        }
+    }
+
+    if (res == KVS_ERRNO_NONE && bHasNalu)
+    {
+        res = prvIndexAddNalu(pxIndex, pBuf, uNaluBegin, uLen - uNaluBegin);
+    }
+
+    return res;
+}
+
+static int prvBuildAvccIndex(uint8_t *pBuf, uint32_t uLen, NaluIndex_t *pxIndex)
+{
+    int res = KVS_ERRNO_NONE;
+    uint32_t uIdx = 0;
+    uint32_t uNaluLen = 0;
+
+    while (uIdx + AVCC_NALU_LENGTH_SIZE < uLen)
+    {
+        uNaluLen = ((uint32_t)pBuf[uIdx] << 24) | ((uint32_t)pBuf[uIdx+1] << 16) | ((uint32_t)pBuf[uIdx+2] << 8) | pBuf[uIdx+3];
+        uIdx += AVCC_NALU_LENGTH_SIZE;
+
+        if (uNaluLen > uLen - uIdx)
+        {
+            res = KVS_ERROR_AVCC_NALU_IS_BROKEN;
+            LogInfo("AVCC NALU length exceeds the frame");
+            break;
         }
-        else if (uNalRbspCount > MAX_NALU_COUNT_IN_A_FRAME)
+        else if ((res = prvIndexAddNalu(pxIndex, pBuf, uIdx, uNaluLen)) != KVS_ERRNO_NONE)
+        {
+            break;
+        }
+        else
+        {
+            uIdx += uNaluLen;
+        }
+    }
+
+    return res;
+}
+
+int NALU_buildIndex(uint8_t *pBuf, size_t uLen, NaluIndex_t *pxIndex)
+{
+    return NALU_buildIndexWithCodec(pBuf, uLen, VIDEO_CODEC_H264, pxIndex);
+}
+
+int NALU_buildIndexWithCodec(uint8_t *pBuf, size_t uLen, VideoCodec_t xCodec, NaluIndex_t *pxIndex)
+{
+    int res = KVS_ERRNO_NONE;
+
+    if (pBuf == NULL || uLen <= 4 || uLen > UINT32_MAX || (xCodec != VIDEO_CODEC_H264 && xCodec != VIDEO_CODEC_H265) || pxIndex == NULL ||
+        pxIndex->pxNalus == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else
+    {
+        pxIndex->uCount = 0;
+        pxIndex->xCodec = xCodec;
+        pxIndex->bIsAnnexB = NALU_isAnnexBFrame(pBuf, (uint32_t)uLen);
+
+        if (pxIndex->bIsAnnexB)
         {
-            res = KVS_ERROR_EXCEED_MAX_NALU_COUNT_LIMIT;
-            LogError("NAL RBSP count exceeds max count");
+            res = prvBuildAnnexBIndex(pBuf, (uint32_t)uLen, pxIndex);
         }
         else
         {
-            /* Update the last BSPS. */
-            xNals[ uNalRbspCount - 1 ].uNalLen = uAnnexbBufLen - xNals[ uNalRbspCount - 1 ].uNalBeginIdx;
+            res = prvBuildAvccIndex(pBuf, (uint32_t)uLen, pxIndex);
+        }
+
+        if (res == KVS_ERRNO_NONE && pxIndex->uCount == 0)
+        {
+            res = KVS_ERROR_MISSING_NALU;
+            LogInfo("No NALU is found in the frame");
+        }
+    }
+
+    return res;
+}
+
+bool NALU_isKeyFrameInIndex(const NaluIndex_t *pxIndex)
+{
+    size_t i = 0;
+    bool bIsKeyFrame = false;
 
-            /* Calculate needed size if we convert it to Avcc format. */
-            uAvccTotalLen = 4 * uNalRbspCount;
-            for (i=0; i<uNalRbspCount; i++)
+    if (pxIndex != NULL)
+    {
+        for (i = 0; i < pxIndex->uCount; i++)
+        {
+            if ((pxIndex->xCodec == VIDEO_CODEC_H264 && pxIndex->pxNalus[i].uType == NALU_TYPE_IFRAME) ||
+                (pxIndex->xCodec == VIDEO_CODEC_H265 && pxIndex->pxNalus[i].uType >= NALU_TYPE_HEVC_IRAP_MIN && pxIndex->pxNalus[i].uType <= NALU_TYPE_HEVC_IRAP_MAX))
             {
-                uAvccTotalLen += xNals[i].uNalLen;
+                bIsKeyFrame = true;
+                break;
             }
+        }
+    }
+
+    return bIsKeyFrame;
+}
+
+int NALU_getNaluFromIndex(const NaluIndex_t *pxIndex, uint8_t *pBuf, uint8_t uNaluType, uint8_t **ppNalu, size_t *puNaluLen)
+{
+    int res = KVS_ERROR_NALU_TYPE_NOT_FOUND;
+    size_t i = 0;
 
-            if (uAvccTotalLen > uAnnexbBufSize)
+    if (pxIndex == NULL || pBuf == NULL || uNaluType == NALU_TYPE_UNKNOWN || uNaluType >= 64 || ppNalu == NULL || puNaluLen == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else
+    {
+        for (i = 0; i < pxIndex->uCount; i++)
+        {
+            if (pxIndex->pxNalus[i].uType == uNaluType)
             {
-                /* We don't have enough space to convert Annex-B to Avcc in place. */
-                LogInfo("No available space to convert Annex-B inplace");
-                *pAvccLen = 0;
-                res = KVS_ERROR_NO_ENOUGH_SPACE_FOR_NALU_CONVERSION;
+                *ppNalu = pBuf + pxIndex->pxNalus[i].uOffset;
+                *puNaluLen = pxIndex->pxNalus[i].uLen;
+                res = KVS_ERRNO_NONE;
+                break;
             }
-            else
-            {
-               /* move RBSP from back to head */
-                i = uNalRbspCount - 1;
-                uAvccIdx = uAvccTotalLen;
-                do
-                {
-                    /* move RBSP */
-                    uAvccIdx -= xNals[i].uNalLen;
-                    memmove(pAnnexbBuf + uAvccIdx, pAnnexbBuf + xNals[i].uNalBeginIdx, xNals[i].uNalLen);
+        }
+    }
+
+    return res;
+}
 
-                    /* fill length info */
-                    uAvccIdx -= 4;
-                    PUT_UNALIGNED_4_byte_BE(pAnnexbBuf + uAvccIdx, xNals[i].uNalLen);
+int NALU_convertAnnexBToAvccInPlaceWithIndex(uint8_t *pBuf, uint32_t uBufSize, NaluIndex_t *pxIndex, uint32_t *pAvccLen)
+{
+    int res = KVS_ERRNO_NONE;
+    size_t i = 0;
+    uint64_t uAvccTotalLen = 0;
+    uint32_t uAvccIdx = 0;
 
-                    if (i == 0)
-                    {
-                        break;
-                    }
-                    i--;
-                } while (true);
+    if (pBuf == NULL || pxIndex == NULL || pxIndex->uCount == 0 || pAvccLen == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else if (!pxIndex->bIsAnnexB)
+    {
+        *pAvccLen = pxIndex->pxNalus[pxIndex->uCount - 1].uOffset + pxIndex->pxNalus[pxIndex->uCount - 1].uLen;
+    }
+    else
+    {
+        /* Calculate needed size if we convert it to Avcc format. */
+        for (i = 0; i < pxIndex->uCount; i++)
+        {
+            uAvccTotalLen += AVCC_NALU_LENGTH_SIZE + pxIndex->pxNalus[i].uLen;
+        }
 
-                *pAvccLen = uAvccTotalLen;
+        if (uAvccTotalLen > uBufSize)
+        {
+            /* We don't have enough space to convert Annex-B to Avcc in place. */
+            LogInfo("No available space to convert Annex-B inplace");
+            *pAvccLen = 0;
+            res = KVS_ERROR_NO_ENOUGH_SPACE_FOR_NALU_CONVERSION;
+        }
+        else
+        {
+            /* Move NALUs from back to head, so a NALU is never overwritten before it's moved. */
+            uAvccIdx = (uint32_t)uAvccTotalLen;
+            i = pxIndex->uCount;
+            while (i > 0)
+            {
+                i--;
+                uAvccIdx -= pxIndex->pxNalus[i].uLen;
+                memmove(pBuf + uAvccIdx, pBuf + pxIndex->pxNalus[i].uOffset, pxIndex->pxNalus[i].uLen);
+                pxIndex->pxNalus[i].uOffset = uAvccIdx;
+
+                uAvccIdx -= AVCC_NALU_LENGTH_SIZE;
+                PUT_UNALIGNED_4_byte_BE(pBuf + uAvccIdx, pxIndex->pxNalus[i].uLen);
             }
+
+            pxIndex->bIsAnnexB = false;
+            *pAvccLen = (uint32_t)uAvccTotalLen;
         }
     }
 
@@ -401,5 +663,34 @@ int NALU_getH264VideoResolutionFromSps(uint8_t *pSps, size_t uSpsLen, uint16_t *
         getH264VideoResolution((char *)(pSps + 1), uSpsLen - 1, puWidth, puHeight);
     }
 
+    return res;
+}
+
+int NALU_getH265VideoResolutionFromSps(uint8_t *pSps, size_t uSpsLen, uint16_t *puWidth, uint16_t *puHeight)
+{
+    int res = KVS_ERRNO_NONE;
+    H265SpsInfo_t xSpsInfo;
+
+    if (pSps == NULL || uSpsLen < 3 || puWidth == NULL || puHeight == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else if (((pSps[0] >> 1) & 0x3F) != NALU_TYPE_HEVC_SPS)
+    {
+        res = KVS_ERROR_INVALID_NALU_FORMAT;
+        LogError("Not a SPS NALU");
+    }
+    else if ((res = getH265SpsInfo(pSps, uSpsLen, &xSpsInfo)) != KVS_ERRNO_NONE)
+    {
+        LogError("Failed to parse SPS");
+        /* Propagate the res error */
+    }
+    else
+    {
+        *puWidth = xSpsInfo.uWidth;
+        *puHeight = xSpsInfo.uHeight;
+    }
+
     return res;
 }
\ No newline at end of file
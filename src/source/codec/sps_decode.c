@@ -17,7 +17,11 @@
 #include <stdio.h>
 #include <string.h>
 
+/* Public headers */
+#include "kvs/errors.h"
+
 /* Internal headers */
+#include "codec/sps_decode.h"
 #include "os/allocator.h"
 
 typedef struct BitStream
@@ -199,4 +203,188 @@ void getH264VideoResolution(char *pSps, size_t uSpsLen, uint16_t *puWidth, uint1
 
     *puWidth = (uint16_t)xWidth;
     *puHeight = (uint16_t)xHeight;
+}
+
+/* A bit reader over the RBSP of a NALU, which skips emulation prevention bytes and never reads beyond the NALU. */
+typedef struct RbspReader
+{
+    const uint8_t *pBuf;
+    size_t uLen;
+    size_t uByteIdx;
+    uint8_t uCurrentByte;
+    unsigned int uBitsLeft;
+    unsigned int uZeroCount;
+    bool bIsInvalid;
+} RbspReader_t;
+
+static void prvRbspLoadByte(RbspReader_t *pxReader)
+{
+    if (pxReader->uZeroCount >= 2 && pxReader->uByteIdx < pxReader->uLen && pxReader->pBuf[pxReader->uByteIdx] == 0x03)
+    {
+        /* 0x000003 carries an emulation prevention byte that is not part of the RBSP. */
+        pxReader->uByteIdx++;
+        pxReader->uZeroCount = 0;
+    }
+
+    if (pxReader->uByteIdx >= pxReader->uLen)
+    {
+        pxReader->bIsInvalid = true;
+        pxReader->uCurrentByte = 0;
+    }
+    else
+    {
+        pxReader->uCurrentByte = pxReader->pBuf[pxReader->uByteIdx++];
+        pxReader->uZeroCount = (pxReader->uCurrentByte == 0) ? pxReader->uZeroCount + 1 : 0;
+    }
+    pxReader->uBitsLeft = 8;
+}
+
+static uint32_t prvRbspReadBits(RbspReader_t *pxReader, unsigned int uBits)
+{
+    uint32_t uValue = 0;
+
+    while (uBits > 0)
+    {
+        if (pxReader->uBitsLeft == 0)
+        {
+            prvRbspLoadByte(pxReader);
+        }
+        pxReader->uBitsLeft--;
+        uValue = (uValue << 1) | ((pxReader->uCurrentByte >> pxReader->uBitsLeft) & 0x01);
+        uBits--;
+    }
+
+    return uValue;
+}
+
+static uint32_t prvRbspReadUe(RbspReader_t *pxReader)
+{
+    unsigned int uLeadingZeros = 0;
+    uint32_t uValue = 0;
+
+    while (prvRbspReadBits(pxReader, 1) == 0 && !pxReader->bIsInvalid)
+    {
+        uLeadingZeros++;
+        if (uLeadingZeros > 31)
+        {
+            pxReader->bIsInvalid = true;
+            break;
+        }
+    }
+
+    if (!pxReader->bIsInvalid)
+    {
+        uValue = (uint32_t)((1ULL << uLeadingZeros) - 1 + prvRbspReadBits(pxReader, uLeadingZeros));
+    }
+
+    return uValue;
+}
+
+int getH265SpsInfo(const uint8_t *pSps, size_t uSpsLen, H265SpsInfo_t *pxInfo)
+{
+    int res = KVS_ERRNO_NONE;
+    RbspReader_t xReader = {0};
+    bool pbSubLayerProfilePresent[8] = {false};
+    bool pbSubLayerLevelPresent[8] = {false};
+    uint32_t uPicWidth = 0;
+    uint32_t uPicHeight = 0;
+    uint32_t uConfWinLeft = 0;
+    uint32_t uConfWinRight = 0;
+    uint32_t uConfWinTop = 0;
+    uint32_t uConfWinBottom = 0;
+    uint32_t uChromaFormatIdc = 0;
+    uint32_t uBitDepthLumaMinus8 = 0;
+    uint32_t uBitDepthChromaMinus8 = 0;
+    uint32_t uSubWidthC = 1;
+    uint32_t uSubHeightC = 1;
+    bool bSeparateColourPlane = false;
+    unsigned int i = 0;
+
+    if (pSps == NULL || uSpsLen < 3 || pxInfo == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else
+    {
+        memset(pxInfo, 0, sizeof(H265SpsInfo_t));
+        xReader.pBuf = pSps;
+        xReader.uLen = uSpsLen;
+
+        /* Please refer to https://www.itu.int/rec/T-REC-H.265/ Section 7.3.2.2 Sequence parameter set RBSP syntax */
+        prvRbspReadBits(&xReader, 16); /* NALU header */
+        prvRbspReadBits(&xReader, 4); /* sps_video_parameter_set_id */
+        pxInfo->uMaxSubLayersMinus1 = (uint8_t)prvRbspReadBits(&xReader, 3);
+        pxInfo->bTemporalIdNesting = (prvRbspReadBits(&xReader, 1) != 0);
+
+        /* profile_tier_level(1, sps_max_sub_layers_minus1) */
+        for (i = 0; i < H265_GENERAL_PROFILE_TIER_LEVEL_SIZE; i++)
+        {
+            pxInfo->puGeneralProfileTierLevel[i] = (uint8_t)prvRbspReadBits(&xReader, 8);
+        }
+        for (i = 0; i < pxInfo->uMaxSubLayersMinus1; i++)
+        {
+            pbSubLayerProfilePresent[i] = (prvRbspReadBits(&xReader, 1) != 0);
+            pbSubLayerLevelPresent[i] = (prvRbspReadBits(&xReader, 1) != 0);
+        }
+        if (pxInfo->uMaxSubLayersMinus1 > 0)
+        {
+            prvRbspReadBits(&xReader, 2 * (8 - pxInfo->uMaxSubLayersMinus1)); /* reserved_zero_2bits */
+        }
+        for (i = 0; i < pxInfo->uMaxSubLayersMinus1; i++)
+        {
+            if (pbSubLayerProfilePresent[i])
+            {
+                prvRbspReadBits(&xReader, 32);
+                prvRbspReadBits(&xReader, 32);
+                prvRbspReadBits(&xReader, 24);
+            }
+            if (pbSubLayerLevelPresent[i])
+            {
+                prvRbspReadBits(&xReader, 8);
+            }
+        }
+
+        prvRbspReadUe(&xReader); /* sps_seq_parameter_set_id */
+        uChromaFormatIdc = prvRbspReadUe(&xReader);
+        if (uChromaFormatIdc == 3)
+        {
+            bSeparateColourPlane = (prvRbspReadBits(&xReader, 1) != 0);
+        }
+        uPicWidth = prvRbspReadUe(&xReader);
+        uPicHeight = prvRbspReadUe(&xReader);
+        if (prvRbspReadBits(&xReader, 1) != 0) /* conformance_window_flag */
+        {
+            uConfWinLeft = prvRbspReadUe(&xReader);
+            uConfWinRight = prvRbspReadUe(&xReader);
+            uConfWinTop = prvRbspReadUe(&xReader);
+            uConfWinBottom = prvRbspReadUe(&xReader);
+        }
+        /* They are narrowed only after they are validated, so a huge value cannot wrap into a valid one. */
+        uBitDepthLumaMinus8 = prvRbspReadUe(&xReader);
+        uBitDepthChromaMinus8 = prvRbspReadUe(&xReader);
+
+        /* The conformance window is in chroma samples, see Table 6-1 for SubWidthC and SubHeightC. */
+        if (!bSeparateColourPlane && (uChromaFormatIdc == 1 || uChromaFormatIdc == 2))
+        {
+            uSubWidthC = 2;
+            uSubHeightC = (uChromaFormatIdc == 1) ? 2 : 1;
+        }
+
+        if (xReader.bIsInvalid || uChromaFormatIdc > 3 || uBitDepthLumaMinus8 > 8 || uBitDepthChromaMinus8 > 8 || uPicWidth > UINT16_MAX ||
+            uPicHeight > UINT16_MAX || (uint64_t)uSubWidthC * ((uint64_t)uConfWinLeft + uConfWinRight) >= uPicWidth ||
+            (uint64_t)uSubHeightC * ((uint64_t)uConfWinTop + uConfWinBottom) >= uPicHeight)
+        {
+            res = KVS_ERROR_INVALID_NALU_FORMAT;
+        }
+        else
+        {
+            pxInfo->uChromaFormatIdc = (uint8_t)uChromaFormatIdc;
+            pxInfo->uBitDepthLumaMinus8 = (uint8_t)uBitDepthLumaMinus8;
+            pxInfo->uBitDepthChromaMinus8 = (uint8_t)uBitDepthChromaMinus8;
+            pxInfo->uWidth = (uint16_t)(uPicWidth - uSubWidthC * (uConfWinLeft + uConfWinRight));
+            pxInfo->uHeight = (uint16_t)(uPicHeight - uSubHeightC * (uConfWinTop + uConfWinBottom));
+        }
+    }
+
+    return res;
 }
\ No newline at end of file
@@ -16,6 +16,25 @@
 #ifndef SPS_DECODE_H
 #define SPS_DECODE_H
 
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* The general profile space, tier, profile, compatibility flags, constraint flags and level of a H.265 SPS */
+#define H265_GENERAL_PROFILE_TIER_LEVEL_SIZE ( 12 )
+
+typedef struct H265SpsInfo
+{
+    uint8_t puGeneralProfileTierLevel[H265_GENERAL_PROFILE_TIER_LEVEL_SIZE];
+    uint8_t uMaxSubLayersMinus1;
+    bool bTemporalIdNesting;
+    uint8_t uChromaFormatIdc;
+    uint8_t uBitDepthLumaMinus8;
+    uint8_t uBitDepthChromaMinus8;
+    uint16_t uWidth;
+    uint16_t uHeight;
+} H265SpsInfo_t;
+
 /**
  * @breif Get H264 resolution from SPS
  *
@@ -26,4 +45,16 @@
  */
 void getH264VideoResolution(char *pSps, size_t uSpsLen, uint16_t *puWidth, uint16_t *puHeight);
 
+/**
+ * @brief Parse a H.265 SPS up to the bit depths
+ *
+ * Emulation prevention bytes are removed while parsing, and reading beyond the SPS is reported as an error.
+ *
+ * @param[in] pSps The SPS NALU including its 2 bytes NALU header
+ * @param[in] uSpsLen The length of SPS NALU
+ * @param[out] pxInfo The parsed SPS fields
+ * @return 0 on success, non-zero value otherwise
+ */
+int getH265SpsInfo(const uint8_t *pSps, size_t uSpsLen, H265SpsInfo_t *pxInfo);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,246 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Thirdparty headers */
+#include "azure_c_shared_utility/xlogging.h"
+#include "parson.h"
+
+/* Public headers */
+#include "kvs/errors.h"
+#include "kvs/port.h"
+
+/* Internal headers */
+#include "misc/endpoint_cache.h"
+#include "os/allocator.h"
+
+/* The cache is a small JSON object, so anything larger is not a cache file. */
+#define ENDPOINT_CACHE_MAX_FILE_SIZE (4 * 1024)
+
+/* The cache is written to a temporary file first, and renamed over the cache file when it's complete. */
+#define ENDPOINT_CACHE_TMP_SUFFIX ".tmp"
+
+#define JSON_KEY_HOST "host"
+#define JSON_KEY_STREAM_NAME "streamName"
+#define JSON_KEY_ENDPOINT "endpoint"
+#define JSON_KEY_EXPIRATION "expiration"
+
+static char *prvReadFile(const char *pcFilename)
+{
+    FILE *fp = NULL;
+    char *pcBuf = NULL;
+    size_t uLen = 0;
+
+    if ((fp = fopen(pcFilename, "rb")) == NULL)
+    {
+        /* It's a cache miss if the file doesn't exist. */
+    }
+    else if ((pcBuf = (char *)kvsMalloc(ENDPOINT_CACHE_MAX_FILE_SIZE + 1)) == NULL)
+    {
+        LogError("OOM: endpoint cache");
+    }
+    else
+    {
+        uLen = fread(pcBuf, 1, ENDPOINT_CACHE_MAX_FILE_SIZE + 1, fp);
+        if (uLen == 0 || uLen > ENDPOINT_CACHE_MAX_FILE_SIZE)
+        {
+            kvsFree(pcBuf);
+            pcBuf = NULL;
+        }
+        else
+        {
+            pcBuf[uLen] = '\0';
+        }
+    }
+
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+
+    return pcBuf;
+}
+
+int EndpointCache_load(const char *pcFilename, const char *pcHost, const char *pcStreamName, char **ppcEndpoint)
+{
+    int res = KVS_ERRNO_NONE;
+    char *pcBuf = NULL;
+    JSON_Value *pxRootValue = NULL;
+    JSON_Object *pxRootObject = NULL;
+    const char *pcCachedHost = NULL;
+    const char *pcCachedStreamName = NULL;
+    const char *pcEndpoint = NULL;
+    uint64_t uExpiration = 0;
+    size_t uEndpointLen = 0;
+
+    if (pcFilename == NULL || pcHost == NULL || pcStreamName == NULL || ppcEndpoint == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else if ((pcBuf = prvReadFile(pcFilename)) == NULL ||
+             (pxRootValue = json_parse_string(pcBuf)) == NULL || (pxRootObject = json_value_get_object(pxRootValue)) == NULL ||
+             (pcCachedHost = json_object_get_string(pxRootObject, JSON_KEY_HOST)) == NULL ||
+             (pcCachedStreamName = json_object_get_string(pxRootObject, JSON_KEY_STREAM_NAME)) == NULL ||
+             (pcEndpoint = json_object_get_string(pxRootObject, JSON_KEY_ENDPOINT)) == NULL)
+    {
+        res = KVS_ERROR_ENDPOINT_CACHE_MISS;
+    }
+    else if (strcmp(pcCachedHost, pcHost) != 0 || strcmp(pcCachedStreamName, pcStreamName) != 0)
+    {
+        res = KVS_ERROR_ENDPOINT_CACHE_MISS;
+        LogInfo("Endpoint cache is for another stream");
+    }
+    else if ((uExpiration = (uint64_t)json_object_get_number(pxRootObject, JSON_KEY_EXPIRATION)) <= getEpochTimestampInMs())
+    {
+        res = KVS_ERROR_ENDPOINT_CACHE_MISS;
+        LogInfo("Endpoint cache is expired");
+    }
+    else
+    {
+        uEndpointLen = strlen(pcEndpoint);
+        if ((*ppcEndpoint = (char *)kvsMalloc(uEndpointLen + 1)) == NULL)
+        {
+            res = KVS_ERROR_OUT_OF_MEMORY;
+            LogError("OOM: endpoint");
+        }
+        else
+        {
+            memcpy(*ppcEndpoint, pcEndpoint, uEndpointLen);
+            (*ppcEndpoint)[uEndpointLen] = '\0';
+        }
+    }
+
+    if (pxRootValue != NULL)
+    {
+        json_value_free(pxRootValue);
+    }
+
+    if (pcBuf != NULL)
+    {
+        kvsFree(pcBuf);
+    }
+
+    return res;
+}
+
+static char *prvGetTmpFilename(const char *pcFilename)
+{
+    size_t uSize = strlen(pcFilename) + sizeof(ENDPOINT_CACHE_TMP_SUFFIX);
+    char *pcTmpFilename = NULL;
+
+    if ((pcTmpFilename = (char *)kvsMalloc(uSize)) != NULL)
+    {
+        snprintf(pcTmpFilename, uSize, "%s%s", pcFilename, ENDPOINT_CACHE_TMP_SUFFIX);
+    }
+
+    return pcTmpFilename;
+}
+
+int EndpointCache_store(const char *pcFilename, const char *pcHost, const char *pcStreamName, const char *pcEndpoint, unsigned int uTtlSec)
+{
+    int res = KVS_ERRNO_NONE;
+    JSON_Value *pxRootValue = NULL;
+    JSON_Object *pxRootObject = NULL;
+    char *pcJson = NULL;
+    size_t uJsonLen = 0;
+    char *pcTmpFilename = NULL;
+    FILE *fp = NULL;
+
+    if (pcFilename == NULL || pcHost == NULL || pcStreamName == NULL || pcEndpoint == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else if ((pxRootValue = json_value_init_object()) == NULL || (pxRootObject = json_value_get_object(pxRootValue)) == NULL ||
+             json_object_set_string(pxRootObject, JSON_KEY_HOST, pcHost) != JSONSuccess ||
+             json_object_set_string(pxRootObject, JSON_KEY_STREAM_NAME, pcStreamName) != JSONSuccess ||
+             json_object_set_string(pxRootObject, JSON_KEY_ENDPOINT, pcEndpoint) != JSONSuccess ||
+             json_object_set_number(pxRootObject, JSON_KEY_EXPIRATION, (double)(getEpochTimestampInMs() + (uint64_t)uTtlSec * 1000)) != JSONSuccess ||
+             (pcJson = json_serialize_to_string(pxRootValue)) == NULL)
+    {
+        res = KVS_ERROR_OUT_OF_MEMORY;
+        LogError("OOM: endpoint cache");
+    }
+    else if ((pcTmpFilename = prvGetTmpFilename(pcFilename)) == NULL)
+    {
+        res = KVS_ERROR_OUT_OF_MEMORY;
+        LogError("OOM: pcTmpFilename");
+    }
+    else if ((fp = fopen(pcTmpFilename, "wb")) == NULL)
+    {
+        res = KVS_ERROR_FAIL_TO_STORE_ENDPOINT_CACHE;
+        LogError("Failed to open endpoint cache %s", pcFilename);
+    }
+    else
+    {
+        uJsonLen = strlen(pcJson);
+        if (fwrite(pcJson, 1, uJsonLen, fp) != uJsonLen || fflush(fp) != 0)
+        {
+            res = KVS_ERROR_FAIL_TO_STORE_ENDPOINT_CACHE;
+            LogError("Failed to write endpoint cache");
+        }
+    }
+
+    if (fp != NULL && fclose(fp) != 0 && res == KVS_ERRNO_NONE)
+    {
+        res = KVS_ERROR_FAIL_TO_STORE_ENDPOINT_CACHE;
+        LogError("Failed to write endpoint cache");
+    }
+
+    /* The cache file is replaced only by a complete one, so a crash or a concurrent load never sees a partial write. */
+    if (res == KVS_ERRNO_NONE && rename(pcTmpFilename, pcFilename) != 0)
+    {
+        /* Some file systems don't rename over an existing file. */
+        remove(pcFilename);
+        if (rename(pcTmpFilename, pcFilename) != 0)
+        {
+            res = KVS_ERROR_FAIL_TO_STORE_ENDPOINT_CACHE;
+            LogError("Failed to replace endpoint cache %s", pcFilename);
+        }
+    }
+
+    if (res != KVS_ERRNO_NONE && fp != NULL)
+    {
+        remove(pcTmpFilename);
+    }
+
+    if (pcTmpFilename != NULL)
+    {
+        kvsFree(pcTmpFilename);
+    }
+
+    if (pcJson != NULL)
+    {
+        json_free_serialized_string(pcJson);
+    }
+
+    if (pxRootValue != NULL)
+    {
+        json_value_free(pxRootValue);
+    }
+
+    return res;
+}
+
+void EndpointCache_invalidate(const char *pcFilename)
+{
+    if (pcFilename != NULL)
+    {
+        remove(pcFilename);
+    }
+}
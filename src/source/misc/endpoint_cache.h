@@ -0,0 +1,52 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#ifndef ENDPOINT_CACHE_H
+#define ENDPOINT_CACHE_H
+
+/**
+ * Load the PUT MEDIA data endpoint of a stream from a cache file.
+ *
+ * A cached endpoint also means that the stream exists. The cache is valid only if it's stored for the same host and
+ * stream, and it's not expired.
+ *
+ * @param[in] pcFilename Cache file name
+ * @param[in] pcHost Control plane host
+ * @param[in] pcStreamName Stream name
+ * @param[out] ppcEndpoint The data endpoint, which should be freed by kvsFree()
+ * @return 0 on success, KVS_ERROR_ENDPOINT_CACHE_MISS if there is no valid cache, non-zero value otherwise
+ */
+int EndpointCache_load(const char *pcFilename, const char *pcHost, const char *pcStreamName, char **ppcEndpoint);
+
+/**
+ * Store the PUT MEDIA data endpoint of a stream to a cache file.
+ *
+ * @param[in] pcFilename Cache file name
+ * @param[in] pcHost Control plane host
+ * @param[in] pcStreamName Stream name
+ * @param[in] pcEndpoint The data endpoint
+ * @param[in] uTtlSec The time in seconds that the cache is valid
+ * @return 0 on success, non-zero value otherwise
+ */
+int EndpointCache_store(const char *pcFilename, const char *pcHost, const char *pcStreamName, const char *pcEndpoint, unsigned int uTtlSec);
+
+/**
+ * Remove a cache file, so the next load misses.
+ *
+ * @param[in] pcFilename Cache file name
+ */
+void EndpointCache_invalidate(const char *pcFilename);
+
+#endif /* ENDPOINT_CACHE_H */
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <string.h>
+
+/* Public headers */
+#include "kvs/latency_histogram.h"
+
+#define SUB_BUCKET_COUNT (1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS)
+
+static size_t prvBucketIndex(uint64_t uLatencyMs)
+{
+    size_t uIndex = 0;
+    unsigned int uMsb = 0;
+
+    if (uLatencyMs < SUB_BUCKET_COUNT)
+    {
+        uIndex = (size_t)uLatencyMs;
+    }
+    else
+    {
+        while (uMsb < 63 && (uLatencyMs >> (uMsb + 1)) != 0)
+        {
+            uMsb++;
+        }
+        uIndex = (uMsb - LATENCY_HISTOGRAM_SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + (size_t)((uLatencyMs >> (uMsb - LATENCY_HISTOGRAM_SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1));
+        if (uIndex >= LATENCY_HISTOGRAM_BUCKET_COUNT)
+        {
+            uIndex = LATENCY_HISTOGRAM_BUCKET_COUNT - 1;
+        }
+    }
+
+    return uIndex;
+}
+
+void LatencyHistogram_reset(LatencyHistogram_t *pxHistogram)
+{
+    if (pxHistogram != NULL)
+    {
+        memset(pxHistogram, 0, sizeof(LatencyHistogram_t));
+    }
+}
+
+void LatencyHistogram_record(LatencyHistogram_t *pxHistogram, uint64_t uLatencyMs)
+{
+    if (pxHistogram != NULL)
+    {
+        if (pxHistogram->uCount == 0 || uLatencyMs < pxHistogram->uMinMs)
+        {
+            pxHistogram->uMinMs = uLatencyMs;
+        }
+        if (uLatencyMs > pxHistogram->uMaxMs)
+        {
+            pxHistogram->uMaxMs = uLatencyMs;
+        }
+        pxHistogram->uCount++;
+        pxHistogram->uSumMs += uLatencyMs;
+        pxHistogram->puBuckets[prvBucketIndex(uLatencyMs)]++;
+    }
+}
+
+uint64_t LatencyHistogram_getBucketLowerBound(size_t uIndex)
+{
+    uint64_t uLowerBound = 0;
+    size_t uShift = 0;
+
+    if (uIndex >= LATENCY_HISTOGRAM_BUCKET_COUNT)
+    {
+        uLowerBound = UINT64_MAX;
+    }
+    else if (uIndex < SUB_BUCKET_COUNT)
+    {
+        uLowerBound = uIndex;
+    }
+    else
+    {
+        uShift = uIndex / SUB_BUCKET_COUNT - 1;
+        uLowerBound = (uint64_t)(SUB_BUCKET_COUNT + uIndex % SUB_BUCKET_COUNT) << uShift;
+    }
+
+    return uLowerBound;
+}
+
+uint64_t LatencyHistogram_getPercentile(const LatencyHistogram_t *pxHistogram, unsigned int uPercentile)
+{
+    uint64_t uLatencyMs = 0;
+    uint64_t uRank = 0;
+    uint64_t uAccumulated = 0;
+    size_t i = 0;
+
+    if (pxHistogram != NULL && pxHistogram->uCount > 0)
+    {
+        if (uPercentile > 100)
+        {
+            uPercentile = 100;
+        }
+
+        /* The rank is rounded up, and at least the first recorded latency. */
+        uRank = ((uint64_t)pxHistogram->uCount * uPercentile + 99) / 100;
+        if (uRank == 0)
+        {
+            uRank = 1;
+        }
+
+        uLatencyMs = pxHistogram->uMaxMs;
+        for (i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT; i++)
+        {
+            uAccumulated += pxHistogram->puBuckets[i];
+            if (uAccumulated >= uRank)
+            {
+                if (i + 1 < LATENCY_HISTOGRAM_BUCKET_COUNT && LatencyHistogram_getBucketLowerBound(i + 1) - 1 < uLatencyMs)
+                {
+                    uLatencyMs = LatencyHistogram_getBucketLowerBound(i + 1) - 1;
+                }
+                break;
+            }
+        }
+
+        if (uLatencyMs < pxHistogram->uMinMs)
+        {
+            uLatencyMs = pxHistogram->uMinMs;
+        }
+    }
+
+    return uLatencyMs;
+}
@@ -28,6 +28,7 @@
 #include "kvs/port.h"
 
 /* Internal headers */
+#include "codec/sps_decode.h"
 #include "os/allocator.h"
 #include "os/endian.h"
 
@@ -99,21 +100,27 @@
 /* The size of simple block header */
 #define SIMPLE_BLOCK_HEADER_SIZE (4)
 
-/* The offset of frame size offset in gClusterSimpleBlock.  This field is 8 bytes long, but we only use least 4 bytes. */
-#define MKV_CLUSTER_SIMPLE_BLOCK_FRAME_SIZE_OFFSET (5)
+/* The EBML ID of SimpleBlock */
+#define MKV_CLUSTER_SIMPLE_BLOCK_ID (0xA3)
 
-/* The offset of track number in gClusterSimpleBlock */
-#define MKV_CLUSTER_SIMPLE_BLOCK_TRACK_NUMBER_OFFSET (9)
+/* The maximum length of an EBML size.  The value with all data bits set is reserved for unknown size. */
+#define MKV_EBML_SIZE_MAX_LEN (8)
 
-/* The offset of delta timestamp in gClusterSimpleBlock */
-#define MKV_CLUSTER_SIMPLE_BLOCK_DELTA_TIMESTAMP_OFFSET (10)
+/* The largest frame size that fits in a SimpleBlock of the longest EBML size */
+#define MKV_SIMPLE_BLOCK_FRAME_SIZE_MAX ((((uint64_t)1 << (7 * MKV_EBML_SIZE_MAX_LEN)) - 2) - SIMPLE_BLOCK_HEADER_SIZE)
 
-/* The offset of property in gClusterSimpleBlock */
-#define MKV_CLUSTER_SIMPLE_BLOCK_PROPERTY_OFFSET (12)
+/* The offset of timestamp in gClusterHeader */
+#define MKV_CLUSTER_TIMESTAMP_OFFSET (7)
 
 /* In H264 extended profile, the size except sps and pps. */
 #define MKV_VIDEO_H264_CODEC_PRIVATE_DATA_HEADER_SIZE (11)
 
+/* The size of HEVCDecoderConfigurationRecord before the NALU arrays. */
+#define MKV_VIDEO_H265_CODEC_PRIVATE_DATA_HEADER_SIZE (23)
+
+/* The size of a NALU array header with one NALU, which are the NALU type, the NALU count and the NALU length. */
+#define MKV_VIDEO_H265_CODEC_PRIVATE_DATA_ARRAY_HEADER_SIZE (5)
+
 /* It's a pre-defined MKV header of EBML document. EBML is used for the first frame in a streaming. There is no
  * configurable field in this header. */
 static uint8_t gEbmlHeader[] = {
@@ -313,24 +320,6 @@ static uint8_t gClusterHeader[] = {
 };
 static const uint32_t gClusterHeaderSize = sizeof(gClusterHeader);
 
-static uint8_t gClusterSimpleBlock[] = {
-    0xA3, // SimpleBlock (L2)
-    0x01,
-    0x00,
-    0x00,
-    0x00,
-    0x00,
-    0x00,
-    0x00,
-    0x00, // len = SimpleBlock Header 4 bytes + raw data size - will be fixed up
-    0x81, // track Number, 0x81 is track number 1 - a placeholder
-    0x00,
-    0x00, // timecode, relative to cluster timecode - INT16 - needs to be fixed up
-    0x00  // Flags - needs to be fixed up
-          // Frame data follows
-};
-static const uint32_t gClusterSimpleBlockSize = sizeof(gClusterSimpleBlock);
-
 // Sampling Frequency in Hz
 static uint32_t gMkvAACSamplingFrequencies[] = {
     96000,
@@ -650,17 +639,62 @@ void Mkv_terminateHeaders(MkvHeader_t *pMkvHeader)
 
 /*-----------------------------------------------------------*/
 
-size_t Mkv_getClusterHdrLen(MkvClusterType_t xType)
+static size_t prvEbmlSizeLen(uint64_t uSize)
+{
+    size_t uLen = 1;
+
+    /* An EBML size of n bytes holds 7n data bits, and the value with all data bits set is reserved. */
+    while (uLen < MKV_EBML_SIZE_MAX_LEN && uSize >= ((uint64_t)1 << (7 * uLen)) - 1)
+    {
+        uLen++;
+    }
+
+    return uLen;
+}
+
+/* The SimpleBlock header is built in place because its size is in the shortest EBML encoding:
+ *   0xA3 (SimpleBlock ID), size (1~8 bytes), track number (1 byte), delta timestamp (2 bytes), flags (1 byte).
+ * The size covers SimpleBlock header 4 bytes and raw data. */
+static uint8_t *prvWriteSimpleBlockHdr(uint8_t *pIdx, uint64_t uBlockSize, size_t uSizeLen, TrackType_t xTrackType, uint16_t uDeltaTimestamp, uint8_t uFlags)
+{
+    size_t i = 0;
+
+    *pIdx++ = MKV_CLUSTER_SIMPLE_BLOCK_ID;
+    for (i = uSizeLen; i > 0; i--)
+    {
+        pIdx[i - 1] = (uint8_t)(uBlockSize & 0xFF);
+        uBlockSize >>= 8;
+    }
+    /* The length marker bit sits right after (uSizeLen - 1) leading zero bits. */
+    pIdx[0] |= (uint8_t)(0x80 >> (uSizeLen - 1));
+    pIdx += uSizeLen;
+
+    *pIdx++ = MKV_LENGTH_INDICATOR_1_BYTE | ((uint8_t)xTrackType & 0xFF);
+    PUT_UNALIGNED_2_byte_BE(pIdx, uDeltaTimestamp);
+    pIdx += 2;
+    *pIdx++ = uFlags;
+
+    return pIdx;
+}
+
+size_t Mkv_getClusterHdrLen(MkvClusterType_t xType, size_t uFrameSize)
 {
     size_t uLen = 0;
+    size_t uSimpleBlockHdrLen = 0;
+
+    if ((uint64_t)uFrameSize > MKV_SIMPLE_BLOCK_FRAME_SIZE_MAX)
+    {
+        uFrameSize = (size_t)MKV_SIMPLE_BLOCK_FRAME_SIZE_MAX;
+    }
+    uSimpleBlockHdrLen = 1 + prvEbmlSizeLen((uint64_t)uFrameSize + SIMPLE_BLOCK_HEADER_SIZE) + SIMPLE_BLOCK_HEADER_SIZE;
 
     if (xType == MKV_CLUSTER)
     {
-        uLen = gClusterHeaderSize + gClusterSimpleBlockSize;
+        uLen = gClusterHeaderSize + uSimpleBlockHdrLen;
     }
     else if (xType == MKV_SIMPLE_BLOCK)
     {
-        uLen = gClusterSimpleBlockSize;
+        uLen = uSimpleBlockHdrLen;
     }
 
     return uLen;
@@ -678,34 +712,33 @@ int Mkv_initializeClusterHdr(
 {
     int res = KVS_ERRNO_NONE;
     uint8_t *pIdx = NULL;
-    size_t uMkvHeaderLen = Mkv_getClusterHdrLen(xType);
+    uint64_t uBlockSize = (uint64_t)uFrameSize + SIMPLE_BLOCK_HEADER_SIZE;
+    size_t uSizeLen = prvEbmlSizeLen(uBlockSize);
+    size_t uMkvHeaderLen = Mkv_getClusterHdrLen(xType, uFrameSize);
 
     if (pMkvHeader == NULL || uMkvHeaderLen > uMkvHeaderSize)
     {
         res = KVS_ERROR_INVALID_ARGUMENT;
         LogError("Invalid argument");
     }
+    else if ((uint64_t)uFrameSize > MKV_SIMPLE_BLOCK_FRAME_SIZE_MAX)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Frame size exceeds the max EBML size");
+    }
     else if (xType == MKV_CLUSTER)
     {
         pIdx = pMkvHeader;
         memcpy(pIdx, gClusterHeader, gClusterHeaderSize);
-        PUT_UNALIGNED_8_byte_BE(pIdx + 7, uAbsoluteTimestamp);
+        PUT_UNALIGNED_8_byte_BE(pIdx + MKV_CLUSTER_TIMESTAMP_OFFSET, uAbsoluteTimestamp);
         pIdx += gClusterHeaderSize;
 
-        memcpy(pIdx, gClusterSimpleBlock, gClusterSimpleBlockSize);
-        *(pIdx + MKV_CLUSTER_SIMPLE_BLOCK_TRACK_NUMBER_OFFSET) = MKV_LENGTH_INDICATOR_1_BYTE | ((uint8_t)xTrackType & 0xFF);
-        PUT_UNALIGNED_4_byte_BE(pIdx + MKV_CLUSTER_SIMPLE_BLOCK_FRAME_SIZE_OFFSET, SIMPLE_BLOCK_HEADER_SIZE + uFrameSize);
-        *(pIdx + MKV_CLUSTER_SIMPLE_BLOCK_PROPERTY_OFFSET) = 0x80;
-        pIdx += gClusterSimpleBlockSize;
+        pIdx = prvWriteSimpleBlockHdr(pIdx, uBlockSize, uSizeLen, xTrackType, 0, 0x80);
     }
     else if (xType == MKV_SIMPLE_BLOCK)
     {
         pIdx = pMkvHeader;
-        memcpy(pIdx, gClusterSimpleBlock, gClusterSimpleBlockSize);
-        *(pIdx + MKV_CLUSTER_SIMPLE_BLOCK_TRACK_NUMBER_OFFSET) = MKV_LENGTH_INDICATOR_1_BYTE | ((uint8_t)xTrackType & 0xFF);
-        PUT_UNALIGNED_4_byte_BE(pIdx + MKV_CLUSTER_SIMPLE_BLOCK_FRAME_SIZE_OFFSET, SIMPLE_BLOCK_HEADER_SIZE + uFrameSize);
-        PUT_UNALIGNED_2_byte_BE(pIdx + MKV_CLUSTER_SIMPLE_BLOCK_DELTA_TIMESTAMP_OFFSET, uDeltaTimestamp);
-        pIdx += gClusterSimpleBlockSize;
+        pIdx = prvWriteSimpleBlockHdr(pIdx, uBlockSize, uSizeLen, xTrackType, uDeltaTimestamp, 0x00);
     }
     else
     {
@@ -894,6 +927,121 @@ int Mkv_generateH264CodecPrivateDataFromSpsPps(uint8_t *pSps, size_t uSpsLen, ui
 
 /*-----------------------------------------------------------*/
 
+static uint8_t *prvWriteH265NaluArray(uint8_t *pCpdIdx, uint8_t uNaluType, uint8_t *pNalu, size_t uNaluLen)
+{
+    *(pCpdIdx++) = 0x80 | uNaluType; /* '1' array_completeness + '0' reserved + NAL_unit_type */
+    PUT_UNALIGNED_2_byte_BE(pCpdIdx, 1); /* numNalus */
+    pCpdIdx += 2;
+    PUT_UNALIGNED_2_byte_BE(pCpdIdx, uNaluLen);
+    pCpdIdx += 2;
+    memcpy(pCpdIdx, pNalu, uNaluLen);
+    pCpdIdx += uNaluLen;
+
+    return pCpdIdx;
+}
+
+int Mkv_generateH265CodecPrivateDataFromVpsSpsPps(
+    uint8_t *pVps, size_t uVpsLen, uint8_t *pSps, size_t uSpsLen, uint8_t *pPps, size_t uPpsLen, uint8_t **ppCodecPrivateData, size_t *puCodecPrivateDataLen)
+{
+    int res = KVS_ERRNO_NONE;
+    uint8_t *pCpdIdx = NULL;
+    uint8_t *pCodecPrivateData = NULL;
+    size_t uCodecPrivateLen = 0;
+    H265SpsInfo_t xSpsInfo;
+
+    if (pVps == NULL || uVpsLen == 0 || uVpsLen > UINT16_MAX || pSps == NULL || uSpsLen == 0 || uSpsLen > UINT16_MAX || pPps == NULL || uPpsLen == 0 ||
+        uPpsLen > UINT16_MAX || ppCodecPrivateData == NULL || puCodecPrivateDataLen == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else if ((res = getH265SpsInfo(pSps, uSpsLen, &xSpsInfo)) != KVS_ERRNO_NONE)
+    {
+        LogError("Failed to parse H265 SPS");
+        /* Propagate the res error */
+    }
+    else
+    {
+        uCodecPrivateLen = MKV_VIDEO_H265_CODEC_PRIVATE_DATA_HEADER_SIZE + 3 * MKV_VIDEO_H265_CODEC_PRIVATE_DATA_ARRAY_HEADER_SIZE + uVpsLen + uSpsLen + uPpsLen;
+
+        if ((pCodecPrivateData = (uint8_t *)kvsMalloc(uCodecPrivateLen)) == NULL)
+        {
+            res = KVS_ERROR_OUT_OF_MEMORY;
+            LogError("OOM: H265 codec private data");
+        }
+        else
+        {
+            /* Please refer to ISO/IEC 14496-15 Section 8.3.3.1 HEVC decoder configuration record */
+            pCpdIdx = pCodecPrivateData;
+            *(pCpdIdx++) = 0x01; /* configurationVersion */
+            memcpy(pCpdIdx, xSpsInfo.puGeneralProfileTierLevel, H265_GENERAL_PROFILE_TIER_LEVEL_SIZE);
+            pCpdIdx += H265_GENERAL_PROFILE_TIER_LEVEL_SIZE;
+            *(pCpdIdx++) = 0xF0; /* '1111' reserved + min_spatial_segmentation_idc which is 0 */
+            *(pCpdIdx++) = 0x00;
+            *(pCpdIdx++) = 0xFC; /* '111111' reserved + parallelismType which is 0 (i.e. unknown) */
+            *(pCpdIdx++) = 0xFC | xSpsInfo.uChromaFormatIdc; /* '111111' reserved + chromaFormat */
+            *(pCpdIdx++) = 0xF8 | xSpsInfo.uBitDepthLumaMinus8; /* '11111' reserved + bitDepthLumaMinus8 */
+            *(pCpdIdx++) = 0xF8 | xSpsInfo.uBitDepthChromaMinus8; /* '11111' reserved + bitDepthChromaMinus8 */
+            *(pCpdIdx++) = 0x00; /* avgFrameRate which is 0 (i.e. unspecified) */
+            *(pCpdIdx++) = 0x00;
+
+            /* '00' constantFrameRate + numTemporalLayers + temporalIdNested + '11' lengthSizeMinusOne which is 3 (i.e. NALU length size = 4) */
+            *(pCpdIdx++) = (uint8_t)(((xSpsInfo.uMaxSubLayersMinus1 + 1) & 0x07) << 3) | (xSpsInfo.bTemporalIdNesting ? 0x04 : 0x00) | 0x03;
+
+            *(pCpdIdx++) = 0x03; /* numOfArrays */
+            pCpdIdx = prvWriteH265NaluArray(pCpdIdx, NALU_TYPE_HEVC_VPS, pVps, uVpsLen);
+            pCpdIdx = prvWriteH265NaluArray(pCpdIdx, NALU_TYPE_HEVC_SPS, pSps, uSpsLen);
+            pCpdIdx = prvWriteH265NaluArray(pCpdIdx, NALU_TYPE_HEVC_PPS, pPps, uPpsLen);
+
+            *ppCodecPrivateData = pCodecPrivateData;
+            *puCodecPrivateDataLen = uCodecPrivateLen;
+        }
+    }
+
+    return res;
+}
+
+/*-----------------------------------------------------------*/
+
+int Mkv_generateH265CodecPrivateDataFromNalus(uint8_t *pBuf, size_t uLen, uint8_t **ppCodecPrivateData, size_t *puCodecPrivateDataLen)
+{
+    int res = KVS_ERRNO_NONE;
+    NaluIndex_t xIndex;
+    uint8_t *pVps = NULL;
+    size_t uVpsLen = 0;
+    uint8_t *pSps = NULL;
+    size_t uSpsLen = 0;
+    uint8_t *pPps = NULL;
+    size_t uPpsLen = 0;
+
+    NALU_initIndex(&xIndex, NULL, 0);
+
+    if (pBuf == NULL || uLen == 0 || ppCodecPrivateData == NULL || puCodecPrivateDataLen == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else if (
+        (res = NALU_buildIndexWithCodec(pBuf, uLen, VIDEO_CODEC_H265, &xIndex)) != KVS_ERRNO_NONE ||
+        (res = NALU_getNaluFromIndex(&xIndex, pBuf, NALU_TYPE_HEVC_VPS, &pVps, &uVpsLen)) != KVS_ERRNO_NONE ||
+        (res = NALU_getNaluFromIndex(&xIndex, pBuf, NALU_TYPE_HEVC_SPS, &pSps, &uSpsLen)) != KVS_ERRNO_NONE ||
+        (res = NALU_getNaluFromIndex(&xIndex, pBuf, NALU_TYPE_HEVC_PPS, &pPps, &uPpsLen)) != KVS_ERRNO_NONE)
+    {
+        LogInfo("Failed to get VPS, SPS and PPS from NALUs");
+        /* Propagate the res error */
+    }
+    else
+    {
+        res = Mkv_generateH265CodecPrivateDataFromVpsSpsPps(pVps, uVpsLen, pSps, uSpsLen, pPps, uPpsLen, ppCodecPrivateData, puCodecPrivateDataLen);
+    }
+
+    NALU_deinitIndex(&xIndex);
+
+    return res;
+}
+
+/*-----------------------------------------------------------*/
+
 int Mkv_generateAacCodecPrivateData(Mpeg4AudioObjectTypes_t objectType, uint32_t frequency, uint16_t channel, uint8_t **ppCodecPrivateData, size_t *puCodecPrivateDataLen)
 {
     int res = KVS_ERRNO_NONE;
@@ -14,16 +14,19 @@
  */
 
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
 
 /* Third party headers */
-#include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/xlogging.h"
+#include "mbedtls/ssl.h"
 
 /* Public headers */
 #include "kvs/errors.h"
+#include "kvs/port.h"
 
 /* Internal headers */
 #include "os/allocator.h"
@@ -125,13 +128,47 @@ int Http_executeHttpReq(NetIoHandle xNetIoHandle, const char *pcHttpMethod, cons
     return res;
 }
 
+static bool prvIsHttpRspComplete(HttpParserHandle xHttpParser, bool bChunkedBodyAsStream)
+{
+    if (HttpParser_isMessageComplete(xHttpParser))
+    {
+        return true;
+    }
+    else if (bChunkedBodyAsStream && HttpParser_isHeadersComplete(xHttpParser) && HttpParser_isChunked(xHttpParser))
+    {
+        /* The chunked body is a stream which is handled by the caller, so the response is complete after headers. */
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+/**
+ * @brief Check if a receive error is only a timeout or a would-block, so it's worth trying again until the deadline.
+ */
+static bool prvIsRecvRetryable(int res)
+{
+    return res == KVS_GENERATE_MBEDTLS_ERROR(MBEDTLS_ERR_SSL_TIMEOUT) || res == KVS_GENERATE_MBEDTLS_ERROR(MBEDTLS_ERR_SSL_WANT_READ) ||
+           res == KVS_GENERATE_MBEDTLS_ERROR(MBEDTLS_ERR_SSL_WANT_WRITE);
+}
+
 int Http_recvHttpRsp(NetIoHandle xNetIoHandle, unsigned int *puHttpStatus, char **ppRspBody, size_t *puRspBodyLen)
+{
+    return Http_recvHttpRspEx(xNetIoHandle, DEFAULT_HTTP_RSP_TIMEOUT_MS, false, puHttpStatus, ppRspBody, puRspBodyLen);
+}
+
+int Http_recvHttpRspEx(NetIoHandle xNetIoHandle, unsigned int uTimeoutMs, bool bChunkedBodyAsStream, unsigned int *puHttpStatus, char **ppRspBody, size_t *puRspBodyLen)
 {
     int res = KVS_ERRNO_NONE;
-    BUFFER_HANDLE xBufRecv = NULL;
+    HttpParserHandle xHttpParser = NULL;
+    unsigned char *pRecvBuf = NULL;
     size_t uBytesReceived = 0;
-    size_t uBytesTotalReceived = 0;
-    unsigned int uHttpStatusCode = 0;
+    size_t uOffset = 0;
+    size_t uConsumedLen = 0;
+    bool bComplete = false;
+    uint64_t uDeadlineMs = getEpochTimestampInMs() + uTimeoutMs;
     const char *pBodyLoc = NULL;
     size_t uBodyLen = 0;
     char *pRspBody = NULL;
@@ -140,71 +177,99 @@ int Http_recvHttpRsp(NetIoHandle xNetIoHandle, unsigned int *puHttpStatus, char
     {
         res = KVS_ERROR_INVALID_ARGUMENT;
     }
-    else if ((xBufRecv = BUFFER_create_with_size(DEFAULT_HTTP_RECV_BUFSIZE)) == NULL)
+    else if ((xHttpParser = HttpParser_create()) == NULL)
+    {
+        res = KVS_ERROR_FAIL_TO_CREATE_HTTP_PARSER;
+    }
+    else if ((pRecvBuf = (unsigned char *)kvsMalloc(DEFAULT_HTTP_RECV_BUFSIZE)) == NULL)
     {
-        res = KVS_ERROR_C_UTIL_UNABLE_TO_CREATE_BUFFER;
+        res = KVS_ERROR_OUT_OF_MEMORY;
+        LogError("OOM: pRecvBuf");
     }
     else
     {
-        do
+        while (!bComplete && res == KVS_ERRNO_NONE)
         {
-            /* TODO: Add timeout checking here */
-
-            if (uBytesTotalReceived == BUFFER_length(xBufRecv))
+            if (getEpochTimestampInMs() >= uDeadlineMs)
             {
-                /* If buffer is full, then we double the size of buffer. */
-                if (BUFFER_enlarge(xBufRecv, uBytesTotalReceived) != 0)
-                {
-                    res = KVS_ERROR_C_UTIL_UNABLE_TO_ENLARGE_BUFFER;
-                    LogError("OOM: xBufRecv");
-                    break;
-                }
+                res = KVS_ERROR_HTTP_RSP_TIMEOUT;
+                LogError("Timeout on receiving http response");
             }
-            if ((res = NetIo_recv(xNetIoHandle, BUFFER_u_char(xBufRecv) + uBytesTotalReceived, BUFFER_length(xBufRecv) - uBytesTotalReceived, &uBytesReceived)) != KVS_ERRNO_NONE)
+            else if ((res = NetIo_recv(xNetIoHandle, pRecvBuf, DEFAULT_HTTP_RECV_BUFSIZE, &uBytesReceived)) != KVS_ERRNO_NONE)
             {
-                /* Propagate the res error */
+                if (prvIsRecvRetryable(res))
+                {
+                    /* Try again until the deadline. */
+                    res = KVS_ERRNO_NONE;
+                }
+                else
+                {
+                    /* Propagate the res error */
+                }
             }
             /* It should be a timeout case. */
             else if (uBytesReceived == 0)
             {
                 res = KVS_ERROR_RECV_ZERO_SIZED_HTTP_DATA;
-                break;
             }
             else
             {
-                uBytesTotalReceived += uBytesReceived;
-                if ((res = HttpParser_parseHttpResponse((const char *)BUFFER_u_char(xBufRecv), uBytesTotalReceived, &uHttpStatusCode, &pBodyLoc, &uBodyLen)) != KVS_ERRNO_NONE)
-                {
-                    /* Propagate the res error */
-                }
-                /* If it's 100-continue, then we need to discard previous result and do it again. */
-                else if (uHttpStatusCode / 100 == 1)
-                {
-                    LogInfo("100-continue");
-                    uBytesTotalReceived = 0;
-                    res = KVS_ERROR_HTTP_100_CONTINUE_EXPECT_MORE;
-                }
-                else
+                /* Only the new bytes are fed into the parser. */
+                for (uOffset = 0; uOffset < uBytesReceived && !bComplete && res == KVS_ERRNO_NONE; uOffset += uConsumedLen)
                 {
-                    res = KVS_ERRNO_NONE;
-                    *puHttpStatus = uHttpStatusCode;
-
-                    if ((pRspBody = (char *)kvsMalloc(uBodyLen + 1)) == NULL)
+                    if ((res = HttpParser_execute(xHttpParser, (const char *)pRecvBuf + uOffset, uBytesReceived - uOffset, &uConsumedLen)) != KVS_ERRNO_NONE)
+                    {
+                        /* Propagate the res error */
+                    }
+                    else if ((bComplete = prvIsHttpRspComplete(xHttpParser, bChunkedBodyAsStream)) && HttpParser_getStatusCode(xHttpParser) / 100 == 1)
+                    {
+                        /* If it's 100-continue, then we discard it and parse the rest as a new response. */
+                        LogInfo("100-continue");
+                        HttpParser_reset(xHttpParser);
+                        bComplete = false;
+                    }
+                    else if (!bComplete && uConsumedLen == 0)
+                    {
+                        res = KVS_ERROR_HTTP_PARSE_EXECUTE_FAIL;
+                    }
+                    else
                     {
-                        res = KVS_ERROR_OUT_OF_MEMORY;
-                        LogError("OOM pRspBody");
-                        break;
+                        /* nop */
                     }
+                }
+            }
+        }
+
+        if (res == KVS_ERRNO_NONE)
+        {
+            if ((res = HttpParser_getBody(xHttpParser, &pBodyLoc, &uBodyLen)) != KVS_ERRNO_NONE)
+            {
+                /* Propagate the res error */
+            }
+            else if ((pRspBody = (char *)kvsMalloc(uBodyLen + 1)) == NULL)
+            {
+                res = KVS_ERROR_OUT_OF_MEMORY;
+                LogError("OOM pRspBody");
+            }
+            else
+            {
+                if (uBodyLen > 0)
+                {
                     memcpy(pRspBody, pBodyLoc, uBodyLen);
-                    pRspBody[uBodyLen] = '\0';
-                    *ppRspBody = pRspBody;
-                    *puRspBodyLen = uBodyLen;
                 }
+                pRspBody[uBodyLen] = '\0';
+                *puHttpStatus = HttpParser_getStatusCode(xHttpParser);
+                *ppRspBody = pRspBody;
+                *puRspBodyLen = uBodyLen;
             }
-        } while (res != KVS_ERRNO_NONE);
+        }
     }
 
-    BUFFER_delete(xBufRecv);
+    if (pRecvBuf != NULL)
+    {
+        kvsFree(pRecvBuf);
+    }
+    HttpParser_terminate(xHttpParser);
 
     return res;
-}
\ No newline at end of file
+}
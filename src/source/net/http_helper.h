@@ -16,6 +16,8 @@
 #ifndef HTTP_HELPER_H
 #define HTTP_HELPER_H
 
+#include <stdbool.h>
+
 #include "azure_c_shared_utility/httpheaders.h"
 
 #include "netio.h"
@@ -53,6 +55,9 @@
 
 #define HTTP_BODY_EMPTY                 ""
 
+/* The total time allowed for receiving a HTTP response */
+#define DEFAULT_HTTP_RSP_TIMEOUT_MS     (30 * 1000)
+
 /**
  * @brief Execute HTTP request
  *
@@ -76,4 +81,22 @@ int Http_executeHttpReq(NetIoHandle xNetIoHandle, const char *pcHttpMethod, cons
  */
 int Http_recvHttpRsp(NetIoHandle xNetIoHandle, unsigned int *puHttpStatus, char **ppRspBody, size_t *puRspBodyLen);
 
+/**
+ * @brief Receive HTTP response with a deadline
+ *
+ * The response is parsed incrementally as it's received. It returns as soon as the response is complete, or returns
+ * an error if the response is not complete within the timeout. The timeout is checked between receives, so it may be
+ * exceeded by at most one receive timeout of the network I/O.
+ *
+ * @param[in] xNetIoHandle The network I/O handle
+ * @param[in] uTimeoutMs The total time allowed for receiving the response
+ * @param[in] bChunkedBodyAsStream true if a chunked body is a stream that the caller reads later, so the response is
+ *                                 complete once headers are received. (Ex. PUT MEDIA)
+ * @param[out] puHttpStatus The HTTP status code
+ * @param[out] ppRspBody The HTTP response body that is memory allocated and the callee has the responsible to free it.
+ * @param[out] puRspBodyLen The length of HTTP response body.
+ * @return 0 on success, non-zero value otherwise
+ */
+int Http_recvHttpRspEx(NetIoHandle xNetIoHandle, unsigned int uTimeoutMs, bool bChunkedBodyAsStream, unsigned int *puHttpStatus, char **ppRspBody, size_t *puRspBodyLen);
+
 #endif /* HTTP_HELPER_H */
\ No newline at end of file
@@ -13,8 +13,20 @@
 * permissions and limitations under the License.
 */
 
+#ifndef HTTP_PARSER_ADAPTER_H
+#define HTTP_PARSER_ADAPTER_H
+
+#include <stdbool.h>
 #include <stddef.h>
 
+/* The max size of a response body. A larger body fails the parser, so a broken or hostile endpoint cannot make the
+ * device allocate until it runs out of memory. */
+#ifndef HTTP_PARSER_MAX_BODY_SIZE
+#define HTTP_PARSER_MAX_BODY_SIZE   (16 * 1024)
+#endif
+
+typedef struct HttpParser *HttpParserHandle;
+
 /**
  * Parse the HTTP response.
  *
@@ -25,4 +37,86 @@
  * @param puBodyLen length of the body
  * @return 0 on success, non-zero value otherwise
  */
-int HttpParser_parseHttpResponse(const char *pBuf, size_t uLen, unsigned int *puStatusCode, const char **ppBodyLoc, size_t *puBodyLen);
\ No newline at end of file
+int HttpParser_parseHttpResponse(const char *pBuf, size_t uLen, unsigned int *puStatusCode, const char **ppBodyLoc, size_t *puBodyLen);
+
+/**
+ * Create a streaming HTTP response parser.
+ *
+ * The parser lives for the whole response. The response is fed into the parser piece by piece as it's received, and
+ * each byte is parsed only once. The body is copied into the parser, so the caller doesn't need to keep the bytes
+ * that have been fed.
+ *
+ * @return The HTTP parser handle on success, NULL otherwise
+ */
+HttpParserHandle HttpParser_create(void);
+
+/**
+ * Terminate a streaming HTTP response parser.
+ *
+ * @param xHttpParser The HTTP parser handle
+ */
+void HttpParser_terminate(HttpParserHandle xHttpParser);
+
+/**
+ * Reset the parser for a new HTTP response. (Ex. The final response after a "100 Continue")
+ *
+ * @param xHttpParser The HTTP parser handle
+ */
+void HttpParser_reset(HttpParserHandle xHttpParser);
+
+/**
+ * Feed the new bytes of the HTTP response into the parser.
+ *
+ * The parser stops at the end of the response, and the remaining bytes are not consumed.
+ *
+ * @param xHttpParser The HTTP parser handle
+ * @param pBuf the new bytes of the response
+ * @param uLen length of the new bytes
+ * @param puConsumedLen the number of bytes that are consumed by the parser
+ * @return 0 on success, KVS_ERROR_HTTP_RSP_BODY_TOO_LARGE if the body exceeds HTTP_PARSER_MAX_BODY_SIZE, non-zero value otherwise
+ */
+int HttpParser_execute(HttpParserHandle xHttpParser, const char *pBuf, size_t uLen, size_t *puConsumedLen);
+
+/**
+ * Check if the status line and all headers have been parsed.
+ *
+ * @param xHttpParser The HTTP parser handle
+ * @return true if headers are complete, false otherwise
+ */
+bool HttpParser_isHeadersComplete(HttpParserHandle xHttpParser);
+
+/**
+ * Check if the whole response including the body has been parsed.
+ *
+ * @param xHttpParser The HTTP parser handle
+ * @return true if the response is complete, false otherwise
+ */
+bool HttpParser_isMessageComplete(HttpParserHandle xHttpParser);
+
+/**
+ * Check if the body is in chunked transfer encoding. It's valid after headers are complete.
+ *
+ * @param xHttpParser The HTTP parser handle
+ * @return true if the body is chunked, false otherwise
+ */
+bool HttpParser_isChunked(HttpParserHandle xHttpParser);
+
+/**
+ * Get the HTTP status code. It's valid after headers are complete.
+ *
+ * @param xHttpParser The HTTP parser handle
+ * @return The HTTP status code
+ */
+unsigned int HttpParser_getStatusCode(HttpParserHandle xHttpParser);
+
+/**
+ * Get the body that has been parsed so far. Chunked bodies are decoded.
+ *
+ * @param xHttpParser The HTTP parser handle
+ * @param ppBodyLoc pointer of the HTTP body in the parser, or NULL if there is no body
+ * @param puBodyLen length of the body
+ * @return 0 on success, non-zero value otherwise
+ */
+int HttpParser_getBody(HttpParserHandle xHttpParser, const char **ppBodyLoc, size_t *puBodyLen);
+
+#endif /* HTTP_PARSER_ADAPTER_H */
@@ -13,14 +13,59 @@
 * permissions and limitations under the License.
  */
 
+#include <string.h>
+
 /* Public headers */
 #include "kvs/errors.h"
 
 /* Internal headers */
+#include "os/allocator.h"
 #include "net/http_parser_adapter.h"
 
 #define HTTP_RSP_STATUS_HDR         "HTTP/1.1"
+#define HTTP_RSP_STATUS_HDR_PREFIX  "HTTP/1."
 #define HTTP_HDR_CONTENT_LENGTH     "Content-Length"
+#define HTTP_HDR_TRANSFER_ENCODING  "Transfer-Encoding"
+#define HTTP_VAL_CHUNKED            "chunked"
+
+/* The max length of a line that is kept for parsing. The rest of a longer line is skipped because it's not used. */
+#define HTTP_PARSER_LINE_BUFSIZE    (128)
+
+/* The initial size of the body buffer. It grows as needed. */
+#define HTTP_PARSER_BODY_BUFSIZE    (256)
+
+typedef enum
+{
+    HTTP_PARSER_STATE_STATUS_LINE = 0,
+    HTTP_PARSER_STATE_HEADER,
+    HTTP_PARSER_STATE_BODY,
+    HTTP_PARSER_STATE_CHUNK_SIZE,
+    HTTP_PARSER_STATE_CHUNK_DATA,
+    HTTP_PARSER_STATE_CHUNK_DATA_END,
+    HTTP_PARSER_STATE_TRAILER,
+    HTTP_PARSER_STATE_COMPLETE
+} HttpParserState_t;
+
+typedef struct HttpParser
+{
+    HttpParserState_t xState;
+    unsigned int uStatusCode;
+    bool bHeadersComplete;
+    bool bChunked;
+    size_t uContentLength;
+
+    /* The remaining length of the body or the current chunk */
+    size_t uRemaining;
+
+    /* The current line. It may span multiple feeds. */
+    char pLine[HTTP_PARSER_LINE_BUFSIZE];
+    size_t uLineLen;
+
+    /* The decoded body */
+    char *pBody;
+    size_t uBodyLen;
+    size_t uBodySize;
+} HttpParser_t;
 
 #define TOLOWERCASE(c)              (c | 0xA0)
 
@@ -187,4 +232,368 @@ int HttpParser_parseHttpResponse(const char *pBuf, size_t uLen, unsigned int *pu
         }
     }
     return res;
-}
\ No newline at end of file
+}
+
+static int prvAppendBody(HttpParser_t *pxParser, const char *pBuf, size_t uLen)
+{
+    int res = KVS_ERRNO_NONE;
+    char *pBody = NULL;
+    size_t uBodySize = 0;
+
+    if (uLen > HTTP_PARSER_MAX_BODY_SIZE - pxParser->uBodyLen)
+    {
+        res = KVS_ERROR_HTTP_RSP_BODY_TOO_LARGE;
+    }
+    else if (pxParser->uBodyLen + uLen > pxParser->uBodySize)
+    {
+        uBodySize = (pxParser->uBodySize == 0) ? HTTP_PARSER_BODY_BUFSIZE : pxParser->uBodySize * 2;
+        if (uBodySize < pxParser->uBodyLen + uLen)
+        {
+            uBodySize = pxParser->uBodyLen + uLen;
+        }
+        if (uBodySize > HTTP_PARSER_MAX_BODY_SIZE)
+        {
+            uBodySize = HTTP_PARSER_MAX_BODY_SIZE;
+        }
+
+        if ((pBody = (char *)kvsRealloc(pxParser->pBody, uBodySize)) == NULL)
+        {
+            res = KVS_ERROR_OUT_OF_MEMORY;
+        }
+        else
+        {
+            pxParser->pBody = pBody;
+            pxParser->uBodySize = uBodySize;
+        }
+    }
+
+    if (res == KVS_ERRNO_NONE)
+    {
+        memcpy(pxParser->pBody + pxParser->uBodyLen, pBuf, uLen);
+        pxParser->uBodyLen += uLen;
+    }
+
+    return res;
+}
+
+/**
+ * Get the value of a header line if the header name matches.
+ *
+ * @param[in] pLine the header line
+ * @param[in] uLineLen the length of the header line
+ * @param[in] pcName the header name
+ * @param[out] ppValue the value with leading spaces skipped
+ * @param[out] puValueLen the length of the value
+ * @return true if the header name matches, false otherwise
+ */
+static bool prvGetHeaderValue(const char *pLine, size_t uLineLen, const char *pcName, const char **ppValue, size_t *puValueLen)
+{
+    bool bMatch = false;
+    size_t uNameLen = strlen(pcName);
+    const char *p = NULL;
+
+    if (uLineLen > uNameLen && pLine[uNameLen] == ':' && prvStrNCmpCi(pLine, pcName, uNameLen) == 0)
+    {
+        p = pLine + uNameLen + 1;
+        while ((p - pLine) < uLineLen && *p == ' ')
+        {
+            p++;
+        }
+        *ppValue = p;
+        *puValueLen = uLineLen - (p - pLine);
+        bMatch = true;
+    }
+
+    return bMatch;
+}
+
+static int prvParseChunkSize(const char *pLine, size_t uLineLen, size_t *puChunkSize)
+{
+    int res = KVS_ERROR_HTTP_PARSE_EXECUTE_FAIL;
+    size_t uChunkSize = 0;
+    size_t i = 0;
+    char c = 0;
+
+    /* Chunk extensions after the size are ignored. */
+    for (i = 0; i < uLineLen; i++)
+    {
+        c = pLine[i];
+        if (c >= '0' && c <= '9')
+        {
+            uChunkSize = uChunkSize * 16 + (c - '0');
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            uChunkSize = uChunkSize * 16 + (c - 'a' + 10);
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            uChunkSize = uChunkSize * 16 + (c - 'A' + 10);
+        }
+        else
+        {
+            break;
+        }
+        res = KVS_ERRNO_NONE;
+    }
+
+    if (res == KVS_ERRNO_NONE)
+    {
+        *puChunkSize = uChunkSize;
+    }
+
+    return res;
+}
+
+static void prvOnHeadersComplete(HttpParser_t *pxParser)
+{
+    pxParser->bHeadersComplete = true;
+
+    if (pxParser->uStatusCode / 100 == 1 || pxParser->uStatusCode == 204 || pxParser->uStatusCode == 304)
+    {
+        /* These responses have no body. */
+        pxParser->xState = HTTP_PARSER_STATE_COMPLETE;
+    }
+    else if (pxParser->bChunked)
+    {
+        pxParser->xState = HTTP_PARSER_STATE_CHUNK_SIZE;
+    }
+    else if (pxParser->uContentLength > 0)
+    {
+        pxParser->uRemaining = pxParser->uContentLength;
+        pxParser->xState = HTTP_PARSER_STATE_BODY;
+    }
+    else
+    {
+        pxParser->xState = HTTP_PARSER_STATE_COMPLETE;
+    }
+}
+
+static int prvParseLine(HttpParser_t *pxParser)
+{
+    int res = KVS_ERRNO_NONE;
+    const char *pLine = pxParser->pLine;
+    size_t uLineLen = pxParser->uLineLen;
+    const char *pValue = NULL;
+    size_t uValueLen = 0;
+    size_t uChunkSize = 0;
+
+    if (uLineLen > 0 && pLine[uLineLen - 1] == '\r')
+    {
+        uLineLen--;
+    }
+
+    if (pxParser->xState == HTTP_PARSER_STATE_STATUS_LINE)
+    {
+        if (uLineLen < sizeof(HTTP_RSP_STATUS_HDR) || prvStrNCmpCi(pLine, HTTP_RSP_STATUS_HDR_PREFIX, sizeof(HTTP_RSP_STATUS_HDR_PREFIX) - 1) != 0)
+        {
+            res = KVS_ERROR_HTTP_PARSE_EXECUTE_FAIL;
+        }
+        else
+        {
+            pxParser->uStatusCode = prvStrToUInt(pLine + sizeof(HTTP_RSP_STATUS_HDR), uLineLen - sizeof(HTTP_RSP_STATUS_HDR));
+            pxParser->xState = HTTP_PARSER_STATE_HEADER;
+        }
+    }
+    else if (pxParser->xState == HTTP_PARSER_STATE_HEADER)
+    {
+        if (uLineLen == 0)
+        {
+            prvOnHeadersComplete(pxParser);
+        }
+        else if (prvGetHeaderValue(pLine, uLineLen, HTTP_HDR_CONTENT_LENGTH, &pValue, &uValueLen))
+        {
+            pxParser->uContentLength = prvStrToUInt(pValue, uValueLen);
+        }
+        else if (prvGetHeaderValue(pLine, uLineLen, HTTP_HDR_TRANSFER_ENCODING, &pValue, &uValueLen))
+        {
+            pxParser->bChunked = (uValueLen >= sizeof(HTTP_VAL_CHUNKED) - 1 && prvStrNCmpCi(pValue, HTTP_VAL_CHUNKED, sizeof(HTTP_VAL_CHUNKED) - 1) == 0);
+        }
+        else
+        {
+            /* Other headers are not used. */
+        }
+    }
+    else if (pxParser->xState == HTTP_PARSER_STATE_CHUNK_SIZE)
+    {
+        if ((res = prvParseChunkSize(pLine, uLineLen, &uChunkSize)) != KVS_ERRNO_NONE)
+        {
+            /* Propagate the res error */
+        }
+        else if (uChunkSize == 0)
+        {
+            pxParser->xState = HTTP_PARSER_STATE_TRAILER;
+        }
+        else
+        {
+            pxParser->uRemaining = uChunkSize;
+            pxParser->xState = HTTP_PARSER_STATE_CHUNK_DATA;
+        }
+    }
+    else if (pxParser->xState == HTTP_PARSER_STATE_CHUNK_DATA_END)
+    {
+        pxParser->xState = HTTP_PARSER_STATE_CHUNK_SIZE;
+    }
+    else if (pxParser->xState == HTTP_PARSER_STATE_TRAILER)
+    {
+        if (uLineLen == 0)
+        {
+            pxParser->xState = HTTP_PARSER_STATE_COMPLETE;
+        }
+    }
+    else
+    {
+        /* nop */
+    }
+
+    pxParser->uLineLen = 0;
+
+    return res;
+}
+
+HttpParserHandle HttpParser_create(void)
+{
+    HttpParser_t *pxParser = NULL;
+
+    if ((pxParser = (HttpParser_t *)kvsMalloc(sizeof(HttpParser_t))) != NULL)
+    {
+        memset(pxParser, 0, sizeof(HttpParser_t));
+    }
+
+    return pxParser;
+}
+
+void HttpParser_terminate(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    if (pxParser != NULL)
+    {
+        if (pxParser->pBody != NULL)
+        {
+            kvsFree(pxParser->pBody);
+        }
+        kvsFree(pxParser);
+    }
+}
+
+void HttpParser_reset(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+    char *pBody = NULL;
+    size_t uBodySize = 0;
+
+    if (pxParser != NULL)
+    {
+        /* Keep the body buffer for reuse. */
+        pBody = pxParser->pBody;
+        uBodySize = pxParser->uBodySize;
+        memset(pxParser, 0, sizeof(HttpParser_t));
+        pxParser->pBody = pBody;
+        pxParser->uBodySize = uBodySize;
+    }
+}
+
+int HttpParser_execute(HttpParserHandle xHttpParser, const char *pBuf, size_t uLen, size_t *puConsumedLen)
+{
+    int res = KVS_ERRNO_NONE;
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+    size_t uConsumedLen = 0;
+    size_t uCopyLen = 0;
+    char c = 0;
+
+    if (pxParser == NULL || (pBuf == NULL && uLen > 0) || puConsumedLen == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else
+    {
+        while (uConsumedLen < uLen && pxParser->xState != HTTP_PARSER_STATE_COMPLETE && res == KVS_ERRNO_NONE)
+        {
+            if (pxParser->xState == HTTP_PARSER_STATE_BODY || pxParser->xState == HTTP_PARSER_STATE_CHUNK_DATA)
+            {
+                uCopyLen = uLen - uConsumedLen;
+                if (uCopyLen > pxParser->uRemaining)
+                {
+                    uCopyLen = pxParser->uRemaining;
+                }
+
+                if ((res = prvAppendBody(pxParser, pBuf + uConsumedLen, uCopyLen)) == KVS_ERRNO_NONE)
+                {
+                    uConsumedLen += uCopyLen;
+                    pxParser->uRemaining -= uCopyLen;
+                    if (pxParser->uRemaining == 0)
+                    {
+                        pxParser->xState = (pxParser->xState == HTTP_PARSER_STATE_BODY) ? HTTP_PARSER_STATE_COMPLETE : HTTP_PARSER_STATE_CHUNK_DATA_END;
+                    }
+                }
+            }
+            else
+            {
+                c = pBuf[uConsumedLen++];
+                if (c == '\n')
+                {
+                    res = prvParseLine(pxParser);
+                }
+                else if (pxParser->uLineLen < HTTP_PARSER_LINE_BUFSIZE)
+                {
+                    pxParser->pLine[pxParser->uLineLen++] = c;
+                }
+                else
+                {
+                    /* Skip the rest of a long line. */
+                }
+            }
+        }
+
+        *puConsumedLen = uConsumedLen;
+    }
+
+    return res;
+}
+
+bool HttpParser_isHeadersComplete(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    return pxParser != NULL && pxParser->bHeadersComplete;
+}
+
+bool HttpParser_isMessageComplete(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    return pxParser != NULL && pxParser->xState == HTTP_PARSER_STATE_COMPLETE;
+}
+
+bool HttpParser_isChunked(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    return pxParser != NULL && pxParser->bChunked;
+}
+
+unsigned int HttpParser_getStatusCode(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    return (pxParser != NULL) ? pxParser->uStatusCode : 0;
+}
+
+int HttpParser_getBody(HttpParserHandle xHttpParser, const char **ppBodyLoc, size_t *puBodyLen)
+{
+    int res = KVS_ERRNO_NONE;
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    if (pxParser == NULL || ppBodyLoc == NULL || puBodyLen == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else
+    {
+        *ppBodyLoc = (pxParser->uBodyLen > 0) ? pxParser->pBody : NULL;
+        *puBodyLen = pxParser->uBodyLen;
+    }
+
+    return res;
+}
@@ -1,3 +1,5 @@
+#include <string.h>
+
 /* Third party headers */
 #include "llhttp.h"
 
@@ -5,8 +7,12 @@
 #include "kvs/errors.h"
 
 /* Internal headers */
+#include "os/allocator.h"
 #include "net/http_parser_adapter.h"
 
+/* The initial size of the body buffer. It grows as needed. */
+#define HTTP_PARSER_BODY_BUFSIZE    (256)
+
 typedef struct
 {
     llhttp_settings_t xSettings;
@@ -14,6 +20,21 @@ typedef struct
     size_t uBodyLen;
 } llhttp_settings_ex_t;
 
+typedef struct HttpParser
+{
+    llhttp_t xHttpParser;
+    llhttp_settings_t xSettings;
+
+    bool bHeadersComplete;
+    bool bMessageComplete;
+    bool bBodyTooLarge;
+
+    /* The decoded body */
+    char *pBody;
+    size_t uBodyLen;
+    size_t uBodySize;
+} HttpParser_t;
+
 static int prvHandleHttpOnBodyComplete(llhttp_t *pHttpParser, const char *at, size_t length)
 {
     llhttp_settings_ex_t *pxSettings = (llhttp_settings_ex_t *)(pHttpParser->settings);
@@ -63,4 +84,199 @@ int HttpParser_parseHttpResponse(const char *pBuf, size_t uLen, unsigned int *pu
     }
 
     return res;
-}
\ No newline at end of file
+}
+
+static int prvHandleHttpOnHeadersComplete(llhttp_t *pHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)(pHttpParser->data);
+    pxParser->bHeadersComplete = true;
+    return 0;
+}
+
+static int prvHandleHttpOnBody(llhttp_t *pHttpParser, const char *at, size_t length)
+{
+    int res = 0;
+    HttpParser_t *pxParser = (HttpParser_t *)(pHttpParser->data);
+    char *pBody = NULL;
+    size_t uBodySize = 0;
+
+    if (length > HTTP_PARSER_MAX_BODY_SIZE - pxParser->uBodyLen)
+    {
+        /* Returning non-zero value makes llhttp stop with an error. */
+        pxParser->bBodyTooLarge = true;
+        res = -1;
+    }
+    else if (pxParser->uBodyLen + length > pxParser->uBodySize)
+    {
+        uBodySize = (pxParser->uBodySize == 0) ? HTTP_PARSER_BODY_BUFSIZE : pxParser->uBodySize * 2;
+        if (uBodySize < pxParser->uBodyLen + length)
+        {
+            uBodySize = pxParser->uBodyLen + length;
+        }
+        if (uBodySize > HTTP_PARSER_MAX_BODY_SIZE)
+        {
+            uBodySize = HTTP_PARSER_MAX_BODY_SIZE;
+        }
+
+        if ((pBody = (char *)kvsRealloc(pxParser->pBody, uBodySize)) == NULL)
+        {
+            /* Returning non-zero value makes llhttp stop with an error. */
+            res = -1;
+        }
+        else
+        {
+            pxParser->pBody = pBody;
+            pxParser->uBodySize = uBodySize;
+        }
+    }
+
+    if (res == 0)
+    {
+        memcpy(pxParser->pBody + pxParser->uBodyLen, at, length);
+        pxParser->uBodyLen += length;
+    }
+
+    return res;
+}
+
+static int prvHandleHttpOnMessageComplete(llhttp_t *pHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)(pHttpParser->data);
+    pxParser->bMessageComplete = true;
+
+    /* Pause the parser, so the bytes after the end of the response are not consumed. */
+    return HPE_PAUSED;
+}
+
+static void prvHttpParserInit(HttpParser_t *pxParser)
+{
+    llhttp_settings_init(&(pxParser->xSettings));
+    pxParser->xSettings.on_headers_complete = prvHandleHttpOnHeadersComplete;
+    pxParser->xSettings.on_body = prvHandleHttpOnBody;
+    pxParser->xSettings.on_message_complete = prvHandleHttpOnMessageComplete;
+    llhttp_init(&(pxParser->xHttpParser), HTTP_RESPONSE, &(pxParser->xSettings));
+    pxParser->xHttpParser.data = pxParser;
+
+    pxParser->bHeadersComplete = false;
+    pxParser->bMessageComplete = false;
+    pxParser->bBodyTooLarge = false;
+    pxParser->uBodyLen = 0;
+}
+
+HttpParserHandle HttpParser_create(void)
+{
+    HttpParser_t *pxParser = NULL;
+
+    if ((pxParser = (HttpParser_t *)kvsMalloc(sizeof(HttpParser_t))) != NULL)
+    {
+        memset(pxParser, 0, sizeof(HttpParser_t));
+        prvHttpParserInit(pxParser);
+    }
+
+    return pxParser;
+}
+
+void HttpParser_terminate(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    if (pxParser != NULL)
+    {
+        if (pxParser->pBody != NULL)
+        {
+            kvsFree(pxParser->pBody);
+        }
+        kvsFree(pxParser);
+    }
+}
+
+void HttpParser_reset(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    if (pxParser != NULL)
+    {
+        /* The body buffer is kept for reuse. */
+        prvHttpParserInit(pxParser);
+    }
+}
+
+int HttpParser_execute(HttpParserHandle xHttpParser, const char *pBuf, size_t uLen, size_t *puConsumedLen)
+{
+    int res = KVS_ERRNO_NONE;
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+    enum llhttp_errno xHttpErrno = HPE_OK;
+
+    if (pxParser == NULL || (pBuf == NULL && uLen > 0) || puConsumedLen == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else if (pxParser->bMessageComplete || uLen == 0)
+    {
+        *puConsumedLen = 0;
+    }
+    else if ((xHttpErrno = llhttp_execute(&(pxParser->xHttpParser), pBuf, uLen)) == HPE_OK)
+    {
+        *puConsumedLen = uLen;
+    }
+    else if (xHttpErrno == HPE_PAUSED && pxParser->bMessageComplete)
+    {
+        *puConsumedLen = llhttp_get_error_pos(&(pxParser->xHttpParser)) - pBuf;
+    }
+    else if (pxParser->bBodyTooLarge)
+    {
+        res = KVS_ERROR_HTTP_RSP_BODY_TOO_LARGE;
+    }
+    else
+    {
+        res = KVS_ERROR_HTTP_PARSE_EXECUTE_FAIL;
+    }
+
+    return res;
+}
+
+bool HttpParser_isHeadersComplete(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    return pxParser != NULL && pxParser->bHeadersComplete;
+}
+
+bool HttpParser_isMessageComplete(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    return pxParser != NULL && pxParser->bMessageComplete;
+}
+
+bool HttpParser_isChunked(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    return pxParser != NULL && (pxParser->xHttpParser.flags & F_CHUNKED) != 0;
+}
+
+unsigned int HttpParser_getStatusCode(HttpParserHandle xHttpParser)
+{
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    return (pxParser != NULL) ? pxParser->xHttpParser.status_code : 0;
+}
+
+int HttpParser_getBody(HttpParserHandle xHttpParser, const char **ppBodyLoc, size_t *puBodyLen)
+{
+    int res = KVS_ERRNO_NONE;
+    HttpParser_t *pxParser = (HttpParser_t *)xHttpParser;
+
+    if (pxParser == NULL || ppBodyLoc == NULL || puBodyLen == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else
+    {
+        *ppBodyLoc = (pxParser->uBodyLen > 0) ? pxParser->pBody : NULL;
+        *puBodyLen = pxParser->uBodyLen;
+    }
+
+    return res;
+}
@@ -13,22 +13,28 @@
  * permissions and limitations under the License.
  */
 
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 #include <sys/time.h>
 #include <sys/socket.h>
 
 /* Third party headers */
+#include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/entropy.h"
 #include "mbedtls/net.h"
 #include "mbedtls/net_sockets.h"
+#include "mbedtls/sha256.h"
 
 /* Public headers */
 #include "kvs/errors.h"
+#include "kvs/port.h"
+#include "kvs/tls_context.h"
 
 /* Internal headers */
 #include "os/allocator.h"
@@ -36,6 +42,55 @@
 
 #define DEFAULT_CONNECTION_TIMEOUT_MS       (10 * 1000)
 
+/* The size of send buffer that small pieces of data are gathered into one TLS record. */
+#define DEFAULT_SEND_BUFFER_SIZE            (4096)
+
+/* The number of TLS sessions that are kept in the shared TLS context for resumption. */
+#define TLS_SESSION_CACHE_SIZE              (4)
+
+/* The length of master secret of a TLS session */
+#define TLS_MASTER_SECRET_LEN               (48)
+
+/* The length of the SHA256 digest that identifies the X509 certificates of a shared TLS context */
+#define TLS_CERT_DIGEST_LEN                 (32)
+
+typedef struct TlsSessionCacheEntry
+{
+    /* The key in the form of "host:port", or NULL if the entry is empty. */
+    char *pcKey;
+    mbedtls_ssl_session xSession;
+    uint32_t uLastUsed;
+} TlsSessionCacheEntry_t;
+
+typedef struct TlsContext
+{
+    /* The random generator is shared by connections, so it's guarded by the lock. */
+    LOCK_HANDLE xLock;
+    mbedtls_ctr_drbg_context xCtrDrbg;
+    mbedtls_entropy_context xEntropy;
+
+    /* Optional X509 certificates. They are parsed once and used read-only by connections. */
+    mbedtls_x509_crt *pRootCA;
+    mbedtls_x509_crt *pCert;
+    mbedtls_pk_context *pPrivKey;
+
+    /* Sessions of previous connections and handshake statistics. They are guarded by the lock. */
+    TlsSessionCacheEntry_t xSessionCache[TLS_SESSION_CACHE_SIZE];
+    uint32_t uSessionCacheClock;
+    TlsContextStats_t xStats;
+
+    /* Process-wide shared contexts are kept in a list keyed by the digest of their X509 certificates. They are guarded
+     * by the lock of the list. */
+    uint32_t uRefCount;
+    uint8_t pCertDigest[TLS_CERT_DIGEST_LEN];
+    struct TlsContext *pxNext;
+} TlsContext_t;
+
+/* The list of process-wide shared TLS contexts. Its lock is created once by the first caller. */
+static pthread_once_t sharedTlsContextsOnce = PTHREAD_ONCE_INIT;
+static LOCK_HANDLE sharedTlsContextsLock = NULL;
+static TlsContext_t *pxSharedTlsContexts = NULL;
+
 typedef struct NetIo
 {
     /* Basic ssl connection parameters */
@@ -50,39 +105,293 @@ typedef struct NetIo
     mbedtls_x509_crt *pCert;
     mbedtls_pk_context *pPrivKey;
 
+    /* The shared TLS context. It's borrowed from user and is NULL if not used. */
+    TlsContext_t *pxTlsContext;
+
     /* Options */
     uint32_t uRecvTimeoutMs;
     uint32_t uSendTimeoutMs;
+
+    /* Send buffer for gather send. It's allocated on first use. */
+    unsigned char *pSendBuf;
+    size_t uSendBufSize;
+    size_t uSendBufLen;
 } NetIo_t;
 
-static int prvCreateX509Cert(NetIo_t *pxNet)
+static int prvCreateX509Cert(mbedtls_x509_crt **ppRootCA, mbedtls_x509_crt **ppCert, mbedtls_pk_context **ppPrivKey)
 {
     int res = KVS_ERRNO_NONE;
 
-    if (pxNet == NULL)
+    if (ppRootCA == NULL || ppCert == NULL || ppPrivKey == NULL)
     {
         res = KVS_ERROR_INVALID_ARGUMENT;
     }
-    else if ((pxNet->pRootCA = (mbedtls_x509_crt *)kvsMalloc(sizeof(mbedtls_x509_crt))) == NULL ||
-        (pxNet->pCert = (mbedtls_x509_crt *)kvsMalloc(sizeof(mbedtls_x509_crt))) == NULL ||
-        (pxNet->pPrivKey = (mbedtls_pk_context *)kvsMalloc(sizeof(mbedtls_pk_context))) == NULL)
+    else
     {
-        res = KVS_ERROR_OUT_OF_MEMORY;
+        /* Initialize them one by one, so they can be freed safely even if some of the allocations fail. */
+        if ((*ppRootCA = (mbedtls_x509_crt *)kvsMalloc(sizeof(mbedtls_x509_crt))) != NULL)
+        {
+            mbedtls_x509_crt_init(*ppRootCA);
+        }
+        if ((*ppCert = (mbedtls_x509_crt *)kvsMalloc(sizeof(mbedtls_x509_crt))) != NULL)
+        {
+            mbedtls_x509_crt_init(*ppCert);
+        }
+        if ((*ppPrivKey = (mbedtls_pk_context *)kvsMalloc(sizeof(mbedtls_pk_context))) != NULL)
+        {
+            mbedtls_pk_init(*ppPrivKey);
+        }
+
+        if (*ppRootCA == NULL || *ppCert == NULL || *ppPrivKey == NULL)
+        {
+            res = KVS_ERROR_OUT_OF_MEMORY;
+        }
     }
-    else
+
+    return res;
+}
+
+static int prvParseX509Cert(
+    mbedtls_x509_crt *pRootCA,
+    mbedtls_x509_crt *pCert,
+    mbedtls_pk_context *pPrivKey,
+    const char *pcRootCA,
+    const char *pcCert,
+    const char *pcPrivKey)
+{
+    int res = KVS_ERRNO_NONE;
+    int retVal = 0;
+
+    if ((retVal = mbedtls_x509_crt_parse(pRootCA, (void *)pcRootCA, strlen(pcRootCA) + 1)) != 0 ||
+        (retVal = mbedtls_x509_crt_parse(pCert, (void *)pcCert, strlen(pcCert) + 1)) != 0 ||
+        (retVal = mbedtls_pk_parse_key(pPrivKey, (void *)pcPrivKey, strlen(pcPrivKey) + 1, NULL, 0)) != 0)
     {
-        mbedtls_x509_crt_init(pxNet->pRootCA);
-        mbedtls_x509_crt_init(pxNet->pCert);
-        mbedtls_pk_init(pxNet->pPrivKey);
+        res = KVS_GENERATE_MBEDTLS_ERROR(retVal);
+        LogError("Failed to parse x509 (err:-%X)", -res);
     }
 
     return res;
 }
 
+static void prvFreeX509Cert(mbedtls_x509_crt **ppRootCA, mbedtls_x509_crt **ppCert, mbedtls_pk_context **ppPrivKey)
+{
+    if (*ppRootCA != NULL)
+    {
+        mbedtls_x509_crt_free(*ppRootCA);
+        kvsFree(*ppRootCA);
+        *ppRootCA = NULL;
+    }
+
+    if (*ppCert != NULL)
+    {
+        mbedtls_x509_crt_free(*ppCert);
+        kvsFree(*ppCert);
+        *ppCert = NULL;
+    }
+
+    if (*ppPrivKey != NULL)
+    {
+        mbedtls_pk_free(*ppPrivKey);
+        kvsFree(*ppPrivKey);
+        *ppPrivKey = NULL;
+    }
+}
+
+static int prvTlsContextRandom(void *pParam, unsigned char *pOutput, size_t uOutputLen)
+{
+    int retVal = 0;
+    TlsContext_t *pxTlsContext = (TlsContext_t *)pParam;
+
+    if (Lock(pxTlsContext->xLock) != LOCK_OK)
+    {
+        retVal = KVS_ERROR_LOCK_ERROR;
+    }
+    else
+    {
+        retVal = mbedtls_ctr_drbg_random(&(pxTlsContext->xCtrDrbg), pOutput, uOutputLen);
+        Unlock(pxTlsContext->xLock);
+    }
+
+    return retVal;
+}
+
+static bool prvSessionCacheKeyMatch(const char *pcKey, const char *pcHost, const char *pcPort)
+{
+    size_t uHostLen = strlen(pcHost);
+
+    return pcKey != NULL && strncmp(pcKey, pcHost, uHostLen) == 0 && pcKey[uHostLen] == ':' && strcmp(pcKey + uHostLen + 1, pcPort) == 0;
+}
+
+static TlsSessionCacheEntry_t *prvSessionCacheFind(TlsContext_t *pxTlsContext, const char *pcHost, const char *pcPort)
+{
+    TlsSessionCacheEntry_t *pxEntry = NULL;
+    size_t i = 0;
+
+    for (i = 0; i < TLS_SESSION_CACHE_SIZE; i++)
+    {
+        if (prvSessionCacheKeyMatch(pxTlsContext->xSessionCache[i].pcKey, pcHost, pcPort))
+        {
+            pxEntry = &(pxTlsContext->xSessionCache[i]);
+            break;
+        }
+    }
+
+    return pxEntry;
+}
+
+static void prvSessionCacheEntryClear(TlsSessionCacheEntry_t *pxEntry)
+{
+    if (pxEntry->pcKey != NULL)
+    {
+        kvsFree(pxEntry->pcKey);
+        pxEntry->pcKey = NULL;
+        mbedtls_ssl_session_free(&(pxEntry->xSession));
+    }
+}
+
+/**
+ * @brief Load the cached session of host and port into the ssl context
+ *
+ * @param[in] pxNet The network I/O
+ * @param[in] pcHost The hostname
+ * @param[in] pcPort The port
+ * @param[out] pMaster The master secret of the cached session, it's used to tell if the session is resumed.
+ * @return true if a cached session is loaded, false otherwise
+ */
+static bool prvSessionCacheLoad(NetIo_t *pxNet, const char *pcHost, const char *pcPort, unsigned char *pMaster)
+{
+    bool bLoaded = false;
+    TlsContext_t *pxTlsContext = pxNet->pxTlsContext;
+    TlsSessionCacheEntry_t *pxEntry = NULL;
+
+    if (pxTlsContext != NULL && Lock(pxTlsContext->xLock) == LOCK_OK)
+    {
+        if ((pxEntry = prvSessionCacheFind(pxTlsContext, pcHost, pcPort)) != NULL && mbedtls_ssl_set_session(&(pxNet->xSsl), &(pxEntry->xSession)) == 0)
+        {
+            memcpy(pMaster, pxEntry->xSession.master, TLS_MASTER_SECRET_LEN);
+            pxEntry->uLastUsed = ++(pxTlsContext->uSessionCacheClock);
+            bLoaded = true;
+        }
+        Unlock(pxTlsContext->xLock);
+    }
+
+    return bLoaded;
+}
+
+/**
+ * @brief Save the session of an established connection, and update handshake statistics
+ *
+ * @param[in] pxNet The network I/O
+ * @param[in] pcHost The hostname
+ * @param[in] pcPort The port
+ * @param[in] pMaster The master secret of the session that was loaded before handshake, or NULL if there was none
+ * @param[in] uHandshakeTimeMs The time spent on handshake
+ */
+static void prvSessionCacheSave(NetIo_t *pxNet, const char *pcHost, const char *pcPort, const unsigned char *pMaster, uint64_t uHandshakeTimeMs)
+{
+    TlsContext_t *pxTlsContext = pxNet->pxTlsContext;
+    TlsSessionCacheEntry_t *pxEntry = NULL;
+    mbedtls_ssl_session xSession;
+    bool bResumed = false;
+    char *pcKey = NULL;
+    size_t uKeyLen = 0;
+    size_t i = 0;
+
+    mbedtls_ssl_session_init(&xSession);
+
+    if (pxTlsContext == NULL)
+    {
+        /* Nothing to do if it's not using a shared TLS context. */
+    }
+    else if (mbedtls_ssl_get_session(&(pxNet->xSsl), &xSession) != 0)
+    {
+        LogInfo("Failed to get TLS session of %s:%s", pcHost, pcPort);
+    }
+    else if (Lock(pxTlsContext->xLock) == LOCK_OK)
+    {
+        /* A resumed session keeps the master secret of the cached one. */
+        bResumed = (pMaster != NULL && memcmp(pMaster, xSession.master, TLS_MASTER_SECRET_LEN) == 0);
+        if (bResumed)
+        {
+            pxTlsContext->xStats.uResumedHandshakeCount++;
+            pxTlsContext->xStats.uResumedHandshakeTimeMs += uHandshakeTimeMs;
+        }
+        else
+        {
+            pxTlsContext->xStats.uFullHandshakeCount++;
+            pxTlsContext->xStats.uFullHandshakeTimeMs += uHandshakeTimeMs;
+        }
+
+        if ((pxEntry = prvSessionCacheFind(pxTlsContext, pcHost, pcPort)) == NULL)
+        {
+            uKeyLen = strlen(pcHost) + 1 + strlen(pcPort);
+            if ((pcKey = (char *)kvsMalloc(uKeyLen + 1)) != NULL)
+            {
+                snprintf(pcKey, uKeyLen + 1, "%s:%s", pcHost, pcPort);
+
+                /* Use an empty entry, or evict the least recently used one. */
+                pxEntry = &(pxTlsContext->xSessionCache[0]);
+                for (i = 0; i < TLS_SESSION_CACHE_SIZE && pxEntry->pcKey != NULL; i++)
+                {
+                    if (pxTlsContext->xSessionCache[i].pcKey == NULL || pxTlsContext->xSessionCache[i].uLastUsed < pxEntry->uLastUsed)
+                    {
+                        pxEntry = &(pxTlsContext->xSessionCache[i]);
+                    }
+                }
+                prvSessionCacheEntryClear(pxEntry);
+                pxEntry->pcKey = pcKey;
+            }
+        }
+        else
+        {
+            mbedtls_ssl_session_free(&(pxEntry->xSession));
+        }
+
+        if (pxEntry != NULL)
+        {
+            /* The entry takes over the session. */
+            memcpy(&(pxEntry->xSession), &xSession, sizeof(mbedtls_ssl_session));
+            mbedtls_ssl_session_init(&xSession);
+            pxEntry->uLastUsed = ++(pxTlsContext->uSessionCacheClock);
+        }
+
+        Unlock(pxTlsContext->xLock);
+    }
+    else
+    {
+        /* nop */
+    }
+
+    mbedtls_ssl_session_free(&xSession);
+}
+
+static void prvSessionCacheRemove(NetIo_t *pxNet, const char *pcHost, const char *pcPort)
+{
+    TlsContext_t *pxTlsContext = pxNet->pxTlsContext;
+    TlsSessionCacheEntry_t *pxEntry = NULL;
+
+    if (pxTlsContext != NULL && Lock(pxTlsContext->xLock) == LOCK_OK)
+    {
+        if ((pxEntry = prvSessionCacheFind(pxTlsContext, pcHost, pcPort)) != NULL)
+        {
+            prvSessionCacheEntryClear(pxEntry);
+        }
+        Unlock(pxTlsContext->xLock);
+    }
+}
+
+static bool prvHasSharedX509Cert(NetIo_t *pxNet)
+{
+    return pxNet->pxTlsContext != NULL && pxNet->pxTlsContext->pRootCA != NULL;
+}
+
 static int prvInitConfig(NetIo_t *pxNet, const char *pcHost, const char *pcRootCA, const char *pcCert, const char *pcPrivKey)
 {
     int res = KVS_ERRNO_NONE;
     int retVal = 0;
+    mbedtls_x509_crt *pRootCA = NULL;
+    mbedtls_x509_crt *pCert = NULL;
+    mbedtls_pk_context *pPrivKey = NULL;
 
     if (pxNet == NULL)
     {
@@ -99,26 +408,39 @@ static int prvInitConfig(NetIo_t *pxNet, const char *pcHost, const char *pcRootC
         }
         else
         {
-            mbedtls_ssl_conf_rng(&(pxNet->xConf), mbedtls_ctr_drbg_random, &(pxNet->xCtrDrbg));
+            if (pxNet->pxTlsContext != NULL)
+            {
+                mbedtls_ssl_conf_rng(&(pxNet->xConf), prvTlsContextRandom, pxNet->pxTlsContext);
+            }
+            else
+            {
+                mbedtls_ssl_conf_rng(&(pxNet->xConf), mbedtls_ctr_drbg_random, &(pxNet->xCtrDrbg));
+            }
             mbedtls_ssl_set_hostname(&(pxNet->xSsl), pcHost);
             mbedtls_ssl_conf_read_timeout(&(pxNet->xConf), pxNet->uRecvTimeoutMs);
             NetIo_setSendTimeout(pxNet, pxNet->uSendTimeoutMs);
 
             if (pcRootCA != NULL && pcCert != NULL && pcPrivKey != NULL)
             {
-                if ((retVal = mbedtls_x509_crt_parse(pxNet->pRootCA, (void *)pcRootCA, strlen(pcRootCA) + 1)) != 0 ||
-                    (retVal = mbedtls_x509_crt_parse(pxNet->pCert, (void *)pcCert, strlen(pcCert) + 1)) != 0 ||
-                    (retVal = mbedtls_pk_parse_key(pxNet->pPrivKey, (void *)pcPrivKey, strlen(pcPrivKey) + 1, NULL, 0)) != 0)
+                if (prvHasSharedX509Cert(pxNet))
                 {
-                    res = KVS_GENERATE_MBEDTLS_ERROR(retVal);
-                    LogError("Failed to parse x509 (err:-%X)", -res);
+                    pRootCA = pxNet->pxTlsContext->pRootCA;
+                    pCert = pxNet->pxTlsContext->pCert;
+                    pPrivKey = pxNet->pxTlsContext->pPrivKey;
                 }
-                else
+                else if ((res = prvParseX509Cert(pxNet->pRootCA, pxNet->pCert, pxNet->pPrivKey, pcRootCA, pcCert, pcPrivKey)) == KVS_ERRNO_NONE)
+                {
+                    pRootCA = pxNet->pRootCA;
+                    pCert = pxNet->pCert;
+                    pPrivKey = pxNet->pPrivKey;
+                }
+
+                if (res == KVS_ERRNO_NONE)
                 {
                     mbedtls_ssl_conf_authmode(&(pxNet->xConf), MBEDTLS_SSL_VERIFY_REQUIRED);
-                    mbedtls_ssl_conf_ca_chain(&(pxNet->xConf), pxNet->pRootCA, NULL);
+                    mbedtls_ssl_conf_ca_chain(&(pxNet->xConf), pRootCA, NULL);
 
-                    if ((retVal = mbedtls_ssl_conf_own_cert(&(pxNet->xConf), pxNet->pCert, pxNet->pPrivKey)) != 0)
+                    if ((retVal = mbedtls_ssl_conf_own_cert(&(pxNet->xConf), pCert, pPrivKey)) != 0)
                     {
                         res = KVS_GENERATE_MBEDTLS_ERROR(retVal);
                         LogError("Failed to conf own cert (err:-%X)", -res);
@@ -148,13 +470,17 @@ static int prvConnect(NetIo_t *pxNet, const char *pcHost, const char *pcPort, co
 {
     int res = KVS_ERRNO_NONE;
     int retVal = 0;
+    unsigned char pMaster[TLS_MASTER_SECRET_LEN] = {0};
+    bool bSessionLoaded = false;
+    uint64_t uHandshakeStartMs = 0;
 
     if (pxNet == NULL || pcHost == NULL || pcPort == NULL)
     {
         res = KVS_ERROR_INVALID_ARGUMENT;
         LogError("Invalid argument");
     }
-    else if ((pcRootCA != NULL && pcCert != NULL && pcPrivKey != NULL) && (res = prvCreateX509Cert(pxNet)) != KVS_ERRNO_NONE)
+    else if ((pcRootCA != NULL && pcCert != NULL && pcPrivKey != NULL) && !prvHasSharedX509Cert(pxNet) &&
+             (res = prvCreateX509Cert(&(pxNet->pRootCA), &(pxNet->pCert), &(pxNet->pPrivKey))) != KVS_ERRNO_NONE)
     {
         LogError("Failed to init x509 (err:-%X)", -res);
         /* Propagate the res error */
@@ -169,20 +495,39 @@ static int prvConnect(NetIo_t *pxNet, const char *pcHost, const char *pcPort, co
         LogError("Failed to config ssl (err:-%X)", -res);
         /* Propagate the res error */
     }
-    else if ((retVal = mbedtls_ssl_handshake(&(pxNet->xSsl))) != 0)
-    {
-        res = KVS_GENERATE_MBEDTLS_ERROR(retVal);
-        LogError("ssl handshake err (-%X)", -res);
-    }
     else
     {
-        /* nop */
+        bSessionLoaded = prvSessionCacheLoad(pxNet, pcHost, pcPort, pMaster);
+        uHandshakeStartMs = getEpochTimestampInMs();
+
+        if ((retVal = mbedtls_ssl_handshake(&(pxNet->xSsl))) != 0)
+        {
+            res = KVS_GENERATE_MBEDTLS_ERROR(retVal);
+            LogError("ssl handshake err (-%X)", -res);
+
+            /* Don't try the cached session again in case it's the cause. */
+            if (bSessionLoaded)
+            {
+                prvSessionCacheRemove(pxNet, pcHost, pcPort);
+            }
+        }
+        else
+        {
+            prvSessionCacheSave(pxNet, pcHost, pcPort, bSessionLoaded ? pMaster : NULL, getEpochTimestampInMs() - uHandshakeStartMs);
+        }
+
+        memset(pMaster, 0, sizeof(pMaster));
     }
 
     return res;
 }
 
 NetIoHandle NetIo_create(void)
+{
+    return NetIo_createWithTlsContext(NULL);
+}
+
+NetIoHandle NetIo_createWithTlsContext(TlsContextHandle xTlsContext)
 {
     NetIo_t *pxNet = NULL;
 
@@ -196,10 +541,12 @@ NetIoHandle NetIo_create(void)
         mbedtls_ctr_drbg_init(&(pxNet->xCtrDrbg));
         mbedtls_entropy_init(&(pxNet->xEntropy));
 
+        pxNet->pxTlsContext = (TlsContext_t *)xTlsContext;
         pxNet->uRecvTimeoutMs = DEFAULT_CONNECTION_TIMEOUT_MS;
         pxNet->uSendTimeoutMs = DEFAULT_CONNECTION_TIMEOUT_MS;
 
-        if (mbedtls_ctr_drbg_seed(&(pxNet->xCtrDrbg), mbedtls_entropy_func, &(pxNet->xEntropy), NULL, 0) != 0)
+        /* Seeding is expensive, so it's skipped if the random generator of the shared TLS context is used. */
+        if (pxNet->pxTlsContext == NULL && mbedtls_ctr_drbg_seed(&(pxNet->xCtrDrbg), mbedtls_entropy_func, &(pxNet->xEntropy), NULL, 0) != 0)
         {
             NetIo_terminate(pxNet);
             pxNet = NULL;
@@ -221,25 +568,12 @@ void NetIo_terminate(NetIoHandle xNetIoHandle)
         mbedtls_ssl_free(&(pxNet->xSsl));
         mbedtls_ssl_config_free(&(pxNet->xConf));
 
-        if (pxNet->pRootCA != NULL)
-        {
-            mbedtls_x509_crt_free(pxNet->pRootCA);
-            kvsFree(pxNet->pRootCA);
-            pxNet->pRootCA = NULL;
-        }
-
-        if (pxNet->pCert != NULL)
-        {
-            mbedtls_x509_crt_free(pxNet->pCert);
-            kvsFree(pxNet->pCert);
-            pxNet->pCert = NULL;
-        }
+        prvFreeX509Cert(&(pxNet->pRootCA), &(pxNet->pCert), &(pxNet->pPrivKey));
 
-        if (pxNet->pPrivKey != NULL)
+        if (pxNet->pSendBuf != NULL)
         {
-            mbedtls_pk_free(pxNet->pPrivKey);
-            kvsFree(pxNet->pPrivKey);
-            pxNet->pPrivKey = NULL;
+            kvsFree(pxNet->pSendBuf);
+            pxNet->pSendBuf = NULL;
         }
         kvsFree(pxNet);
     }
@@ -265,38 +599,160 @@ void NetIo_disconnect(NetIoHandle xNetIoHandle)
     }
 }
 
-int NetIo_send(NetIoHandle xNetIoHandle, const unsigned char *pBuffer, size_t uBytesToSend)
+static int prvSend(NetIo_t *pxNet, const unsigned char *pBuffer, size_t uBytesToSend)
 {
     int n = 0;
     int res = KVS_ERRNO_NONE;
-    NetIo_t *pxNet = (NetIo_t *)xNetIoHandle;
     size_t uBytesRemaining = uBytesToSend;
     char *pIndex = (char *)pBuffer;
 
-    if (pxNet == NULL || pBuffer == NULL)
+    while (uBytesRemaining > 0)
     {
-        res = KVS_ERROR_INVALID_ARGUMENT;
+        n = mbedtls_ssl_write(&(pxNet->xSsl), (const unsigned char *)pIndex, uBytesRemaining);
+        if (n < 0)
+        {
+            res = KVS_GENERATE_MBEDTLS_ERROR(n);
+            LogError("SSL send error -%X", -res);
+            break;
+        }
+        else if (n > uBytesRemaining)
+        {
+            res = KVS_ERROR_NETIO_SEND_MORE_THAN_REMAINING_DATA;
+            LogError("SSL send error -%X", -res);
+            break;
+        }
+        uBytesRemaining -= n;
+        pIndex += n;
+    }
+
+    return res;
+}
+
+static int prvFlushSendBuffer(NetIo_t *pxNet)
+{
+    int res = KVS_ERRNO_NONE;
+
+    if (pxNet->uSendBufLen > 0)
+    {
+        res = prvSend(pxNet, pxNet->pSendBuf, pxNet->uSendBufLen);
+        pxNet->uSendBufLen = 0;
+    }
+
+    return res;
+}
+
+static int prvGatherSend(NetIo_t *pxNet, const unsigned char *pBuffer, size_t uBytesToSend)
+{
+    int res = KVS_ERRNO_NONE;
+    size_t uCopyLen = 0;
+
+    if (pxNet->pSendBuf == NULL)
+    {
+        if ((pxNet->pSendBuf = (unsigned char *)kvsMalloc(DEFAULT_SEND_BUFFER_SIZE)) != NULL)
+        {
+            pxNet->uSendBufSize = DEFAULT_SEND_BUFFER_SIZE;
+            pxNet->uSendBufLen = 0;
+        }
+    }
+
+    if (pxNet->pSendBuf == NULL)
+    {
+        /* Fall back to send it directly if there is no send buffer. */
+        res = prvSend(pxNet, pBuffer, uBytesToSend);
     }
     else
     {
-        do
+        while (uBytesToSend > 0 && res == KVS_ERRNO_NONE)
         {
-            n = mbedtls_ssl_write(&(pxNet->xSsl), (const unsigned char *)pIndex, uBytesRemaining);
-            if (n < 0)
+            if (pxNet->uSendBufLen == 0 && uBytesToSend >= pxNet->uSendBufSize)
             {
-                res = KVS_GENERATE_MBEDTLS_ERROR(n);
-                LogError("SSL send error -%X", -res);
+                /* It's large enough to be sent without copying. */
+                res = prvSend(pxNet, pBuffer, uBytesToSend);
                 break;
             }
-            else if (n > uBytesRemaining)
+
+            uCopyLen = pxNet->uSendBufSize - pxNet->uSendBufLen;
+            if (uCopyLen > uBytesToSend)
             {
-                res = KVS_ERROR_NETIO_SEND_MORE_THAN_REMAINING_DATA;
-                LogError("SSL send error -%X", -res);
-                break;
+                uCopyLen = uBytesToSend;
+            }
+            memcpy(pxNet->pSendBuf + pxNet->uSendBufLen, pBuffer, uCopyLen);
+            pxNet->uSendBufLen += uCopyLen;
+            pBuffer += uCopyLen;
+            uBytesToSend -= uCopyLen;
+
+            if (pxNet->uSendBufLen == pxNet->uSendBufSize)
+            {
+                res = prvFlushSendBuffer(pxNet);
             }
-            uBytesRemaining -= n;
-            pIndex += n;
-        } while (uBytesRemaining > 0);
+        }
+    }
+
+    return res;
+}
+
+int NetIo_send(NetIoHandle xNetIoHandle, const unsigned char *pBuffer, size_t uBytesToSend)
+{
+    int res = KVS_ERRNO_NONE;
+    NetIo_t *pxNet = (NetIo_t *)xNetIoHandle;
+
+    if (pxNet == NULL || pBuffer == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else if ((res = prvFlushSendBuffer(pxNet)) != KVS_ERRNO_NONE)
+    {
+        /* Propagate the res error */
+    }
+    else
+    {
+        res = prvSend(pxNet, pBuffer, uBytesToSend);
+    }
+
+    return res;
+}
+
+int NetIo_sendv(NetIoHandle xNetIoHandle, const NetIoBuffer_t *pxBuffers, size_t uBufferCount, bool bFlush)
+{
+    int res = KVS_ERRNO_NONE;
+    NetIo_t *pxNet = (NetIo_t *)xNetIoHandle;
+    size_t i = 0;
+
+    if (pxNet == NULL || (pxBuffers == NULL && uBufferCount > 0))
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else
+    {
+        for (i = 0; i < uBufferCount && res == KVS_ERRNO_NONE; i++)
+        {
+            if (pxBuffers[i].pBuffer != NULL && pxBuffers[i].uLen > 0)
+            {
+                res = prvGatherSend(pxNet, pxBuffers[i].pBuffer, pxBuffers[i].uLen);
+            }
+        }
+
+        if (res == KVS_ERRNO_NONE && bFlush)
+        {
+            res = prvFlushSendBuffer(pxNet);
+        }
+    }
+
+    return res;
+}
+
+int NetIo_flush(NetIoHandle xNetIoHandle)
+{
+    int res = KVS_ERRNO_NONE;
+    NetIo_t *pxNet = (NetIo_t *)xNetIoHandle;
+
+    if (pxNet == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else
+    {
+        res = prvFlushSendBuffer(pxNet);
     }
 
     return res;
@@ -418,3 +874,219 @@ int NetIo_setSendTimeout(NetIoHandle xNetIoHandle, unsigned int uSendTimeoutMs)
 
     return res;
 }
+
+TlsContextHandle TlsContext_create(const char *pcRootCA, const char *pcCert, const char *pcPrivKey)
+{
+    int res = KVS_ERRNO_NONE;
+    int retVal = 0;
+    TlsContext_t *pxTlsContext = NULL;
+
+    if ((pxTlsContext = (TlsContext_t *)kvsMalloc(sizeof(TlsContext_t))) == NULL)
+    {
+        res = KVS_ERROR_OUT_OF_MEMORY;
+    }
+    else
+    {
+        memset(pxTlsContext, 0, sizeof(TlsContext_t));
+
+        mbedtls_ctr_drbg_init(&(pxTlsContext->xCtrDrbg));
+        mbedtls_entropy_init(&(pxTlsContext->xEntropy));
+
+        if ((pxTlsContext->xLock = Lock_Init()) == NULL)
+        {
+            res = KVS_ERROR_LOCK_ERROR;
+            LogError("Failed to init lock");
+        }
+        else if ((retVal = mbedtls_ctr_drbg_seed(&(pxTlsContext->xCtrDrbg), mbedtls_entropy_func, &(pxTlsContext->xEntropy), NULL, 0)) != 0)
+        {
+            res = KVS_GENERATE_MBEDTLS_ERROR(retVal);
+            LogError("Failed to seed random generator (err:-%X)", -res);
+        }
+        else if (pcRootCA != NULL && pcCert != NULL && pcPrivKey != NULL)
+        {
+            if ((res = prvCreateX509Cert(&(pxTlsContext->pRootCA), &(pxTlsContext->pCert), &(pxTlsContext->pPrivKey))) != KVS_ERRNO_NONE)
+            {
+                LogError("Failed to init x509 (err:-%X)", -res);
+                /* Propagate the res error */
+            }
+            else if ((res = prvParseX509Cert(pxTlsContext->pRootCA, pxTlsContext->pCert, pxTlsContext->pPrivKey, pcRootCA, pcCert, pcPrivKey)) != KVS_ERRNO_NONE)
+            {
+                /* Propagate the res error */
+            }
+            else
+            {
+                /* nop */
+            }
+        }
+        else
+        {
+            /* nop */
+        }
+    }
+
+    if (res != KVS_ERRNO_NONE)
+    {
+        TlsContext_terminate(pxTlsContext);
+        pxTlsContext = NULL;
+    }
+
+    return pxTlsContext;
+}
+
+void TlsContext_terminate(TlsContextHandle xTlsContext)
+{
+    TlsContext_t *pxTlsContext = (TlsContext_t *)xTlsContext;
+    size_t i = 0;
+
+    if (pxTlsContext != NULL)
+    {
+        mbedtls_ctr_drbg_free(&(pxTlsContext->xCtrDrbg));
+        mbedtls_entropy_free(&(pxTlsContext->xEntropy));
+        prvFreeX509Cert(&(pxTlsContext->pRootCA), &(pxTlsContext->pCert), &(pxTlsContext->pPrivKey));
+
+        for (i = 0; i < TLS_SESSION_CACHE_SIZE; i++)
+        {
+            prvSessionCacheEntryClear(&(pxTlsContext->xSessionCache[i]));
+        }
+
+        if (pxTlsContext->xLock != NULL)
+        {
+            Lock_Deinit(pxTlsContext->xLock);
+        }
+        kvsFree(pxTlsContext);
+    }
+}
+
+static void prvInitSharedTlsContexts(void)
+{
+    sharedTlsContextsLock = Lock_Init();
+}
+
+static int prvX509CertDigest(const char *pcRootCA, const char *pcCert, const char *pcPrivKey, uint8_t *pDigest)
+{
+    int res = KVS_ERRNO_NONE;
+    int retVal = 0;
+    const char *pcPems[3] = {pcRootCA, pcCert, pcPrivKey};
+    uint8_t pPemDigests[3 * TLS_CERT_DIGEST_LEN] = {0};
+    size_t i = 0;
+
+    /* A context without certificates is keyed by the digest of all zero PEM digests. */
+    if (pcRootCA != NULL && pcCert != NULL && pcPrivKey != NULL)
+    {
+        for (i = 0; i < 3 && res == KVS_ERRNO_NONE; i++)
+        {
+            if ((retVal = mbedtls_sha256_ret((const unsigned char *)pcPems[i], strlen(pcPems[i]), pPemDigests + i * TLS_CERT_DIGEST_LEN, 0)) != 0)
+            {
+                res = KVS_GENERATE_MBEDTLS_ERROR(retVal);
+            }
+        }
+    }
+
+    if (res == KVS_ERRNO_NONE && (retVal = mbedtls_sha256_ret(pPemDigests, sizeof(pPemDigests), pDigest, 0)) != 0)
+    {
+        res = KVS_GENERATE_MBEDTLS_ERROR(retVal);
+    }
+
+    return res;
+}
+
+TlsContextHandle TlsContext_acquire(const char *pcRootCA, const char *pcCert, const char *pcPrivKey)
+{
+    int res = KVS_ERRNO_NONE;
+    TlsContext_t *pxTlsContext = NULL;
+    uint8_t pDigest[TLS_CERT_DIGEST_LEN] = {0};
+
+    pthread_once(&sharedTlsContextsOnce, prvInitSharedTlsContexts);
+
+    if (sharedTlsContextsLock == NULL)
+    {
+        LogError("Failed to init lock");
+    }
+    else if ((res = prvX509CertDigest(pcRootCA, pcCert, pcPrivKey, pDigest)) != KVS_ERRNO_NONE)
+    {
+        LogError("Failed to digest x509 certificates (err:-%X)", -res);
+    }
+    else if (Lock(sharedTlsContextsLock) != LOCK_OK)
+    {
+        LogError("Failed to lock");
+    }
+    else
+    {
+        for (pxTlsContext = pxSharedTlsContexts; pxTlsContext != NULL; pxTlsContext = pxTlsContext->pxNext)
+        {
+            if (memcmp(pxTlsContext->pCertDigest, pDigest, TLS_CERT_DIGEST_LEN) == 0)
+            {
+                break;
+            }
+        }
+
+        /* The first caller pays the cost of seeding and parsing, and others with the same certificates share it. */
+        if (pxTlsContext == NULL && (pxTlsContext = (TlsContext_t *)TlsContext_create(pcRootCA, pcCert, pcPrivKey)) != NULL)
+        {
+            memcpy(pxTlsContext->pCertDigest, pDigest, TLS_CERT_DIGEST_LEN);
+            pxTlsContext->pxNext = pxSharedTlsContexts;
+            pxSharedTlsContexts = pxTlsContext;
+        }
+
+        if (pxTlsContext != NULL)
+        {
+            pxTlsContext->uRefCount++;
+        }
+
+        Unlock(sharedTlsContextsLock);
+    }
+
+    return pxTlsContext;
+}
+
+void TlsContext_release(TlsContextHandle xTlsContext)
+{
+    TlsContext_t *pxTlsContext = (TlsContext_t *)xTlsContext;
+    TlsContext_t **ppxIter = NULL;
+
+    if (pxTlsContext != NULL && sharedTlsContextsLock != NULL && Lock(sharedTlsContextsLock) == LOCK_OK)
+    {
+        if (--(pxTlsContext->uRefCount) == 0)
+        {
+            for (ppxIter = &pxSharedTlsContexts; *ppxIter != NULL; ppxIter = &((*ppxIter)->pxNext))
+            {
+                if (*ppxIter == pxTlsContext)
+                {
+                    *ppxIter = pxTlsContext->pxNext;
+                    break;
+                }
+            }
+        }
+        else
+        {
+            /* It's still used by others. */
+            pxTlsContext = NULL;
+        }
+
+        Unlock(sharedTlsContextsLock);
+
+        TlsContext_terminate(pxTlsContext);
+    }
+}
+
+int TlsContext_getStats(TlsContextHandle xTlsContext, TlsContextStats_t *pxStats)
+{
+    int res = KVS_ERRNO_NONE;
+    TlsContext_t *pxTlsContext = (TlsContext_t *)xTlsContext;
+
+    if (pxTlsContext == NULL || pxStats == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else if (Lock(pxTlsContext->xLock) != LOCK_OK)
+    {
+        res = KVS_ERROR_LOCK_ERROR;
+    }
+    else
+    {
+        memcpy(pxStats, &(pxTlsContext->xStats), sizeof(TlsContextStats_t));
+        Unlock(pxTlsContext->xLock);
+    }
+
+    return res;
+}
@@ -17,9 +17,18 @@
 #define NETIO_H
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#include "kvs/tls_context.h"
 
 typedef struct NetIo *NetIoHandle;
 
+typedef struct NetIoBuffer
+{
+    const unsigned char *pBuffer;
+    size_t uLen;
+} NetIoBuffer_t;
+
 /**
  * @brief Create a network I/O handle
  *
@@ -27,6 +36,17 @@ typedef struct NetIo *NetIoHandle;
  */
 NetIoHandle NetIo_create(void);
 
+/**
+ * @brief Create a network I/O handle that uses a shared TLS context
+ *
+ * The random generator and the X509 certificates of the TLS context are used instead of setting up its own. The TLS
+ * context must outlive the network I/O handle.
+ *
+ * @param[in] xTlsContext The shared TLS context, or NULL to behave the same as NetIo_create()
+ * @return The network I/O handle
+ */
+NetIoHandle NetIo_createWithTlsContext(TlsContextHandle xTlsContext);
+
 /**
  * @brief Terminate a network I/O handle
  *
@@ -74,6 +94,28 @@ void NetIo_disconnect(NetIoHandle xNetIoHandle);
  */
 int NetIo_send(NetIoHandle xNetIoHandle, const unsigned char *pBuffer, size_t uBytesToSend);
 
+/**
+ * @brief Gather send data
+ *
+ * Small pieces of data are copied into a send buffer, so they can be sent in one TLS record instead of one record per
+ * piece. Data that is not flushed stays in the send buffer until the next flush or the next NetIo_send().
+ *
+ * @param[in] xNetIoHandle The network I/O handle
+ * @param[in] pxBuffers The data buffers
+ * @param[in] uBufferCount The number of data buffers
+ * @param[in] bFlush true to send out the send buffer before return, false otherwise
+ * @return 0 on success, non-zero value otherwise
+ */
+int NetIo_sendv(NetIoHandle xNetIoHandle, const NetIoBuffer_t *pxBuffers, size_t uBufferCount, bool bFlush);
+
+/**
+ * @brief Send out data in the send buffer
+ *
+ * @param[in] xNetIoHandle The network I/O handle
+ * @return 0 on success, non-zero value otherwise
+ */
+int NetIo_flush(NetIoHandle xNetIoHandle);
+
 /**
  * @brief Receive data
  *
@@ -14,6 +14,7 @@
  */
 
 #include <pthread.h>
+#include <stdbool.h>
 #include <string.h>
 
 /* Third party headers */
@@ -23,10 +24,314 @@
 #include "kvs/errors.h"
 #include "kvs/pool_allocator.h"
 
+/* The number of threads that can have their own cache. Other threads use the pool directly. */
+#ifndef POOL_THREAD_CACHE_MAX_THREADS
+#define POOL_THREAD_CACHE_MAX_THREADS (8)
+#endif
+
+/* The memory that each size class of a thread cache can hold */
+#ifndef POOL_THREAD_CACHE_BYTES_PER_CLASS
+#define POOL_THREAD_CACHE_BYTES_PER_CLASS (1024)
+#endif
+
+/* The number of blocks that each size class of a thread cache can hold */
+#ifndef POOL_THREAD_CACHE_MAX_BLOCKS_PER_CLASS
+#define POOL_THREAD_CACHE_MAX_BLOCKS_PER_CLASS (16)
+#endif
+
+#define POOL_THREAD_CACHE_MIN_BLOCKS_PER_CLASS (2)
+
+/* Only small allocations are cached. Larger ones go to the pool directly. */
+static const size_t sizeClasses[] = {16, 32, 64, 128, 256};
+
+#define NUM_OF_SIZE_CLASSES (sizeof(sizeClasses) / sizeof(sizeClasses[0]))
+
+typedef struct CachedBlock
+{
+    struct CachedBlock *pNext;
+} CachedBlock_t;
+
+typedef struct ThreadCache
+{
+    /* Only the owner thread takes this lock on allocation, so it's not contended except when collecting stats. */
+    pthread_mutex_t xLock;
+    bool bInUse;
+
+    CachedBlock_t *pFreeBlocks[NUM_OF_SIZE_CLASSES];
+    size_t uNumOfFreeBlocks[NUM_OF_SIZE_CLASSES];
+
+    /* The allocations and frees that are served by this cache */
+    size_t uNumOfAllocs;
+    size_t uNumOfFrees;
+} ThreadCache_t;
+
+/*
+ * Lock order: threadCachesMutex, then ThreadCache_t.xLock, then memPoolMutex.
+ */
 static pthread_mutex_t memPoolMutex = PTHREAD_MUTEX_INITIALIZER;
 static tlsf_t tlsf = NULL;
 static void *pMem = NULL;
 
+/* The allocations and frees that are served by the pool directly, or by caches of threads that have exited */
+static size_t uNumOfPoolAllocs = 0;
+static size_t uNumOfPoolFrees = 0;
+
+static pthread_mutex_t threadCachesMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t threadCacheOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t threadCacheKey;
+static bool bThreadCacheKeyCreated = false;
+static ThreadCache_t threadCaches[POOL_THREAD_CACHE_MAX_THREADS];
+
+/* The thread specific value of threads that don't get a cache, so they don't try again on every allocation. */
+static ThreadCache_t noThreadCache;
+
+static size_t prvMaxBlocksOfClass(size_t uClassIdx)
+{
+    size_t uMaxBlocks = POOL_THREAD_CACHE_BYTES_PER_CLASS / sizeClasses[uClassIdx];
+
+    if (uMaxBlocks > POOL_THREAD_CACHE_MAX_BLOCKS_PER_CLASS)
+    {
+        uMaxBlocks = POOL_THREAD_CACHE_MAX_BLOCKS_PER_CLASS;
+    }
+    else if (uMaxBlocks < POOL_THREAD_CACHE_MIN_BLOCKS_PER_CLASS)
+    {
+        uMaxBlocks = POOL_THREAD_CACHE_MIN_BLOCKS_PER_CLASS;
+    }
+
+    return uMaxBlocks;
+}
+
+/* Get the smallest class that fits an allocation, or -1 if it's too large to cache. */
+static int prvGetAllocClass(size_t bytes)
+{
+    int classIdx = -1;
+    size_t i = 0;
+
+    if (bytes > 0)
+    {
+        for (i = 0; i < NUM_OF_SIZE_CLASSES; i++)
+        {
+            if (bytes <= sizeClasses[i])
+            {
+                classIdx = (int)i;
+                break;
+            }
+        }
+    }
+
+    return classIdx;
+}
+
+/* Get the largest class that a block can serve, or -1 if it's not cacheable. */
+static int prvGetBlockClass(size_t uBlockSize)
+{
+    int classIdx = -1;
+    size_t i = 0;
+
+    if (uBlockSize < 2 * sizeClasses[NUM_OF_SIZE_CLASSES - 1])
+    {
+        for (i = 0; i < NUM_OF_SIZE_CLASSES && sizeClasses[i] <= uBlockSize; i++)
+        {
+            classIdx = (int)i;
+        }
+    }
+
+    return classIdx;
+}
+
+/* Return cached blocks of a class to the pool. The caller must hold the cache lock and memPoolMutex. */
+static void prvDrainClass(ThreadCache_t *pCache, size_t uClassIdx, size_t uNumOfBlocks)
+{
+    CachedBlock_t *pBlock = NULL;
+
+    while (uNumOfBlocks > 0 && pCache->pFreeBlocks[uClassIdx] != NULL)
+    {
+        pBlock = pCache->pFreeBlocks[uClassIdx];
+        pCache->pFreeBlocks[uClassIdx] = pBlock->pNext;
+        pCache->uNumOfFreeBlocks[uClassIdx]--;
+        if (tlsf != NULL)
+        {
+            tlsf_free(tlsf, pBlock);
+        }
+        uNumOfBlocks--;
+    }
+}
+
+/* Return all cached blocks to the pool. The caller must hold the cache lock and memPoolMutex. */
+static void prvDrainAll(ThreadCache_t *pCache)
+{
+    size_t i = 0;
+
+    for (i = 0; i < NUM_OF_SIZE_CLASSES; i++)
+    {
+        prvDrainClass(pCache, i, pCache->uNumOfFreeBlocks[i]);
+    }
+}
+
+/* Forget all cached blocks without returning them, because the pool is gone. The caller must hold the cache lock. */
+static void prvDiscardAll(ThreadCache_t *pCache)
+{
+    memset(pCache->pFreeBlocks, 0, sizeof(pCache->pFreeBlocks));
+    memset(pCache->uNumOfFreeBlocks, 0, sizeof(pCache->uNumOfFreeBlocks));
+}
+
+static void prvLockAllCaches(void)
+{
+    size_t i = 0;
+
+    pthread_mutex_lock(&threadCachesMutex);
+    for (i = 0; i < POOL_THREAD_CACHE_MAX_THREADS; i++)
+    {
+        if (threadCaches[i].bInUse)
+        {
+            pthread_mutex_lock(&(threadCaches[i].xLock));
+        }
+    }
+}
+
+static void prvUnlockAllCaches(void)
+{
+    size_t i = 0;
+
+    for (i = 0; i < POOL_THREAD_CACHE_MAX_THREADS; i++)
+    {
+        if (threadCaches[i].bInUse)
+        {
+            pthread_mutex_unlock(&(threadCaches[i].xLock));
+        }
+    }
+    pthread_mutex_unlock(&threadCachesMutex);
+}
+
+static void prvReleaseThreadCache(void *pValue)
+{
+    ThreadCache_t *pCache = (ThreadCache_t *)pValue;
+
+    if (pCache != NULL && pCache != &noThreadCache)
+    {
+        pthread_mutex_lock(&threadCachesMutex);
+        pthread_mutex_lock(&(pCache->xLock));
+        pthread_mutex_lock(&memPoolMutex);
+        prvDrainAll(pCache);
+        uNumOfPoolAllocs += pCache->uNumOfAllocs;
+        uNumOfPoolFrees += pCache->uNumOfFrees;
+        pthread_mutex_unlock(&memPoolMutex);
+        pCache->bInUse = false;
+        pthread_mutex_unlock(&(pCache->xLock));
+        pthread_mutex_unlock(&threadCachesMutex);
+    }
+}
+
+static void prvInitThreadCaches(void)
+{
+    size_t i = 0;
+
+    for (i = 0; i < POOL_THREAD_CACHE_MAX_THREADS; i++)
+    {
+        pthread_mutex_init(&(threadCaches[i].xLock), NULL);
+    }
+
+    if (pthread_key_create(&threadCacheKey, prvReleaseThreadCache) == 0)
+    {
+        bThreadCacheKeyCreated = true;
+    }
+}
+
+static ThreadCache_t *prvGetThreadCache(void)
+{
+    ThreadCache_t *pCache = NULL;
+    size_t i = 0;
+
+    pthread_once(&threadCacheOnce, prvInitThreadCaches);
+
+    if (bThreadCacheKeyCreated)
+    {
+        if ((pCache = (ThreadCache_t *)pthread_getspecific(threadCacheKey)) == NULL)
+        {
+            pCache = &noThreadCache;
+
+            pthread_mutex_lock(&threadCachesMutex);
+            for (i = 0; i < POOL_THREAD_CACHE_MAX_THREADS; i++)
+            {
+                if (!threadCaches[i].bInUse)
+                {
+                    pCache = &(threadCaches[i]);
+                    prvDiscardAll(pCache);
+                    pCache->uNumOfAllocs = 0;
+                    pCache->uNumOfFrees = 0;
+                    pCache->bInUse = true;
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&threadCachesMutex);
+
+            pthread_setspecific(threadCacheKey, pCache);
+        }
+    }
+
+    return (pCache == &noThreadCache) ? NULL : pCache;
+}
+
+static void *prvCacheMalloc(ThreadCache_t *pCache, size_t uClassIdx)
+{
+    void *pNewPtr = NULL;
+    CachedBlock_t *pBlock = NULL;
+    size_t uRefill = 0;
+
+    pthread_mutex_lock(&(pCache->xLock));
+
+    if (pCache->pFreeBlocks[uClassIdx] == NULL)
+    {
+        /* Refill half of the class in a batch, so the next allocations don't need the pool lock. */
+        uRefill = prvMaxBlocksOfClass(uClassIdx) / 2;
+
+        pthread_mutex_lock(&memPoolMutex);
+        while (tlsf != NULL && uRefill > 0 && (pBlock = (CachedBlock_t *)tlsf_malloc(tlsf, sizeClasses[uClassIdx])) != NULL)
+        {
+            pBlock->pNext = pCache->pFreeBlocks[uClassIdx];
+            pCache->pFreeBlocks[uClassIdx] = pBlock;
+            pCache->uNumOfFreeBlocks[uClassIdx]++;
+            uRefill--;
+        }
+        pthread_mutex_unlock(&memPoolMutex);
+    }
+
+    if ((pBlock = pCache->pFreeBlocks[uClassIdx]) != NULL)
+    {
+        pCache->pFreeBlocks[uClassIdx] = pBlock->pNext;
+        pCache->uNumOfFreeBlocks[uClassIdx]--;
+        pCache->uNumOfAllocs++;
+        pNewPtr = pBlock;
+    }
+
+    pthread_mutex_unlock(&(pCache->xLock));
+
+    return pNewPtr;
+}
+
+static void prvCacheFree(ThreadCache_t *pCache, size_t uClassIdx, void *ptr)
+{
+    CachedBlock_t *pBlock = (CachedBlock_t *)ptr;
+    size_t uMaxBlocks = prvMaxBlocksOfClass(uClassIdx);
+
+    pthread_mutex_lock(&(pCache->xLock));
+
+    if (pCache->uNumOfFreeBlocks[uClassIdx] >= uMaxBlocks)
+    {
+        /* Drain half of the class in a batch, so the next frees don't need the pool lock. */
+        pthread_mutex_lock(&memPoolMutex);
+        prvDrainClass(pCache, uClassIdx, uMaxBlocks / 2);
+        pthread_mutex_unlock(&memPoolMutex);
+    }
+
+    pBlock->pNext = pCache->pFreeBlocks[uClassIdx];
+    pCache->pFreeBlocks[uClassIdx] = pBlock;
+    pCache->uNumOfFreeBlocks[uClassIdx]++;
+    pCache->uNumOfFrees++;
+
+    pthread_mutex_unlock(&(pCache->xLock));
+}
+
 int poolAllocatorInit(void *pMemPool, size_t bytes)
 {
     int res = 0;
@@ -57,13 +362,22 @@ int poolAllocatorInit(void *pMemPool, size_t bytes)
 void *poolAllocatorMalloc(size_t bytes)
 {
     void *pNewPtr = NULL;
+    ThreadCache_t *pCache = NULL;
+    int classIdx = prvGetAllocClass(bytes);
 
-    pthread_mutex_lock(&memPoolMutex);
-    if (tlsf != NULL)
+    if (classIdx >= 0 && (pCache = prvGetThreadCache()) != NULL)
     {
-        pNewPtr = tlsf_malloc(tlsf, bytes);
+        pNewPtr = prvCacheMalloc(pCache, (size_t)classIdx);
+    }
+    else
+    {
+        pthread_mutex_lock(&memPoolMutex);
+        if (tlsf != NULL && (pNewPtr = tlsf_malloc(tlsf, bytes)) != NULL)
+        {
+            uNumOfPoolAllocs++;
+        }
+        pthread_mutex_unlock(&memPoolMutex);
     }
-    pthread_mutex_unlock(&memPoolMutex);
 
     return pNewPtr;
 }
@@ -73,9 +387,11 @@ void *poolAllocatorRealloc(void *ptr, size_t bytes)
     void *pNewPtr = NULL;
 
     pthread_mutex_lock(&memPoolMutex);
-    if (tlsf != NULL)
+    if (tlsf != NULL && (pNewPtr = tlsf_realloc(tlsf, ptr, bytes)) != NULL)
     {
-        pNewPtr = tlsf_realloc(tlsf, ptr, bytes);
+        /* A realloc counts as a free of the old block and an allocation of the new one. */
+        uNumOfPoolAllocs++;
+        uNumOfPoolFrees += (ptr != NULL) ? 1 : 0;
     }
     pthread_mutex_unlock(&memPoolMutex);
 
@@ -97,17 +413,44 @@ void *poolAllocatorCalloc(size_t num, size_t bytes)
 
 void poolAllocatorFree(void *ptr)
 {
+    ThreadCache_t *pCache = NULL;
+    int classIdx = -1;
+
     if (ptr != NULL && tlsf != NULL)
     {
-        pthread_mutex_lock(&memPoolMutex);
-        tlsf_free(tlsf, ptr);
-        pthread_mutex_unlock(&memPoolMutex);
+        /* A block can be cached by any thread, no matter which thread allocated it, because it's a block of the pool. */
+        classIdx = prvGetBlockClass(tlsf_block_size(ptr));
+        if (classIdx >= 0 && (pCache = prvGetThreadCache()) != NULL)
+        {
+            prvCacheFree(pCache, (size_t)classIdx, ptr);
+        }
+        else
+        {
+            pthread_mutex_lock(&memPoolMutex);
+            tlsf_free(tlsf, ptr);
+            uNumOfPoolFrees++;
+            pthread_mutex_unlock(&memPoolMutex);
+        }
     }
 }
 
 void poolAllocatorDeinit(void)
 {
+    size_t i = 0;
+
+    prvLockAllCaches();
     pthread_mutex_lock(&memPoolMutex);
+    for (i = 0; i < POOL_THREAD_CACHE_MAX_THREADS; i++)
+    {
+        if (threadCaches[i].bInUse)
+        {
+            prvDiscardAll(&(threadCaches[i]));
+            threadCaches[i].uNumOfAllocs = 0;
+            threadCaches[i].uNumOfFrees = 0;
+        }
+    }
+    uNumOfPoolAllocs = 0;
+    uNumOfPoolFrees = 0;
     if (tlsf != NULL)
     {
         tlsf_destroy(tlsf);
@@ -118,6 +461,7 @@ void poolAllocatorDeinit(void)
         pMem = NULL;
     }
     pthread_mutex_unlock(&memPoolMutex);
+    prvUnlockAllCaches();
 }
 
 static void prvTlsfPoolWalker(void *ptr, size_t size, int used, void *pUser)
@@ -145,11 +489,26 @@ static void prvTlsfPoolWalker(void *ptr, size_t size, int used, void *pUser)
 
 void poolAllocatorGetStats(PoolStats_t *pPoolStats)
 {
+    size_t i = 0;
+
+    /* Cached blocks are returned to the pool first, so the pool walk sees them as free and the numbers are exact. */
+    prvLockAllCaches();
     pthread_mutex_lock(&memPoolMutex);
     if (tlsf != NULL && pMem != NULL)
     {
+        for (i = 0; i < POOL_THREAD_CACHE_MAX_THREADS; i++)
+        {
+            if (threadCaches[i].bInUse)
+            {
+                prvDrainAll(&(threadCaches[i]));
+                pPoolStats->uNumberOfAllocations += threadCaches[i].uNumOfAllocs;
+                pPoolStats->uNumberOfFrees += threadCaches[i].uNumOfFrees;
+            }
+        }
+        pPoolStats->uNumberOfAllocations += uNumOfPoolAllocs;
+        pPoolStats->uNumberOfFrees += uNumOfPoolFrees;
         tlsf_walk_pool(tlsf_get_pool(tlsf), prvTlsfPoolWalker, pPoolStats);
     }
     pthread_mutex_unlock(&memPoolMutex);
+    prvUnlockAllCaches();
 }
-
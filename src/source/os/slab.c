@@ -0,0 +1,164 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+/* Third party headers */
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+/* Internal headers */
+#include "os/allocator.h"
+#include "os/slab.h"
+
+/* Objects are aligned to 8 bytes, so they can hold 64-bit members on 32-bit platforms too. */
+#define SLAB_OBJECT_ALIGNMENT (8)
+#define SLAB_ALIGN_UP(x) (((x) + SLAB_OBJECT_ALIGNMENT - 1) & ~((size_t)SLAB_OBJECT_ALIGNMENT - 1))
+
+typedef struct SlabObject
+{
+    struct SlabObject *pxNext;
+} SlabObject_t;
+
+typedef struct Slab
+{
+    LOCK_HANDLE xLock;
+
+    size_t uObjectSize;
+    uint8_t *pBegin;
+    uint8_t *pEnd;
+
+    /* Free objects are linked through their own memory. */
+    SlabObject_t *pxFreeList;
+} Slab_t;
+
+static bool prvIsInSlab(Slab_t *pxSlab, void *pObject)
+{
+    return (uint8_t *)pObject >= pxSlab->pBegin && (uint8_t *)pObject < pxSlab->pEnd;
+}
+
+SlabHandle Slab_create(size_t uObjectSize, size_t uObjectCount)
+{
+    Slab_t *pxSlab = NULL;
+    size_t uHeaderSize = SLAB_ALIGN_UP(sizeof(Slab_t));
+    size_t i = 0;
+    SlabObject_t *pxObject = NULL;
+
+    if (uObjectSize < sizeof(SlabObject_t))
+    {
+        uObjectSize = sizeof(SlabObject_t);
+    }
+
+    if (uObjectCount == 0 || uObjectSize > SIZE_MAX - SLAB_OBJECT_ALIGNMENT || uObjectCount > (SIZE_MAX - uHeaderSize) / SLAB_ALIGN_UP(uObjectSize))
+    {
+        LogError("Invalid argument");
+    }
+    else if ((pxSlab = (Slab_t *)kvsMalloc(uHeaderSize + SLAB_ALIGN_UP(uObjectSize) * uObjectCount)) == NULL)
+    {
+        LogError("OOM: pxSlab");
+    }
+    else if ((pxSlab->xLock = Lock_Init()) == NULL)
+    {
+        LogError("Failed to initialize lock");
+        kvsFree(pxSlab);
+        pxSlab = NULL;
+    }
+    else
+    {
+        pxSlab->uObjectSize = SLAB_ALIGN_UP(uObjectSize);
+        pxSlab->pBegin = (uint8_t *)pxSlab + uHeaderSize;
+        pxSlab->pEnd = pxSlab->pBegin + pxSlab->uObjectSize * uObjectCount;
+        pxSlab->pxFreeList = NULL;
+
+        /* Link from the end, so objects are handed out in address order. */
+        for (i = uObjectCount; i > 0; i--)
+        {
+            pxObject = (SlabObject_t *)(pxSlab->pBegin + pxSlab->uObjectSize * (i - 1));
+            pxObject->pxNext = pxSlab->pxFreeList;
+            pxSlab->pxFreeList = pxObject;
+        }
+    }
+
+    return pxSlab;
+}
+
+void Slab_terminate(SlabHandle xSlab)
+{
+    Slab_t *pxSlab = xSlab;
+
+    if (pxSlab != NULL)
+    {
+        Lock_Deinit(pxSlab->xLock);
+        kvsFree(pxSlab);
+    }
+}
+
+void *Slab_alloc(SlabHandle xSlab)
+{
+    Slab_t *pxSlab = xSlab;
+    SlabObject_t *pxObject = NULL;
+
+    if (pxSlab == NULL)
+    {
+        LogError("Invalid argument");
+    }
+    else
+    {
+        if (Lock(pxSlab->xLock) != LOCK_OK)
+        {
+            LogError("Failed to Lock");
+        }
+        else
+        {
+            if ((pxObject = pxSlab->pxFreeList) != NULL)
+            {
+                pxSlab->pxFreeList = pxObject->pxNext;
+            }
+            Unlock(pxSlab->xLock);
+        }
+
+        if (pxObject == NULL)
+        {
+            pxObject = (SlabObject_t *)kvsMalloc(pxSlab->uObjectSize);
+        }
+    }
+
+    return pxObject;
+}
+
+void Slab_free(SlabHandle xSlab, void *pObject)
+{
+    Slab_t *pxSlab = xSlab;
+    SlabObject_t *pxObject = (SlabObject_t *)pObject;
+
+    if (pxObject != NULL)
+    {
+        if (pxSlab == NULL || !prvIsInSlab(pxSlab, pxObject))
+        {
+            kvsFree(pxObject);
+        }
+        else if (Lock(pxSlab->xLock) != LOCK_OK)
+        {
+            LogError("Failed to Lock");
+        }
+        else
+        {
+            pxObject->pxNext = pxSlab->pxFreeList;
+            pxSlab->pxFreeList = pxObject;
+            Unlock(pxSlab->xLock);
+        }
+    }
+}
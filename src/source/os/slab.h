@@ -0,0 +1,59 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+typedef struct Slab *SlabHandle;
+
+/**
+ * Create a slab of fixed-size objects.
+ *
+ * All objects are carved from one allocation that is made here, so allocating and freeing objects afterwards does not
+ * touch the heap until the slab runs out.
+ *
+ * @param[in] uObjectSize Object size
+ * @param[in] uObjectCount Number of objects
+ * @return Slab handle on success, NULL otherwise
+ */
+SlabHandle Slab_create(size_t uObjectSize, size_t uObjectCount);
+
+/**
+ * Terminate a slab. All objects that are allocated from the slab must have been freed.
+ *
+ * @param[in] xSlab Slab handle
+ */
+void Slab_terminate(SlabHandle xSlab);
+
+/**
+ * Allocate an object from a slab. If the slab runs out, the object is allocated from the heap instead.
+ *
+ * @param[in] xSlab Slab handle
+ * @return Object address on success, NULL otherwise
+ */
+void *Slab_alloc(SlabHandle xSlab);
+
+/**
+ * Free an object that is allocated by Slab_alloc. If the slab handle is NULL or the object is not in the slab, it's
+ * freed to the heap.
+ *
+ * @param[in] xSlab Slab handle
+ * @param[in] pObject Object address
+ */
+void Slab_free(SlabHandle xSlab, void *pObject);
+
+#endif /* SLAB_H */
@@ -13,9 +13,14 @@
  * permissions and limitations under the License.
  */
 
+#include <pthread.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 /* Third party headers */
+#include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/strings.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "mbedtls/md.h"
@@ -61,6 +66,25 @@
 
 #define TEMPLATE_SIGNATURE_START "%s%s"
 
+/* The number of signing keys that are cached. One entry is used per region, service and secret key. */
+#define SIGNING_KEY_CACHE_SIZE 4
+
+/* The max string length of region and service that can be cached. */
+#define SIGNING_KEY_CACHE_MAX_NAME_LEN 31
+
+typedef struct SigningKeyCacheEntry
+{
+    bool bValid;
+    char pcDate[SIGNATURE_DATE_STRING_LEN];
+    char pcRegion[SIGNING_KEY_CACHE_MAX_NAME_LEN + 1];
+    char pcService[SIGNING_KEY_CACHE_MAX_NAME_LEN + 1];
+
+    /* The hash of secret key. It's used to tell if credentials change without keeping another copy of the secret. */
+    unsigned char pSecretKeyHash[SHA256_DIGEST_LENGTH];
+    unsigned char pSigningKey[SHA256_DIGEST_LENGTH];
+    uint32_t uLastUsed;
+} SigningKeyCacheEntry_t;
+
 typedef struct AwsSigV4
 {
     STRING_HANDLE xStCanonicalRequest;
@@ -70,6 +94,15 @@ typedef struct AwsSigV4
     STRING_HANDLE xStAuthorization;
 } AwsSigV4_t;
 
+/* The signing key only depends on date, region, service and secret key, so it's cached and shared by all signers.
+ * The lock is created once by the first caller, and it's kept for the lifetime of the process. */
+static pthread_once_t signingKeyCacheOnce = PTHREAD_ONCE_INIT;
+static LOCK_HANDLE signingKeyCacheLock = NULL;
+static SigningKeyCacheEntry_t signingKeyCache[SIGNING_KEY_CACHE_SIZE] = {0};
+static uint32_t signingKeyCacheClock = 0;
+static uint32_t signingKeyCacheHitCount = 0;
+static uint32_t signingKeyCacheMissCount = 0;
+
 static int prvValidateHttpMethod(const char *pcHttpMethod)
 {
     if (pcHttpMethod == NULL)
@@ -142,6 +175,151 @@ static int prvHexEncodedSha256(const unsigned char *pMsg, size_t uMsgLen, char p
     return res;
 }
 
+/**
+ * @brief Calculate the signing key by the HMAC chain of date, region, service and signature end.
+ */
+static int prvCalculateSigningKey(
+    const mbedtls_md_info_t *pxMdInfo,
+    size_t uHmacSize,
+    const char *pcSecretKey,
+    const char *pcXAmzDate,
+    const char *pcRegion,
+    const char *pcService,
+    unsigned char *pSigningKey)
+{
+    int res = KVS_ERRNO_NONE;
+    int retVal = 0;
+    char pHmac[AWS_SIG_V4_MAX_HMAC_SIZE] = {0};
+
+    /* Generate the beginning of the signature. */
+    if (snprintf(pHmac, AWS_SIG_V4_MAX_HMAC_SIZE, TEMPLATE_SIGNATURE_START, AWS_SIG_V4_SIGNATURE_START, pcSecretKey) == 0)
+    {
+        res = KVS_ERROR_C_UTIL_STRING_ERROR;
+    }
+    else if (
+        (retVal = mbedtls_md_hmac(pxMdInfo, (const unsigned char *)pHmac, strlen(pHmac), (const unsigned char *)pcXAmzDate, SIGNATURE_DATE_STRING_LEN, (unsigned char *)pHmac)) != 0 ||
+        (retVal = mbedtls_md_hmac(pxMdInfo, (const unsigned char *)pHmac, uHmacSize, (const unsigned char *)pcRegion, strlen(pcRegion), (unsigned char *)pHmac)) != 0 ||
+        (retVal = mbedtls_md_hmac(pxMdInfo, (const unsigned char *)pHmac, uHmacSize, (const unsigned char *)pcService, strlen(pcService), (unsigned char *)pHmac)) != 0 ||
+        (retVal = mbedtls_md_hmac(pxMdInfo, (const unsigned char *)pHmac, uHmacSize, (const unsigned char *)AWS_SIG_V4_SIGNATURE_END, sizeof(AWS_SIG_V4_SIGNATURE_END) - 1, (unsigned char *)pHmac)) != 0)
+    {
+        res = KVS_GENERATE_MBEDTLS_ERROR(retVal);
+    }
+    else
+    {
+        memcpy(pSigningKey, pHmac, uHmacSize);
+    }
+
+    memset(pHmac, 0, sizeof(pHmac));
+
+    return res;
+}
+
+static void prvInitSigningKeyCacheLock(void)
+{
+    signingKeyCacheLock = Lock_Init();
+}
+
+/**
+ * @brief Get the lock of the signing key cache. It's created exactly once even if signers of many threads race for it.
+ *
+ * @return The lock, or NULL if it failed to be created
+ */
+static LOCK_HANDLE prvGetSigningKeyCacheLock(void)
+{
+    pthread_once(&signingKeyCacheOnce, prvInitSigningKeyCacheLock);
+
+    return signingKeyCacheLock;
+}
+
+/**
+ * @brief Get the signing key from cache, or calculate and cache it if the date or the credentials have changed.
+ */
+static int prvGetSigningKey(
+    const mbedtls_md_info_t *pxMdInfo,
+    size_t uHmacSize,
+    const char *pcSecretKey,
+    const char *pcXAmzDate,
+    const char *pcRegion,
+    const char *pcService,
+    unsigned char *pSigningKey)
+{
+    int res = KVS_ERRNO_NONE;
+    int retVal = 0;
+    unsigned char pSecretKeyHash[SHA256_DIGEST_LENGTH] = {0};
+    SigningKeyCacheEntry_t *pxEntry = NULL;
+    LOCK_HANDLE xLock = prvGetSigningKeyCacheLock();
+    int i = 0;
+
+    if (uHmacSize != SHA256_DIGEST_LENGTH || strlen(pcRegion) > SIGNING_KEY_CACHE_MAX_NAME_LEN || strlen(pcService) > SIGNING_KEY_CACHE_MAX_NAME_LEN)
+    {
+        /* It cannot be cached. */
+        res = prvCalculateSigningKey(pxMdInfo, uHmacSize, pcSecretKey, pcXAmzDate, pcRegion, pcService, pSigningKey);
+    }
+    else if ((retVal = mbedtls_sha256_ret((const unsigned char *)pcSecretKey, strlen(pcSecretKey), pSecretKeyHash, 0)) != 0)
+    {
+        res = KVS_GENERATE_MBEDTLS_ERROR(retVal);
+    }
+    else if (xLock == NULL)
+    {
+        LogError("Failed to init lock, the signing key is not cached");
+        res = prvCalculateSigningKey(pxMdInfo, uHmacSize, pcSecretKey, pcXAmzDate, pcRegion, pcService, pSigningKey);
+    }
+    else if (Lock(xLock) != LOCK_OK)
+    {
+        res = KVS_ERROR_LOCK_ERROR;
+        LogError("Failed to lock");
+    }
+    else
+    {
+
+        /* Find the entry of the same region, service and secret key, or the least recently used one. */
+        pxEntry = &(signingKeyCache[0]);
+        for (i = 0; i < SIGNING_KEY_CACHE_SIZE; i++)
+        {
+            if (signingKeyCache[i].bValid && strcmp(signingKeyCache[i].pcRegion, pcRegion) == 0 && strcmp(signingKeyCache[i].pcService, pcService) == 0 &&
+                memcmp(signingKeyCache[i].pSecretKeyHash, pSecretKeyHash, SHA256_DIGEST_LENGTH) == 0)
+            {
+                pxEntry = &(signingKeyCache[i]);
+                break;
+            }
+            else if (pxEntry->bValid && (!signingKeyCache[i].bValid || signingKeyCache[i].uLastUsed < pxEntry->uLastUsed))
+            {
+                pxEntry = &(signingKeyCache[i]);
+            }
+        }
+
+        if (i < SIGNING_KEY_CACHE_SIZE && memcmp(pxEntry->pcDate, pcXAmzDate, SIGNATURE_DATE_STRING_LEN) == 0)
+        {
+            memcpy(pSigningKey, pxEntry->pSigningKey, SHA256_DIGEST_LENGTH);
+            signingKeyCacheHitCount++;
+        }
+        else if ((res = prvCalculateSigningKey(pxMdInfo, uHmacSize, pcSecretKey, pcXAmzDate, pcRegion, pcService, pSigningKey)) != KVS_ERRNO_NONE)
+        {
+            /* Propagate the res error */
+        }
+        else
+        {
+            /* It's a new entry, or the date has rolled over. */
+            memcpy(pxEntry->pcDate, pcXAmzDate, SIGNATURE_DATE_STRING_LEN);
+            snprintf(pxEntry->pcRegion, sizeof(pxEntry->pcRegion), "%s", pcRegion);
+            snprintf(pxEntry->pcService, sizeof(pxEntry->pcService), "%s", pcService);
+            memcpy(pxEntry->pSecretKeyHash, pSecretKeyHash, SHA256_DIGEST_LENGTH);
+            memcpy(pxEntry->pSigningKey, pSigningKey, SHA256_DIGEST_LENGTH);
+            pxEntry->bValid = true;
+            signingKeyCacheMissCount++;
+        }
+
+        if (res == KVS_ERRNO_NONE)
+        {
+            pxEntry->uLastUsed = ++signingKeyCacheClock;
+        }
+
+        Unlock(xLock);
+    }
+
+    return res;
+}
+
 AwsSigV4Handle AwsSigV4_Create(char *pcHttpMethod, char *pcUri, char *pcQuery)
 {
     int res = KVS_ERRNO_NONE;
@@ -305,18 +483,13 @@ int AwsSigV4_Sign(AwsSigV4Handle xSigV4Handle, char *pcAccessKey, char *pcSecret
     {
         res = KVS_ERROR_C_UTIL_STRING_ERROR;
     }
-    /* Generate the beginning of the signature. */
-    else if (snprintf(pHmac, AWS_SIG_V4_MAX_HMAC_SIZE, TEMPLATE_SIGNATURE_START, AWS_SIG_V4_SIGNATURE_START, pcSecretKey) == 0)
+    /* Get the signing key which is derived from date, region, service and secret key. */
+    else if ((res = prvGetSigningKey(pxMdInfo, uHmacSize, pcSecretKey, pcXAmzDate, pcRegion, pcService, (unsigned char *)pHmac)) != KVS_ERRNO_NONE)
     {
-        res = KVS_ERROR_C_UTIL_STRING_ERROR;
+        /* Propagate the res error */
     }
-    /* Calculate the HMAC of date, region, service, signature end, and signed string*/
-    else if (
-        (retVal = mbedtls_md_hmac(pxMdInfo, (const unsigned char *)pHmac, strlen(pHmac), (const unsigned char *)pcXAmzDate, SIGNATURE_DATE_STRING_LEN, (unsigned char *)pHmac)) != 0 ||
-        (retVal = mbedtls_md_hmac(pxMdInfo, (const unsigned char *)pHmac, uHmacSize, (const unsigned char *)pcRegion, strlen(pcRegion), (unsigned char *)pHmac)) != 0 ||
-        (retVal = mbedtls_md_hmac(pxMdInfo, (const unsigned char *)pHmac, uHmacSize, (const unsigned char *)pcService, strlen(pcService), (unsigned char *)pHmac)) != 0 ||
-        (retVal = mbedtls_md_hmac(pxMdInfo, (const unsigned char *)pHmac, uHmacSize, (const unsigned char *)AWS_SIG_V4_SIGNATURE_END, sizeof(AWS_SIG_V4_SIGNATURE_END) - 1, (unsigned char *)pHmac)) != 0 ||
-        (retVal = mbedtls_md_hmac(pxMdInfo, (const unsigned char *)pHmac, uHmacSize, (const unsigned char *)STRING_c_str(xStSignedStr), STRING_length(xStSignedStr), (unsigned char *)pHmac)) != 0)
+    /* Calculate the HMAC of signed string */
+    else if ((retVal = mbedtls_md_hmac(pxMdInfo, (const unsigned char *)pHmac, uHmacSize, (const unsigned char *)STRING_c_str(xStSignedStr), STRING_length(xStSignedStr), (unsigned char *)pHmac)) != 0)
     {
         res = KVS_GENERATE_MBEDTLS_ERROR(retVal);
     }
@@ -363,4 +536,33 @@ const char *AwsSigV4_GetAuthorization(AwsSigV4Handle xSigV4Handle)
     {
         return NULL;
     }
+}
+
+int AwsSigV4_GetSigningKeyCacheStats(uint32_t *puHitCount, uint32_t *puMissCount)
+{
+    int res = KVS_ERRNO_NONE;
+    LOCK_HANDLE xLock = prvGetSigningKeyCacheLock();
+
+    if (puHitCount == NULL || puMissCount == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else if (xLock == NULL)
+    {
+        res = KVS_ERROR_LOCK_ERROR;
+        LogError("Failed to init lock");
+    }
+    else if (Lock(xLock) != LOCK_OK)
+    {
+        res = KVS_ERROR_LOCK_ERROR;
+        LogError("Failed to lock");
+    }
+    else
+    {
+        *puHitCount = signingKeyCacheHitCount;
+        *puMissCount = signingKeyCacheMissCount;
+        Unlock(xLock);
+    }
+
+    return res;
 }
\ No newline at end of file
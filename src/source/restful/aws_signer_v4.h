@@ -16,6 +16,9 @@
 #ifndef AWS_SIGNER_V4_H
 #define AWS_SIGNER_V4_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 typedef struct AwsSigV4 *AwsSigV4Handle;
 
 /**
@@ -83,4 +86,13 @@ int AwsSigV4_Sign(AwsSigV4Handle xSigV4Handle, char *pcAccessKey, char *pcSecret
  */
 const char *AwsSigV4_GetAuthorization(AwsSigV4Handle xSigV4Handle);
 
+/**
+ * @brief Get the counts of the signing key cache that is shared by all signers
+ *
+ * @param[out] puHitCount The number of signatures that reuse a cached signing key
+ * @param[out] puMissCount The number of signing keys that are calculated and cached
+ * @return 0 on success, non-zero value otherwise
+ */
+int AwsSigV4_GetSigningKeyCacheStats(uint32_t *puHitCount, uint32_t *puMissCount);
+
 #endif /* AWS_SIGNER_V4_H */
\ No newline at end of file
@@ -14,6 +14,7 @@
  */
 
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 
 /* Thirdparty headers */
@@ -35,6 +36,70 @@
 #define IOT_URI_ROLE_ALIASES_BEGIN  "/role-aliases"
 #define IOT_URI_ROLE_ALIASES_END    "/credentials"
 
+#define PORT_HTTPS "443"
+#define HOST_NAME_MAX_LEN (255)
+
+#define IOT_CREDENTIAL_EXPIRATION_FORMAT "%4u-%2u-%2uT%2u:%2u:%2u"
+
+/**
+ * Convert a UTC time like "2021-06-24T17:53:53Z" to epoch time in milliseconds.
+ *
+ * @param[in] pcTime The time in the format of IoT credential expiration
+ * @return The epoch time in milliseconds on success, or 0 otherwise
+ */
+static uint64_t prvParseExpiration(const char *pcTime)
+{
+    unsigned int uYear = 0, uMonth = 0, uDay = 0, uHour = 0, uMinute = 0, uSecond = 0;
+    unsigned int uEra = 0, uYearOfEra = 0, uDayOfYear = 0, uDayOfEra = 0;
+    int64_t xDays = 0;
+
+    if (pcTime == NULL || sscanf(pcTime, IOT_CREDENTIAL_EXPIRATION_FORMAT, &uYear, &uMonth, &uDay, &uHour, &uMinute, &uSecond) != 6 || uYear < 1970 ||
+        uMonth < 1 || uMonth > 12 || uDay < 1 || uDay > 31 || uHour > 23 || uMinute > 59 || uSecond > 60)
+    {
+        return 0;
+    }
+
+    /* Days since 1970-01-01 of the proleptic Gregorian calendar, with years that start in March. */
+    uYear -= (uMonth <= 2) ? 1 : 0;
+    uEra = uYear / 400;
+    uYearOfEra = uYear - uEra * 400;
+    uDayOfYear = (153 * (uMonth > 2 ? uMonth - 3 : uMonth + 9) + 2) / 5 + uDay - 1;
+    uDayOfEra = uYearOfEra * 365 + uYearOfEra / 4 - uYearOfEra / 100 + uDayOfYear;
+    xDays = (int64_t)uEra * 146097 + (int64_t)uDayOfEra - 719468;
+
+    return ((uint64_t)xDays * 86400 + uHour * 3600 + uMinute * 60 + uSecond) * 1000;
+}
+
+/**
+ * Connect to a credential host with X509 certificate. The host can be followed by a port like "localhost:8443",
+ * otherwise the HTTPS port is used.
+ */
+static int prvConnectWithX509(NetIoHandle xNetIoHandle, IotCredentialRequest_t *pReq)
+{
+    int res = KVS_ERRNO_NONE;
+    const char *pcPortSeparator = NULL;
+    size_t uHostNameLen = 0;
+    char pcHostName[HOST_NAME_MAX_LEN + 1];
+
+    if ((pcPortSeparator = strrchr(pReq->pCredentialHost, ':')) == NULL)
+    {
+        res = NetIo_connectWithX509(xNetIoHandle, pReq->pCredentialHost, PORT_HTTPS, pReq->pRootCA, pReq->pCertificate, pReq->pPrivateKey);
+    }
+    else if ((uHostNameLen = (size_t)(pcPortSeparator - pReq->pCredentialHost)) > HOST_NAME_MAX_LEN || pcPortSeparator[1] == '\0')
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid host:%s", pReq->pCredentialHost);
+    }
+    else
+    {
+        memcpy(pcHostName, pReq->pCredentialHost, uHostNameLen);
+        pcHostName[uHostNameLen] = '\0';
+        res = NetIo_connectWithX509(xNetIoHandle, pcHostName, pcPortSeparator + 1, pReq->pRootCA, pReq->pCertificate, pReq->pPrivateKey);
+    }
+
+    return res;
+}
+
 static int parseIoTCredential(const char *pcJsonSrc, size_t uJsonSrcLen, IotCredentialToken_t *pToken)
 {
     int res = KVS_ERRNO_NONE;
@@ -63,9 +128,10 @@ static int parseIoTCredential(const char *pcJsonSrc, size_t uJsonSrcLen, IotCred
         res = KVS_ERROR_FAIL_TO_PARSE_JSON_OF_IOT_CREDENTIAL;
         LogError("Failed to parse IoT credential");
     }
-    else
+    else if ((pToken->uExpirationMs = prvParseExpiration(json_object_dotget_string(pxRootObject, "credentials.expiration"))) == 0)
     {
-        /* nop */
+        /* It's not fatal. The credential is refreshed after a fixed time instead. */
+        LogInfo("Unknown IoT credential expiration");
     }
 
     if (pxRootValue != NULL)
@@ -111,12 +177,12 @@ IotCredentialToken_t *Iot_getCredential(IotCredentialRequest_t *pReq)
         res = KVS_ERROR_FAIL_TO_GENERATE_HTTP_HEADERS;
         LogError("Failed to generate HTTP headers");
     }
-    else if ((xNetIoHandle = NetIo_create()) == NULL)
+    else if ((xNetIoHandle = NetIo_createWithTlsContext(pReq->xTlsContext)) == NULL)
     {
         res = KVS_ERROR_FAIL_TO_CREATE_NETIO_HANDLE;
         LogError("Failed to create netio handle");
     }
-    else if ((res = NetIo_connectWithX509(xNetIoHandle, pReq->pCredentialHost, "443", pReq->pRootCA, pReq->pCertificate, pReq->pPrivateKey)) != KVS_ERRNO_NONE)
+    else if ((res = prvConnectWithX509(xNetIoHandle, pReq)) != KVS_ERRNO_NONE)
     {
         LogError("Failed to connect to %s\r\n", pReq->pCredentialHost);
         /* Propagate the res error */
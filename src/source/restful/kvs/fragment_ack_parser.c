@@ -0,0 +1,477 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Public headers */
+#include "kvs/errors.h"
+
+/* Internal headers */
+#include "restful/kvs/fragment_ack_parser.h"
+
+#define JSON_KEY_EVENT_TYPE "EventType"
+#define JSON_KEY_FRAGMENT_TIMECODE "FragmentTimecode"
+#define JSON_KEY_ERROR_ID "ErrorId"
+
+#define EVENT_TYPE_BUFFERING "BUFFERING"
+#define EVENT_TYPE_RECEIVED "RECEIVED"
+#define EVENT_TYPE_PERSISTED "PERSISTED"
+#define EVENT_TYPE_ERROR "ERROR"
+#define EVENT_TYPE_IDLE "IDLE"
+
+/* A chunk size with more hex digits than this is treated as malformed. */
+#define CHUNK_SIZE_MAX_DIGITS (8)
+
+typedef struct
+{
+    const char *pcName;
+    ePutMediaFragmentAckEventType eventType;
+} EventTypeEntry_t;
+
+static const EventTypeEntry_t eventTypeTable[] = {
+    {EVENT_TYPE_BUFFERING, eBuffering},
+    {EVENT_TYPE_RECEIVED, eReceived},
+    {EVENT_TYPE_PERSISTED, ePersisted},
+    {EVENT_TYPE_ERROR, eError},
+    {EVENT_TYPE_IDLE, eIdle},
+};
+
+static bool prvIsJsonWhitespace(char c)
+{
+    return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+}
+
+static int prvHexValue(char c)
+{
+    int val = -1;
+
+    if (c >= '0' && c <= '9')
+    {
+        val = c - '0';
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+        val = c - 'a' + 10;
+    }
+    else if (c >= 'A' && c <= 'F')
+    {
+        val = c - 'A' + 10;
+    }
+
+    return val;
+}
+
+static void prvResetAck(FragmentAckParser_t *pxParser)
+{
+    pxParser->bHasEventType = false;
+    memset(&(pxParser->xAck), 0, sizeof(FragmentAckInfo_t));
+}
+
+static ePutMediaFragmentAckEventType prvGetEventType(const char *pcEventType)
+{
+    ePutMediaFragmentAckEventType ev = eUnknown;
+    size_t i = 0;
+
+    for (i = 0; i < sizeof(eventTypeTable) / sizeof(eventTypeTable[0]); i++)
+    {
+        if (strcmp(pcEventType, eventTypeTable[i].pcName) == 0)
+        {
+            ev = eventTypeTable[i].eventType;
+            break;
+        }
+    }
+
+    return ev;
+}
+
+static void prvApplyStringValue(FragmentAckParser_t *pxParser)
+{
+    if (pxParser->uKeyLen <= FRAGMENT_ACK_KEY_MAX_LEN && strcmp(pxParser->pcKey, JSON_KEY_EVENT_TYPE) == 0)
+    {
+        pxParser->bHasEventType = true;
+        if (pxParser->uValueLen <= FRAGMENT_ACK_VALUE_MAX_LEN)
+        {
+            pxParser->xAck.eventType = prvGetEventType(pxParser->pcValue);
+        }
+        else
+        {
+            pxParser->xAck.eventType = eUnknown;
+        }
+    }
+}
+
+static void prvApplyNumberValue(FragmentAckParser_t *pxParser)
+{
+    if (pxParser->uKeyLen <= FRAGMENT_ACK_KEY_MAX_LEN)
+    {
+        if (strcmp(pxParser->pcKey, JSON_KEY_FRAGMENT_TIMECODE) == 0)
+        {
+            pxParser->xAck.uFragmentTimecode = pxParser->uNumber;
+        }
+        else if (strcmp(pxParser->pcKey, JSON_KEY_ERROR_ID) == 0)
+        {
+            pxParser->xAck.uErrorId = (unsigned int)pxParser->uNumber;
+        }
+    }
+}
+
+static bool prvCompleteAck(FragmentAckParser_t *pxParser, FragmentAckInfo_t *pxAck)
+{
+    bool bAckAvailable = false;
+    ePutMediaFragmentAckEventType eventType = pxParser->xAck.eventType;
+
+    if (pxParser->bHasEventType)
+    {
+        /* Only these event types carry a fragment timecode, and only an error carries an error ID. */
+        if (eventType != eBuffering && eventType != eReceived && eventType != ePersisted && eventType != eError)
+        {
+            pxParser->xAck.uFragmentTimecode = 0;
+        }
+        if (eventType != eError)
+        {
+            pxParser->xAck.uErrorId = 0;
+        }
+        memcpy(pxAck, &(pxParser->xAck), sizeof(FragmentAckInfo_t));
+        bAckAvailable = true;
+    }
+
+    prvResetAck(pxParser);
+    pxParser->xJsonState = FRAGMENT_ACK_JSON_IDLE;
+
+    return bAckAvailable;
+}
+
+static int prvParseJsonChar(FragmentAckParser_t *pxParser, char c, bool *pbAckAvailable, FragmentAckInfo_t *pxAck)
+{
+    int res = KVS_ERRNO_NONE;
+
+    switch (pxParser->xJsonState)
+    {
+        case FRAGMENT_ACK_JSON_IDLE:
+            if (c == '{')
+            {
+                prvResetAck(pxParser);
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_KEY_START;
+            }
+            break;
+
+        case FRAGMENT_ACK_JSON_KEY_START:
+            if (c == '"')
+            {
+                pxParser->uKeyLen = 0;
+                pxParser->pcKey[0] = '\0';
+                pxParser->bEscaped = false;
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_KEY;
+            }
+            else if (c == '}')
+            {
+                *pbAckAvailable = prvCompleteAck(pxParser, pxAck);
+            }
+            else if (!prvIsJsonWhitespace(c))
+            {
+                res = KVS_ERROR_FAIL_TO_PARSE_FRAGMENT_ACK_MSG;
+            }
+            break;
+
+        case FRAGMENT_ACK_JSON_KEY:
+            if (pxParser->bEscaped)
+            {
+                pxParser->bEscaped = false;
+            }
+            else if (c == '\\')
+            {
+                pxParser->bEscaped = true;
+            }
+            else if (c == '"')
+            {
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_COLON;
+            }
+            else if (pxParser->uKeyLen < FRAGMENT_ACK_KEY_MAX_LEN)
+            {
+                pxParser->pcKey[pxParser->uKeyLen++] = c;
+                pxParser->pcKey[pxParser->uKeyLen] = '\0';
+            }
+            else
+            {
+                /* Mark the key as too long so it never matches. */
+                pxParser->uKeyLen = FRAGMENT_ACK_KEY_MAX_LEN + 1;
+            }
+            break;
+
+        case FRAGMENT_ACK_JSON_COLON:
+            if (c == ':')
+            {
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_VALUE_START;
+            }
+            else if (!prvIsJsonWhitespace(c))
+            {
+                res = KVS_ERROR_FAIL_TO_PARSE_FRAGMENT_ACK_MSG;
+            }
+            break;
+
+        case FRAGMENT_ACK_JSON_VALUE_START:
+            if (c == '"')
+            {
+                pxParser->uValueLen = 0;
+                pxParser->pcValue[0] = '\0';
+                pxParser->bEscaped = false;
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_STRING_VALUE;
+            }
+            else if ((c >= '0' && c <= '9') || c == '-')
+            {
+                pxParser->uNumber = (c == '-') ? 0 : (uint64_t)(c - '0');
+                pxParser->bNumberFraction = false;
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_NUMBER_VALUE;
+            }
+            else if (c == 't' || c == 'f' || c == 'n')
+            {
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_LITERAL_VALUE;
+            }
+            else if (c == '{' || c == '[')
+            {
+                pxParser->uNestedDepth = 1;
+                pxParser->bInNestedString = false;
+                pxParser->bEscaped = false;
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_NESTED_VALUE;
+            }
+            else if (!prvIsJsonWhitespace(c))
+            {
+                res = KVS_ERROR_FAIL_TO_PARSE_FRAGMENT_ACK_MSG;
+            }
+            break;
+
+        case FRAGMENT_ACK_JSON_STRING_VALUE:
+            if (pxParser->bEscaped)
+            {
+                pxParser->bEscaped = false;
+            }
+            else if (c == '\\')
+            {
+                pxParser->bEscaped = true;
+            }
+            else if (c == '"')
+            {
+                prvApplyStringValue(pxParser);
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_VALUE_END;
+            }
+            else if (pxParser->uValueLen < FRAGMENT_ACK_VALUE_MAX_LEN)
+            {
+                pxParser->pcValue[pxParser->uValueLen++] = c;
+                pxParser->pcValue[pxParser->uValueLen] = '\0';
+            }
+            else
+            {
+                /* Mark the value as too long so it never matches. */
+                pxParser->uValueLen = FRAGMENT_ACK_VALUE_MAX_LEN + 1;
+            }
+            break;
+
+        case FRAGMENT_ACK_JSON_NUMBER_VALUE:
+            if (c >= '0' && c <= '9')
+            {
+                if (!pxParser->bNumberFraction)
+                {
+                    pxParser->uNumber = pxParser->uNumber * 10 + (uint64_t)(c - '0');
+                }
+            }
+            else if (c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+            {
+                pxParser->bNumberFraction = true;
+            }
+            else
+            {
+                /* The number ends at the first character that is not part of it, and that character is the end of value. */
+                prvApplyNumberValue(pxParser);
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_VALUE_END;
+                res = prvParseJsonChar(pxParser, c, pbAckAvailable, pxAck);
+            }
+            break;
+
+        case FRAGMENT_ACK_JSON_LITERAL_VALUE:
+            if (!(c >= 'a' && c <= 'z'))
+            {
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_VALUE_END;
+                res = prvParseJsonChar(pxParser, c, pbAckAvailable, pxAck);
+            }
+            break;
+
+        case FRAGMENT_ACK_JSON_NESTED_VALUE:
+            if (pxParser->bInNestedString)
+            {
+                if (pxParser->bEscaped)
+                {
+                    pxParser->bEscaped = false;
+                }
+                else if (c == '\\')
+                {
+                    pxParser->bEscaped = true;
+                }
+                else if (c == '"')
+                {
+                    pxParser->bInNestedString = false;
+                }
+            }
+            else if (c == '"')
+            {
+                pxParser->bInNestedString = true;
+            }
+            else if (c == '{' || c == '[')
+            {
+                pxParser->uNestedDepth++;
+            }
+            else if (c == '}' || c == ']')
+            {
+                pxParser->uNestedDepth--;
+                if (pxParser->uNestedDepth == 0)
+                {
+                    pxParser->xJsonState = FRAGMENT_ACK_JSON_VALUE_END;
+                }
+            }
+            break;
+
+        case FRAGMENT_ACK_JSON_VALUE_END:
+            if (c == ',')
+            {
+                pxParser->xJsonState = FRAGMENT_ACK_JSON_KEY_START;
+            }
+            else if (c == '}')
+            {
+                *pbAckAvailable = prvCompleteAck(pxParser, pxAck);
+            }
+            else if (!prvIsJsonWhitespace(c))
+            {
+                res = KVS_ERROR_FAIL_TO_PARSE_FRAGMENT_ACK_MSG;
+            }
+            break;
+
+        case FRAGMENT_ACK_JSON_SKIP:
+        default:
+            break;
+    }
+
+    return res;
+}
+
+void FragmentAckParser_init(FragmentAckParser_t *pxParser)
+{
+    if (pxParser != NULL)
+    {
+        memset(pxParser, 0, sizeof(FragmentAckParser_t));
+        pxParser->xChunkState = FRAGMENT_ACK_CHUNK_SIZE;
+        pxParser->xJsonState = FRAGMENT_ACK_JSON_IDLE;
+    }
+}
+
+int FragmentAckParser_parse(FragmentAckParser_t *pxParser, const uint8_t *pBuf, size_t uLen, size_t *puConsumedLen, bool *pbAckAvailable, FragmentAckInfo_t *pxAck)
+{
+    int res = KVS_ERRNO_NONE;
+    size_t uIdx = 0;
+    char c = 0;
+    int hex = 0;
+
+    if (pxParser == NULL || pBuf == NULL || puConsumedLen == NULL || pbAckAvailable == NULL || pxAck == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else
+    {
+        *pbAckAvailable = false;
+
+        while (uIdx < uLen && res == KVS_ERRNO_NONE && !(*pbAckAvailable))
+        {
+            c = (char)pBuf[uIdx++];
+
+            switch (pxParser->xChunkState)
+            {
+                case FRAGMENT_ACK_CHUNK_SIZE:
+                    if ((hex = prvHexValue(c)) >= 0)
+                    {
+                        if (pxParser->uChunkSizeDigits >= CHUNK_SIZE_MAX_DIGITS)
+                        {
+                            res = KVS_ERROR_FAIL_TO_PARSE_FRAGMENT_ACK_LENGTH;
+                        }
+                        else
+                        {
+                            pxParser->uChunkRemaining = pxParser->uChunkRemaining * 16 + (size_t)hex;
+                            pxParser->uChunkSizeDigits++;
+                        }
+                    }
+                    else if (c == '\n')
+                    {
+                        /* An empty line, like the one after the last chunk, has no digits and is skipped. */
+                        pxParser->uChunkSizeDigits = 0;
+                        pxParser->xChunkState = (pxParser->uChunkRemaining > 0) ? FRAGMENT_ACK_CHUNK_DATA : FRAGMENT_ACK_CHUNK_SIZE;
+                    }
+                    else if (c == ';' || c == '\r' || c == ' ' || c == '\t')
+                    {
+                        pxParser->xChunkState = FRAGMENT_ACK_CHUNK_EXT;
+                    }
+                    else
+                    {
+                        res = KVS_ERROR_FAIL_TO_PARSE_FRAGMENT_ACK_LENGTH;
+                    }
+
+                    if (res != KVS_ERRNO_NONE)
+                    {
+                        /* Skip the rest of the line and look for the next chunk size. */
+                        pxParser->uChunkRemaining = 0;
+                        pxParser->xChunkState = FRAGMENT_ACK_CHUNK_EXT;
+                    }
+                    break;
+
+                case FRAGMENT_ACK_CHUNK_EXT:
+                    if (c == '\n')
+                    {
+                        pxParser->uChunkSizeDigits = 0;
+                        pxParser->xChunkState = (pxParser->uChunkRemaining > 0) ? FRAGMENT_ACK_CHUNK_DATA : FRAGMENT_ACK_CHUNK_SIZE;
+                    }
+                    break;
+
+                case FRAGMENT_ACK_CHUNK_DATA:
+                    if ((res = prvParseJsonChar(pxParser, c, pbAckAvailable, pxAck)) != KVS_ERRNO_NONE)
+                    {
+                        /* Skip the rest of this chunk and resume with the next one. */
+                        prvResetAck(pxParser);
+                        pxParser->xJsonState = FRAGMENT_ACK_JSON_SKIP;
+                    }
+
+                    pxParser->uChunkRemaining--;
+                    if (pxParser->uChunkRemaining == 0)
+                    {
+                        if (pxParser->xJsonState == FRAGMENT_ACK_JSON_SKIP)
+                        {
+                            pxParser->xJsonState = FRAGMENT_ACK_JSON_IDLE;
+                        }
+                        pxParser->xChunkState = FRAGMENT_ACK_CHUNK_DATA_END;
+                    }
+                    break;
+
+                case FRAGMENT_ACK_CHUNK_DATA_END:
+                default:
+                    if (c == '\n')
+                    {
+                        pxParser->xChunkState = FRAGMENT_ACK_CHUNK_SIZE;
+                    }
+                    break;
+            }
+        }
+
+        *puConsumedLen = uIdx;
+    }
+
+    return res;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#ifndef FRAGMENT_ACK_PARSER_H
+#define FRAGMENT_ACK_PARSER_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "kvs/restapi.h"
+
+/* The longest JSON key that is kept for matching. Longer keys are ignored. */
+#define FRAGMENT_ACK_KEY_MAX_LEN (31)
+
+/* The longest JSON string value that is kept for matching. Longer values are ignored. */
+#define FRAGMENT_ACK_VALUE_MAX_LEN (15)
+
+typedef enum
+{
+    FRAGMENT_ACK_CHUNK_SIZE = 0,
+    FRAGMENT_ACK_CHUNK_EXT,
+    FRAGMENT_ACK_CHUNK_DATA,
+    FRAGMENT_ACK_CHUNK_DATA_END
+} FragmentAckChunkState_t;
+
+typedef enum
+{
+    FRAGMENT_ACK_JSON_IDLE = 0,
+    FRAGMENT_ACK_JSON_KEY_START,
+    FRAGMENT_ACK_JSON_KEY,
+    FRAGMENT_ACK_JSON_COLON,
+    FRAGMENT_ACK_JSON_VALUE_START,
+    FRAGMENT_ACK_JSON_STRING_VALUE,
+    FRAGMENT_ACK_JSON_NUMBER_VALUE,
+    FRAGMENT_ACK_JSON_LITERAL_VALUE,
+    FRAGMENT_ACK_JSON_NESTED_VALUE,
+    FRAGMENT_ACK_JSON_VALUE_END,
+    FRAGMENT_ACK_JSON_SKIP
+} FragmentAckJsonState_t;
+
+typedef struct
+{
+    ePutMediaFragmentAckEventType eventType;
+    uint64_t uFragmentTimecode;
+    unsigned int uErrorId;
+} FragmentAckInfo_t;
+
+/**
+ * The fragment ACK parser state. It's a plain struct so it can be embedded in its owner and parse without any memory
+ * allocation. All partial states, including a chunk size, a JSON key or a JSON value that is split by the boundary of
+ * a receive buffer, are carried over to the next call.
+ */
+typedef struct FragmentAckParser
+{
+    /* HTTP chunked transfer encoding states */
+    FragmentAckChunkState_t xChunkState;
+    size_t uChunkRemaining;
+    size_t uChunkSizeDigits;
+
+    /* JSON scanning states */
+    FragmentAckJsonState_t xJsonState;
+    bool bEscaped;
+    bool bInNestedString;
+    size_t uNestedDepth;
+    char pcKey[FRAGMENT_ACK_KEY_MAX_LEN + 1];
+    size_t uKeyLen;
+    char pcValue[FRAGMENT_ACK_VALUE_MAX_LEN + 1];
+    size_t uValueLen;
+    uint64_t uNumber;
+    bool bNumberFraction;
+
+    /* The fragment ACK that is being parsed */
+    bool bHasEventType;
+    FragmentAckInfo_t xAck;
+} FragmentAckParser_t;
+
+/**
+ * @brief Initialize a fragment ACK parser
+ *
+ * @param[in] pxParser The fragment ACK parser
+ */
+void FragmentAckParser_init(FragmentAckParser_t *pxParser);
+
+/**
+ * @brief Parse fragment ACKs from the HTTP chunked body of PUT MEDIA
+ *
+ * It parses at most one fragment ACK per call. If a fragment ACK is complete, it stops right after it and reports the
+ * consumed length, so the caller can handle the ACK and call again with the rest of the buffer. If the buffer ends in
+ * the middle of a fragment ACK, all of the buffer is consumed and the parsing continues with the next buffer.
+ *
+ * Malformed data is skipped to the next chunk, and an error is returned with the consumed length so the caller can
+ * continue with the rest of the buffer.
+ *
+ * @param[in] pxParser The fragment ACK parser
+ * @param[in] pBuf The received data
+ * @param[in] uLen The length of the received data
+ * @param[out] puConsumedLen The length of data that has been parsed
+ * @param[out] pbAckAvailable true if a fragment ACK is complete, false otherwise
+ * @param[out] pxAck The fragment ACK if it is complete
+ * @return 0 on success, non-zero value otherwise
+ */
+int FragmentAckParser_parse(FragmentAckParser_t *pxParser, const uint8_t *pBuf, size_t uLen, size_t *puConsumedLen, bool *pbAckAvailable, FragmentAckInfo_t *pxAck);
+
+#endif /* FRAGMENT_ACK_PARSER_H */
@@ -13,12 +13,10 @@
  * permissions and limitations under the License.
  */
 
-#include <ctype.h>
 #include <inttypes.h>
 #include <stddef.h>
 
 /* Thirdparty headers */
-#include "azure_c_shared_utility/buffer_.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/lock.h"
@@ -35,7 +33,9 @@
 
 /* Internal headers */
 #include "os/allocator.h"
+#include "os/slab.h"
 #include "restful/aws_signer_v4.h"
+#include "restful/kvs/fragment_ack_parser.h"
 #include "misc/json_helper.h"
 #include "net/http_helper.h"
 #include "net/netio.h"
@@ -51,8 +51,14 @@
 
 #define DEFAULT_RECV_BUFSIZE (1024)
 
+/* Pending fragment ACKs are flushed whenever new ones arrive, so a few records cover one receive buffer. */
+#define FRAGMENT_ACK_SLAB_COUNT (16)
+
 #define PORT_HTTPS "443"
 
+/* The longest host name that can be followed by a port */
+#define HOST_NAME_MAX_LEN (255)
+
 /*-----------------------------------------------------------*/
 
 #define KVS_URI_CREATE_STREAM "/createStream"
@@ -85,17 +91,12 @@ typedef struct PutMedia
 
     NetIoHandle xNetIoHandle;
     DLIST_ENTRY xPendingFragmentAcks;
-} PutMedia_t;
-
-#define JSON_KEY_EVENT_TYPE "EventType"
-#define JSON_KEY_FRAGMENT_TIMECODE "FragmentTimecode"
-#define JSON_KEY_ERROR_ID "ErrorId"
+    SlabHandle xFragmentAckSlab;
 
-#define EVENT_TYPE_BUFFERING "\"BUFFERING\""
-#define EVENT_TYPE_RECEIVED "\"RECEIVED\""
-#define EVENT_TYPE_PERSISTED "\"PERSISTED\""
-#define EVENT_TYPE_ERROR "\"ERROR\""
-#define EVENT_TYPE_IDLE "\"IDLE\""
+    /* Fragment ACKs are parsed as they arrive, and a fragment ACK split across receive calls is carried over. */
+    FragmentAckParser_t xFragmentAckParser;
+    uint8_t pRecvBuf[DEFAULT_RECV_BUFSIZE];
+} PutMedia_t;
 
 /*-----------------------------------------------------------*/
 
@@ -341,177 +342,6 @@ static int prvGetEpochTimestampInStr(uint64_t uProducerStartTimestampMs, STRING_
     return res;
 }
 
-static int prvParseFragmentAckLength(char *pcSrc, size_t uLen, size_t *puMsgLen, size_t *puBytesRead)
-{
-    int res = KVS_ERRNO_NONE;
-    size_t uMsgLen = 0;
-    size_t uBytesRead = 0;
-    size_t i = 0;
-    char c = 0;
-
-    if (pcSrc == NULL || uLen == 0 || puMsgLen == NULL || puBytesRead == NULL)
-    {
-        res = KVS_ERROR_INVALID_ARGUMENT;
-    }
-    else
-    {
-        for (i = 0; i < uLen - 1; i++)
-        {
-            c = toupper(pcSrc[i]);
-            if (isxdigit(c))
-            {
-                if (c >= '0' && c <= '9')
-                {
-                    uMsgLen = uMsgLen * 16 + (c - '0');
-                }
-                else
-                {
-                    uMsgLen = uMsgLen * 16 + (c - 'A') + 10;
-                }
-            }
-            else if (c == '\r')
-            {
-                if (pcSrc[i + 1] == '\n')
-                {
-                    uBytesRead = i + 2;
-                    break;
-                }
-            }
-            else
-            {
-                res = KVS_ERROR_FAIL_TO_PARSE_FRAGMENT_ACK_LENGTH;
-            }
-        }
-    }
-
-    if (res == KVS_ERRNO_NONE)
-    {
-        if (uBytesRead < 3 || (uBytesRead + uMsgLen + 2) > uLen || pcSrc[uBytesRead + uMsgLen] != '\r' || pcSrc[uBytesRead + uMsgLen + 1] != '\n')
-        {
-            res = KVS_ERROR_FAIL_TO_PARSE_FRAGMENT_ACK_LENGTH;
-        }
-        else
-        {
-            *puMsgLen = uMsgLen;
-            *puBytesRead = uBytesRead;
-        }
-    }
-
-    return res;
-}
-
-static ePutMediaFragmentAckEventType prvGetEventType(char *pcEventType)
-{
-    ePutMediaFragmentAckEventType ev = eUnknown;
-
-    if (pcEventType != NULL)
-    {
-        if (strncmp(pcEventType, EVENT_TYPE_BUFFERING, sizeof(EVENT_TYPE_BUFFERING) - 1) == 0)
-        {
-            ev = eBuffering;
-        }
-        else if (strncmp(pcEventType, EVENT_TYPE_RECEIVED, sizeof(EVENT_TYPE_RECEIVED) - 1) == 0)
-        {
-            ev = eReceived;
-        }
-        else if (strncmp(pcEventType, EVENT_TYPE_PERSISTED, sizeof(EVENT_TYPE_PERSISTED) - 1) == 0)
-        {
-            ev = ePersisted;
-        }
-        else if (strncmp(pcEventType, EVENT_TYPE_ERROR, sizeof(EVENT_TYPE_ERROR) - 1) == 0)
-        {
-            ev = eError;
-        }
-        else if (strncmp(pcEventType, EVENT_TYPE_IDLE, sizeof(EVENT_TYPE_IDLE) - 1) == 0)
-        {
-            ev = eIdle;
-        }
-    }
-
-    return ev;
-}
-
-static int parseFragmentMsg(const char *pcFragmentMsg, FragmentAck_t *pxFragmentAck)
-{
-    int res = KVS_ERRNO_NONE;
-    JSON_Value *pxRootValue = NULL;
-    JSON_Object *pxRootObject = NULL;
-    char *pcEventType = NULL;
-
-    json_set_escape_slashes(0);
-
-    if (pcFragmentMsg == NULL || pxFragmentAck == NULL)
-    {
-        res = KVS_ERROR_INVALID_ARGUMENT;
-        LogError("Invalid argument");
-    }
-    else if ((pxRootValue = json_parse_string(pcFragmentMsg)) == NULL || (pxRootObject = json_value_get_object(pxRootValue)) == NULL)
-    {
-        res = KVS_ERROR_FAIL_TO_PARSE_FRAGMENT_ACK_MSG;
-        LogInfo("Failed to parse fragment msg:%s", pcFragmentMsg);
-    }
-    else if ((pcEventType = json_object_dotget_serialize_to_string(pxRootObject, JSON_KEY_EVENT_TYPE, false)) == NULL)
-    {
-        res = KVS_ERROR_UNKNOWN_FRAGMENT_ACK_TYPE;
-        LogInfo("Unknown fragment ack:%s", pcFragmentMsg);
-    }
-    else
-    {
-        pxFragmentAck->eventType = prvGetEventType(pcEventType);
-        kvsFree(pcEventType);
-
-        if (pxFragmentAck->eventType == eBuffering || pxFragmentAck->eventType == eReceived || pxFragmentAck->eventType == ePersisted ||
-            pxFragmentAck->eventType == eError)
-        {
-            pxFragmentAck->uFragmentTimecode = json_object_dotget_uint64(pxRootObject, JSON_KEY_FRAGMENT_TIMECODE, 10);
-            if (pxFragmentAck->eventType == eError)
-            {
-                pxFragmentAck->uErrorId = (unsigned int)json_object_dotget_uint64(pxRootObject, JSON_KEY_ERROR_ID, 10);
-            }
-        }
-    }
-
-    if (pxRootValue != NULL)
-    {
-        json_value_free(pxRootValue);
-    }
-
-    return res;
-}
-
-static int prvParseFragmentAck(char *pcSrc, size_t uLen, FragmentAck_t *pxFragAck, size_t *puFragAckLen)
-{
-    int res = KVS_ERRNO_NONE;
-    size_t uMsgLen = 0;
-    size_t uBytesRead = 0;
-    STRING_HANDLE xStFragMsg = NULL;
-
-    if (pcSrc == NULL || uLen == 0 || pxFragAck == NULL || puFragAckLen == NULL)
-    {
-        res = KVS_ERROR_INVALID_ARGUMENT;
-        LogError("Invalid argument");
-    }
-    else if ((res = prvParseFragmentAckLength(pcSrc, uLen, &uMsgLen, &uBytesRead)) != KVS_ERRNO_NONE)
-    {
-        LogInfo("Unknown fragment ack:%.*s", (int)uLen, pcSrc);
-        /* Propagate the res error */
-    }
-    else if ((xStFragMsg = STRING_construct_n(pcSrc + uBytesRead, uMsgLen)) == NULL ||
-             parseFragmentMsg(STRING_c_str(xStFragMsg), pxFragAck) != KVS_ERRNO_NONE)
-    {
-        res = KVS_ERROR_FAIL_TO_PARSE_FRAGMENT_ACK_MSG;
-        LogInfo("Failed to parse fragment ack");
-    }
-    else
-    {
-        *puFragAckLen = uBytesRead + uMsgLen + 2;
-    }
-
-    STRING_delete(xStFragMsg);
-
-    return res;
-}
-
 static void prvLogFragmentAck(FragmentAck_t *pFragmentAck)
 {
     if (pFragmentAck != NULL)
@@ -574,7 +404,7 @@ static int prvPushFragmentAck(PutMedia_t *pPutMedia, FragmentAck_t *pFragmentAck
     {
         res = KVS_ERROR_INVALID_ARGUMENT;
     }
-    else if ((pFragmentAck = (FragmentAck_t *)kvsMalloc(sizeof(FragmentAck_t))) == NULL)
+    else if ((pFragmentAck = (FragmentAck_t *)Slab_alloc(pPutMedia->xFragmentAckSlab)) == NULL)
     {
         res = KVS_ERROR_OUT_OF_MEMORY;
     }
@@ -599,13 +429,47 @@ static int prvPushFragmentAck(PutMedia_t *pPutMedia, FragmentAck_t *pFragmentAck
     {
         if (pFragmentAck != NULL)
         {
-            kvsFree(pFragmentAck);
+            Slab_free(pPutMedia->xFragmentAckSlab, pFragmentAck);
         }
     }
 
     return res;
 }
 
+/**
+ * Connect to a host. The host can be followed by a port like "localhost:8443", otherwise the HTTPS port is used.
+ */
+static int prvConnect(NetIoHandle xNetIoHandle, const char *pcHost)
+{
+    int res = KVS_ERRNO_NONE;
+    const char *pcPortSeparator = NULL;
+    size_t uHostNameLen = 0;
+    char pcHostName[HOST_NAME_MAX_LEN + 1];
+
+    if (pcHost == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else if ((pcPortSeparator = strrchr(pcHost, ':')) == NULL)
+    {
+        res = NetIo_connect(xNetIoHandle, pcHost, PORT_HTTPS);
+    }
+    else if ((uHostNameLen = (size_t)(pcPortSeparator - pcHost)) > HOST_NAME_MAX_LEN || pcPortSeparator[1] == '\0')
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid host:%s", pcHost);
+    }
+    else
+    {
+        memcpy(pcHostName, pcHost, uHostNameLen);
+        pcHostName[uHostNameLen] = '\0';
+        res = NetIo_connect(xNetIoHandle, pcHostName, pcPortSeparator + 1);
+    }
+
+    return res;
+}
+
 static PutMedia_t *prvCreateDefaultPutMediaHandle()
 {
     int res = KVS_ERRNO_NONE;
@@ -625,9 +489,15 @@ static PutMedia_t *prvCreateDefaultPutMediaHandle()
             res = KVS_ERROR_LOCK_ERROR;
             LogError("Failed to initialize lock");
         }
+        else if ((pPutMedia->xFragmentAckSlab = Slab_create(sizeof(FragmentAck_t), FRAGMENT_ACK_SLAB_COUNT)) == NULL)
+        {
+            res = KVS_ERROR_OUT_OF_MEMORY;
+            LogError("OOM: xFragmentAckSlab");
+        }
         else
         {
             DList_InitializeListHead(&(pPutMedia->xPendingFragmentAcks));
+            FragmentAckParser_init(&(pPutMedia->xFragmentAckParser));
         }
     }
 
@@ -639,6 +509,7 @@ static PutMedia_t *prvCreateDefaultPutMediaHandle()
             {
                 Lock_Deinit(pPutMedia->xLock);
             }
+            Slab_terminate(pPutMedia->xFragmentAckSlab);
             kvsFree(pPutMedia);
             pPutMedia = NULL;
         }
@@ -673,7 +544,7 @@ static void prvFlushFragmentAck(PutMedia_t *pPutMedia)
     FragmentAck_t *pFragmentAck = NULL;
     while ((pFragmentAck = prvReadFragmentAck(pPutMedia)) != NULL)
     {
-        kvsFree(pFragmentAck);
+        Slab_free(pPutMedia->xFragmentAckSlab, pFragmentAck);
     }
 }
 
@@ -737,7 +608,7 @@ int Kvs_describeStream(KvsServiceParameter_t *pServPara, KvsDescribeStreamParame
         res = KVS_ERROR_FAIL_TO_SIGN_HTTP_REQ;
         LogError("Failed to sign");
     }
-    else if ((xNetIoHandle = NetIo_create()) == NULL)
+    else if ((xNetIoHandle = NetIo_createWithTlsContext(pServPara->xTlsContext)) == NULL)
     {
         res = KVS_ERROR_FAIL_TO_CREATE_NETIO_HANDLE;
         LogError("Failed to create NetIo handle");
@@ -745,7 +616,7 @@ int Kvs_describeStream(KvsServiceParameter_t *pServPara, KvsDescribeStreamParame
     else if (
         (res = NetIo_setRecvTimeout(xNetIoHandle, pServPara->uRecvTimeoutMs)) != KVS_ERRNO_NONE ||
         (res = NetIo_setSendTimeout(xNetIoHandle, pServPara->uSendTimeoutMs)) != KVS_ERRNO_NONE ||
-        (res = NetIo_connect(xNetIoHandle, pServPara->pcHost, PORT_HTTPS)) != KVS_ERRNO_NONE)
+        (res = prvConnect(xNetIoHandle, pServPara->pcHost)) != KVS_ERRNO_NONE)
     {
         LogError("Failed to connect to %s", pServPara->pcHost);
         /* Propagate the res error */
@@ -845,7 +716,7 @@ int Kvs_createStream(KvsServiceParameter_t *pServPara, KvsCreateStreamParameter_
         LogError("Failed to sign");
         res = KVS_ERROR_FAIL_TO_SIGN_HTTP_REQ;
     }
-    else if ((xNetIoHandle = NetIo_create()) == NULL)
+    else if ((xNetIoHandle = NetIo_createWithTlsContext(pServPara->xTlsContext)) == NULL)
     {
         res = KVS_ERROR_FAIL_TO_CREATE_NETIO_HANDLE;
         LogError("Failed to create NetIo handle");
@@ -853,7 +724,7 @@ int Kvs_createStream(KvsServiceParameter_t *pServPara, KvsCreateStreamParameter_
     else if (
         (res = NetIo_setRecvTimeout(xNetIoHandle, pServPara->uRecvTimeoutMs)) != KVS_ERRNO_NONE ||
         (res = NetIo_setSendTimeout(xNetIoHandle, pServPara->uSendTimeoutMs)) != KVS_ERRNO_NONE ||
-        (res = NetIo_connect(xNetIoHandle, pServPara->pcHost, PORT_HTTPS)) != KVS_ERRNO_NONE)
+        (res = prvConnect(xNetIoHandle, pServPara->pcHost)) != KVS_ERRNO_NONE)
     {
         LogError("Failed to connect to %s", pServPara->pcHost);
         /* Propagate the res error */
@@ -953,7 +824,7 @@ int Kvs_getDataEndpoint(KvsServiceParameter_t *pServPara, KvsGetDataEndpointPara
         res = KVS_ERROR_FAIL_TO_SIGN_HTTP_REQ;
         LogError("Failed to sign");
     }
-    else if ((xNetIoHandle = NetIo_create()) == NULL)
+    else if ((xNetIoHandle = NetIo_createWithTlsContext(pServPara->xTlsContext)) == NULL)
     {
         res = KVS_ERROR_FAIL_TO_CREATE_NETIO_HANDLE;
         LogError("Failed to create NetIo handle");
@@ -961,7 +832,7 @@ int Kvs_getDataEndpoint(KvsServiceParameter_t *pServPara, KvsGetDataEndpointPara
     else if (
         (res = NetIo_setRecvTimeout(xNetIoHandle, pServPara->uRecvTimeoutMs)) != KVS_ERRNO_NONE ||
         (res = NetIo_setSendTimeout(xNetIoHandle, pServPara->uSendTimeoutMs)) != KVS_ERRNO_NONE ||
-        (res = NetIo_connect(xNetIoHandle, pServPara->pcHost, PORT_HTTPS)) != KVS_ERRNO_NONE)
+        (res = prvConnect(xNetIoHandle, pServPara->pcHost)) != KVS_ERRNO_NONE)
     {
         LogError("Failed to connect to %s", pServPara->pcHost);
         /* Propagate the res error */
@@ -1080,7 +951,7 @@ int Kvs_putMediaStart(KvsServiceParameter_t *pServPara, KvsPutMediaParameter_t *
         res = KVS_ERROR_FAIL_TO_SIGN_HTTP_REQ;
         LogError("Failed to sign");
     }
-    else if ((xNetIoHandle = NetIo_create()) == NULL)
+    else if ((xNetIoHandle = NetIo_createWithTlsContext(pServPara->xTlsContext)) == NULL)
     {
         res = KVS_ERROR_FAIL_TO_CREATE_NETIO_HANDLE;
         LogError("Failed to create NetIo handle");
@@ -1088,7 +959,7 @@ int Kvs_putMediaStart(KvsServiceParameter_t *pServPara, KvsPutMediaParameter_t *
     else if (
         (res = NetIo_setRecvTimeout(xNetIoHandle, pServPara->uRecvTimeoutMs)) != KVS_ERRNO_NONE ||
         (res = NetIo_setSendTimeout(xNetIoHandle, pServPara->uSendTimeoutMs)) != KVS_ERRNO_NONE ||
-        (res = NetIo_connect(xNetIoHandle, pServPara->pcPutMediaEndpoint, PORT_HTTPS)) != KVS_ERRNO_NONE)
+        (res = prvConnect(xNetIoHandle, pServPara->pcPutMediaEndpoint)) != KVS_ERRNO_NONE)
     {
         LogError("Failed to connect to %s", pServPara->pcPutMediaEndpoint);
         /* Propagate the res error */
@@ -1098,7 +969,7 @@ int Kvs_putMediaStart(KvsServiceParameter_t *pServPara, KvsPutMediaParameter_t *
         LogError("Failed send http request to %s", pServPara->pcHost);
         /* Propagate the res error */
     }
-    else if ((res = Http_recvHttpRsp(xNetIoHandle, &uHttpStatusCode, &pRspBody, &uRspBodyLen)) != KVS_ERRNO_NONE)
+    else if ((res = Http_recvHttpRspEx(xNetIoHandle, DEFAULT_HTTP_RSP_TIMEOUT_MS, true, &uHttpStatusCode, &pRspBody, &uRspBodyLen)) != KVS_ERRNO_NONE)
     {
         LogError("Failed recv http response from %s", pServPara->pcHost);
         /* Propagate the res error */
@@ -1148,13 +1019,50 @@ int Kvs_putMediaStart(KvsServiceParameter_t *pServPara, KvsPutMediaParameter_t *
     return res;
 }
 
-int Kvs_putMediaUpdate(PutMediaHandle xPutMediaHandle, uint8_t *pMkvHeader, size_t uMkvHeaderLen, uint8_t *pData, size_t uDataLen)
+static int prvPutMediaUpdate(PutMedia_t *pPutMedia, uint8_t *pMkvHeader, size_t uMkvHeaderLen, uint8_t *pData, size_t uDataLen, bool bFlush)
 {
     int res = KVS_ERRNO_NONE;
-    PutMedia_t *pPutMedia = xPutMediaHandle;
     int xChunkedHeaderLen = 0;
     char pcChunkedHeader[sizeof(size_t) * 2 + 3];
     const char *pcChunkedEnd = "\r\n";
+    NetIoBuffer_t pxBuffers[4];
+
+    xChunkedHeaderLen = snprintf(pcChunkedHeader, sizeof(pcChunkedHeader), "%lx\r\n", (unsigned long)(uMkvHeaderLen + uDataLen));
+    if (xChunkedHeaderLen <= 0)
+    {
+        res = KVS_ERROR_C_UTIL_STRING_ERROR;
+        LogError("Failed to init chunk size");
+    }
+    else
+    {
+        pxBuffers[0].pBuffer = (const unsigned char *)pcChunkedHeader;
+        pxBuffers[0].uLen = (size_t)xChunkedHeaderLen;
+        pxBuffers[1].pBuffer = pMkvHeader;
+        pxBuffers[1].uLen = uMkvHeaderLen;
+        pxBuffers[2].pBuffer = pData;
+        pxBuffers[2].uLen = uDataLen;
+        pxBuffers[3].pBuffer = (const unsigned char *)pcChunkedEnd;
+        pxBuffers[3].uLen = strlen(pcChunkedEnd);
+
+        if ((res = NetIo_sendv(pPutMedia->xNetIoHandle, pxBuffers, sizeof(pxBuffers) / sizeof(pxBuffers[0]), bFlush)) != KVS_ERRNO_NONE)
+        {
+            LogError("Failed to send data frame");
+            /* Propagate the res error */
+        }
+    }
+
+    return res;
+}
+
+int Kvs_putMediaUpdate(PutMediaHandle xPutMediaHandle, uint8_t *pMkvHeader, size_t uMkvHeaderLen, uint8_t *pData, size_t uDataLen)
+{
+    return Kvs_putMediaUpdateEx(xPutMediaHandle, pMkvHeader, uMkvHeaderLen, pData, uDataLen, true);
+}
+
+int Kvs_putMediaUpdateEx(PutMediaHandle xPutMediaHandle, uint8_t *pMkvHeader, size_t uMkvHeaderLen, uint8_t *pData, size_t uDataLen, bool bFlush)
+{
+    int res = KVS_ERRNO_NONE;
+    PutMedia_t *pPutMedia = xPutMediaHandle;
 
     if (pData == NULL)
     {
@@ -1168,27 +1076,7 @@ int Kvs_putMediaUpdate(PutMediaHandle xPutMediaHandle, uint8_t *pMkvHeader, size
     }
     else
     {
-        xChunkedHeaderLen = snprintf(pcChunkedHeader, sizeof(pcChunkedHeader), "%lx\r\n", (unsigned long)(uMkvHeaderLen + uDataLen));
-        if (xChunkedHeaderLen <= 0)
-        {
-            res = KVS_ERROR_C_UTIL_STRING_ERROR;
-            LogError("Failed to init chunk size");
-        }
-        else
-        {
-            if ((res = NetIo_send(pPutMedia->xNetIoHandle, (const unsigned char *)pcChunkedHeader, (size_t)xChunkedHeaderLen)) != KVS_ERRNO_NONE ||
-                (res = NetIo_send(pPutMedia->xNetIoHandle, pMkvHeader, uMkvHeaderLen)) != KVS_ERRNO_NONE ||
-                (pData != NULL && uDataLen > 0 && (res = NetIo_send(pPutMedia->xNetIoHandle, pData, uDataLen)) != KVS_ERRNO_NONE) ||
-                (res = NetIo_send(pPutMedia->xNetIoHandle, (const unsigned char *)pcChunkedEnd, strlen(pcChunkedEnd))) != KVS_ERRNO_NONE)
-            {
-                LogError("Failed to send data frame");
-                /* Propagate the res error */
-            }
-            else
-            {
-                /* nop */
-            }
-        }
+        res = prvPutMediaUpdate(pPutMedia, pMkvHeader, uMkvHeaderLen, pData, uDataLen, bFlush);
     }
 
     return res;
@@ -1198,9 +1086,6 @@ int Kvs_putMediaUpdateRaw(PutMediaHandle xPutMediaHandle, uint8_t *pBuf, size_t
 {
     int res = KVS_ERRNO_NONE;
     PutMedia_t *pPutMedia = xPutMediaHandle;
-    int xChunkedHeaderLen = 0;
-    char pcChunkedHeader[sizeof(size_t) * 2 + 3];
-    const char *pcChunkedEnd = "\r\n";
 
     if (pPutMedia == NULL || pBuf == NULL || uLen == 0)
     {
@@ -1209,24 +1094,65 @@ int Kvs_putMediaUpdateRaw(PutMediaHandle xPutMediaHandle, uint8_t *pBuf, size_t
     }
     else
     {
-        xChunkedHeaderLen = snprintf(pcChunkedHeader, sizeof(pcChunkedHeader), "%lx\r\n", (unsigned long)uLen);
-        if (xChunkedHeaderLen <= 0)
+        res = prvPutMediaUpdate(pPutMedia, pBuf, uLen, NULL, 0, true);
+    }
+
+    return res;
+}
+
+int Kvs_putMediaFlush(PutMediaHandle xPutMediaHandle)
+{
+    int res = KVS_ERRNO_NONE;
+    PutMedia_t *pPutMedia = xPutMediaHandle;
+
+    if (pPutMedia == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else if ((res = NetIo_flush(pPutMedia->xNetIoHandle)) != KVS_ERRNO_NONE)
+    {
+        LogError("Failed to flush data frames");
+        /* Propagate the res error */
+    }
+    else
+    {
+        /* nop */
+    }
+
+    return res;
+}
+
+static int prvParseFragmentAcks(PutMedia_t *pPutMedia, const uint8_t *pBuf, size_t uLen)
+{
+    int res = KVS_ERRNO_NONE;
+    size_t uConsumedLen = 0;
+    bool bAckAvailable = false;
+    FragmentAckInfo_t xAckInfo = {0};
+    FragmentAck_t xFragmentAck = {0};
+
+    while (uLen > 0)
+    {
+        if (FragmentAckParser_parse(&(pPutMedia->xFragmentAckParser), pBuf, uLen, &uConsumedLen, &bAckAvailable, &xAckInfo) != KVS_ERRNO_NONE)
         {
-            res = KVS_ERROR_C_UTIL_STRING_ERROR;
-            LogError("Failed to init chunk size");
+            LogInfo("Failed to parse fragment ack");
         }
-        else
+        pBuf += uConsumedLen;
+        uLen -= uConsumedLen;
+
+        if (bAckAvailable)
         {
-            if ((res = NetIo_send(pPutMedia->xNetIoHandle, (const unsigned char *)pcChunkedHeader, (size_t)xChunkedHeaderLen)) != KVS_ERRNO_NONE ||
-                (res = NetIo_send(pPutMedia->xNetIoHandle, pBuf, uLen)) != KVS_ERRNO_NONE ||
-                (res = NetIo_send(pPutMedia->xNetIoHandle, (const unsigned char *)pcChunkedEnd, strlen(pcChunkedEnd))) != KVS_ERRNO_NONE)
-            {
-                LogError("Failed to send data frame");
-                /* Propagate the res error */
-            }
-            else
+            memset(&xFragmentAck, 0, sizeof(FragmentAck_t));
+            xFragmentAck.eventType = xAckInfo.eventType;
+            xFragmentAck.uFragmentTimecode = xAckInfo.uFragmentTimecode;
+            xFragmentAck.uErrorId = xAckInfo.uErrorId;
+
+            prvLogFragmentAck(&xFragmentAck);
+            prvPushFragmentAck(pPutMedia, &xFragmentAck);
+            if (xFragmentAck.eventType == eError)
             {
-                /* nop */
+                res = KVS_GENERATE_PUTMEDIA_ERROR(xFragmentAck.uErrorId);
+                break;
             }
         }
     }
@@ -1238,11 +1164,7 @@ int Kvs_putMediaDoWork(PutMediaHandle xPutMediaHandle)
 {
     int res = KVS_ERRNO_NONE;
     PutMedia_t *pPutMedia = xPutMediaHandle;
-    BUFFER_HANDLE xBufRecv = NULL;
-    size_t uBytesTotalReceived = 0;
     size_t uBytesReceived = 0;
-    FragmentAck_t xFragmentAck = {0};
-    size_t uFragAckLen = 0;
 
     if (pPutMedia == NULL)
     {
@@ -1253,63 +1175,47 @@ int Kvs_putMediaDoWork(PutMediaHandle xPutMediaHandle)
     {
         if (NetIo_isDataAvailable(pPutMedia->xNetIoHandle))
         {
-            if ((xBufRecv = BUFFER_create_with_size(DEFAULT_RECV_BUFSIZE)) == NULL)
+            prvFlushFragmentAck(pPutMedia);
+            while (NetIo_isDataAvailable(pPutMedia->xNetIoHandle))
             {
-                res = KVS_ERROR_C_UTIL_UNABLE_TO_CREATE_BUFFER;
-                LogError("OOM: xBufRecv");
-            }
-            else
-            {
-                prvFlushFragmentAck(pPutMedia);
-                while (NetIo_isDataAvailable(pPutMedia->xNetIoHandle))
+                if ((res = NetIo_recv(pPutMedia->xNetIoHandle, pPutMedia->pRecvBuf, sizeof(pPutMedia->pRecvBuf), &uBytesReceived)) != KVS_ERRNO_NONE)
                 {
-                    if (BUFFER_length(xBufRecv) == uBytesTotalReceived && BUFFER_enlarge(xBufRecv, BUFFER_length(xBufRecv) * 2) != 0)
-                    {
-                        res = KVS_ERROR_C_UTIL_UNABLE_TO_ENLARGE_BUFFER;
-                        LogError("OOM: xBufRecv");
-                        break;
-                    }
-
-                    if ((res = NetIo_recv(pPutMedia->xNetIoHandle, BUFFER_u_char(xBufRecv) + uBytesTotalReceived, BUFFER_length(xBufRecv) - uBytesTotalReceived, &uBytesReceived)) !=KVS_ERRNO_NONE)
-                    {
-                        LogError("Failed to receive");
-                        /* Propagate the res error */
-                        break;
-                    }
-
-                    uBytesTotalReceived += uBytesReceived;
+                    LogError("Failed to receive");
+                    /* Propagate the res error */
+                    break;
                 }
-
-                if (res == KVS_ERRNO_NONE && uBytesTotalReceived > 0)
+                else if ((res = prvParseFragmentAcks(pPutMedia, pPutMedia->pRecvBuf, uBytesReceived)) != KVS_ERRNO_NONE)
                 {
-                    uBytesReceived = 0;
-                    while (uBytesReceived < uBytesTotalReceived)
-                    {
-                        memset(&xFragmentAck, 0, sizeof(FragmentAck_t));
-                        if (prvParseFragmentAck((char *)BUFFER_u_char(xBufRecv) + uBytesReceived, uBytesTotalReceived - uBytesReceived, &xFragmentAck, &uFragAckLen) != KVS_ERRNO_NONE ||
-                            uFragAckLen == 0)
-                        {
-                            break;
-                        }
-                        else
-                        {
-                            prvLogFragmentAck(&xFragmentAck);
-                            prvPushFragmentAck(pPutMedia, &xFragmentAck);
-                            if (xFragmentAck.eventType == eError)
-                            {
-                                res = KVS_GENERATE_PUTMEDIA_ERROR(xFragmentAck.uErrorId);
-                                break;
-                            }
-                        }
-                        uBytesReceived += uFragAckLen;
-                    }
-                    // prvLogPendingFragmentAcks(pPutMedia);
+                    /* Propagate the res error */
+                    break;
                 }
             }
         }
     }
 
-    BUFFER_delete(xBufRecv);
+    return res;
+}
+
+int Kvs_putMediaEnd(PutMediaHandle xPutMediaHandle)
+{
+    int res = KVS_ERRNO_NONE;
+    PutMedia_t *pPutMedia = xPutMediaHandle;
+    const char *pcLastChunk = "0\r\n\r\n";
+
+    if (pPutMedia == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else if ((res = NetIo_send(pPutMedia->xNetIoHandle, (const unsigned char *)pcLastChunk, strlen(pcLastChunk))) != KVS_ERRNO_NONE)
+    {
+        LogError("Failed to end the body");
+        /* Propagate the res error */
+    }
+    else
+    {
+        /* nop */
+    }
 
     return res;
 }
@@ -1321,6 +1227,7 @@ void Kvs_putMediaFinish(PutMediaHandle xPutMediaHandle)
     if (pPutMedia != NULL)
     {
         prvFlushFragmentAck(pPutMedia);
+        Slab_terminate(pPutMedia->xFragmentAckSlab);
         Lock_Deinit(pPutMedia->xLock);
         if (pPutMedia->xNetIoHandle != NULL)
         {
@@ -1401,7 +1308,7 @@ int Kvs_putMediaReadFragmentAck(PutMediaHandle xPutMediaHandle, ePutMediaFragmen
         {
             *puErrorId = pFragmentAck->uErrorId;
         }
-        kvsFree(pFragmentAck);
+        Slab_free(pPutMedia->xFragmentAckSlab, pFragmentAck);
     }
 
     return res;
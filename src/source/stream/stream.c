@@ -28,6 +28,7 @@
 
 /* Internal headers */
 #include "os/allocator.h"
+#include "os/slab.h"
 
 typedef struct DataFrame
 {
@@ -38,6 +39,9 @@ typedef struct DataFrame
 
     size_t uMkvHdrLen;
     char *pMkvHdr;
+
+    /* The slab that the data frame is allocated from, or NULL if it's from the heap */
+    SlabHandle xSlab;
 } DataFrame_t;
 
 typedef struct Stream
@@ -48,13 +52,245 @@ typedef struct Stream
     size_t uMkvEbmlSegLen;
 
     uint64_t uEarliestClusterTimestamp;
-    DLIST_ENTRY xClusterPending;
+    uint64_t uLatestTimestamp;
+    DLIST_ENTRY xClusterPending; /* Index of the pending cluster data frames, in the same order as xDataFramePending */
     DLIST_ENTRY xDataFramePending;
 
+    /* Data frames are allocated from this slab if it's reserved, so steady-state ingest does not touch the heap. */
+    SlabHandle xDataFrameSlab;
+
     bool bHasVideoTrack;
     bool bHasAudioTrack;
+
+    /* Running totals of pending data frames, updated on add and pop. */
+    size_t uDataFrameMemTotal;
+    size_t uDataFrameCount;
+    size_t puTrackDataFrameCount[TRACK_MAX + 1];
 } Stream_t;
 
+/**
+ * @brief Update running totals of a stream when a data frame is added or removed
+ *
+ * @param[in] pxStream The stream
+ * @param[in] pxDataFrame The data frame
+ * @param[in] bAdd true if the data frame is added, false if it's removed
+ */
+static void prvStreamUpdateStat(Stream_t *pxStream, DataFrame_t *pxDataFrame, bool bAdd)
+{
+    size_t uMem = pxDataFrame->xDataFrameIn.uDataLen + sizeof(DataFrame_t) + pxDataFrame->uMkvHdrLen;
+    TrackType_t xTrackType = pxDataFrame->xDataFrameIn.xTrackType;
+
+    if (bAdd)
+    {
+        pxStream->uDataFrameMemTotal += uMem;
+        pxStream->uDataFrameCount++;
+        if (xTrackType <= TRACK_MAX)
+        {
+            pxStream->puTrackDataFrameCount[xTrackType]++;
+        }
+    }
+    else
+    {
+        pxStream->uDataFrameMemTotal -= uMem;
+        pxStream->uDataFrameCount--;
+        if (xTrackType <= TRACK_MAX)
+        {
+            pxStream->puTrackDataFrameCount[xTrackType]--;
+        }
+    }
+}
+
+/**
+ * @brief Check if a new data frame should be placed in front of a pending data frame
+ *
+ * Data frames are ordered by timestamp. If timestamps are the same, then the video frame goes first.
+ *
+ * @param[in] pxDataFrame The new data frame
+ * @param[in] pxDataFrameCurrent The pending data frame
+ * @return true if the new data frame goes in front of the pending data frame, false otherwise
+ */
+static bool prvIsDataFrameBefore(DataFrame_t *pxDataFrame, DataFrame_t *pxDataFrameCurrent)
+{
+    return (pxDataFrame->xDataFrameIn.uTimestampMs < pxDataFrameCurrent->xDataFrameIn.uTimestampMs) ||
+           ((pxDataFrame->xDataFrameIn.uTimestampMs == pxDataFrameCurrent->xDataFrameIn.uTimestampMs) && (pxDataFrame->xDataFrameIn.xTrackType == TRACK_VIDEO));
+}
+
+/**
+ * @brief Find the position to insert a new data frame into the pending data frame list
+ *
+ * In-order data frames are appended to the tail directly. For out-of-order data frames, the cluster index is searched
+ * backward first, so only the data frames of one cluster need to be visited.
+ *
+ * @param[in] pxStream The stream
+ * @param[in] pxDataFrame The new data frame
+ * @param[out] ppxPrevCluster The cluster data frame in front of the insert position, or NULL if there is none
+ * @return The list entry that the new data frame should be inserted in front of
+ */
+static PDLIST_ENTRY prvStreamFindInsertPoint(Stream_t *pxStream, DataFrame_t *pxDataFrame, DataFrame_t **ppxPrevCluster)
+{
+    PDLIST_ENTRY pxListHead = &(pxStream->xDataFramePending);
+    PDLIST_ENTRY pxClusterHead = &(pxStream->xClusterPending);
+    PDLIST_ENTRY pxListItem = NULL;
+    DataFrame_t *pxDataFrameCurrent = NULL;
+    DataFrame_t *pxPrevCluster = NULL;
+
+    /* Find the last cluster that the new data frame goes after. */
+    pxListItem = pxClusterHead->Blink;
+    while (pxListItem != pxClusterHead)
+    {
+        pxDataFrameCurrent = containingRecord(pxListItem, DataFrame_t, xClusterEntry);
+        if (!prvIsDataFrameBefore(pxDataFrame, pxDataFrameCurrent))
+        {
+            pxPrevCluster = pxDataFrameCurrent;
+            break;
+        }
+        pxListItem = pxListItem->Blink;
+    }
+    *ppxPrevCluster = pxPrevCluster;
+
+    if (DList_IsListEmpty(pxListHead) || !prvIsDataFrameBefore(pxDataFrame, containingRecord(pxListHead->Blink, DataFrame_t, xDataFrameEntry)))
+    {
+        /* Fast path: the data frame is in order, so append it to the tail. */
+        pxListItem = pxListHead;
+    }
+    else
+    {
+        pxListItem = (pxPrevCluster != NULL) ? pxPrevCluster->xDataFrameEntry.Flink : pxListHead->Flink;
+        while (pxListItem != pxListHead)
+        {
+            pxDataFrameCurrent = containingRecord(pxListItem, DataFrame_t, xDataFrameEntry);
+            if (prvIsDataFrameBefore(pxDataFrame, pxDataFrameCurrent))
+            {
+                break;
+            }
+            pxListItem = pxListItem->Flink;
+        }
+    }
+
+    return pxListItem;
+}
+
+/**
+ * @brief Update delta timestamps of the data frames that follow a cluster data frame until the next cluster
+ *
+ * @param[in] pxStream The stream
+ * @param[in] pxCluster The cluster data frame
+ */
+static void prvStreamUpdateDeltaTimestamp(Stream_t *pxStream, DataFrame_t *pxCluster)
+{
+    PDLIST_ENTRY pxListHead = &(pxStream->xDataFramePending);
+    PDLIST_ENTRY pxListItem = pxCluster->xDataFrameEntry.Flink;
+    DataFrame_t *pxDataFrameCurrent = NULL;
+    uint16_t uDeltaTimestampMs = 0;
+
+    while (pxListItem != pxListHead)
+    {
+        pxDataFrameCurrent = containingRecord(pxListItem, DataFrame_t, xDataFrameEntry);
+        if (pxDataFrameCurrent->xDataFrameIn.xClusterType == MKV_CLUSTER)
+        {
+            break;
+        }
+
+        uDeltaTimestampMs = (uint16_t)(pxDataFrameCurrent->xDataFrameIn.uTimestampMs - pxCluster->xDataFrameIn.uTimestampMs);
+        Mkv_initializeClusterHdr(
+            (uint8_t *)(pxDataFrameCurrent->pMkvHdr),
+            pxDataFrameCurrent->uMkvHdrLen,
+            pxDataFrameCurrent->xDataFrameIn.xClusterType,
+            pxDataFrameCurrent->xDataFrameIn.uDataLen,
+            pxDataFrameCurrent->xDataFrameIn.xTrackType,
+            pxDataFrameCurrent->xDataFrameIn.bIsKeyFrame,
+            pxDataFrameCurrent->xDataFrameIn.uTimestampMs,
+            uDeltaTimestampMs);
+
+        pxListItem = pxListItem->Flink;
+    }
+}
+
+/**
+ * @brief Get the cluster data frame that ends the GOP at the head of a stream
+ *
+ * A GOP starts from a cluster data frame and ends in front of the next cluster. If the head data frame is not a
+ * cluster, the head GOP is the headless run in front of the first cluster.
+ *
+ * @param[in] pxStream The stream
+ * @return The cluster data frame that follows the head GOP, or NULL if the head GOP is the newest one
+ */
+static DataFrame_t *prvStreamGetHeadGopEnd(Stream_t *pxStream)
+{
+    PDLIST_ENTRY pxClusterHead = &(pxStream->xClusterPending);
+    PDLIST_ENTRY pxListItem = pxClusterHead->Flink;
+    DataFrame_t *pxHead = containingRecord(pxStream->xDataFramePending.Flink, DataFrame_t, xDataFrameEntry);
+
+    if (pxHead->xDataFrameIn.xClusterType == MKV_CLUSTER)
+    {
+        /* The head cluster is always the first one in the cluster index. */
+        pxListItem = pxListItem->Flink;
+    }
+
+    return (pxListItem == pxClusterHead) ? NULL : containingRecord(pxListItem, DataFrame_t, xClusterEntry);
+}
+
+/**
+ * @brief Move the GOP at the head of a stream to a detached list
+ *
+ * The end of the GOP comes from the cluster index, so the whole run is unlinked in one splice. Only the running totals
+ * are updated per data frame.
+ *
+ * @param[in] pxStream The stream
+ * @param[in] pxDetached The list head that the GOP is appended to
+ */
+static void prvStreamDetachHeadGop(Stream_t *pxStream, PDLIST_ENTRY pxDetached)
+{
+    PDLIST_ENTRY pxListHead = &(pxStream->xDataFramePending);
+    DataFrame_t *pxHead = containingRecord(pxListHead->Flink, DataFrame_t, xDataFrameEntry);
+    DataFrame_t *pxGopEnd = prvStreamGetHeadGopEnd(pxStream);
+    PDLIST_ENTRY pxFirst = pxListHead->Flink;
+    PDLIST_ENTRY pxEnd = (pxGopEnd != NULL) ? &(pxGopEnd->xDataFrameEntry) : pxListHead;
+    PDLIST_ENTRY pxLast = pxEnd->Blink;
+    PDLIST_ENTRY pxListItem = NULL;
+
+    if (pxHead->xDataFrameIn.xClusterType == MKV_CLUSTER)
+    {
+        pxStream->uEarliestClusterTimestamp = pxHead->xDataFrameIn.uTimestampMs;
+        DList_RemoveEntryList(&(pxHead->xClusterEntry));
+        DList_InitializeListHead(&(pxHead->xClusterEntry));
+    }
+
+    for (pxListItem = pxFirst; pxListItem != pxEnd; pxListItem = pxListItem->Flink)
+    {
+        prvStreamUpdateStat(pxStream, containingRecord(pxListItem, DataFrame_t, xDataFrameEntry), false);
+    }
+
+    pxListHead->Flink = pxEnd;
+    pxEnd->Blink = pxListHead;
+
+    pxFirst->Blink = pxDetached->Blink;
+    pxDetached->Blink->Flink = pxFirst;
+    pxLast->Flink = pxDetached;
+    pxDetached->Blink = pxLast;
+}
+
+/**
+ * @brief Hand detached data frames over to the evicted callback
+ *
+ * @param[in] pxDetached The list head of detached data frames
+ * @param[in] onDataFrameEvicted The callback that takes over each data frame
+ * @param[in] pAppData The application data that is passed to the callback
+ */
+static void prvStreamReleaseDetached(PDLIST_ENTRY pxDetached, OnDataFrameEvicted_t onDataFrameEvicted, void *pAppData)
+{
+    PDLIST_ENTRY pxListItem = NULL;
+    DataFrame_t *pxDataFrame = NULL;
+
+    while (!DList_IsListEmpty(pxDetached))
+    {
+        pxListItem = DList_RemoveHeadList(pxDetached);
+        pxDataFrame = containingRecord(pxListItem, DataFrame_t, xDataFrameEntry);
+        DList_InitializeListHead(&(pxDataFrame->xDataFrameEntry));
+        onDataFrameEvicted(pxDataFrame, pAppData);
+    }
+}
+
 static DataFrameHandle prvStreamPop(StreamHandle xStreamHandle, bool bPeek)
 {
     Stream_t *pxStream = xStreamHandle;
@@ -94,9 +330,13 @@ static DataFrameHandle prvStreamPop(StreamHandle xStreamHandle, bool bPeek)
 
                 if (!bPeek)
                 {
+                    prvStreamUpdateStat(pxStream, pxDataFrame, false);
+
                     if (pxDataFrame->xDataFrameIn.xClusterType == MKV_CLUSTER)
                     {
                         pxStream->uEarliestClusterTimestamp = pxDataFrame->xDataFrameIn.uTimestampMs;
+                        DList_RemoveEntryList(&(pxDataFrame->xClusterEntry));
+                        DList_InitializeListHead(&(pxDataFrame->xClusterEntry));
                     }
                 }
             }
@@ -159,6 +399,7 @@ void Kvs_streamTermintate(StreamHandle xStreamHandle)
     if (pxStream != NULL)
     {
         kvsFree(pxStream->pMkvEbmlSeg);
+        Slab_terminate(pxStream->xDataFrameSlab);
         Lock_Deinit(pxStream->xLock);
         kvsFree(pxStream);
     }
@@ -188,18 +429,45 @@ int Kvs_streamGetMkvEbmlSegHdr(StreamHandle xStreamHandle, uint8_t **ppMkvHeader
     return res;
 }
 
+int Kvs_streamReserveDataFrames(StreamHandle xStreamHandle, size_t uDataFrameCount)
+{
+    int res = KVS_ERRNO_NONE;
+    Stream_t *pxStream = xStreamHandle;
+    size_t uClusterHdrLen = Mkv_getClusterHdrLen(MKV_CLUSTER, SIZE_MAX);
+    size_t uSimpleBlockHdrLen = Mkv_getClusterHdrLen(MKV_SIMPLE_BLOCK, SIZE_MAX);
+    size_t uMkvHdrLenMax = (uClusterHdrLen > uSimpleBlockHdrLen) ? uClusterHdrLen : uSimpleBlockHdrLen;
+
+    if (pxStream == NULL || uDataFrameCount == 0)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else if (pxStream->xDataFrameSlab != NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Data frames have been reserved");
+    }
+    else if ((pxStream->xDataFrameSlab = Slab_create(sizeof(DataFrame_t) + uMkvHdrLenMax, uDataFrameCount)) == NULL)
+    {
+        res = KVS_ERROR_OUT_OF_MEMORY;
+        LogError("OOM: xDataFrameSlab");
+    }
+    else
+    {
+        /* nop */
+    }
+
+    return res;
+}
+
 DataFrameHandle Kvs_streamAddDataFrame(StreamHandle xStreamHandle, DataFrameIn_t *pxDataFrameIn)
 {
     int res = KVS_ERRNO_NONE;
     Stream_t *pxStream = xStreamHandle;
     DataFrame_t *pxDataFrame = NULL;
     size_t uMkvHdrLen = 0;
-    DataFrame_t *pxDataFrameCurrent = NULL;
-    PDLIST_ENTRY pxListHead = NULL;
-    PDLIST_ENTRY pxListItem = NULL;
-    bool bListAdded = false;
-    bool bNeedCorrectDeltaTimestamp = false;
-    bool bCorrectDeltaTimestampStarted = false;
+    DataFrame_t *pxPrevCluster = NULL;
+    PDLIST_ENTRY pxInsertBefore = NULL;
     uint64_t uClusterTimestamp = 0;
     uint16_t uDeltaTimestampMs = 0;
 
@@ -208,12 +476,12 @@ DataFrameHandle Kvs_streamAddDataFrame(StreamHandle xStreamHandle, DataFrameIn_t
         res = KVS_ERROR_INVALID_ARGUMENT;
         LogError("Invalid argument");
     }
-    else if ((uMkvHdrLen = Mkv_getClusterHdrLen(pxDataFrameIn->xClusterType)) == 0)
+    else if ((uMkvHdrLen = Mkv_getClusterHdrLen(pxDataFrameIn->xClusterType, pxDataFrameIn->uDataLen)) == 0)
     {
         res = KVS_ERROR_INVALID_CLUSTER_HDR_LEN;
         LogError("Invalid cluster len");
     }
-    else if ((pxDataFrame = (DataFrame_t *)kvsMalloc(sizeof(DataFrame_t) + uMkvHdrLen)) == NULL)
+    else if ((pxDataFrame = (DataFrame_t *)((pxStream->xDataFrameSlab != NULL) ? Slab_alloc(pxStream->xDataFrameSlab) : kvsMalloc(sizeof(DataFrame_t) + uMkvHdrLen))) == NULL)
     {
         res = KVS_ERROR_OUT_OF_MEMORY;
         LogError("OOM: pxDataFrame");
@@ -231,39 +499,26 @@ DataFrameHandle Kvs_streamAddDataFrame(StreamHandle xStreamHandle, DataFrameIn_t
         DList_InitializeListHead(&(pxDataFrame->xDataFrameEntry));
         pxDataFrame->uMkvHdrLen = uMkvHdrLen;
         pxDataFrame->pMkvHdr = (char *)pxDataFrame + sizeof(DataFrame_t);
-        uClusterTimestamp = pxStream->uEarliestClusterTimestamp;
+        pxDataFrame->xSlab = pxStream->xDataFrameSlab;
 
-        pxListHead = &(pxStream->xDataFramePending);
-        pxListItem = pxListHead->Flink;
-        while (pxListItem != pxListHead)
+        pxInsertBefore = prvStreamFindInsertPoint(pxStream, pxDataFrame, &pxPrevCluster);
+        DList_InsertTailList(pxInsertBefore, &(pxDataFrame->xDataFrameEntry));
+        prvStreamUpdateStat(pxStream, pxDataFrame, true);
+        if (pxDataFrame->xDataFrameIn.uTimestampMs > pxStream->uLatestTimestamp)
         {
-            pxDataFrameCurrent = containingRecord(pxListItem, DataFrame_t, xDataFrameEntry);
-            if (pxDataFrame->xDataFrameIn.uTimestampMs < pxDataFrameCurrent->xDataFrameIn.uTimestampMs ||
-                ((pxDataFrame->xDataFrameIn.uTimestampMs == pxDataFrameCurrent->xDataFrameIn.uTimestampMs) && (pxDataFrame->xDataFrameIn.xTrackType == TRACK_VIDEO)))
-            {
-                DList_InsertTailList(pxListItem, &(pxDataFrame->xDataFrameEntry));
-                uDeltaTimestampMs = (uint16_t)(pxDataFrame->xDataFrameIn.uTimestampMs - uClusterTimestamp);
-                if (pxDataFrame->xDataFrameIn.xClusterType == MKV_CLUSTER)
-                {
-                    uDeltaTimestampMs = 0;
+            pxStream->uLatestTimestamp = pxDataFrame->xDataFrameIn.uTimestampMs;
+        }
 
-                    /* If we insert a cluster head, then the following frames's delta timestamp needs updates. */
-                    bNeedCorrectDeltaTimestamp = true;
-                }
-                bListAdded = true;
-                break;
-            }
-            if (pxDataFrameCurrent->xDataFrameIn.xClusterType == MKV_CLUSTER)
-            {
-                uClusterTimestamp = pxDataFrameCurrent->xDataFrameIn.uTimestampMs;
-            }
-            pxListItem = pxListItem->Flink;
+        if (pxDataFrame->xDataFrameIn.xClusterType == MKV_CLUSTER)
+        {
+            /* Keep the cluster index in the same order as the data frame list. */
+            DList_InsertHeadList((pxPrevCluster != NULL) ? &(pxPrevCluster->xClusterEntry) : &(pxStream->xClusterPending), &(pxDataFrame->xClusterEntry));
+            uDeltaTimestampMs = 0;
         }
-        if (!bListAdded)
+        else
         {
+            uClusterTimestamp = (pxPrevCluster != NULL) ? pxPrevCluster->xDataFrameIn.uTimestampMs : pxStream->uEarliestClusterTimestamp;
             uDeltaTimestampMs = (uint16_t)(pxDataFrame->xDataFrameIn.uTimestampMs - uClusterTimestamp);
-            DList_InsertTailList(&(pxStream->xDataFramePending), &(pxDataFrame->xDataFrameEntry));
-            bListAdded = true;
         }
 
         Mkv_initializeClusterHdr(
@@ -276,34 +531,10 @@ DataFrameHandle Kvs_streamAddDataFrame(StreamHandle xStreamHandle, DataFrameIn_t
             pxDataFrameIn->uTimestampMs,
             uDeltaTimestampMs);
 
-        if (bNeedCorrectDeltaTimestamp)
+        if (pxDataFrame->xDataFrameIn.xClusterType == MKV_CLUSTER && pxInsertBefore != &(pxStream->xDataFramePending))
         {
-            bCorrectDeltaTimestampStarted = false;
-            pxListHead = &(pxStream->xDataFramePending);
-            pxListItem = pxListHead->Flink;
-            while (pxListItem != pxListHead)
-            {
-                pxDataFrameCurrent = containingRecord(pxListItem, DataFrame_t, xDataFrameEntry);
-                if (pxDataFrameCurrent->xDataFrameIn.xClusterType == MKV_CLUSTER)
-                {
-                    uClusterTimestamp = pxDataFrameCurrent->xDataFrameIn.uTimestampMs;
-                    bCorrectDeltaTimestampStarted = true;
-                }
-                if (bCorrectDeltaTimestampStarted)
-                {
-                    uDeltaTimestampMs = (uint16_t)(pxDataFrameCurrent->xDataFrameIn.uTimestampMs - uClusterTimestamp);
-                    Mkv_initializeClusterHdr(
-                        (uint8_t *)(pxDataFrameCurrent->pMkvHdr),
-                        pxDataFrameCurrent->uMkvHdrLen,
-                        pxDataFrameCurrent->xDataFrameIn.xClusterType,
-                        pxDataFrameCurrent->xDataFrameIn.uDataLen,
-                        pxDataFrameCurrent->xDataFrameIn.xTrackType,
-                        pxDataFrameCurrent->xDataFrameIn.bIsKeyFrame,
-                        pxDataFrameCurrent->xDataFrameIn.uTimestampMs,
-                        uDeltaTimestampMs);
-                }
-                pxListItem = pxListItem->Flink;
-            }
+            /* A cluster head is inserted in the middle, so the following frames up to the next cluster belong to it now. */
+            prvStreamUpdateDeltaTimestamp(pxStream, pxDataFrame);
         }
 
         Unlock(pxStream->xLock);
@@ -313,7 +544,7 @@ DataFrameHandle Kvs_streamAddDataFrame(StreamHandle xStreamHandle, DataFrameIn_t
     {
         if (pxDataFrame != NULL)
         {
-            kvsFree(pxDataFrame);
+            Slab_free(pxStream->xDataFrameSlab, pxDataFrame);
             pxDataFrame = NULL;
         }
     }
@@ -344,7 +575,7 @@ bool Kvs_streamIsEmpty(StreamHandle xStreamHandle)
         }
         else
         {
-            if (!DList_IsListEmpty(&(pxStream->xDataFramePending)))
+            if (pxStream->uDataFrameCount > 0)
             {
                 bRes = false;
             }
@@ -359,11 +590,8 @@ bool Kvs_streamAvailOnTrack(StreamHandle xStreamHandle, TrackType_t xTrackType)
 {
     bool bRes = false;
     Stream_t *pxStream = xStreamHandle;
-    PDLIST_ENTRY pxListHead = NULL;
-    PDLIST_ENTRY pxListItem = NULL;
-    DataFrame_t *pxDataFrame = NULL;
 
-    if (pxStream != NULL)
+    if (pxStream != NULL && xTrackType <= TRACK_MAX)
     {
         if (Lock(pxStream->xLock) != LOCK_OK)
         {
@@ -371,18 +599,9 @@ bool Kvs_streamAvailOnTrack(StreamHandle xStreamHandle, TrackType_t xTrackType)
         }
         else
         {
-            pxListHead = &(pxStream->xDataFramePending);
-            pxListItem = pxListHead->Flink;
-            while (pxListItem != pxListHead)
+            if (pxStream->puTrackDataFrameCount[xTrackType] > 0)
             {
-                pxDataFrame = containingRecord(pxListItem, DataFrame_t, xDataFrameEntry);
-                if (pxDataFrame->xDataFrameIn.xTrackType == xTrackType)
-                {
-                    bRes = true;
-                    break;
-                }
-
-                pxListItem = pxListItem->Flink;
+                bRes = true;
             }
 
             Unlock(pxStream->xLock);
@@ -396,10 +615,6 @@ int Kvs_streamMemStatTotal(StreamHandle xStreamHandle, size_t *puMemTotal)
 {
     int res = KVS_ERRNO_NONE;
     Stream_t *pxStream = xStreamHandle;
-    DataFrame_t *pxDataFrame = NULL;
-    PDLIST_ENTRY pxListHead = NULL;
-    PDLIST_ENTRY pxListItem = NULL;
-    size_t uMemTotal = 0;
 
     if (pxStream == NULL || puMemTotal == NULL)
     {
@@ -413,20 +628,88 @@ int Kvs_streamMemStatTotal(StreamHandle xStreamHandle, size_t *puMemTotal)
     }
     else
     {
-        uMemTotal += sizeof(Stream_t) + pxStream->uMkvEbmlSegLen;
+        *puMemTotal = sizeof(Stream_t) + pxStream->uMkvEbmlSegLen + pxStream->uDataFrameMemTotal;
+        Unlock(pxStream->xLock);
+    }
 
-        pxListHead = &(pxStream->xDataFramePending);
-        pxListItem = pxListHead->Flink;
-        while (pxListItem != pxListHead)
+    return res;
+}
+
+int Kvs_streamEvictHeadless(StreamHandle xStreamHandle, OnDataFrameEvicted_t onDataFrameEvicted, void *pAppData)
+{
+    int res = KVS_ERRNO_NONE;
+    Stream_t *pxStream = xStreamHandle;
+    DLIST_ENTRY xDetached;
+
+    DList_InitializeListHead(&xDetached);
+
+    if (pxStream == NULL || onDataFrameEvicted == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else if (Lock(pxStream->xLock) != LOCK_OK)
+    {
+        res = KVS_ERROR_LOCK_ERROR;
+        LogError("Failed to Lock");
+    }
+    else
+    {
+        if (!DList_IsListEmpty(&(pxStream->xDataFramePending)) &&
+            containingRecord(pxStream->xDataFramePending.Flink, DataFrame_t, xDataFrameEntry)->xDataFrameIn.xClusterType != MKV_CLUSTER)
         {
-            pxDataFrame = containingRecord(pxListItem, DataFrame_t, xDataFrameEntry);
-            uMemTotal += pxDataFrame->xDataFrameIn.uDataLen;
-            uMemTotal += sizeof(DataFrame_t) + pxDataFrame->uMkvHdrLen;
-            pxListItem = pxListItem->Flink;
+            prvStreamDetachHeadGop(pxStream, &xDetached);
         }
+        Unlock(pxStream->xLock);
+
+        prvStreamReleaseDetached(&xDetached, onDataFrameEvicted, pAppData);
+    }
 
-        *puMemTotal = uMemTotal;
+    return res;
+}
+
+int Kvs_streamEvictGops(StreamHandle xStreamHandle, size_t uMemLimit, uint64_t uDurationLimitMs, OnDataFrameEvicted_t onDataFrameEvicted, void *pAppData)
+{
+    int res = KVS_ERRNO_NONE;
+    Stream_t *pxStream = xStreamHandle;
+    DataFrame_t *pxGopEnd = NULL;
+    bool bOverMemLimit = false;
+    bool bOverDurationLimit = false;
+    DLIST_ENTRY xDetached;
+
+    DList_InitializeListHead(&xDetached);
+
+    if (pxStream == NULL || onDataFrameEvicted == NULL)
+    {
+        res = KVS_ERROR_INVALID_ARGUMENT;
+        LogError("Invalid argument");
+    }
+    else if (Lock(pxStream->xLock) != LOCK_OK)
+    {
+        res = KVS_ERROR_LOCK_ERROR;
+        LogError("Failed to Lock");
+    }
+    else
+    {
+        while (!DList_IsListEmpty(&(pxStream->xDataFramePending)))
+        {
+            pxGopEnd = prvStreamGetHeadGopEnd(pxStream);
+
+            /* The memory limit is hard, so even the newest GOP goes if it alone exceeds the limit. */
+            bOverMemLimit = (uMemLimit > 0) && (sizeof(Stream_t) + pxStream->uMkvEbmlSegLen + pxStream->uDataFrameMemTotal > uMemLimit);
+
+            /* A GOP is out of the duration limit only if the GOPs after it still cover the whole duration. */
+            bOverDurationLimit = (uDurationLimitMs > 0) && (pxGopEnd != NULL) && (pxGopEnd->xDataFrameIn.uTimestampMs + uDurationLimitMs <= pxStream->uLatestTimestamp);
+
+            if (!bOverMemLimit && !bOverDurationLimit)
+            {
+                break;
+            }
+            prvStreamDetachHeadGop(pxStream, &xDetached);
+        }
         Unlock(pxStream->xLock);
+
+        prvStreamReleaseDetached(&xDetached, onDataFrameEvicted, pAppData);
     }
 
     return res;
@@ -459,6 +742,6 @@ void Kvs_dataFrameTerminate(DataFrameHandle xDataFrameHandle)
 
     if (pxDataFrame != NULL)
     {
-        kvsFree(pxDataFrame);
+        Slab_free(pxDataFrame->xSlab, pxDataFrame);
     }
 }
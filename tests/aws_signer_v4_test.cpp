@@ -0,0 +1,102 @@
+#ifdef __cplusplus
+extern "C" {
+#include <stdint.h>
+
+#include "kvs/errors.h"
+#include "restful/aws_signer_v4.h"
+}
+#endif
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#define TEST_ACCESS_KEY "AKIDEXAMPLE"
+#define TEST_SECRET_KEY "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY"
+#define TEST_ROTATED_SECRET_KEY "je7MtGbClwBF/2Zp9Utk/h3yCo8nvbEXAMPLEKEY"
+
+typedef struct SigningCacheCounts
+{
+    uint32_t uHitCount;
+    uint32_t uMissCount;
+} SigningCacheCounts_t;
+
+/* The request of the AWS Signature V4 example, which is "GET https://iam.amazonaws.com/?Action=ListUsers&Version=2010-05-08" */
+static std::string prvSign(const char *pcSecretKey, const char *pcXAmzDate, const char *pcRegion, const char *pcService)
+{
+    AwsSigV4Handle xSigV4Handle = NULL;
+    std::string xSignature;
+    const char *pcAuthorization = NULL;
+    const char *pcSignature = NULL;
+
+    EXPECT_NE(nullptr, xSigV4Handle = AwsSigV4_Create((char *)"GET", (char *)"/", (char *)"Action=ListUsers&Version=2010-05-08"));
+    EXPECT_EQ(0, AwsSigV4_AddCanonicalHeader(xSigV4Handle, "content-type", "application/x-www-form-urlencoded; charset=utf-8"));
+    EXPECT_EQ(0, AwsSigV4_AddCanonicalHeader(xSigV4Handle, "host", "iam.amazonaws.com"));
+    EXPECT_EQ(0, AwsSigV4_AddCanonicalHeader(xSigV4Handle, "x-amz-date", pcXAmzDate));
+    EXPECT_EQ(0, AwsSigV4_AddCanonicalBody(xSigV4Handle, "", 0));
+    EXPECT_EQ(0, AwsSigV4_Sign(xSigV4Handle, (char *)TEST_ACCESS_KEY, (char *)pcSecretKey, (char *)pcRegion, (char *)pcService, pcXAmzDate));
+
+    if ((pcAuthorization = AwsSigV4_GetAuthorization(xSigV4Handle)) != NULL && (pcSignature = strstr(pcAuthorization, "Signature=")) != NULL)
+    {
+        xSignature = pcSignature + strlen("Signature=");
+    }
+    AwsSigV4_Terminate(xSigV4Handle);
+
+    return xSignature;
+}
+
+static SigningCacheCounts_t prvGetCacheCounts(void)
+{
+    SigningCacheCounts_t xCounts = {0, 0};
+
+    EXPECT_EQ(0, AwsSigV4_GetSigningKeyCacheStats(&(xCounts.uHitCount), &(xCounts.uMissCount)));
+
+    return xCounts;
+}
+
+static void prvExpectCacheCounts(const SigningCacheCounts_t *pxBase, uint32_t uHitCount, uint32_t uMissCount)
+{
+    SigningCacheCounts_t xCounts = prvGetCacheCounts();
+
+    EXPECT_EQ(uHitCount, xCounts.uHitCount - pxBase->uHitCount);
+    EXPECT_EQ(uMissCount, xCounts.uMissCount - pxBase->uMissCount);
+}
+
+TEST(AwsSigV4_Sign, signing_key_cache)
+{
+    SigningCacheCounts_t xBase = prvGetCacheCounts();
+
+    /* The signature of the AWS example */
+    EXPECT_EQ("5d672d79c15b13162d9279b0855cfba6789a8edb4c82c400e06b5924a6f2b5d7", prvSign(TEST_SECRET_KEY, "20150830T123600Z", "us-east-1", "iam"));
+    prvExpectCacheCounts(&xBase, 0, 1);
+
+    /* A hit gives the same signature. */
+    EXPECT_EQ("5d672d79c15b13162d9279b0855cfba6789a8edb4c82c400e06b5924a6f2b5d7", prvSign(TEST_SECRET_KEY, "20150830T123600Z", "us-east-1", "iam"));
+    prvExpectCacheCounts(&xBase, 1, 1);
+
+    /* The date rolls over, and the signing key is derived again. Another time of the same date is a hit. */
+    EXPECT_EQ("6268a351cf2d965b6013db4f7e04fb6736c627b3ac0d577d44af46c9c3bfd6ed", prvSign(TEST_SECRET_KEY, "20150831T000100Z", "us-east-1", "iam"));
+    prvExpectCacheCounts(&xBase, 1, 2);
+    EXPECT_EQ("bb86b696fcc30205ca2daf7fbed6205d5ea1905efa159ea46133831806add597", prvSign(TEST_SECRET_KEY, "20150831T000200Z", "us-east-1", "iam"));
+    prvExpectCacheCounts(&xBase, 2, 2);
+
+    /* A different region, service or secret key has its own signing key. */
+    EXPECT_EQ("6735d7b8b816ae24a3e9c47cccf1b18a4540683c99843da3c9ba9f9235c1cd51", prvSign(TEST_SECRET_KEY, "20150831T000100Z", "us-west-2", "iam"));
+    prvExpectCacheCounts(&xBase, 2, 3);
+    EXPECT_EQ("ecbceede2c2aa294d2c67ac229136a9852736a7b6feb6dbf60c085fcfb3897b8", prvSign(TEST_SECRET_KEY, "20150831T000100Z", "us-east-1", "kinesisvideo"));
+    prvExpectCacheCounts(&xBase, 2, 4);
+    EXPECT_EQ("e394437deab2c8cebce83b9d35d696fa7d1332acd21cc2133596098741fd1449", prvSign(TEST_ROTATED_SECRET_KEY, "20150831T000100Z", "us-east-1", "iam"));
+    prvExpectCacheCounts(&xBase, 2, 5);
+
+    /* The first credential is still cached. */
+    EXPECT_EQ("bb86b696fcc30205ca2daf7fbed6205d5ea1905efa159ea46133831806add597", prvSign(TEST_SECRET_KEY, "20150831T000200Z", "us-east-1", "iam"));
+    prvExpectCacheCounts(&xBase, 3, 5);
+}
+
+TEST(AwsSigV4_GetSigningKeyCacheStats, invalid_argument)
+{
+    uint32_t uCount = 0;
+
+    EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, AwsSigV4_GetSigningKeyCacheStats(NULL, &uCount));
+    EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, AwsSigV4_GetSigningKeyCacheStats(&uCount, NULL));
+}
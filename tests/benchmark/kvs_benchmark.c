@@ -0,0 +1,613 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Public headers */
+#include "kvs/errors.h"
+#include "kvs/mkv_generator.h"
+#include "kvs/nalu.h"
+#include "kvs/pool_allocator.h"
+#include "kvs/stream.h"
+
+/* Internal headers */
+#include "os/allocator.h"
+#include "restful/aws_signer_v4.h"
+#include "restful/kvs/fragment_ack_parser.h"
+
+#include "frame_ring_buffer/frame_ring_buffer.h"
+
+#define MAX_FRAMES (1000)
+#define FRAME_FILE_FORMAT "%s/h264_annexb/frame-%03d.h264"
+#define FRAME_INTERVAL_MS (40)
+
+/* Converting 3-byte start codes to 4-byte lengths needs spare space */
+#define FRAME_SPARE_BYTES (64)
+
+#define DEFAULT_MIN_TIME_MS (500)
+
+/* The pool holds the sample frames when malloc is wrapped too, so it's sized after the media */
+#define POOL_ALLOCATOR_SIZE (8 * 1024 * 1024)
+
+#define NANOSECONDS_IN_A_MILLISECOND (1000000ULL)
+#define NANOSECONDS_IN_A_SECOND (1000000000ULL)
+
+/* The fragment ACKs that KVS sends for a fragment, in HTTP chunked transfer encoding */
+#define ACK_BUFFERING "{\"EventType\":\"BUFFERING\",\"FragmentTimecode\":1616046513020,\"FragmentNumber\":\"91343852333181432392682062607743920146264380217\"}"
+#define ACK_RECEIVED "{\"EventType\":\"RECEIVED\",\"FragmentTimecode\":1616046513020,\"FragmentNumber\":\"91343852333181432392682062607743920146264380217\"}"
+#define ACK_PERSISTED "{\"EventType\":\"PERSISTED\",\"FragmentTimecode\":1616046513020,\"FragmentNumber\":\"91343852333181432392682062607743920146264380217\"}"
+#define FRAGMENT_ACKS "7d\r\n" ACK_BUFFERING "\r\n7c\r\n" ACK_RECEIVED "\r\n7d\r\n" ACK_PERSISTED "\r\n"
+#define NUM_OF_FRAGMENT_ACKS (3)
+
+#define SIGV4_HOST "kinesisvideo.us-east-1.amazonaws.com"
+#define SIGV4_BODY "{\"StreamName\":\"kvs_example_camera_stream\"}"
+
+typedef struct
+{
+    uint8_t *pAnnexB[MAX_FRAMES];
+    uint8_t *pAvcc[MAX_FRAMES];
+    size_t uAnnexBLen[MAX_FRAMES];
+    size_t uAvccLen[MAX_FRAMES];
+    bool bIsKeyFrame[MAX_FRAMES];
+    size_t uNumOfFrames;
+
+    /* A working buffer that is large enough for any frame */
+    uint8_t *pWorkBuf;
+
+    VideoTrackInfo_t xVideoTrackInfo;
+} Media_t;
+
+/**
+ * A benchmark runs its operation uIterations times, and returns the number of bytes that are processed.
+ */
+typedef size_t (*BenchmarkRun_t)(Media_t *pMedia, size_t uIterations);
+
+typedef struct
+{
+    const char *pcName;
+    BenchmarkRun_t run;
+} Benchmark_t;
+
+static volatile size_t gSink = 0;
+
+#ifdef KVS_USE_POOL_ALLOCATOR
+static char pMemPool[POOL_ALLOCATOR_SIZE];
+#endif /* KVS_USE_POOL_ALLOCATOR */
+
+static uint64_t prvNowNs(void)
+{
+    struct timespec xTs;
+
+    clock_gettime(CLOCK_MONOTONIC, &xTs);
+
+    return (uint64_t)xTs.tv_sec * NANOSECONDS_IN_A_SECOND + (uint64_t)xTs.tv_nsec;
+}
+
+static size_t prvGetNumberOfAllocations(void)
+{
+    size_t uAllocs = 0;
+#ifdef KVS_USE_POOL_ALLOCATOR
+    PoolStats_t xStats = {0};
+
+    poolAllocatorGetStats(&xStats);
+    uAllocs = xStats.uNumberOfAllocations;
+#endif /* KVS_USE_POOL_ALLOCATOR */
+
+    return uAllocs;
+}
+
+/*-----------------------------------------------------------*/
+
+static size_t prvConvertAnnexBToAvcc(Media_t *pMedia, size_t uIterations)
+{
+    size_t uBytes = 0;
+    size_t i = 0;
+    size_t uIdx = 0;
+    uint32_t uAvccLen = 0;
+
+    for (i = 0; i < uIterations; i++)
+    {
+        uIdx = i % pMedia->uNumOfFrames;
+        memcpy(pMedia->pWorkBuf, pMedia->pAnnexB[uIdx], pMedia->uAnnexBLen[uIdx]);
+        NALU_convertAnnexBToAvccInPlace(pMedia->pWorkBuf, (uint32_t)pMedia->uAnnexBLen[uIdx], (uint32_t)pMedia->uAnnexBLen[uIdx] + FRAME_SPARE_BYTES, &uAvccLen);
+        uBytes += pMedia->uAnnexBLen[uIdx];
+    }
+
+    return uBytes;
+}
+
+static size_t prvIsKeyFrame(Media_t *pMedia, size_t uIterations)
+{
+    size_t uBytes = 0;
+    size_t uKeyFrames = 0;
+    size_t i = 0;
+    size_t uIdx = 0;
+
+    for (i = 0; i < uIterations; i++)
+    {
+        uIdx = i % pMedia->uNumOfFrames;
+        uKeyFrames += isKeyFrame(pMedia->pAvcc[uIdx], pMedia->uAvccLen[uIdx]) ? 1 : 0;
+        uBytes += pMedia->uAvccLen[uIdx];
+    }
+    gSink += uKeyFrames;
+
+    return uBytes;
+}
+
+static size_t prvGetNaluFromAnnexBNalus(Media_t *pMedia, size_t uIterations)
+{
+    size_t uBytes = 0;
+    size_t i = 0;
+    size_t uIdx = 0;
+    uint8_t *pNalu = NULL;
+    size_t uNaluLen = 0;
+
+    /* Most frames don't have SPS, so it's mostly a scan over the whole frame. */
+    for (i = 0; i < uIterations; i++)
+    {
+        uIdx = i % pMedia->uNumOfFrames;
+        NALU_getNaluFromAnnexBNalus(pMedia->pAnnexB[uIdx], pMedia->uAnnexBLen[uIdx], NALU_TYPE_SPS, &pNalu, &uNaluLen);
+        uBytes += pMedia->uAnnexBLen[uIdx];
+    }
+    gSink += uNaluLen;
+
+    return uBytes;
+}
+
+static size_t prvGetNaluFromAvccNalus(Media_t *pMedia, size_t uIterations)
+{
+    size_t uBytes = 0;
+    size_t i = 0;
+    size_t uIdx = 0;
+    uint8_t *pNalu = NULL;
+    size_t uNaluLen = 0;
+
+    for (i = 0; i < uIterations; i++)
+    {
+        uIdx = i % pMedia->uNumOfFrames;
+        NALU_getNaluFromAvccNalus(pMedia->pAvcc[uIdx], pMedia->uAvccLen[uIdx], NALU_TYPE_SPS, &pNalu, &uNaluLen);
+        uBytes += pMedia->uAvccLen[uIdx];
+    }
+    gSink += uNaluLen;
+
+    return uBytes;
+}
+
+static size_t prvInitializeClusterHdr(Media_t *pMedia, size_t uIterations)
+{
+    size_t uBytes = 0;
+    size_t i = 0;
+    size_t uIdx = 0;
+    uint8_t pMkvHeader[64];
+    MkvClusterType_t xType = MKV_SIMPLE_BLOCK;
+    uint64_t uTimestamp = 1616046513020ULL;
+    uint64_t uClusterTimestamp = uTimestamp;
+
+    for (i = 0; i < uIterations; i++)
+    {
+        uIdx = i % pMedia->uNumOfFrames;
+        if (pMedia->bIsKeyFrame[uIdx])
+        {
+            xType = MKV_CLUSTER;
+            uClusterTimestamp = uTimestamp;
+        }
+        else
+        {
+            xType = MKV_SIMPLE_BLOCK;
+        }
+        Mkv_initializeClusterHdr(pMkvHeader, sizeof(pMkvHeader), xType, pMedia->uAvccLen[uIdx], TRACK_VIDEO, pMedia->bIsKeyFrame[uIdx], uTimestamp,
+                                 (uint16_t)(uTimestamp - uClusterTimestamp));
+        uBytes += Mkv_getClusterHdrLen(xType, pMedia->uAvccLen[uIdx]);
+        uTimestamp += FRAME_INTERVAL_MS;
+    }
+
+    return uBytes;
+}
+
+static size_t prvAwsSigV4Sign(Media_t *pMedia, size_t uIterations)
+{
+    size_t uBytes = 0;
+    size_t i = 0;
+    AwsSigV4Handle xSigV4Handle = NULL;
+
+    (void)pMedia;
+
+    /* It signs a describeStream request the same way as the RESTful APIs do. */
+    for (i = 0; i < uIterations; i++)
+    {
+        if ((xSigV4Handle = AwsSigV4_Create("POST", "/describeStream", "")) != NULL)
+        {
+            AwsSigV4_AddCanonicalHeader(xSigV4Handle, "connection", "Keep-Alive");
+            AwsSigV4_AddCanonicalHeader(xSigV4Handle, "host", SIGV4_HOST);
+            AwsSigV4_AddCanonicalHeader(xSigV4Handle, "user-agent", "kvs-embedded-c");
+            AwsSigV4_AddCanonicalHeader(xSigV4Handle, "x-amz-date", "20210318T053513Z");
+            AwsSigV4_AddCanonicalBody(xSigV4Handle, SIGV4_BODY, strlen(SIGV4_BODY));
+            AwsSigV4_Sign(xSigV4Handle, "AKIDEXAMPLE", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", "us-east-1", "kinesisvideo", "20210318T053513Z");
+            gSink += strlen(AwsSigV4_GetAuthorization(xSigV4Handle));
+            AwsSigV4_Terminate(xSigV4Handle);
+        }
+        uBytes += strlen(SIGV4_BODY);
+    }
+
+    return uBytes;
+}
+
+static size_t prvStreamAddAndPopHelper(Media_t *pMedia, size_t uIterations, size_t uReservedDataFrames)
+{
+    size_t uBytes = 0;
+    size_t i = 0;
+    size_t uIdx = 0;
+    StreamHandle xStreamHandle = NULL;
+    DataFrameHandle xDataFrameHandle = NULL;
+    DataFrameIn_t xDataFrameIn = {0};
+
+    if ((xStreamHandle = Kvs_streamCreate(&(pMedia->xVideoTrackInfo), NULL)) != NULL)
+    {
+        if (uReservedDataFrames > 0)
+        {
+            Kvs_streamReserveDataFrames(xStreamHandle, uReservedDataFrames);
+        }
+
+        for (i = 0; i < uIterations; i++)
+        {
+            uIdx = i % pMedia->uNumOfFrames;
+            xDataFrameIn.pData = (char *)pMedia->pAvcc[uIdx];
+            xDataFrameIn.uDataLen = pMedia->uAvccLen[uIdx];
+            xDataFrameIn.bIsKeyFrame = pMedia->bIsKeyFrame[uIdx];
+            xDataFrameIn.uTimestampMs = (uint64_t)i * FRAME_INTERVAL_MS;
+            xDataFrameIn.xTrackType = TRACK_VIDEO;
+            xDataFrameIn.xClusterType = (xDataFrameIn.bIsKeyFrame) ? MKV_CLUSTER : MKV_SIMPLE_BLOCK;
+
+            if (Kvs_streamAddDataFrame(xStreamHandle, &xDataFrameIn) != NULL && (xDataFrameHandle = Kvs_streamPop(xStreamHandle)) != NULL)
+            {
+                Kvs_dataFrameTerminate(xDataFrameHandle);
+            }
+            uBytes += pMedia->uAvccLen[uIdx];
+        }
+
+        Kvs_streamTermintate(xStreamHandle);
+    }
+
+    return uBytes;
+}
+
+static size_t prvStreamAddAndPop(Media_t *pMedia, size_t uIterations)
+{
+    return prvStreamAddAndPopHelper(pMedia, uIterations, 0);
+}
+
+static size_t prvStreamAddAndPopReserved(Media_t *pMedia, size_t uIterations)
+{
+    return prvStreamAddAndPopHelper(pMedia, uIterations, 1);
+}
+
+static size_t prvFrameRingBufferEnqueueAndDequeue(Media_t *pMedia, size_t uIterations)
+{
+    size_t uBytes = 0;
+    size_t i = 0;
+    size_t uIdx = 0;
+    FrameRingBufferHandle xRingBuffer = NULL;
+
+    if ((xRingBuffer = FrameRingBuffer_create(pMedia->uNumOfFrames)) != NULL)
+    {
+        for (i = 0; i < uIterations; i++)
+        {
+            uIdx = i % pMedia->uNumOfFrames;
+            if (FrameRingBuffer_enqueue(xRingBuffer, pMedia->pAvcc[uIdx], pMedia->uAvccLen[uIdx], NULL) != NULL)
+            {
+                FrameRingBuffer_dequeue(xRingBuffer);
+            }
+            uBytes += pMedia->uAvccLen[uIdx];
+        }
+
+        FrameRingBuffer_terminate(xRingBuffer);
+    }
+
+    return uBytes;
+}
+
+static size_t prvFragmentAckParse(Media_t *pMedia, size_t uIterations)
+{
+    size_t uBytes = 0;
+    size_t i = 0;
+    const uint8_t *pAcks = (const uint8_t *)FRAGMENT_ACKS;
+    size_t uAcksLen = strlen(FRAGMENT_ACKS);
+    size_t uIdx = 0;
+    size_t uConsumedLen = 0;
+    bool bAckAvailable = false;
+    FragmentAckParser_t xParser;
+    FragmentAckInfo_t xAck;
+
+    (void)pMedia;
+
+    FragmentAckParser_init(&xParser);
+
+    /* One operation parses one fragment ACK. */
+    for (i = 0; i < uIterations; i++)
+    {
+        bAckAvailable = false;
+        while (!bAckAvailable)
+        {
+            if (FragmentAckParser_parse(&xParser, pAcks + uIdx, uAcksLen - uIdx, &uConsumedLen, &bAckAvailable, &xAck) != KVS_ERRNO_NONE)
+            {
+                break;
+            }
+            uBytes += uConsumedLen;
+            uIdx = (uIdx + uConsumedLen) % uAcksLen;
+        }
+        gSink += xAck.eventType;
+    }
+
+    return uBytes;
+}
+
+static const Benchmark_t benchmarks[] = {
+    {"NALU_convertAnnexBToAvccInPlace", prvConvertAnnexBToAvcc},
+    {"isKeyFrame", prvIsKeyFrame},
+    {"NALU_getNaluFromAnnexBNalus", prvGetNaluFromAnnexBNalus},
+    {"NALU_getNaluFromAvccNalus", prvGetNaluFromAvccNalus},
+    {"Mkv_initializeClusterHdr", prvInitializeClusterHdr},
+    {"AwsSigV4_Sign", prvAwsSigV4Sign},
+    {"Kvs_streamAddDataFrame+Pop", prvStreamAddAndPop},
+    {"Kvs_streamAddDataFrame+Pop(reserved)", prvStreamAddAndPopReserved},
+    {"FrameRingBuffer_enqueue+dequeue", prvFrameRingBufferEnqueueAndDequeue},
+    {"FragmentAckParser_parse", prvFragmentAckParse},
+};
+
+#define NUM_OF_BENCHMARKS (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+/*-----------------------------------------------------------*/
+
+static uint8_t *prvReadFile(const char *pcPath, size_t *puLen)
+{
+    FILE *fp = NULL;
+    long len = 0;
+    uint8_t *pData = NULL;
+
+    if ((fp = fopen(pcPath, "rb")) != NULL)
+    {
+        fseek(fp, 0, SEEK_END);
+        len = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if (len > 0 && (pData = (uint8_t *)malloc((size_t)len)) != NULL && fread(pData, 1, (size_t)len, fp) != (size_t)len)
+        {
+            free(pData);
+            pData = NULL;
+        }
+        fclose(fp);
+    }
+    *puLen = (pData == NULL) ? 0 : (size_t)len;
+
+    return pData;
+}
+
+static void prvMediaTerminate(Media_t *pMedia)
+{
+    size_t i = 0;
+
+    for (i = 0; i < pMedia->uNumOfFrames; i++)
+    {
+        free(pMedia->pAnnexB[i]);
+        free(pMedia->pAvcc[i]);
+    }
+    free(pMedia->pWorkBuf);
+    if (pMedia->xVideoTrackInfo.pCodecPrivate != NULL)
+    {
+        kvsFree(pMedia->xVideoTrackInfo.pCodecPrivate);
+    }
+    memset(pMedia, 0, sizeof(Media_t));
+}
+
+/**
+ * Load the sample H.264 frames, and prepare their AVCC copies and the video track info.
+ */
+static int prvMediaLoad(Media_t *pMedia, const char *pcMediaDir)
+{
+    int res = KVS_ERRNO_NONE;
+    char pcPath[512];
+    size_t uMaxLen = 0;
+    uint8_t *pFrame = NULL;
+    size_t uLen = 0;
+    uint32_t uAvccLen = 0;
+    uint8_t *pSps = NULL;
+    size_t uSpsLen = 0;
+    size_t uCodecPrivateLen = 0;
+
+    memset(pMedia, 0, sizeof(Media_t));
+
+    while (pMedia->uNumOfFrames < MAX_FRAMES)
+    {
+        snprintf(pcPath, sizeof(pcPath), FRAME_FILE_FORMAT, pcMediaDir, (int)pMedia->uNumOfFrames + 1);
+        if ((pFrame = prvReadFile(pcPath, &uLen)) == NULL)
+        {
+            break;
+        }
+
+        pMedia->pAnnexB[pMedia->uNumOfFrames] = pFrame;
+        pMedia->uAnnexBLen[pMedia->uNumOfFrames] = uLen;
+        uMaxLen = (uLen > uMaxLen) ? uLen : uMaxLen;
+
+        if ((pMedia->pAvcc[pMedia->uNumOfFrames] = (uint8_t *)malloc(uLen + FRAME_SPARE_BYTES)) == NULL)
+        {
+            res = KVS_ERROR_OUT_OF_MEMORY;
+            break;
+        }
+        memcpy(pMedia->pAvcc[pMedia->uNumOfFrames], pFrame, uLen);
+        if ((res = NALU_convertAnnexBToAvccInPlace(pMedia->pAvcc[pMedia->uNumOfFrames], (uint32_t)uLen, (uint32_t)uLen + FRAME_SPARE_BYTES, &uAvccLen)) != KVS_ERRNO_NONE)
+        {
+            break;
+        }
+        pMedia->uAvccLen[pMedia->uNumOfFrames] = uAvccLen;
+        pMedia->bIsKeyFrame[pMedia->uNumOfFrames] = isKeyFrame(pMedia->pAvcc[pMedia->uNumOfFrames], uAvccLen);
+
+        pMedia->uNumOfFrames++;
+    }
+
+    if (res != KVS_ERRNO_NONE)
+    {
+        /* Propagate the res error */
+    }
+    else if (pMedia->uNumOfFrames == 0)
+    {
+        printf("No frame is found in %s\n", pcMediaDir);
+        res = KVS_ERROR_INVALID_ARGUMENT;
+    }
+    else if ((pMedia->pWorkBuf = (uint8_t *)malloc(uMaxLen + FRAME_SPARE_BYTES)) == NULL)
+    {
+        res = KVS_ERROR_OUT_OF_MEMORY;
+    }
+    else if (
+        (res = NALU_getNaluFromAnnexBNalus(pMedia->pAnnexB[0], pMedia->uAnnexBLen[0], NALU_TYPE_SPS, &pSps, &uSpsLen)) != KVS_ERRNO_NONE ||
+        (res = NALU_getH264VideoResolutionFromSps(pSps, uSpsLen, &(pMedia->xVideoTrackInfo.uWidth), &(pMedia->xVideoTrackInfo.uHeight))) != KVS_ERRNO_NONE ||
+        (res = Mkv_generateH264CodecPrivateDataFromAnnexBNalus(pMedia->pAnnexB[0], pMedia->uAnnexBLen[0], &(pMedia->xVideoTrackInfo.pCodecPrivate), &uCodecPrivateLen)) !=
+            KVS_ERRNO_NONE)
+    {
+        printf("The first frame is not a key frame with SPS and PPS\n");
+        /* Propagate the res error */
+    }
+    else
+    {
+        pMedia->xVideoTrackInfo.pTrackName = "kvs video track";
+        pMedia->xVideoTrackInfo.pCodecName = "V_MPEG4/ISO/AVC";
+        pMedia->xVideoTrackInfo.uCodecPrivateLen = (uint32_t)uCodecPrivateLen;
+    }
+
+    if (res != KVS_ERRNO_NONE)
+    {
+        prvMediaTerminate(pMedia);
+    }
+
+    return res;
+}
+
+/**
+ * Run a benchmark with increasing iterations until it runs for the minimum time, and print the result of the last run.
+ */
+static void prvRunBenchmark(const Benchmark_t *pBenchmark, Media_t *pMedia, uint64_t uMinTimeNs)
+{
+    size_t uIterations = 1;
+    size_t uBytes = 0;
+    size_t uAllocs = 0;
+    uint64_t uStartNs = 0;
+    uint64_t uElapsedNs = 0;
+
+    /* Warm up caches and lazy initializations */
+    pBenchmark->run(pMedia, pMedia->uNumOfFrames);
+
+    while (1)
+    {
+        uAllocs = prvGetNumberOfAllocations();
+        uStartNs = prvNowNs();
+        uBytes = pBenchmark->run(pMedia, uIterations);
+        uElapsedNs = prvNowNs() - uStartNs;
+        uAllocs = prvGetNumberOfAllocations() - uAllocs;
+
+        if (uElapsedNs >= uMinTimeNs)
+        {
+            break;
+        }
+        else if (uElapsedNs < uMinTimeNs / 100)
+        {
+            uIterations *= 10;
+        }
+        else
+        {
+            /* Aim a bit over the minimum time, so it's unlikely to take another run. */
+            uIterations = (size_t)((double)uIterations * (double)uMinTimeNs * 1.2 / (double)uElapsedNs) + 1;
+        }
+    }
+
+#ifdef KVS_USE_POOL_ALLOCATOR
+    printf("%-36s %12zu %12.1f %12.2f %12.3f\n", pBenchmark->pcName, uIterations, (double)uElapsedNs / (double)uIterations,
+           (double)uBytes * NANOSECONDS_IN_A_SECOND / (double)uElapsedNs / (1024 * 1024), (double)uAllocs / (double)uIterations);
+#else
+    printf("%-36s %12zu %12.1f %12.2f %12s\n", pBenchmark->pcName, uIterations, (double)uElapsedNs / (double)uIterations,
+           (double)uBytes * NANOSECONDS_IN_A_SECOND / (double)uElapsedNs / (1024 * 1024), "n/a");
+#endif /* KVS_USE_POOL_ALLOCATOR */
+}
+
+static void prvPrintUsage(const char *pcProgram)
+{
+    printf("Usage: %s [-m media_dir] [-t min_time_ms] [-f name_filter]\n", pcProgram);
+}
+
+int main(int argc, char *argv[])
+{
+    Media_t xMedia;
+    const char *pcMediaDir = KVS_MEDIA_DIR;
+    const char *pcFilter = NULL;
+    uint64_t uMinTimeMs = DEFAULT_MIN_TIME_MS;
+    size_t i = 0;
+    int idx = 0;
+
+    for (idx = 1; idx + 1 < argc; idx += 2)
+    {
+        if (strcmp(argv[idx], "-m") == 0)
+        {
+            pcMediaDir = argv[idx + 1];
+        }
+        else if (strcmp(argv[idx], "-t") == 0)
+        {
+            uMinTimeMs = strtoull(argv[idx + 1], NULL, 10);
+        }
+        else if (strcmp(argv[idx], "-f") == 0)
+        {
+            pcFilter = argv[idx + 1];
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (idx < argc)
+    {
+        prvPrintUsage(argv[0]);
+        return -1;
+    }
+
+#ifdef KVS_USE_POOL_ALLOCATOR
+    poolAllocatorInit((void *)pMemPool, sizeof(pMemPool));
+#endif /* KVS_USE_POOL_ALLOCATOR */
+
+    if (prvMediaLoad(&xMedia, pcMediaDir) != KVS_ERRNO_NONE)
+    {
+        printf("Failed to load media from %s\n", pcMediaDir);
+        return -1;
+    }
+
+    printf("%zu frames are loaded from %s\n", xMedia.uNumOfFrames, pcMediaDir);
+    printf("%-36s %12s %12s %12s %12s\n", "Benchmark", "Iterations", "ns/op", "MiB/s", "allocs/op");
+
+    for (i = 0; i < NUM_OF_BENCHMARKS; i++)
+    {
+        if (pcFilter == NULL || strstr(benchmarks[i].pcName, pcFilter) != NULL)
+        {
+            prvRunBenchmark(&(benchmarks[i]), &xMedia, uMinTimeMs * NANOSECONDS_IN_A_MILLISECOND);
+        }
+    }
+
+    prvMediaTerminate(&xMedia);
+
+#ifdef KVS_USE_POOL_ALLOCATOR
+    poolAllocatorDeinit();
+#endif /* KVS_USE_POOL_ALLOCATOR */
+
+    return 0;
+}
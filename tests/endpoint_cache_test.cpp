@@ -0,0 +1,89 @@
+#ifdef __cplusplus
+extern "C" {
+#include <stddef.h>
+
+#include "kvs/errors.h"
+#include "misc/endpoint_cache.h"
+#include "os/allocator.h"
+}
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#define TEST_CACHE_FILE "endpoint_cache_test.json"
+#define TEST_HOST "kinesisvideo.us-east-1.amazonaws.com"
+#define TEST_STREAM_NAME "endpoint-cache-test-stream"
+#define TEST_ENDPOINT "s-1234abcd.kinesisvideo.us-east-1.amazonaws.com"
+#define TEST_TTL_SEC (60)
+
+TEST(EndpointCache, store_and_load)
+{
+    char *pcEndpoint = NULL;
+
+    ASSERT_EQ(0, EndpointCache_store(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, TEST_ENDPOINT, TEST_TTL_SEC));
+    ASSERT_EQ(0, EndpointCache_load(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, &pcEndpoint));
+    EXPECT_STREQ(TEST_ENDPOINT, pcEndpoint);
+    kvsFree(pcEndpoint);
+
+    EndpointCache_invalidate(TEST_CACHE_FILE);
+}
+
+TEST(EndpointCache, store_replaces_cache_file)
+{
+    char *pcEndpoint = NULL;
+    FILE *fp = NULL;
+
+    ASSERT_EQ(0, EndpointCache_store(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, "s-old.kinesisvideo.us-east-1.amazonaws.com", TEST_TTL_SEC));
+    ASSERT_EQ(0, EndpointCache_store(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, TEST_ENDPOINT, TEST_TTL_SEC));
+    ASSERT_EQ(0, EndpointCache_load(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, &pcEndpoint));
+    EXPECT_STREQ(TEST_ENDPOINT, pcEndpoint);
+    kvsFree(pcEndpoint);
+
+    /* The temporary file is renamed over the cache file, so nothing is left behind. */
+    EXPECT_EQ(nullptr, fp = fopen(TEST_CACHE_FILE ".tmp", "rb"));
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+
+    EndpointCache_invalidate(TEST_CACHE_FILE);
+}
+
+TEST(EndpointCache, miss)
+{
+    char *pcEndpoint = NULL;
+    FILE *fp = NULL;
+
+    EndpointCache_invalidate(TEST_CACHE_FILE);
+    EXPECT_EQ(KVS_ERROR_ENDPOINT_CACHE_MISS, EndpointCache_load(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, &pcEndpoint));
+
+    /* The cache is for one host and one stream. */
+    ASSERT_EQ(0, EndpointCache_store(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, TEST_ENDPOINT, TEST_TTL_SEC));
+    EXPECT_EQ(KVS_ERROR_ENDPOINT_CACHE_MISS, EndpointCache_load(TEST_CACHE_FILE, "kinesisvideo.us-west-2.amazonaws.com", TEST_STREAM_NAME, &pcEndpoint));
+    EXPECT_EQ(KVS_ERROR_ENDPOINT_CACHE_MISS, EndpointCache_load(TEST_CACHE_FILE, TEST_HOST, "another-stream", &pcEndpoint));
+
+    /* Expired */
+    ASSERT_EQ(0, EndpointCache_store(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, TEST_ENDPOINT, 0));
+    EXPECT_EQ(KVS_ERROR_ENDPOINT_CACHE_MISS, EndpointCache_load(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, &pcEndpoint));
+
+    /* Corrupted */
+    ASSERT_NE(nullptr, fp = fopen(TEST_CACHE_FILE, "wb"));
+    fputs("{\"host\":", fp);
+    fclose(fp);
+    EXPECT_EQ(KVS_ERROR_ENDPOINT_CACHE_MISS, EndpointCache_load(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, &pcEndpoint));
+
+    EXPECT_EQ(nullptr, pcEndpoint);
+    EndpointCache_invalidate(TEST_CACHE_FILE);
+}
+
+TEST(EndpointCache, invalid_argument)
+{
+    char *pcEndpoint = NULL;
+
+    EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, EndpointCache_load(NULL, TEST_HOST, TEST_STREAM_NAME, &pcEndpoint));
+    EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, EndpointCache_load(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, NULL));
+    EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, EndpointCache_store(TEST_CACHE_FILE, TEST_HOST, TEST_STREAM_NAME, NULL, TEST_TTL_SEC));
+}
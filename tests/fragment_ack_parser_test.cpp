@@ -0,0 +1,107 @@
+#ifdef __cplusplus
+extern "C" {
+#include "restful/kvs/fragment_ack_parser.h"
+}
+#endif
+
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#define ACK_PERSISTED "{\"EventType\":\"PERSISTED\",\"FragmentTimecode\":1616046513020,\"FragmentNumber\":\"91343852333181432392682062607743920146264380217\"}"
+#define ACK_ERROR "{\"EventType\":\"ERROR\",\"FragmentTimecode\":1616046513020,\"FragmentNumber\":\"9134\",\"ErrorId\":4002,\"ErrorCode\":\"TIMECODE_OUT_OF_RANGE\"}"
+#define ACK_IDLE "{\"EventType\":\"IDLE\"}"
+
+static size_t parseAll(FragmentAckParser_t *pxParser, const char *pcSrc, size_t uLen, FragmentAckInfo_t *pxAcks, size_t uAcksMax)
+{
+    size_t uAckCount = 0;
+    size_t uConsumedLen = 0;
+    bool bAckAvailable = false;
+    FragmentAckInfo_t xAck = {eUnknown, 0, 0};
+
+    while (uLen > 0)
+    {
+        FragmentAckParser_parse(pxParser, (const uint8_t *)pcSrc, uLen, &uConsumedLen, &bAckAvailable, &xAck);
+        if (bAckAvailable && uAckCount < uAcksMax)
+        {
+            pxAcks[uAckCount++] = xAck;
+        }
+        pcSrc += uConsumedLen;
+        uLen -= uConsumedLen;
+    }
+
+    return uAckCount;
+}
+
+TEST(FragmentAckParser_parse, invalid_parameter)
+{
+    FragmentAckParser_t xParser;
+    const char *pcSrc = "14\r\n" ACK_IDLE "\r\n";
+    size_t uConsumedLen = 0;
+    bool bAckAvailable = false;
+    FragmentAckInfo_t xAck;
+
+    FragmentAckParser_init(&xParser);
+
+    EXPECT_NE(0, FragmentAckParser_parse(NULL, (const uint8_t *)pcSrc, strlen(pcSrc), &uConsumedLen, &bAckAvailable, &xAck));
+    EXPECT_NE(0, FragmentAckParser_parse(&xParser, NULL, strlen(pcSrc), &uConsumedLen, &bAckAvailable, &xAck));
+    EXPECT_NE(0, FragmentAckParser_parse(&xParser, (const uint8_t *)pcSrc, strlen(pcSrc), NULL, &bAckAvailable, &xAck));
+    EXPECT_NE(0, FragmentAckParser_parse(&xParser, (const uint8_t *)pcSrc, strlen(pcSrc), &uConsumedLen, NULL, &xAck));
+    EXPECT_NE(0, FragmentAckParser_parse(&xParser, (const uint8_t *)pcSrc, strlen(pcSrc), &uConsumedLen, &bAckAvailable, NULL));
+}
+
+TEST(FragmentAckParser_parse, multiple_acks_in_one_buffer)
+{
+    FragmentAckParser_t xParser;
+    const char *pcSrc = "14\r\n" ACK_IDLE "\r\n"
+                        "7d\r\n" ACK_PERSISTED "\r\n"
+                        "81\r\n" ACK_ERROR "\r\n";
+    FragmentAckInfo_t xAcks[4];
+
+    FragmentAckParser_init(&xParser);
+
+    ASSERT_EQ(3, parseAll(&xParser, pcSrc, strlen(pcSrc), xAcks, 4));
+    EXPECT_EQ(eIdle, xAcks[0].eventType);
+    EXPECT_EQ(0, xAcks[0].uFragmentTimecode);
+    EXPECT_EQ(ePersisted, xAcks[1].eventType);
+    EXPECT_EQ(1616046513020ULL, xAcks[1].uFragmentTimecode);
+    EXPECT_EQ(0, xAcks[1].uErrorId);
+    EXPECT_EQ(eError, xAcks[2].eventType);
+    EXPECT_EQ(1616046513020ULL, xAcks[2].uFragmentTimecode);
+    EXPECT_EQ(4002, xAcks[2].uErrorId);
+}
+
+TEST(FragmentAckParser_parse, ack_split_at_every_position)
+{
+    const char *pcSrc = "7d\r\n" ACK_PERSISTED "\r\n";
+    size_t uLen = strlen(pcSrc);
+    size_t uSplit = 0;
+    FragmentAckParser_t xParser;
+    FragmentAckInfo_t xAcks[2];
+
+    for (uSplit = 1; uSplit < uLen; uSplit++)
+    {
+        FragmentAckParser_init(&xParser);
+
+        size_t uAckCount = parseAll(&xParser, pcSrc, uSplit, xAcks, 2);
+        uAckCount += parseAll(&xParser, pcSrc + uSplit, uLen - uSplit, xAcks + uAckCount, 2 - uAckCount);
+
+        ASSERT_EQ(1, uAckCount) << "split at " << uSplit;
+        EXPECT_EQ(ePersisted, xAcks[0].eventType);
+        EXPECT_EQ(1616046513020ULL, xAcks[0].uFragmentTimecode);
+    }
+}
+
+TEST(FragmentAckParser_parse, skip_malformed_chunk)
+{
+    FragmentAckParser_t xParser;
+    const char *pcSrc = "6\r\n{\"a\"x}\r\n"
+                        "zz\r\n"
+                        "2a\r\n{\"Extra\":{\"k\":[1,\"}\"]},\"EventType\":\"IDLE\"}\r\n";
+    FragmentAckInfo_t xAcks[2];
+
+    FragmentAckParser_init(&xParser);
+
+    ASSERT_EQ(1, parseAll(&xParser, pcSrc, strlen(pcSrc), xAcks, 2));
+    EXPECT_EQ(eIdle, xAcks[0].eventType);
+}
@@ -1,9 +1,14 @@
 #ifdef __cplusplus
 extern "C" {
+#include "kvs/errors.h"
 #include "net/http_parser_adapter.h"
 }
 #endif
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <gtest/gtest.h>
 
 TEST(HttpParser_parseHttpResponse, invalid_parameter)
@@ -65,4 +70,143 @@ TEST(HttpParser_parseHttpResponse, valid_parameter_without_body)
     EXPECT_EQ(200, uStatusCode);
     EXPECT_EQ(0, uBodyLen);
     EXPECT_EQ(NULL, pBodyLoc);
-}
\ No newline at end of file
+}
+static int prvFeedByteByByte(HttpParserHandle xHttpParser, const char *pHttp, size_t uHttpLen, size_t *puTotalConsumedLen)
+{
+    int res = 0;
+    size_t uConsumedLen = 0;
+    size_t i = 0;
+
+    *puTotalConsumedLen = 0;
+    for (i = 0; i < uHttpLen && res == 0 && !HttpParser_isMessageComplete(xHttpParser); i++)
+    {
+        res = HttpParser_execute(xHttpParser, pHttp + i, 1, &uConsumedLen);
+        *puTotalConsumedLen += uConsumedLen;
+    }
+
+    return res;
+}
+
+TEST(HttpParser_execute, content_length_byte_by_byte)
+{
+    const char *pHttp = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 90\r\n\r\n{\"StreamInfo\": {\"Status\": \"ACTIVE\",\"StreamARN\": \"xxxxxxxx\",\"StreamName\": \"my-kvs-stream\"}}";
+    size_t uHttpLen = 161;
+    size_t uConsumedLen = 0;
+    const char *pBodyLoc = NULL;
+    size_t uBodyLen = 0;
+    HttpParserHandle xHttpParser = HttpParser_create();
+    ASSERT_TRUE(xHttpParser != NULL);
+
+    EXPECT_EQ(0, prvFeedByteByByte(xHttpParser, pHttp, uHttpLen, &uConsumedLen));
+    EXPECT_EQ(uHttpLen, uConsumedLen);
+    EXPECT_TRUE(HttpParser_isHeadersComplete(xHttpParser));
+    EXPECT_TRUE(HttpParser_isMessageComplete(xHttpParser));
+    EXPECT_FALSE(HttpParser_isChunked(xHttpParser));
+    EXPECT_EQ(200, HttpParser_getStatusCode(xHttpParser));
+    EXPECT_EQ(0, HttpParser_getBody(xHttpParser, &pBodyLoc, &uBodyLen));
+    EXPECT_EQ(90, uBodyLen);
+    EXPECT_EQ(0, memcmp(pBodyLoc, pHttp + 71, uBodyLen));
+
+    HttpParser_terminate(xHttpParser);
+}
+
+TEST(HttpParser_execute, chunked_body)
+{
+    const char *pHttp = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n7;ext=1\r\n, world\r\n0\r\n\r\nHTTP/1.1";
+    size_t uHttpLen = strlen(pHttp);
+    size_t uConsumedLen = 0;
+    const char *pBodyLoc = NULL;
+    size_t uBodyLen = 0;
+    HttpParserHandle xHttpParser = HttpParser_create();
+    ASSERT_TRUE(xHttpParser != NULL);
+
+    EXPECT_EQ(0, HttpParser_execute(xHttpParser, pHttp, 50, &uConsumedLen));
+    EXPECT_EQ(50, uConsumedLen);
+    EXPECT_TRUE(HttpParser_isHeadersComplete(xHttpParser));
+    EXPECT_TRUE(HttpParser_isChunked(xHttpParser));
+    EXPECT_FALSE(HttpParser_isMessageComplete(xHttpParser));
+
+    /* The parser stops at the end of the response. */
+    EXPECT_EQ(0, HttpParser_execute(xHttpParser, pHttp + 50, uHttpLen - 50, &uConsumedLen));
+    EXPECT_EQ(uHttpLen - 50 - 8, uConsumedLen);
+    EXPECT_TRUE(HttpParser_isMessageComplete(xHttpParser));
+    EXPECT_EQ(0, HttpParser_getBody(xHttpParser, &pBodyLoc, &uBodyLen));
+    EXPECT_EQ(12, uBodyLen);
+    EXPECT_EQ(0, memcmp(pBodyLoc, "hello, world", uBodyLen));
+
+    HttpParser_terminate(xHttpParser);
+}
+
+TEST(HttpParser_execute, continue_then_reset)
+{
+    const char *pHttp = "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 403 Forbidden\r\nContent-Length: 2\r\n\r\n{}";
+    size_t uHttpLen = strlen(pHttp);
+    size_t uConsumedLen = 0;
+    const char *pBodyLoc = NULL;
+    size_t uBodyLen = 0;
+    HttpParserHandle xHttpParser = HttpParser_create();
+    ASSERT_TRUE(xHttpParser != NULL);
+
+    EXPECT_EQ(0, HttpParser_execute(xHttpParser, pHttp, uHttpLen, &uConsumedLen));
+    EXPECT_EQ(25, uConsumedLen);
+    EXPECT_TRUE(HttpParser_isMessageComplete(xHttpParser));
+    EXPECT_EQ(100, HttpParser_getStatusCode(xHttpParser));
+
+    HttpParser_reset(xHttpParser);
+    EXPECT_EQ(0, HttpParser_execute(xHttpParser, pHttp + 25, uHttpLen - 25, &uConsumedLen));
+    EXPECT_EQ(uHttpLen - 25, uConsumedLen);
+    EXPECT_TRUE(HttpParser_isMessageComplete(xHttpParser));
+    EXPECT_EQ(403, HttpParser_getStatusCode(xHttpParser));
+    EXPECT_EQ(0, HttpParser_getBody(xHttpParser, &pBodyLoc, &uBodyLen));
+    EXPECT_EQ(2, uBodyLen);
+
+    HttpParser_terminate(xHttpParser);
+}
+
+TEST(HttpParser_execute, body_too_large)
+{
+    char pHttp[128 + HTTP_PARSER_MAX_BODY_SIZE + 1];
+    size_t uHeaderLen = snprintf(pHttp, 128, "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", HTTP_PARSER_MAX_BODY_SIZE + 1);
+    size_t uConsumedLen = 0;
+    HttpParserHandle xHttpParser = HttpParser_create();
+    ASSERT_TRUE(xHttpParser != NULL);
+
+    memset(pHttp + uHeaderLen, 'a', HTTP_PARSER_MAX_BODY_SIZE + 1);
+
+    /* The body up to the max size is accepted, the byte after it fails the parser. */
+    EXPECT_EQ(0, HttpParser_execute(xHttpParser, pHttp, uHeaderLen + HTTP_PARSER_MAX_BODY_SIZE, &uConsumedLen));
+    EXPECT_FALSE(HttpParser_isMessageComplete(xHttpParser));
+    EXPECT_EQ(KVS_ERROR_HTTP_RSP_BODY_TOO_LARGE, HttpParser_execute(xHttpParser, pHttp + uHeaderLen + HTTP_PARSER_MAX_BODY_SIZE, 1, &uConsumedLen));
+
+    HttpParser_terminate(xHttpParser);
+}
+
+TEST(HttpParser_execute, chunked_body_too_large)
+{
+    char pHttp[128];
+    size_t uHttpLen = snprintf(pHttp, sizeof(pHttp), "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n%x\r\n", HTTP_PARSER_MAX_BODY_SIZE + 1);
+    char *pChunk = (char *)malloc(HTTP_PARSER_MAX_BODY_SIZE + 1);
+    size_t uConsumedLen = 0;
+    HttpParserHandle xHttpParser = HttpParser_create();
+    ASSERT_TRUE(xHttpParser != NULL);
+    ASSERT_TRUE(pChunk != NULL);
+
+    memset(pChunk, 'a', HTTP_PARSER_MAX_BODY_SIZE + 1);
+    EXPECT_EQ(0, HttpParser_execute(xHttpParser, pHttp, uHttpLen, &uConsumedLen));
+    EXPECT_EQ(KVS_ERROR_HTTP_RSP_BODY_TOO_LARGE, HttpParser_execute(xHttpParser, pChunk, HTTP_PARSER_MAX_BODY_SIZE + 1, &uConsumedLen));
+
+    free(pChunk);
+    HttpParser_terminate(xHttpParser);
+}
+
+TEST(HttpParser_execute, invalid_status_line)
+{
+    size_t uConsumedLen = 0;
+    HttpParserHandle xHttpParser = HttpParser_create();
+    ASSERT_TRUE(xHttpParser != NULL);
+
+    EXPECT_NE(0, HttpParser_execute(NULL, "HTTP/1.1 200 OK\r\n", 17, &uConsumedLen));
+    EXPECT_NE(0, HttpParser_execute(xHttpParser, "SSH-2.0-OpenSSH\r\n", 17, &uConsumedLen));
+
+    HttpParser_terminate(xHttpParser);
+}
@@ -0,0 +1,78 @@
+#ifdef __cplusplus
+extern "C" {
+#include "kvs/latency_histogram.h"
+}
+#endif
+
+#include <gtest/gtest.h>
+
+TEST(LatencyHistogram_record, counts_sum_min_and_max)
+{
+    LatencyHistogram_t xHistogram;
+
+    LatencyHistogram_reset(&xHistogram);
+    EXPECT_EQ(0, LatencyHistogram_getPercentile(&xHistogram, 50));
+
+    LatencyHistogram_record(&xHistogram, 30);
+    LatencyHistogram_record(&xHistogram, 10);
+    LatencyHistogram_record(&xHistogram, 20);
+
+    EXPECT_EQ(3, xHistogram.uCount);
+    EXPECT_EQ(60, xHistogram.uSumMs);
+    EXPECT_EQ(10, xHistogram.uMinMs);
+    EXPECT_EQ(30, xHistogram.uMaxMs);
+
+    /* Records are ignored without a histogram. */
+    LatencyHistogram_record(NULL, 10);
+    EXPECT_EQ(0, LatencyHistogram_getPercentile(NULL, 50));
+}
+
+TEST(LatencyHistogram_getBucketLowerBound, buckets_cover_every_latency)
+{
+    LatencyHistogram_t xHistogram;
+    uint64_t uLowerBound = 0;
+    uint64_t uUpperBound = 0;
+
+    for (size_t i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT; i++)
+    {
+        uLowerBound = LatencyHistogram_getBucketLowerBound(i);
+        if (i > 0)
+        {
+            /* Buckets are contiguous, and each is at most 25% wider than its lower bound. */
+            EXPECT_EQ(uUpperBound + 1, uLowerBound) << "bucket " << i;
+        }
+        uUpperBound = (i + 1 < LATENCY_HISTOGRAM_BUCKET_COUNT) ? LatencyHistogram_getBucketLowerBound(i + 1) - 1 : UINT64_MAX;
+        if (i + 1 < LATENCY_HISTOGRAM_BUCKET_COUNT)
+        {
+            EXPECT_LE((uUpperBound - uLowerBound) * 4, uLowerBound > 0 ? uLowerBound : 4) << "bucket " << i;
+        }
+
+        /* Both bounds of a bucket are counted in it. */
+        LatencyHistogram_reset(&xHistogram);
+        LatencyHistogram_record(&xHistogram, uLowerBound);
+        LatencyHistogram_record(&xHistogram, uUpperBound);
+        EXPECT_EQ(2, xHistogram.puBuckets[i]) << "bucket " << i;
+    }
+
+    EXPECT_EQ(UINT64_MAX, LatencyHistogram_getBucketLowerBound(LATENCY_HISTOGRAM_BUCKET_COUNT));
+}
+
+TEST(LatencyHistogram_getPercentile, estimates_within_bucket)
+{
+    LatencyHistogram_t xHistogram;
+
+    LatencyHistogram_reset(&xHistogram);
+    for (uint64_t i = 1; i <= 1000; i++)
+    {
+        LatencyHistogram_record(&xHistogram, i);
+    }
+
+    /* The estimation is never below the exact percentile, and it's at most one bucket width above. */
+    EXPECT_GE(LatencyHistogram_getPercentile(&xHistogram, 50), 500);
+    EXPECT_LE(LatencyHistogram_getPercentile(&xHistogram, 50), 500 + 500 / 4);
+    EXPECT_GE(LatencyHistogram_getPercentile(&xHistogram, 99), 990);
+    EXPECT_LE(LatencyHistogram_getPercentile(&xHistogram, 99), 1000);
+    EXPECT_EQ(1000, LatencyHistogram_getPercentile(&xHistogram, 100));
+    EXPECT_EQ(1000, LatencyHistogram_getPercentile(&xHistogram, 200));
+    EXPECT_EQ(1, LatencyHistogram_getPercentile(&xHistogram, 0));
+}
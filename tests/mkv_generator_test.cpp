@@ -0,0 +1,157 @@
+#ifdef __cplusplus
+extern "C" {
+#include "kvs/errors.h"
+#include "kvs/mkv_generator.h"
+#include "kvs/nalu.h"
+#include "os/allocator.h"
+}
+#endif
+
+#include <gtest/gtest.h>
+
+/* Main profile, level 3.1, 1280x720, 4:2:0, 8 bits */
+static uint8_t gHevcVps[] = {0x40, 0x01, 0x0C, 0x01, 0xFF, 0xFF, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00,
+                             0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5D, 0x95, 0x98, 0x09};
+static uint8_t gHevcSps[] = {0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00,
+                             0x03, 0x00, 0x5D, 0xA0, 0x02, 0x80, 0x80, 0x2D, 0x16, 0x59, 0x59, 0xA4, 0x93, 0x2B, 0xC0};
+/* The same SPS with bit_depth_luma_minus8 set to 264, which is 8 when truncated to 8 bits */
+static uint8_t gHevcSpsWrappingBitDepth[] = {0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00,
+                                             0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5D, 0xA0, 0x02, 0x80, 0x80,
+                                             0x2D, 0x10, 0x04, 0x26, 0x59, 0x59, 0xA4, 0x93, 0x2B, 0xC0};
+static uint8_t gHevcPps[] = {0x44, 0x01, 0xC1, 0x72, 0xB4, 0x62, 0x40};
+
+static void prvExpectHevcCodecPrivateData(const uint8_t *pCpd, size_t uCpdLen)
+{
+    const uint8_t pExpectedHeader[] = {
+        0x01,                                                                   /* configurationVersion */
+        0x01, 0x60, 0x00, 0x00, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5D, /* Profile, tier and level without emulation prevention bytes */
+        0xF0, 0x00, 0xFC, 0xFD, 0xF8, 0xF8, 0x00, 0x00,
+        0x0F, /* 1 temporal layer, temporal ID nested, and 4 bytes NALU length */
+        0x03  /* numOfArrays */
+    };
+    const uint8_t *pArray = pCpd + sizeof(pExpectedHeader);
+
+    ASSERT_EQ(sizeof(pExpectedHeader) + 3 * 5 + sizeof(gHevcVps) + sizeof(gHevcSps) + sizeof(gHevcPps), uCpdLen);
+    EXPECT_EQ(0, memcmp(pExpectedHeader, pCpd, sizeof(pExpectedHeader)));
+
+    EXPECT_EQ(0xA0, pArray[0]);
+    EXPECT_EQ(0, memcmp("\x00\x01\x00\x18", pArray + 1, 4));
+    EXPECT_EQ(0, memcmp(gHevcVps, pArray + 5, sizeof(gHevcVps)));
+    pArray += 5 + sizeof(gHevcVps);
+
+    EXPECT_EQ(0xA1, pArray[0]);
+    EXPECT_EQ(0, memcmp("\x00\x01\x00\x1E", pArray + 1, 4));
+    EXPECT_EQ(0, memcmp(gHevcSps, pArray + 5, sizeof(gHevcSps)));
+    pArray += 5 + sizeof(gHevcSps);
+
+    EXPECT_EQ(0xA2, pArray[0]);
+    EXPECT_EQ(0, memcmp("\x00\x01\x00\x07", pArray + 1, 4));
+    EXPECT_EQ(0, memcmp(gHevcPps, pArray + 5, sizeof(gHevcPps)));
+}
+
+TEST(Mkv_generateH265CodecPrivateDataFromVpsSpsPps, hvcc)
+{
+    uint8_t *pCpd = NULL;
+    size_t uCpdLen = 0;
+
+    ASSERT_EQ(0, Mkv_generateH265CodecPrivateDataFromVpsSpsPps(gHevcVps, sizeof(gHevcVps), gHevcSps, sizeof(gHevcSps), gHevcPps, sizeof(gHevcPps), &pCpd, &uCpdLen));
+    prvExpectHevcCodecPrivateData(pCpd, uCpdLen);
+    kvsFree(pCpd);
+
+    /* A truncated SPS is rejected instead of being read beyond its end. */
+    EXPECT_EQ(KVS_ERROR_INVALID_NALU_FORMAT, Mkv_generateH265CodecPrivateDataFromVpsSpsPps(gHevcVps, sizeof(gHevcVps), gHevcSps, 20, gHevcPps, sizeof(gHevcPps), &pCpd, &uCpdLen));
+    /* A bit depth out of range is rejected even if it would wrap into a valid one. */
+    EXPECT_EQ(KVS_ERROR_INVALID_NALU_FORMAT,
+              Mkv_generateH265CodecPrivateDataFromVpsSpsPps(gHevcVps, sizeof(gHevcVps), gHevcSpsWrappingBitDepth, sizeof(gHevcSpsWrappingBitDepth), gHevcPps,
+                                                            sizeof(gHevcPps), &pCpd, &uCpdLen));
+    EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, Mkv_generateH265CodecPrivateDataFromVpsSpsPps(NULL, 0, gHevcSps, sizeof(gHevcSps), gHevcPps, sizeof(gHevcPps), &pCpd, &uCpdLen));
+}
+
+TEST(Mkv_generateH265CodecPrivateDataFromNalus, annexb_and_length_prefixed)
+{
+    uint8_t pFrame[4 * 4 + sizeof(gHevcVps) + sizeof(gHevcSps) + sizeof(gHevcPps) + 4];
+    uint8_t *pIdx = pFrame;
+    uint8_t *pCpd = NULL;
+    size_t uCpdLen = 0;
+    uint32_t uLen = 0;
+
+    memcpy(pIdx, "\x00\x00\x00\x01", 4);
+    memcpy(pIdx + 4, gHevcVps, sizeof(gHevcVps));
+    pIdx += 4 + sizeof(gHevcVps);
+    memcpy(pIdx, "\x00\x00\x00\x01", 4);
+    memcpy(pIdx + 4, gHevcSps, sizeof(gHevcSps));
+    pIdx += 4 + sizeof(gHevcSps);
+    memcpy(pIdx, "\x00\x00\x00\x01", 4);
+    memcpy(pIdx + 4, gHevcPps, sizeof(gHevcPps));
+    pIdx += 4 + sizeof(gHevcPps);
+    /* IDR_W_RADL */
+    memcpy(pIdx, "\x00\x00\x00\x01\x26\x01\xAF\x09", 8);
+
+    ASSERT_EQ(0, Mkv_generateH265CodecPrivateDataFromNalus(pFrame, sizeof(pFrame), &pCpd, &uCpdLen));
+    prvExpectHevcCodecPrivateData(pCpd, uCpdLen);
+    kvsFree(pCpd);
+
+    /* The 4 bytes start codes become 4 bytes lengths in place. */
+    ASSERT_EQ(0, NALU_convertAnnexBToAvccInPlace(pFrame, sizeof(pFrame), sizeof(pFrame), &uLen));
+    ASSERT_EQ(sizeof(pFrame), uLen);
+    ASSERT_EQ(0, Mkv_generateH265CodecPrivateDataFromNalus(pFrame, sizeof(pFrame), &pCpd, &uCpdLen));
+    prvExpectHevcCodecPrivateData(pCpd, uCpdLen);
+    kvsFree(pCpd);
+
+    /* NALUs without a VPS are rejected. */
+    EXPECT_EQ(KVS_ERROR_NALU_TYPE_NOT_FOUND, Mkv_generateH265CodecPrivateDataFromNalus(pFrame + 4 + sizeof(gHevcVps), sizeof(pFrame) - 4 - sizeof(gHevcVps), &pCpd, &uCpdLen));
+}
+
+TEST(Mkv_initializeClusterHdr, minimal_simple_block_size)
+{
+    struct
+    {
+        size_t uFrameSize;
+        size_t uSizeLen;
+        uint8_t pSize[3];
+    } xCases[] = {
+        {4, 1, {0x88}},                 /* 4 bytes SimpleBlock header + 4 bytes frame */
+        {122, 1, {0xFE}},               /* The largest 1 byte size */
+        {123, 2, {0x40, 0x7F}},         /* 0xFF is reserved for unknown size */
+        {16378, 2, {0x7F, 0xFE}},       /* The largest 2 bytes size */
+        {16379, 3, {0x20, 0x3F, 0xFF}}, /* 0x7FFF is reserved for unknown size */
+    };
+    uint8_t pHdr[64];
+    size_t uHdrLen = 0;
+    size_t i = 0;
+
+    for (i = 0; i < sizeof(xCases) / sizeof(xCases[0]); i++)
+    {
+        uHdrLen = Mkv_getClusterHdrLen(MKV_SIMPLE_BLOCK, xCases[i].uFrameSize);
+        ASSERT_EQ(1 + xCases[i].uSizeLen + 4, uHdrLen);
+        ASSERT_EQ(0, Mkv_initializeClusterHdr(pHdr, uHdrLen, MKV_SIMPLE_BLOCK, xCases[i].uFrameSize, TRACK_AUDIO, false, 1000, 0x1234));
+        EXPECT_EQ(0xA3, pHdr[0]);
+        EXPECT_EQ(0, memcmp(xCases[i].pSize, pHdr + 1, xCases[i].uSizeLen));
+        EXPECT_EQ(0x82, pHdr[1 + xCases[i].uSizeLen]);
+        EXPECT_EQ(0x12, pHdr[2 + xCases[i].uSizeLen]);
+        EXPECT_EQ(0x34, pHdr[3 + xCases[i].uSizeLen]);
+        EXPECT_EQ(0x00, pHdr[4 + xCases[i].uSizeLen]);
+
+        /* The buffer must fit the header. */
+        EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, Mkv_initializeClusterHdr(pHdr, uHdrLen - 1, MKV_SIMPLE_BLOCK, xCases[i].uFrameSize, TRACK_AUDIO, false, 1000, 0));
+    }
+
+    /* SIZE_MAX gives the longest header with 8 bytes size. */
+    EXPECT_EQ(1 + 8 + 4, Mkv_getClusterHdrLen(MKV_SIMPLE_BLOCK, SIZE_MAX));
+}
+
+TEST(Mkv_initializeClusterHdr, cluster)
+{
+    const uint8_t pExpected[] = {
+        0x1F, 0x43, 0xB6, 0x75, 0xFF,                               /* Cluster with unknown size */
+        0xE7, 0x88, 0x00, 0x00, 0x01, 0x7B, 0x5E, 0x2A, 0x4C, 0x10, /* Timestamp */
+        0xA7, 0x81, 0x00,                                           /* Position */
+        0xA3, 0x40, 0x80,                                           /* SimpleBlock with 2 bytes size */
+        0x81, 0x00, 0x00, 0x80                                      /* Video track, no delta timestamp, key frame */
+    };
+    uint8_t pHdr[64];
+
+    ASSERT_EQ(sizeof(pExpected), Mkv_getClusterHdrLen(MKV_CLUSTER, 124));
+    ASSERT_EQ(0, Mkv_initializeClusterHdr(pHdr, sizeof(pHdr), MKV_CLUSTER, 124, TRACK_VIDEO, true, 0x17B5E2A4C10ULL, 0));
+    EXPECT_EQ(0, memcmp(pExpected, pHdr, sizeof(pExpected)));
+}
@@ -0,0 +1,1511 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+
+/* Thirdparty headers */
+#include "mbedtls/bignum.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/ecp.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_cache.h"
+#include "mbedtls/x509_crt.h"
+#include "parson.h"
+
+/* Public headers */
+#include "kvs/port.h"
+
+#include "mock_kvs_server.h"
+
+#define MOCK_KVS_BIND_ADDRESS "127.0.0.1"
+
+/* The interval to check if the server is stopping, and to send delayed fragment ACKs */
+#define MOCK_KVS_POLL_INTERVAL_MS (50)
+
+#define MOCK_KVS_RECV_BUFSIZE (4096)
+#define MOCK_KVS_PEM_BUFSIZE (2048)
+
+#define MOCK_KVS_MAX_STREAMS (8)
+#define MOCK_KVS_STREAM_NAME_MAX_LEN (256)
+#define MOCK_KVS_HOST_MAX_LEN (256)
+#define MOCK_KVS_MAX_PENDING_ACKS (32)
+
+#define MOCK_KVS_CA_SUBJECT "CN=KVS Mock Test CA,O=KVS Embedded C SDK Test"
+#define MOCK_KVS_SERVER_SUBJECT "CN=" MOCK_KVS_BIND_ADDRESS ",O=KVS Embedded C SDK Test"
+#define MOCK_KVS_CLIENT_SUBJECT "CN=KVS Mock Test Thing,O=KVS Embedded C SDK Test"
+#define MOCK_KVS_CERT_NOT_BEFORE "20200101000000"
+#define MOCK_KVS_CERT_NOT_AFTER "20991231235959"
+
+#define MOCK_KVS_STREAM_ARN_TEMPLATE "arn:aws:kinesisvideo:us-east-1:000000000000:stream/%s/0"
+
+#define MOCK_KVS_IOT_URI_ROLE_ALIASES_BEGIN "/role-aliases/"
+#define MOCK_KVS_IOT_URI_ROLE_ALIASES_END "/credentials"
+#define MOCK_KVS_IOT_CREDENTIAL_DEFAULT_LIFETIME_SEC (3600)
+
+/* EBML element IDs that the MKV validator cares about */
+#define MKV_ID_EBML (0x1A45DFA3)
+#define MKV_ID_SEGMENT (0x18538067)
+#define MKV_ID_SEEK_HEAD (0x114D9B74)
+#define MKV_ID_INFO (0x1549A966)
+#define MKV_ID_TRACKS (0x1654AE6B)
+#define MKV_ID_CHAPTERS (0x1043A770)
+#define MKV_ID_CUES (0x1C53BB6B)
+#define MKV_ID_ATTACHMENTS (0x1941A469)
+#define MKV_ID_TAGS (0x1254C367)
+#define MKV_ID_CLUSTER (0x1F43B675)
+#define MKV_ID_CLUSTER_TIMECODE (0xE7)
+#define MKV_ID_SIMPLE_BLOCK (0xA3)
+
+#define MKV_SIMPLE_BLOCK_HEADER_SIZE (4)
+#define MKV_SIMPLE_BLOCK_FLAG_KEY_FRAME (0x80)
+
+typedef enum
+{
+    ACK_BUFFERING = 0,
+    ACK_RECEIVED,
+    ACK_PERSISTED,
+    ACK_ERROR
+} MockAckType_t;
+
+typedef struct
+{
+    MockAckType_t xType;
+    uint64_t uFragmentTimecode;
+    unsigned int uFragmentNumber;
+    unsigned int uErrorId;
+    uint64_t uDueMs;
+} MockPendingAck_t;
+
+typedef enum
+{
+    BODY_CHUNK_SIZE = 0,
+    BODY_CHUNK_EXT,
+    BODY_CHUNK_DATA,
+    BODY_CHUNK_DATA_END,
+    BODY_TRAILER,
+    BODY_COMPLETE
+} MockBodyState_t;
+
+typedef enum
+{
+    MKV_ELEMENT_HEADER = 0,
+    MKV_ELEMENT_CAPTURE,
+    MKV_ELEMENT_SKIP
+} MockMkvState_t;
+
+typedef struct
+{
+    MockMkvState_t xState;
+
+    /* The element header that is being collected */
+    uint8_t pHeader[12];
+    size_t uHeaderLen;
+    uint32_t uId;
+    uint64_t uSize;
+    bool bUnknownSize;
+
+    /* The beginning of an element payload that is captured, or the rest of the payload that is skipped */
+    uint8_t pCapture[8];
+    size_t uCaptureLen;
+    size_t uCaptureNeed;
+    uint64_t uSkipRemaining;
+
+    bool bSeenEbmlHeader;
+    bool bInSegment;
+    bool bInCluster;
+    bool bClusterHasTimecode;
+    bool bHasLastClusterTimecode;
+    uint64_t uLastClusterTimecode;
+} MockMkvValidator_t;
+
+typedef struct MockKvsServer MockKvsServer_t;
+
+typedef struct
+{
+    MockKvsServer_t *pxServer;
+    mbedtls_net_context xFd;
+    mbedtls_ssl_context xSsl;
+
+    uint8_t pRecvBuf[MOCK_KVS_RECV_BUFSIZE];
+    size_t uRecvLen;
+
+    char pcHost[MOCK_KVS_HOST_MAX_LEN + 1];
+} MockConnection_t;
+
+typedef struct
+{
+    MockConnection_t *pxConn;
+
+    MockBodyState_t xBodyState;
+    size_t uChunkRemaining;
+
+    MockMkvValidator_t xMkv;
+    bool bMkvError;
+
+    /* The fragment that is being received */
+    bool bFragmentOpen;
+    unsigned int uFragmentNumber;
+    uint64_t uFragmentTimecode;
+
+    MockPendingAck_t xPendingAcks[MOCK_KVS_MAX_PENDING_ACKS];
+    size_t uPendingAckCount;
+} MockPutMediaSession_t;
+
+struct MockKvsServer
+{
+    MockKvsServerParameter_t xPara;
+
+    pthread_mutex_t xLock;
+    MockKvsServerStats_t xStats;
+    char pcStreamNames[MOCK_KVS_MAX_STREAMS][MOCK_KVS_STREAM_NAME_MAX_LEN + 1];
+    unsigned int uActiveConnections;
+
+    /* The random generator is shared by connections, and handshakes are serialized for the session cache. */
+    pthread_mutex_t xRngLock;
+    pthread_mutex_t xHandshakeLock;
+    mbedtls_entropy_context xEntropy;
+    mbedtls_ctr_drbg_context xCtrDrbg;
+
+    mbedtls_pk_context xCaKey;
+    mbedtls_pk_context xServerKey;
+    mbedtls_x509_crt xServerCertChain;
+    char pcRootCA[MOCK_KVS_PEM_BUFSIZE];
+
+    /* The client certificate is not verified by the server. It's for clients that require one, like IoT. */
+    mbedtls_pk_context xClientKey;
+    char pcClientCert[MOCK_KVS_PEM_BUFSIZE];
+    char pcClientPrivateKey[MOCK_KVS_PEM_BUFSIZE];
+
+    mbedtls_ssl_config xConf;
+    mbedtls_ssl_cache_context xCache;
+
+    mbedtls_net_context xListenFd;
+    uint16_t uPort;
+
+    pthread_t xAcceptThread;
+    bool bAcceptThreadStarted;
+    volatile bool bStopping;
+};
+
+/*-----------------------------------------------------------*/
+
+static int prvRandom(void *pCtx, unsigned char *pBuf, size_t uLen)
+{
+    MockKvsServer_t *pxServer = (MockKvsServer_t *)pCtx;
+    int retVal = 0;
+
+    pthread_mutex_lock(&(pxServer->xRngLock));
+    retVal = mbedtls_ctr_drbg_random(&(pxServer->xCtrDrbg), pBuf, uLen);
+    pthread_mutex_unlock(&(pxServer->xRngLock));
+
+    return retVal;
+}
+
+static int prvGenerateKey(MockKvsServer_t *pxServer, mbedtls_pk_context *pxKey)
+{
+    int retVal = 0;
+
+    if ((retVal = mbedtls_pk_setup(pxKey, mbedtls_pk_info_from_type(MBEDTLS_PK_ECKEY))) == 0)
+    {
+        retVal = mbedtls_ecp_gen_key(MBEDTLS_ECP_DP_SECP256R1, mbedtls_pk_ec(*pxKey), prvRandom, pxServer);
+    }
+
+    return retVal;
+}
+
+static int prvWriteCert(MockKvsServer_t *pxServer, const char *pcSubject, mbedtls_pk_context *pxSubjectKey, bool bIsCA, int serial, unsigned char *pPem, size_t uPemSize)
+{
+    int retVal = 0;
+    mbedtls_x509write_cert xCrt;
+    mbedtls_mpi xSerial;
+
+    mbedtls_x509write_crt_init(&xCrt);
+    mbedtls_mpi_init(&xSerial);
+
+    mbedtls_x509write_crt_set_version(&xCrt, MBEDTLS_X509_CRT_VERSION_3);
+    mbedtls_x509write_crt_set_md_alg(&xCrt, MBEDTLS_MD_SHA256);
+    mbedtls_x509write_crt_set_subject_key(&xCrt, pxSubjectKey);
+    mbedtls_x509write_crt_set_issuer_key(&xCrt, &(pxServer->xCaKey));
+
+    if ((retVal = mbedtls_mpi_lset(&xSerial, serial)) != 0 ||
+        (retVal = mbedtls_x509write_crt_set_serial(&xCrt, &xSerial)) != 0 ||
+        (retVal = mbedtls_x509write_crt_set_subject_name(&xCrt, pcSubject)) != 0 ||
+        (retVal = mbedtls_x509write_crt_set_issuer_name(&xCrt, MOCK_KVS_CA_SUBJECT)) != 0 ||
+        (retVal = mbedtls_x509write_crt_set_validity(&xCrt, MOCK_KVS_CERT_NOT_BEFORE, MOCK_KVS_CERT_NOT_AFTER)) != 0 ||
+        (retVal = mbedtls_x509write_crt_set_basic_constraints(&xCrt, bIsCA ? 1 : 0, bIsCA ? 0 : -1)) != 0)
+    {
+        /* Propagate the retVal error */
+    }
+    else
+    {
+        retVal = mbedtls_x509write_crt_pem(&xCrt, pPem, uPemSize, prvRandom, pxServer);
+    }
+
+    mbedtls_mpi_free(&xSerial);
+    mbedtls_x509write_crt_free(&xCrt);
+
+    return retVal;
+}
+
+/**
+ * Generate a test CA, and a server certificate and a client certificate signed by it. The server certificate chain
+ * includes the CA.
+ */
+static int prvSetupCertificates(MockKvsServer_t *pxServer)
+{
+    int retVal = 0;
+    unsigned char pServerCertPem[MOCK_KVS_PEM_BUFSIZE];
+
+    if ((retVal = prvGenerateKey(pxServer, &(pxServer->xCaKey))) != 0 ||
+        (retVal = prvGenerateKey(pxServer, &(pxServer->xServerKey))) != 0 ||
+        (retVal = prvWriteCert(pxServer, MOCK_KVS_CA_SUBJECT, &(pxServer->xCaKey), true, 1, (unsigned char *)pxServer->pcRootCA, sizeof(pxServer->pcRootCA))) != 0 ||
+        (retVal = prvWriteCert(pxServer, MOCK_KVS_SERVER_SUBJECT, &(pxServer->xServerKey), false, 2, pServerCertPem, sizeof(pServerCertPem))) != 0 ||
+        (retVal = prvGenerateKey(pxServer, &(pxServer->xClientKey))) != 0 ||
+        (retVal = prvWriteCert(pxServer, MOCK_KVS_CLIENT_SUBJECT, &(pxServer->xClientKey), false, 3, (unsigned char *)pxServer->pcClientCert, sizeof(pxServer->pcClientCert))) != 0 ||
+        (retVal = mbedtls_pk_write_key_pem(&(pxServer->xClientKey), (unsigned char *)pxServer->pcClientPrivateKey, sizeof(pxServer->pcClientPrivateKey))) != 0)
+    {
+        /* Propagate the retVal error */
+    }
+    else if (
+        (retVal = mbedtls_x509_crt_parse(&(pxServer->xServerCertChain), pServerCertPem, strlen((const char *)pServerCertPem) + 1)) != 0 ||
+        (retVal = mbedtls_x509_crt_parse(&(pxServer->xServerCertChain), (const unsigned char *)pxServer->pcRootCA, strlen(pxServer->pcRootCA) + 1)) != 0)
+    {
+        /* Propagate the retVal error */
+    }
+
+    return retVal;
+}
+
+static int prvSetupTls(MockKvsServer_t *pxServer)
+{
+    int retVal = 0;
+
+    if ((retVal = mbedtls_ctr_drbg_seed(&(pxServer->xCtrDrbg), mbedtls_entropy_func, &(pxServer->xEntropy), NULL, 0)) != 0 ||
+        (retVal = prvSetupCertificates(pxServer)) != 0 ||
+        (retVal = mbedtls_ssl_config_defaults(&(pxServer->xConf), MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT)) != 0)
+    {
+        /* Propagate the retVal error */
+    }
+    else
+    {
+        mbedtls_ssl_conf_rng(&(pxServer->xConf), prvRandom, pxServer);
+        mbedtls_ssl_conf_read_timeout(&(pxServer->xConf), MOCK_KVS_POLL_INTERVAL_MS);
+        mbedtls_ssl_conf_session_cache(&(pxServer->xConf), &(pxServer->xCache), mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
+        retVal = mbedtls_ssl_conf_own_cert(&(pxServer->xConf), &(pxServer->xServerCertChain), &(pxServer->xServerKey));
+    }
+
+    return retVal;
+}
+
+/*-----------------------------------------------------------*/
+
+static bool prvStreamExists(MockKvsServer_t *pxServer, const char *pcStreamName)
+{
+    bool bExists = pxServer->xPara.bStreamExists;
+    size_t i = 0;
+
+    for (i = 0; i < MOCK_KVS_MAX_STREAMS && !bExists; i++)
+    {
+        bExists = (pxServer->pcStreamNames[i][0] != '\0' && strcmp(pxServer->pcStreamNames[i], pcStreamName) == 0);
+    }
+
+    return bExists;
+}
+
+static bool prvAddStream(MockKvsServer_t *pxServer, const char *pcStreamName)
+{
+    bool bAdded = false;
+    size_t i = 0;
+
+    if (strlen(pcStreamName) <= MOCK_KVS_STREAM_NAME_MAX_LEN && !prvStreamExists(pxServer, pcStreamName))
+    {
+        for (i = 0; i < MOCK_KVS_MAX_STREAMS; i++)
+        {
+            if (pxServer->pcStreamNames[i][0] == '\0')
+            {
+                strcpy(pxServer->pcStreamNames[i], pcStreamName);
+                bAdded = true;
+                break;
+            }
+        }
+    }
+
+    return bAdded;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvSend(MockConnection_t *pxConn, const void *pBuf, size_t uLen)
+{
+    int retVal = 0;
+    const unsigned char *pIdx = (const unsigned char *)pBuf;
+
+    while (uLen > 0)
+    {
+        retVal = mbedtls_ssl_write(&(pxConn->xSsl), pIdx, uLen);
+        if (retVal > 0)
+        {
+            pIdx += retVal;
+            uLen -= (size_t)retVal;
+            retVal = 0;
+        }
+        else if (retVal != MBEDTLS_ERR_SSL_WANT_READ && retVal != MBEDTLS_ERR_SSL_WANT_WRITE)
+        {
+            break;
+        }
+    }
+
+    return retVal;
+}
+
+/**
+ * Receive more data into the receive buffer.
+ *
+ * @return The number of bytes received, 0 on timeout, or negative value if the connection is closed or fails.
+ */
+static int prvRecv(MockConnection_t *pxConn)
+{
+    int retVal = 0;
+
+    if (pxConn->uRecvLen >= sizeof(pxConn->pRecvBuf))
+    {
+        retVal = -1;
+    }
+    else
+    {
+        retVal = mbedtls_ssl_read(&(pxConn->xSsl), pxConn->pRecvBuf + pxConn->uRecvLen, sizeof(pxConn->pRecvBuf) - pxConn->uRecvLen);
+        if (retVal > 0)
+        {
+            pxConn->uRecvLen += (size_t)retVal;
+        }
+        else if (retVal == MBEDTLS_ERR_SSL_TIMEOUT || retVal == MBEDTLS_ERR_SSL_WANT_READ || retVal == MBEDTLS_ERR_SSL_WANT_WRITE)
+        {
+            retVal = 0;
+        }
+        else
+        {
+            retVal = -1;
+        }
+    }
+
+    return retVal;
+}
+
+static void prvConsume(MockConnection_t *pxConn, size_t uLen)
+{
+    if (uLen >= pxConn->uRecvLen)
+    {
+        pxConn->uRecvLen = 0;
+    }
+    else
+    {
+        memmove(pxConn->pRecvBuf, pxConn->pRecvBuf + uLen, pxConn->uRecvLen - uLen);
+        pxConn->uRecvLen -= uLen;
+    }
+}
+
+static int prvSendResponse(MockConnection_t *pxConn, unsigned int uStatusCode, const char *pcReason, const char *pcBody)
+{
+    int retVal = 0;
+    char pcHeader[256];
+    int headerLen = 0;
+
+    headerLen = snprintf(pcHeader, sizeof(pcHeader), "HTTP/1.1 %u %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n", uStatusCode, pcReason, strlen(pcBody));
+
+    if ((retVal = prvSend(pxConn, pcHeader, (size_t)headerLen)) == 0)
+    {
+        retVal = prvSend(pxConn, pcBody, strlen(pcBody));
+    }
+
+    return retVal;
+}
+
+static int prvSendChunk(MockConnection_t *pxConn, const char *pcData, size_t uLen)
+{
+    int retVal = 0;
+    char pcChunkSize[16];
+    int chunkSizeLen = 0;
+
+    chunkSizeLen = snprintf(pcChunkSize, sizeof(pcChunkSize), "%zx\r\n", uLen);
+
+    if ((retVal = prvSend(pxConn, pcChunkSize, (size_t)chunkSizeLen)) == 0 && (retVal = prvSend(pxConn, pcData, uLen)) == 0)
+    {
+        retVal = prvSend(pxConn, "\r\n", 2);
+    }
+
+    return retVal;
+}
+
+/*-----------------------------------------------------------*/
+
+static int prvSendAck(MockPutMediaSession_t *pxSession, const MockPendingAck_t *pxAck)
+{
+    MockKvsServer_t *pxServer = pxSession->pxConn->pxServer;
+    char pcAck[256];
+    int ackLen = 0;
+
+    switch (pxAck->xType)
+    {
+        case ACK_BUFFERING:
+        case ACK_RECEIVED:
+        case ACK_PERSISTED:
+            ackLen = snprintf(pcAck, sizeof(pcAck), "{\"EventType\":\"%s\",\"FragmentTimecode\":%" PRIu64 ",\"FragmentNumber\":\"%u\"}",
+                              (pxAck->xType == ACK_BUFFERING) ? "BUFFERING" : (pxAck->xType == ACK_RECEIVED) ? "RECEIVED" : "PERSISTED", pxAck->uFragmentTimecode,
+                              pxAck->uFragmentNumber);
+            break;
+        case ACK_ERROR:
+        default:
+            ackLen = snprintf(pcAck, sizeof(pcAck), "{\"EventType\":\"ERROR\",\"FragmentTimecode\":%" PRIu64 ",\"FragmentNumber\":\"%u\",\"ErrorId\":%u}",
+                              pxAck->uFragmentTimecode, pxAck->uFragmentNumber, pxAck->uErrorId);
+            break;
+    }
+
+    pthread_mutex_lock(&(pxServer->xLock));
+    if (pxAck->xType == ACK_BUFFERING)
+    {
+        pxServer->xStats.uBufferingAckCount++;
+    }
+    else if (pxAck->xType == ACK_RECEIVED)
+    {
+        pxServer->xStats.uReceivedAckCount++;
+    }
+    else if (pxAck->xType == ACK_PERSISTED)
+    {
+        pxServer->xStats.uPersistedAckCount++;
+    }
+    else
+    {
+        pxServer->xStats.uErrorAckCount++;
+    }
+    pthread_mutex_unlock(&(pxServer->xLock));
+
+    return prvSendChunk(pxSession->pxConn, pcAck, (size_t)ackLen);
+}
+
+static int prvQueueAck(MockPutMediaSession_t *pxSession, MockAckType_t xType, unsigned int uErrorId, unsigned int uDelayMs)
+{
+    int retVal = 0;
+    MockPendingAck_t xAck;
+
+    xAck.xType = xType;
+    xAck.uFragmentTimecode = pxSession->uFragmentTimecode;
+    xAck.uFragmentNumber = pxSession->uFragmentNumber;
+    xAck.uErrorId = uErrorId;
+    xAck.uDueMs = getEpochTimestampInMs() + uDelayMs;
+
+    if (uDelayMs == 0 || pxSession->uPendingAckCount >= MOCK_KVS_MAX_PENDING_ACKS)
+    {
+        retVal = prvSendAck(pxSession, &xAck);
+    }
+    else
+    {
+        pxSession->xPendingAcks[pxSession->uPendingAckCount++] = xAck;
+    }
+
+    return retVal;
+}
+
+/**
+ * Send the pending ACKs that are due, or all of them if bFlush is true. ACKs are sent in the order they are queued.
+ */
+static int prvSendDueAcks(MockPutMediaSession_t *pxSession, bool bFlush)
+{
+    int retVal = 0;
+    uint64_t uNowMs = getEpochTimestampInMs();
+    size_t i = 0;
+    size_t uKept = 0;
+
+    for (i = 0; i < pxSession->uPendingAckCount; i++)
+    {
+        if (retVal == 0 && (bFlush || pxSession->xPendingAcks[i].uDueMs <= uNowMs))
+        {
+            retVal = prvSendAck(pxSession, &(pxSession->xPendingAcks[i]));
+        }
+        else
+        {
+            pxSession->xPendingAcks[uKept++] = pxSession->xPendingAcks[i];
+        }
+    }
+    pxSession->uPendingAckCount = uKept;
+
+    return retVal;
+}
+
+static int prvEndFragment(MockPutMediaSession_t *pxSession)
+{
+    int retVal = 0;
+    const MockKvsServerParameter_t *pxPara = &(pxSession->pxConn->pxServer->xPara);
+
+    if (pxSession->bFragmentOpen)
+    {
+        pxSession->bFragmentOpen = false;
+
+        if (pxPara->uErrorAckFragmentIndex != 0 && pxSession->uFragmentNumber == pxPara->uErrorAckFragmentIndex)
+        {
+            retVal = prvQueueAck(pxSession, ACK_ERROR, pxPara->uErrorAckErrorId, 0);
+        }
+        else
+        {
+            if (retVal == 0 && pxPara->bSendReceivedAck)
+            {
+                retVal = prvQueueAck(pxSession, ACK_RECEIVED, 0, pxPara->uReceivedAckDelayMs);
+            }
+            if (retVal == 0 && pxPara->bSendPersistedAck)
+            {
+                retVal = prvQueueAck(pxSession, ACK_PERSISTED, 0, pxPara->uPersistedAckDelayMs);
+            }
+        }
+    }
+
+    return retVal;
+}
+
+static int prvStartFragment(MockPutMediaSession_t *pxSession, uint64_t uTimecode)
+{
+    int retVal = 0;
+    MockKvsServer_t *pxServer = pxSession->pxConn->pxServer;
+
+    if ((retVal = prvEndFragment(pxSession)) == 0)
+    {
+        pxSession->bFragmentOpen = true;
+        pxSession->uFragmentNumber++;
+        pxSession->uFragmentTimecode = uTimecode;
+
+        if (pxServer->xPara.bSendBufferingAck)
+        {
+            retVal = prvQueueAck(pxSession, ACK_BUFFERING, 0, 0);
+        }
+    }
+
+    return retVal;
+}
+
+static void prvMkvError(MockPutMediaSession_t *pxSession, unsigned int uErrorId)
+{
+    MockKvsServer_t *pxServer = pxSession->pxConn->pxServer;
+
+    pthread_mutex_lock(&(pxServer->xLock));
+    pxServer->xStats.uMkvErrorCount++;
+    pthread_mutex_unlock(&(pxServer->xLock));
+
+    /* The real service reports the error and closes the connection. */
+    pxSession->bMkvError = true;
+    prvSendDueAcks(pxSession, true);
+    prvQueueAck(pxSession, ACK_ERROR, uErrorId, 0);
+}
+
+/*-----------------------------------------------------------*/
+
+/* Get the length of an EBML variable size integer from its first byte, or 0 if it's invalid. */
+static size_t prvEbmlVintLen(uint8_t uFirstByte, size_t uMaxLen)
+{
+    size_t uLen = 0;
+    size_t i = 0;
+
+    for (i = 0; i < uMaxLen; i++)
+    {
+        if (uFirstByte & (0x80 >> i))
+        {
+            uLen = i + 1;
+            break;
+        }
+    }
+
+    return uLen;
+}
+
+static bool prvIsSegmentLevelId(uint32_t uId)
+{
+    return (uId == MKV_ID_SEEK_HEAD || uId == MKV_ID_INFO || uId == MKV_ID_TRACKS || uId == MKV_ID_CHAPTERS || uId == MKV_ID_CUES || uId == MKV_ID_ATTACHMENTS ||
+            uId == MKV_ID_TAGS);
+}
+
+static void prvMkvStartPayload(MockMkvValidator_t *pxMkv, size_t uCaptureNeed)
+{
+    pxMkv->uCaptureLen = 0;
+    pxMkv->uCaptureNeed = uCaptureNeed;
+    pxMkv->uSkipRemaining = pxMkv->uSize - uCaptureNeed;
+    pxMkv->xState = (uCaptureNeed > 0) ? MKV_ELEMENT_CAPTURE : ((pxMkv->uSkipRemaining > 0) ? MKV_ELEMENT_SKIP : MKV_ELEMENT_HEADER);
+}
+
+static void prvMkvOnElementHeader(MockPutMediaSession_t *pxSession)
+{
+    MockMkvValidator_t *pxMkv = &(pxSession->xMkv);
+    MockKvsServer_t *pxServer = pxSession->pxConn->pxServer;
+    uint32_t uId = pxMkv->uId;
+
+    pxMkv->xState = MKV_ELEMENT_HEADER;
+
+    if (!pxMkv->bSeenEbmlHeader && uId != MKV_ID_EBML)
+    {
+        prvMkvError(pxSession, MOCK_KVS_ERROR_ID_INVALID_MKV_DATA);
+    }
+    else if (pxMkv->bUnknownSize && uId != MKV_ID_SEGMENT && uId != MKV_ID_CLUSTER)
+    {
+        prvMkvError(pxSession, MOCK_KVS_ERROR_ID_INVALID_MKV_DATA);
+    }
+    else if (uId == MKV_ID_EBML)
+    {
+        /* A new EBML header starts a new MKV stream on the same connection. */
+        prvEndFragment(pxSession);
+        pxMkv->bSeenEbmlHeader = true;
+        pxMkv->bInSegment = false;
+        pxMkv->bInCluster = false;
+        pthread_mutex_lock(&(pxServer->xLock));
+        pxServer->xStats.uEbmlHeaderCount++;
+        pthread_mutex_unlock(&(pxServer->xLock));
+        prvMkvStartPayload(pxMkv, 0);
+    }
+    else if (uId == MKV_ID_SEGMENT)
+    {
+        /* Descend into the segment */
+        pxMkv->bInSegment = true;
+        pxMkv->bInCluster = false;
+    }
+    else if (!pxMkv->bInSegment)
+    {
+        prvMkvError(pxSession, MOCK_KVS_ERROR_ID_INVALID_MKV_DATA);
+    }
+    else if (uId == MKV_ID_CLUSTER)
+    {
+        /* Descend into the cluster. The fragment starts when the cluster timecode is known. */
+        prvEndFragment(pxSession);
+        pxMkv->bInCluster = true;
+        pxMkv->bClusterHasTimecode = false;
+        pthread_mutex_lock(&(pxServer->xLock));
+        pxServer->xStats.uClusterCount++;
+        pthread_mutex_unlock(&(pxServer->xLock));
+    }
+    else if (prvIsSegmentLevelId(uId))
+    {
+        if (pxMkv->bInCluster)
+        {
+            prvEndFragment(pxSession);
+            pxMkv->bInCluster = false;
+        }
+        prvMkvStartPayload(pxMkv, 0);
+    }
+    else if (pxMkv->bInCluster && uId == MKV_ID_CLUSTER_TIMECODE)
+    {
+        if (pxMkv->uSize == 0 || pxMkv->uSize > sizeof(pxMkv->pCapture))
+        {
+            prvMkvError(pxSession, MOCK_KVS_ERROR_ID_INVALID_MKV_DATA);
+        }
+        else
+        {
+            prvMkvStartPayload(pxMkv, (size_t)pxMkv->uSize);
+        }
+    }
+    else if (pxMkv->bInCluster && uId == MKV_ID_SIMPLE_BLOCK)
+    {
+        if (!pxMkv->bClusterHasTimecode || pxMkv->uSize < MKV_SIMPLE_BLOCK_HEADER_SIZE)
+        {
+            prvMkvError(pxSession, MOCK_KVS_ERROR_ID_INVALID_MKV_DATA);
+        }
+        else
+        {
+            prvMkvStartPayload(pxMkv, MKV_SIMPLE_BLOCK_HEADER_SIZE);
+        }
+    }
+    else
+    {
+        prvMkvStartPayload(pxMkv, 0);
+    }
+}
+
+static void prvMkvOnCaptured(MockPutMediaSession_t *pxSession)
+{
+    MockMkvValidator_t *pxMkv = &(pxSession->xMkv);
+    MockKvsServer_t *pxServer = pxSession->pxConn->pxServer;
+    uint64_t uTimecode = 0;
+    size_t i = 0;
+
+    if (pxMkv->uId == MKV_ID_CLUSTER_TIMECODE)
+    {
+        for (i = 0; i < pxMkv->uCaptureLen; i++)
+        {
+            uTimecode = (uTimecode << 8) | pxMkv->pCapture[i];
+        }
+
+        if (pxMkv->bHasLastClusterTimecode && uTimecode < pxMkv->uLastClusterTimecode)
+        {
+            prvMkvError(pxSession, MOCK_KVS_ERROR_ID_FRAGMENT_TIMECODE_LESSER_THAN_PREVIOUS);
+        }
+        else
+        {
+            pxMkv->bClusterHasTimecode = true;
+            pxMkv->bHasLastClusterTimecode = true;
+            pxMkv->uLastClusterTimecode = uTimecode;
+            prvStartFragment(pxSession, uTimecode);
+        }
+    }
+    else if (pxMkv->uId == MKV_ID_SIMPLE_BLOCK)
+    {
+        /* Only 1 byte track numbers are used by the producer. */
+        if ((pxMkv->pCapture[0] & 0x80) == 0)
+        {
+            prvMkvError(pxSession, MOCK_KVS_ERROR_ID_INVALID_MKV_DATA);
+        }
+        else
+        {
+            pthread_mutex_lock(&(pxServer->xLock));
+            pxServer->xStats.uSimpleBlockCount++;
+            if (pxMkv->pCapture[3] & MKV_SIMPLE_BLOCK_FLAG_KEY_FRAME)
+            {
+                pxServer->xStats.uKeyFrameCount++;
+            }
+            pthread_mutex_unlock(&(pxServer->xLock));
+        }
+    }
+}
+
+/**
+ * Validate MKV incrementally. Element headers and captured payloads that are split by the boundary of HTTP chunks are
+ * carried over.
+ */
+static void prvMkvValidate(MockPutMediaSession_t *pxSession, const uint8_t *pData, size_t uLen)
+{
+    MockMkvValidator_t *pxMkv = &(pxSession->xMkv);
+    size_t uIdLen = 0;
+    size_t uSizeLen = 0;
+    size_t uCopyLen = 0;
+    size_t i = 0;
+
+    while (uLen > 0 && !pxSession->bMkvError)
+    {
+        if (pxMkv->xState == MKV_ELEMENT_SKIP)
+        {
+            uCopyLen = (pxMkv->uSkipRemaining < uLen) ? (size_t)pxMkv->uSkipRemaining : uLen;
+            pxMkv->uSkipRemaining -= uCopyLen;
+            pData += uCopyLen;
+            uLen -= uCopyLen;
+            if (pxMkv->uSkipRemaining == 0)
+            {
+                pxMkv->xState = MKV_ELEMENT_HEADER;
+            }
+        }
+        else if (pxMkv->xState == MKV_ELEMENT_CAPTURE)
+        {
+            uCopyLen = pxMkv->uCaptureNeed - pxMkv->uCaptureLen;
+            uCopyLen = (uCopyLen < uLen) ? uCopyLen : uLen;
+            memcpy(pxMkv->pCapture + pxMkv->uCaptureLen, pData, uCopyLen);
+            pxMkv->uCaptureLen += uCopyLen;
+            pData += uCopyLen;
+            uLen -= uCopyLen;
+            if (pxMkv->uCaptureLen == pxMkv->uCaptureNeed)
+            {
+                pxMkv->xState = (pxMkv->uSkipRemaining > 0) ? MKV_ELEMENT_SKIP : MKV_ELEMENT_HEADER;
+                prvMkvOnCaptured(pxSession);
+            }
+        }
+        else
+        {
+            pxMkv->pHeader[pxMkv->uHeaderLen++] = *pData;
+            pData++;
+            uLen--;
+
+            if ((uIdLen = prvEbmlVintLen(pxMkv->pHeader[0], 4)) == 0)
+            {
+                prvMkvError(pxSession, MOCK_KVS_ERROR_ID_INVALID_MKV_DATA);
+            }
+            else if (pxMkv->uHeaderLen > uIdLen)
+            {
+                if ((uSizeLen = prvEbmlVintLen(pxMkv->pHeader[uIdLen], 8)) == 0)
+                {
+                    prvMkvError(pxSession, MOCK_KVS_ERROR_ID_INVALID_MKV_DATA);
+                }
+                else if (pxMkv->uHeaderLen == uIdLen + uSizeLen)
+                {
+                    pxMkv->uId = 0;
+                    for (i = 0; i < uIdLen; i++)
+                    {
+                        pxMkv->uId = (pxMkv->uId << 8) | pxMkv->pHeader[i];
+                    }
+
+                    pxMkv->uSize = pxMkv->pHeader[uIdLen] & (0xFF >> uSizeLen);
+                    pxMkv->bUnknownSize = (pxMkv->uSize == (uint64_t)(0xFF >> uSizeLen));
+                    for (i = uIdLen + 1; i < uIdLen + uSizeLen; i++)
+                    {
+                        pxMkv->uSize = (pxMkv->uSize << 8) | pxMkv->pHeader[i];
+                        pxMkv->bUnknownSize = pxMkv->bUnknownSize && (pxMkv->pHeader[i] == 0xFF);
+                    }
+
+                    pxMkv->uHeaderLen = 0;
+                    prvMkvOnElementHeader(pxSession);
+                }
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/**
+ * Decode the chunked body of PUT MEDIA in the receive buffer, and pass the MKV to the validator.
+ */
+static void prvDecodePutMediaBody(MockPutMediaSession_t *pxSession)
+{
+    MockConnection_t *pxConn = pxSession->pxConn;
+    MockKvsServer_t *pxServer = pxConn->pxServer;
+    size_t uIdx = 0;
+    size_t uDataLen = 0;
+    char c = 0;
+
+    while (uIdx < pxConn->uRecvLen && pxSession->xBodyState != BODY_COMPLETE)
+    {
+        if (pxSession->xBodyState == BODY_CHUNK_DATA)
+        {
+            uDataLen = pxConn->uRecvLen - uIdx;
+            uDataLen = (pxSession->uChunkRemaining < uDataLen) ? pxSession->uChunkRemaining : uDataLen;
+
+            pthread_mutex_lock(&(pxServer->xLock));
+            pxServer->xStats.uMkvBytes += uDataLen;
+            pthread_mutex_unlock(&(pxServer->xLock));
+
+            prvMkvValidate(pxSession, pxConn->pRecvBuf + uIdx, uDataLen);
+            uIdx += uDataLen;
+            pxSession->uChunkRemaining -= uDataLen;
+            if (pxSession->uChunkRemaining == 0)
+            {
+                pxSession->xBodyState = BODY_CHUNK_DATA_END;
+            }
+            continue;
+        }
+
+        c = (char)pxConn->pRecvBuf[uIdx++];
+        switch (pxSession->xBodyState)
+        {
+            case BODY_CHUNK_SIZE:
+                if (c >= '0' && c <= '9')
+                {
+                    pxSession->uChunkRemaining = pxSession->uChunkRemaining * 16 + (size_t)(c - '0');
+                }
+                else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+                {
+                    pxSession->uChunkRemaining = pxSession->uChunkRemaining * 16 + (size_t)((c | 0x20) - 'a' + 10);
+                }
+                else if (c == '\n')
+                {
+                    pxSession->xBodyState = (pxSession->uChunkRemaining > 0) ? BODY_CHUNK_DATA : BODY_TRAILER;
+                }
+                else
+                {
+                    pxSession->xBodyState = BODY_CHUNK_EXT;
+                }
+                break;
+            case BODY_CHUNK_EXT:
+                if (c == '\n')
+                {
+                    pxSession->xBodyState = (pxSession->uChunkRemaining > 0) ? BODY_CHUNK_DATA : BODY_TRAILER;
+                }
+                break;
+            case BODY_CHUNK_DATA_END:
+                if (c == '\n')
+                {
+                    pxSession->uChunkRemaining = 0;
+                    pxSession->xBodyState = BODY_CHUNK_SIZE;
+                }
+                break;
+            case BODY_TRAILER:
+                /* The body ends at the empty line after the last chunk. */
+                if (c == '\n')
+                {
+                    pxSession->xBodyState = BODY_COMPLETE;
+                }
+                else if (c != '\r')
+                {
+                    pxSession->xBodyState = BODY_CHUNK_EXT;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    prvConsume(pxConn, uIdx);
+}
+
+static void prvServePutMedia(MockConnection_t *pxConn)
+{
+    MockKvsServer_t *pxServer = pxConn->pxServer;
+    MockPutMediaSession_t *pxSession = NULL;
+    const char *pcHeader = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked\r\n\r\n";
+    int retVal = 0;
+
+    pthread_mutex_lock(&(pxServer->xLock));
+    pxServer->xStats.uPutMediaCount++;
+    pthread_mutex_unlock(&(pxServer->xLock));
+
+    if ((pxSession = (MockPutMediaSession_t *)calloc(1, sizeof(MockPutMediaSession_t))) != NULL && prvSend(pxConn, pcHeader, strlen(pcHeader)) == 0)
+    {
+        pxSession->pxConn = pxConn;
+
+        while (!pxServer->bStopping && !pxSession->bMkvError && pxSession->xBodyState != BODY_COMPLETE)
+        {
+            prvDecodePutMediaBody(pxSession);
+            if (prvSendDueAcks(pxSession, false) != 0)
+            {
+                break;
+            }
+            if (pxSession->xBodyState != BODY_COMPLETE && !pxSession->bMkvError && (retVal = prvRecv(pxConn)) < 0)
+            {
+                break;
+            }
+        }
+
+        if (!pxServer->bStopping && retVal >= 0)
+        {
+            if (!pxSession->bMkvError)
+            {
+                prvEndFragment(pxSession);
+            }
+            prvSendDueAcks(pxSession, true);
+            prvSend(pxConn, "0\r\n\r\n", 5);
+        }
+    }
+
+    free(pxSession);
+}
+
+/*-----------------------------------------------------------*/
+
+static const char *prvGetJsonStreamName(JSON_Value *pxRootValue)
+{
+    const char *pcStreamName = NULL;
+    JSON_Object *pxRootObject = NULL;
+
+    if (pxRootValue != NULL && (pxRootObject = json_value_get_object(pxRootValue)) != NULL)
+    {
+        pcStreamName = json_object_get_string(pxRootObject, "StreamName");
+    }
+
+    return pcStreamName;
+}
+
+static bool prvIsIotCredentialUri(const char *pcUri)
+{
+    size_t uUriLen = strlen(pcUri);
+    size_t uBeginLen = strlen(MOCK_KVS_IOT_URI_ROLE_ALIASES_BEGIN);
+    size_t uEndLen = strlen(MOCK_KVS_IOT_URI_ROLE_ALIASES_END);
+
+    return uUriLen > uBeginLen + uEndLen && strncmp(pcUri, MOCK_KVS_IOT_URI_ROLE_ALIASES_BEGIN, uBeginLen) == 0 &&
+           strcmp(pcUri + uUriLen - uEndLen, MOCK_KVS_IOT_URI_ROLE_ALIASES_END) == 0;
+}
+
+/**
+ * Issue an IoT credential that expires after the configured lifetime.
+ */
+static int prvServeIotCredential(MockConnection_t *pxConn)
+{
+    MockKvsServer_t *pxServer = pxConn->pxServer;
+    unsigned int uLifetimeSec = pxServer->xPara.uIotCredentialLifetimeSec;
+    unsigned int uCount = 0;
+    time_t xExpiration = time(NULL);
+    struct tm xTm;
+    char pcExpiration[32];
+    char pcRspBody[256];
+
+    pthread_mutex_lock(&(pxServer->xLock));
+    uCount = ++(pxServer->xStats.uIotCredentialCount);
+    pthread_mutex_unlock(&(pxServer->xLock));
+
+    xExpiration += (uLifetimeSec == 0) ? MOCK_KVS_IOT_CREDENTIAL_DEFAULT_LIFETIME_SEC : uLifetimeSec;
+    gmtime_r(&xExpiration, &xTm);
+    strftime(pcExpiration, sizeof(pcExpiration), "%Y-%m-%dT%H:%M:%SZ", &xTm);
+
+    snprintf(pcRspBody, sizeof(pcRspBody),
+             "{\"credentials\":{\"accessKeyId\":\"ASIAMOCKKVS%08u\",\"secretAccessKey\":\"mock-secret-%u\",\"sessionToken\":\"mock-token-%u\",\"expiration\":\"%s\"}}", uCount,
+             uCount, uCount, pcExpiration);
+
+    return prvSendResponse(pxConn, 200, "OK", pcRspBody);
+}
+
+static int prvServeControlPlane(MockConnection_t *pxConn, const char *pcUri, const char *pcBody)
+{
+    int retVal = 0;
+    MockKvsServer_t *pxServer = pxConn->pxServer;
+    JSON_Value *pxRootValue = json_parse_string(pcBody);
+    const char *pcStreamName = prvGetJsonStreamName(pxRootValue);
+    char pcRspBody[MOCK_KVS_STREAM_NAME_MAX_LEN * 2 + MOCK_KVS_HOST_MAX_LEN + 256];
+    bool bExists = false;
+
+    if (prvIsIotCredentialUri(pcUri))
+    {
+        retVal = prvServeIotCredential(pxConn);
+    }
+    else if (pcStreamName == NULL)
+    {
+        retVal = prvSendResponse(pxConn, 400, "Bad Request", "{\"__type\":\"InvalidArgumentException\",\"Message\":\"StreamName is required\"}");
+    }
+    else if (strcmp(pcUri, "/describeStream") == 0)
+    {
+        pthread_mutex_lock(&(pxServer->xLock));
+        pxServer->xStats.uDescribeStreamCount++;
+        bExists = prvStreamExists(pxServer, pcStreamName);
+        pthread_mutex_unlock(&(pxServer->xLock));
+
+        if (bExists)
+        {
+            snprintf(pcRspBody, sizeof(pcRspBody),
+                     "{\"StreamInfo\":{\"DataRetentionInHours\":2,\"Status\":\"ACTIVE\",\"StreamARN\":\"" MOCK_KVS_STREAM_ARN_TEMPLATE "\",\"StreamName\":\"%s\",\"Version\":\"1\"}}",
+                     pcStreamName, pcStreamName);
+            retVal = prvSendResponse(pxConn, 200, "OK", pcRspBody);
+        }
+        else
+        {
+            retVal = prvSendResponse(pxConn, 404, "Not Found", "{\"__type\":\"ResourceNotFoundException\",\"Message\":\"The requested stream is not found or not active.\"}");
+        }
+    }
+    else if (strcmp(pcUri, "/createStream") == 0)
+    {
+        pthread_mutex_lock(&(pxServer->xLock));
+        pxServer->xStats.uCreateStreamCount++;
+        bExists = !prvAddStream(pxServer, pcStreamName);
+        pthread_mutex_unlock(&(pxServer->xLock));
+
+        if (bExists)
+        {
+            retVal = prvSendResponse(pxConn, 400, "Bad Request", "{\"__type\":\"ResourceInUseException\",\"Message\":\"The stream already exists.\"}");
+        }
+        else
+        {
+            snprintf(pcRspBody, sizeof(pcRspBody), "{\"StreamARN\":\"" MOCK_KVS_STREAM_ARN_TEMPLATE "\"}", pcStreamName);
+            retVal = prvSendResponse(pxConn, 200, "OK", pcRspBody);
+        }
+    }
+    else if (strcmp(pcUri, "/getDataEndpoint") == 0)
+    {
+        pthread_mutex_lock(&(pxServer->xLock));
+        pxServer->xStats.uGetDataEndpointCount++;
+        pthread_mutex_unlock(&(pxServer->xLock));
+
+        /* The data endpoint is this server, addressed the same way as the client did. */
+        snprintf(pcRspBody, sizeof(pcRspBody), "{\"DataEndpoint\":\"https://%s\"}", pxConn->pcHost);
+        retVal = prvSendResponse(pxConn, 200, "OK", pcRspBody);
+    }
+    else
+    {
+        retVal = prvSendResponse(pxConn, 404, "Not Found", "{\"__type\":\"UnknownOperationException\"}");
+    }
+
+    if (pxRootValue != NULL)
+    {
+        json_value_free(pxRootValue);
+    }
+
+    return retVal;
+}
+
+/**
+ * Receive a request header, and get the URI, the content length and if the body is chunked.
+ *
+ * @return The length of the request header, 0 if the connection closes, or negative value on error.
+ */
+static int prvRecvRequestHeader(MockConnection_t *pxConn, char *pcUri, size_t uUriSize, size_t *puContentLength, bool *pbChunked)
+{
+    int retVal = 0;
+    char *pcHeaderEnd = NULL;
+    char *pcLine = NULL;
+    char *pcLineEnd = NULL;
+    char *pcValue = NULL;
+
+    while (!pxConn->pxServer->bStopping)
+    {
+        if (pxConn->uRecvLen > 0)
+        {
+            pxConn->pRecvBuf[pxConn->uRecvLen < sizeof(pxConn->pRecvBuf) ? pxConn->uRecvLen : sizeof(pxConn->pRecvBuf) - 1] = '\0';
+            if ((pcHeaderEnd = strstr((char *)pxConn->pRecvBuf, "\r\n\r\n")) != NULL)
+            {
+                break;
+            }
+        }
+        if ((retVal = prvRecv(pxConn)) < 0)
+        {
+            break;
+        }
+    }
+
+    if (pcHeaderEnd == NULL)
+    {
+        retVal = 0;
+    }
+    else
+    {
+        *pcHeaderEnd = '\0';
+        *puContentLength = 0;
+        *pbChunked = false;
+        pxConn->pcHost[0] = '\0';
+        pcUri[0] = '\0';
+
+        /* Request line: METHOD SP URI SP VERSION */
+        pcLine = (char *)pxConn->pRecvBuf;
+        if ((pcLineEnd = strstr(pcLine, "\r\n")) != NULL)
+        {
+            *pcLineEnd = '\0';
+        }
+        if ((pcValue = strchr(pcLine, ' ')) != NULL)
+        {
+            snprintf(pcUri, uUriSize, "%.*s", (int)strcspn(pcValue + 1, " "), pcValue + 1);
+        }
+
+        while (pcLineEnd != NULL)
+        {
+            pcLine = pcLineEnd + 2;
+            if ((pcLineEnd = strstr(pcLine, "\r\n")) != NULL)
+            {
+                *pcLineEnd = '\0';
+            }
+            if ((pcValue = strchr(pcLine, ':')) == NULL)
+            {
+                continue;
+            }
+            *pcValue++ = '\0';
+            while (*pcValue == ' ')
+            {
+                pcValue++;
+            }
+
+            if (strcasecmp(pcLine, "content-length") == 0)
+            {
+                *puContentLength = (size_t)strtoul(pcValue, NULL, 10);
+            }
+            else if (strcasecmp(pcLine, "transfer-encoding") == 0)
+            {
+                *pbChunked = (strcasecmp(pcValue, "chunked") == 0);
+            }
+            else if (strcasecmp(pcLine, "host") == 0)
+            {
+                snprintf(pxConn->pcHost, sizeof(pxConn->pcHost), "%s", pcValue);
+            }
+        }
+
+        retVal = (int)(pcHeaderEnd - (char *)pxConn->pRecvBuf) + 4;
+    }
+
+    return retVal;
+}
+
+static void prvServeConnection(MockConnection_t *pxConn)
+{
+    MockKvsServer_t *pxServer = pxConn->pxServer;
+    int retVal = 0;
+    char pcUri[64];
+    size_t uContentLength = 0;
+    bool bChunked = false;
+    char *pcBody = NULL;
+
+    pthread_mutex_lock(&(pxServer->xHandshakeLock));
+    while ((retVal = mbedtls_ssl_handshake(&(pxConn->xSsl))) != 0)
+    {
+        if (retVal != MBEDTLS_ERR_SSL_WANT_READ && retVal != MBEDTLS_ERR_SSL_WANT_WRITE && retVal != MBEDTLS_ERR_SSL_TIMEOUT)
+        {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&(pxServer->xHandshakeLock));
+
+    /* Serve requests until the client closes the connection */
+    while (retVal == 0 && !pxServer->bStopping && (retVal = prvRecvRequestHeader(pxConn, pcUri, sizeof(pcUri), &uContentLength, &bChunked)) > 0)
+    {
+        prvConsume(pxConn, (size_t)retVal);
+        retVal = 0;
+
+        if (strcmp(pcUri, "/putMedia") == 0 && bChunked)
+        {
+            prvServePutMedia(pxConn);
+            break;
+        }
+        else if (uContentLength >= sizeof(pxConn->pRecvBuf))
+        {
+            prvSendResponse(pxConn, 413, "Payload Too Large", "{}");
+            break;
+        }
+        else
+        {
+            while (pxConn->uRecvLen < uContentLength && !pxServer->bStopping && (retVal = prvRecv(pxConn)) >= 0)
+            {
+            }
+
+            if (pxConn->uRecvLen < uContentLength || (pcBody = (char *)malloc(uContentLength + 1)) == NULL)
+            {
+                break;
+            }
+
+            memcpy(pcBody, pxConn->pRecvBuf, uContentLength);
+            pcBody[uContentLength] = '\0';
+            prvConsume(pxConn, uContentLength);
+
+            retVal = prvServeControlPlane(pxConn, pcUri, pcBody);
+            free(pcBody);
+            pcBody = NULL;
+        }
+    }
+
+    mbedtls_ssl_close_notify(&(pxConn->xSsl));
+}
+
+static void *prvConnectionThread(void *pArg)
+{
+    MockConnection_t *pxConn = (MockConnection_t *)pArg;
+    MockKvsServer_t *pxServer = pxConn->pxServer;
+
+    prvServeConnection(pxConn);
+
+    mbedtls_ssl_free(&(pxConn->xSsl));
+    mbedtls_net_free(&(pxConn->xFd));
+    free(pxConn);
+
+    pthread_mutex_lock(&(pxServer->xLock));
+    pxServer->uActiveConnections--;
+    pthread_mutex_unlock(&(pxServer->xLock));
+
+    return NULL;
+}
+
+static void *prvAcceptThread(void *pArg)
+{
+    MockKvsServer_t *pxServer = (MockKvsServer_t *)pArg;
+    MockConnection_t *pxConn = NULL;
+    pthread_t xThread;
+    pthread_attr_t xAttr;
+
+    pthread_attr_init(&xAttr);
+    pthread_attr_setdetachstate(&xAttr, PTHREAD_CREATE_DETACHED);
+
+    while (!pxServer->bStopping)
+    {
+        if (mbedtls_net_poll(&(pxServer->xListenFd), MBEDTLS_NET_POLL_READ, MOCK_KVS_POLL_INTERVAL_MS) <= 0)
+        {
+            continue;
+        }
+
+        if ((pxConn = (MockConnection_t *)calloc(1, sizeof(MockConnection_t))) == NULL)
+        {
+            break;
+        }
+
+        pxConn->pxServer = pxServer;
+        mbedtls_net_init(&(pxConn->xFd));
+        mbedtls_ssl_init(&(pxConn->xSsl));
+
+        if (mbedtls_net_accept(&(pxServer->xListenFd), &(pxConn->xFd), NULL, 0, NULL) != 0 || mbedtls_net_set_block(&(pxConn->xFd)) != 0 ||
+            mbedtls_ssl_setup(&(pxConn->xSsl), &(pxServer->xConf)) != 0)
+        {
+            mbedtls_ssl_free(&(pxConn->xSsl));
+            mbedtls_net_free(&(pxConn->xFd));
+            free(pxConn);
+            continue;
+        }
+
+        mbedtls_ssl_set_bio(&(pxConn->xSsl), &(pxConn->xFd), mbedtls_net_send, NULL, mbedtls_net_recv_timeout);
+
+        pthread_mutex_lock(&(pxServer->xLock));
+        pxServer->uActiveConnections++;
+        pthread_mutex_unlock(&(pxServer->xLock));
+
+        if (pthread_create(&xThread, &xAttr, prvConnectionThread, pxConn) != 0)
+        {
+            pthread_mutex_lock(&(pxServer->xLock));
+            pxServer->uActiveConnections--;
+            pthread_mutex_unlock(&(pxServer->xLock));
+
+            mbedtls_ssl_free(&(pxConn->xSsl));
+            mbedtls_net_free(&(pxConn->xFd));
+            free(pxConn);
+        }
+    }
+
+    pthread_attr_destroy(&xAttr);
+
+    return NULL;
+}
+
+static int prvListen(MockKvsServer_t *pxServer)
+{
+    int retVal = 0;
+    char pcPort[8];
+    struct sockaddr_in xAddr;
+    socklen_t uAddrLen = sizeof(xAddr);
+
+    snprintf(pcPort, sizeof(pcPort), "%u", (unsigned int)pxServer->xPara.uPort);
+
+    if ((retVal = mbedtls_net_bind(&(pxServer->xListenFd), MOCK_KVS_BIND_ADDRESS, pcPort, MBEDTLS_NET_PROTO_TCP)) != 0)
+    {
+        /* Propagate the retVal error */
+    }
+    else if ((retVal = getsockname(pxServer->xListenFd.fd, (struct sockaddr *)&xAddr, &uAddrLen)) != 0)
+    {
+        /* Propagate the retVal error */
+    }
+    else
+    {
+        pxServer->uPort = ntohs(xAddr.sin_port);
+    }
+
+    return retVal;
+}
+
+/*-----------------------------------------------------------*/
+
+void MockKvsServer_getDefaultParameter(MockKvsServerParameter_t *pxPara)
+{
+    if (pxPara != NULL)
+    {
+        memset(pxPara, 0, sizeof(MockKvsServerParameter_t));
+        pxPara->bSendBufferingAck = true;
+        pxPara->bSendReceivedAck = true;
+        pxPara->bSendPersistedAck = true;
+    }
+}
+
+MockKvsServerHandle MockKvsServer_create(const MockKvsServerParameter_t *pxPara)
+{
+    MockKvsServer_t *pxServer = NULL;
+    int retVal = 0;
+
+    if (pxPara != NULL && (pxServer = (MockKvsServer_t *)calloc(1, sizeof(MockKvsServer_t))) != NULL)
+    {
+        pxServer->xPara = *pxPara;
+
+        pthread_mutex_init(&(pxServer->xLock), NULL);
+        pthread_mutex_init(&(pxServer->xRngLock), NULL);
+        pthread_mutex_init(&(pxServer->xHandshakeLock), NULL);
+        mbedtls_entropy_init(&(pxServer->xEntropy));
+        mbedtls_ctr_drbg_init(&(pxServer->xCtrDrbg));
+        mbedtls_pk_init(&(pxServer->xCaKey));
+        mbedtls_pk_init(&(pxServer->xServerKey));
+        mbedtls_pk_init(&(pxServer->xClientKey));
+        mbedtls_x509_crt_init(&(pxServer->xServerCertChain));
+        mbedtls_ssl_config_init(&(pxServer->xConf));
+        mbedtls_ssl_cache_init(&(pxServer->xCache));
+        mbedtls_net_init(&(pxServer->xListenFd));
+
+        if ((retVal = prvSetupTls(pxServer)) != 0)
+        {
+            printf("Mock KVS server: failed to setup TLS (err:-%X)\n", -retVal);
+        }
+        else if ((retVal = prvListen(pxServer)) != 0)
+        {
+            printf("Mock KVS server: failed to listen on port %u\n", (unsigned int)pxPara->uPort);
+        }
+        else if ((retVal = pthread_create(&(pxServer->xAcceptThread), NULL, prvAcceptThread, pxServer)) != 0)
+        {
+            printf("Mock KVS server: failed to create thread\n");
+        }
+        else
+        {
+            pxServer->bAcceptThreadStarted = true;
+        }
+
+        if (retVal != 0)
+        {
+            MockKvsServer_terminate(pxServer);
+            pxServer = NULL;
+        }
+    }
+
+    return pxServer;
+}
+
+void MockKvsServer_terminate(MockKvsServerHandle xServer)
+{
+    MockKvsServer_t *pxServer = xServer;
+    unsigned int uActiveConnections = 0;
+
+    if (pxServer != NULL)
+    {
+        pxServer->bStopping = true;
+        if (pxServer->bAcceptThreadStarted)
+        {
+            pthread_join(pxServer->xAcceptThread, NULL);
+        }
+
+        /* Connection threads notice the stopping flag within a poll interval. */
+        do
+        {
+            pthread_mutex_lock(&(pxServer->xLock));
+            uActiveConnections = pxServer->uActiveConnections;
+            pthread_mutex_unlock(&(pxServer->xLock));
+            if (uActiveConnections > 0)
+            {
+                sleepInMs(MOCK_KVS_POLL_INTERVAL_MS);
+            }
+        } while (uActiveConnections > 0);
+
+        mbedtls_net_free(&(pxServer->xListenFd));
+        mbedtls_ssl_cache_free(&(pxServer->xCache));
+        mbedtls_ssl_config_free(&(pxServer->xConf));
+        mbedtls_x509_crt_free(&(pxServer->xServerCertChain));
+        mbedtls_pk_free(&(pxServer->xClientKey));
+        mbedtls_pk_free(&(pxServer->xServerKey));
+        mbedtls_pk_free(&(pxServer->xCaKey));
+        mbedtls_ctr_drbg_free(&(pxServer->xCtrDrbg));
+        mbedtls_entropy_free(&(pxServer->xEntropy));
+        pthread_mutex_destroy(&(pxServer->xHandshakeLock));
+        pthread_mutex_destroy(&(pxServer->xRngLock));
+        pthread_mutex_destroy(&(pxServer->xLock));
+        free(pxServer);
+    }
+}
+
+uint16_t MockKvsServer_getPort(MockKvsServerHandle xServer)
+{
+    return (xServer == NULL) ? 0 : xServer->uPort;
+}
+
+const char *MockKvsServer_getRootCA(MockKvsServerHandle xServer)
+{
+    return (xServer == NULL) ? NULL : xServer->pcRootCA;
+}
+
+const char *MockKvsServer_getClientCertificate(MockKvsServerHandle xServer)
+{
+    return (xServer == NULL) ? NULL : xServer->pcClientCert;
+}
+
+const char *MockKvsServer_getClientPrivateKey(MockKvsServerHandle xServer)
+{
+    return (xServer == NULL) ? NULL : xServer->pcClientPrivateKey;
+}
+
+int MockKvsServer_getStats(MockKvsServerHandle xServer, MockKvsServerStats_t *pxStats)
+{
+    int res = 0;
+    MockKvsServer_t *pxServer = xServer;
+
+    if (pxServer == NULL || pxStats == NULL)
+    {
+        res = -1;
+    }
+    else
+    {
+        pthread_mutex_lock(&(pxServer->xLock));
+        *pxStats = pxServer->xStats;
+        pthread_mutex_unlock(&(pxServer->xLock));
+    }
+
+    return res;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#ifndef MOCK_KVS_SERVER_H
+#define MOCK_KVS_SERVER_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* PUT MEDIA error IDs that the mock server reports */
+#define MOCK_KVS_ERROR_ID_FRAGMENT_TIMECODE_LESSER_THAN_PREVIOUS (4004)
+#define MOCK_KVS_ERROR_ID_INVALID_MKV_DATA (4006)
+
+typedef struct MockKvsServer *MockKvsServerHandle;
+
+typedef struct
+{
+    /* The port to listen on 127.0.0.1, or 0 to pick a free port */
+    uint16_t uPort;
+
+    /* true if describing any stream succeeds without creating it first */
+    bool bStreamExists;
+
+    /* Fragment ACKs to send. BUFFERING is sent when a fragment starts, RECEIVED and PERSISTED are sent after it ends. */
+    bool bSendBufferingAck;
+    bool bSendReceivedAck;
+    bool bSendPersistedAck;
+    unsigned int uReceivedAckDelayMs;
+    unsigned int uPersistedAckDelayMs;
+
+    /* The 1-based index of the fragment that gets an ERROR ACK instead of RECEIVED and PERSISTED, or 0 for none */
+    unsigned int uErrorAckFragmentIndex;
+    unsigned int uErrorAckErrorId;
+
+    /* The lifetime of IoT credentials, or 0 for the default of one hour */
+    unsigned int uIotCredentialLifetimeSec;
+} MockKvsServerParameter_t;
+
+typedef struct
+{
+    /* Control plane requests */
+    unsigned int uDescribeStreamCount;
+    unsigned int uCreateStreamCount;
+    unsigned int uGetDataEndpointCount;
+    unsigned int uPutMediaCount;
+    unsigned int uIotCredentialCount;
+
+    /* The MKV that is received by PUT MEDIA */
+    uint64_t uMkvBytes;
+    unsigned int uEbmlHeaderCount;
+    unsigned int uClusterCount;
+    unsigned int uSimpleBlockCount;
+    unsigned int uKeyFrameCount;
+    unsigned int uMkvErrorCount;
+
+    /* Fragment ACKs that have been sent */
+    unsigned int uBufferingAckCount;
+    unsigned int uReceivedAckCount;
+    unsigned int uPersistedAckCount;
+    unsigned int uErrorAckCount;
+} MockKvsServerStats_t;
+
+/**
+ * @brief Get the default parameter of mock server
+ *
+ * The default mock server picks a free port, requires the stream to be created, and sends all fragment ACKs without
+ * delay.
+ *
+ * @param[out] pxPara The parameter of mock server
+ */
+void MockKvsServer_getDefaultParameter(MockKvsServerParameter_t *pxPara);
+
+/**
+ * @brief Create a mock KVS server and start serving
+ *
+ * The mock server speaks HTTPS on 127.0.0.1 with a test CA that is generated on creation. It serves
+ * "/describeStream", "/createStream", "/getDataEndpoint", "/putMedia" and the IoT credentials of any role alias
+ * "/role-aliases/<alias>/credentials". The MKV received by PUT MEDIA is validated,
+ * and fragment ACKs are sent back according to the parameter.
+ *
+ * @param[in] pxPara The parameter of mock server
+ * @return The mock server handle on success, or NULL otherwise
+ */
+MockKvsServerHandle MockKvsServer_create(const MockKvsServerParameter_t *pxPara);
+
+/**
+ * @brief Stop serving and terminate a mock KVS server
+ *
+ * @param[in] xServer The mock server handle
+ */
+void MockKvsServer_terminate(MockKvsServerHandle xServer);
+
+/**
+ * @brief Get the listening port of a mock KVS server
+ *
+ * @param[in] xServer The mock server handle
+ * @return The listening port, or 0 if the handle is invalid
+ */
+uint16_t MockKvsServer_getPort(MockKvsServerHandle xServer);
+
+/**
+ * @brief Get the root CA that signs the certificate of a mock KVS server
+ *
+ * @param[in] xServer The mock server handle
+ * @return The root CA in PEM, or NULL if the handle is invalid
+ */
+const char *MockKvsServer_getRootCA(MockKvsServerHandle xServer);
+
+/**
+ * @brief Get a client certificate signed by the root CA of a mock KVS server, which can be used as IoT certificate
+ *
+ * @param[in] xServer The mock server handle
+ * @return The client certificate in PEM, or NULL if the handle is invalid
+ */
+const char *MockKvsServer_getClientCertificate(MockKvsServerHandle xServer);
+
+/**
+ * @brief Get the private key of the client certificate of a mock KVS server
+ *
+ * @param[in] xServer The mock server handle
+ * @return The private key in PEM, or NULL if the handle is invalid
+ */
+const char *MockKvsServer_getClientPrivateKey(MockKvsServerHandle xServer);
+
+/**
+ * @brief Get the statistics of a mock KVS server
+ *
+ * @param[in] xServer The mock server handle
+ * @param[out] pxStats The statistics
+ * @return 0 on success, non-zero value otherwise
+ */
+int MockKvsServer_getStats(MockKvsServerHandle xServer, MockKvsServerStats_t *pxStats);
+
+#endif /* MOCK_KVS_SERVER_H */
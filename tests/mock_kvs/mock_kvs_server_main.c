@@ -0,0 +1,126 @@
+/*
+ * Copyright 2021 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kvs/port.h"
+
+#include "mock_kvs_server.h"
+
+#define DEFAULT_PORT (8443)
+
+static volatile bool gStopRunning = false;
+
+static void signalHandler(int signum)
+{
+    (void)signum;
+    gStopRunning = true;
+}
+
+static void printUsage(const char *pcProgram)
+{
+    printf("Usage: %s [-p port] [-r received_ack_delay_ms] [-d persisted_ack_delay_ms] [-e error_fragment_index] [-c root_ca_file]\n", pcProgram);
+    printf("  The mock server listens on 127.0.0.1 and accepts any stream name and credential.\n");
+    printf("  Point the producer to \"127.0.0.1:<port>\" and trust the root CA written to root_ca_file.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    MockKvsServerStats_t xStats;
+    const char *pcRootCAFile = NULL;
+    FILE *fp = NULL;
+    int i = 0;
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    xPara.uPort = DEFAULT_PORT;
+    xPara.bStreamExists = true;
+    xPara.uErrorAckErrorId = MOCK_KVS_ERROR_ID_INVALID_MKV_DATA;
+
+    for (i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-p") == 0)
+        {
+            xPara.uPort = (uint16_t)atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-r") == 0)
+        {
+            xPara.uReceivedAckDelayMs = (unsigned int)atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-d") == 0)
+        {
+            xPara.uPersistedAckDelayMs = (unsigned int)atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-e") == 0)
+        {
+            xPara.uErrorAckFragmentIndex = (unsigned int)atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-c") == 0)
+        {
+            pcRootCAFile = argv[i + 1];
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (i < argc)
+    {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    if ((xServer = MockKvsServer_create(&xPara)) == NULL)
+    {
+        printf("Failed to create mock KVS server\n");
+        return -1;
+    }
+
+    if (pcRootCAFile != NULL)
+    {
+        if ((fp = fopen(pcRootCAFile, "w")) == NULL)
+        {
+            printf("Failed to open %s\n", pcRootCAFile);
+        }
+        else
+        {
+            fputs(MockKvsServer_getRootCA(xServer), fp);
+            fclose(fp);
+        }
+    }
+
+    printf("Mock KVS server is listening on 127.0.0.1:%u\n", (unsigned int)MockKvsServer_getPort(xServer));
+
+    signal(SIGINT, signalHandler);
+    while (!gStopRunning)
+    {
+        sleepInMs(100);
+    }
+
+    MockKvsServer_getStats(xServer, &xStats);
+    printf("PUT MEDIA:%u MKV bytes:%llu clusters:%u blocks:%u key frames:%u MKV errors:%u\n", xStats.uPutMediaCount, (unsigned long long)xStats.uMkvBytes,
+           xStats.uClusterCount, xStats.uSimpleBlockCount, xStats.uKeyFrameCount, xStats.uMkvErrorCount);
+    printf("ACKs BUFFERING:%u RECEIVED:%u PERSISTED:%u ERROR:%u\n", xStats.uBufferingAckCount, xStats.uReceivedAckCount, xStats.uPersistedAckCount,
+           xStats.uErrorAckCount);
+
+    MockKvsServer_terminate(xServer);
+
+    return 0;
+}
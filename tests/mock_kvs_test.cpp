@@ -0,0 +1,802 @@
+#ifdef __cplusplus
+extern "C" {
+#include "kvs/errors.h"
+#include "kvs/kvsapp.h"
+#include "kvs/kvsapp_options.h"
+#include "kvs/nalu.h"
+#include "kvs/port.h"
+#include "kvs/restapi.h"
+#include "misc/endpoint_cache.h"
+#include "mock_kvs_server.h"
+#include "os/allocator.h"
+}
+#endif
+
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#define TEST_STREAM_NAME "mock-kvs-test-stream"
+#define TEST_FRAME_COUNT (240)
+#define TEST_FRAME_INTERVAL_MS (40)
+#define TEST_FRAME_FILE_FORMAT KVS_MEDIA_DIR "/h264_annexb/frame-%03d.h264"
+#define TEST_TIMEOUT_MS (10000)
+#define TEST_ENDPOINT_CACHE_FILE "mock_kvs_endpoint_cache.json"
+
+/* Converting 3-byte start codes to 4-byte lengths needs spare space */
+#define TEST_FRAME_SPARE_BYTES (64)
+
+static void prvGetHost(MockKvsServerHandle xServer, char *pcHost, size_t uHostSize)
+{
+    snprintf(pcHost, uHostSize, "127.0.0.1:%u", (unsigned int)MockKvsServer_getPort(xServer));
+}
+
+static uint8_t *prvReadFrame(int index, size_t *puLen)
+{
+    char pcPath[256];
+    FILE *fp = NULL;
+    long len = 0;
+    uint8_t *pData = NULL;
+
+    snprintf(pcPath, sizeof(pcPath), TEST_FRAME_FILE_FORMAT, index);
+    if ((fp = fopen(pcPath, "rb")) != NULL)
+    {
+        fseek(fp, 0, SEEK_END);
+        len = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        if (len > 0 && (pData = (uint8_t *)malloc((size_t)len + TEST_FRAME_SPARE_BYTES)) != NULL && fread(pData, 1, (size_t)len, fp) != (size_t)len)
+        {
+            free(pData);
+            pData = NULL;
+        }
+        fclose(fp);
+    }
+    *puLen = (pData == NULL) ? 0 : (size_t)len;
+
+    return pData;
+}
+
+static bool prvIsKeyFrame(uint8_t *pData, size_t uLen)
+{
+    uint8_t *pNalu = NULL;
+    size_t uNaluLen = 0;
+
+    return NALU_getNaluFromAnnexBNalus(pData, uLen, NALU_TYPE_IFRAME, &pNalu, &uNaluLen) == KVS_ERRNO_NONE;
+}
+
+static KvsAppHandle prvCreateKvsApp(MockKvsServerHandle xServer)
+{
+    char pcHost[64];
+    KvsAppHandle xKvsApp = NULL;
+
+    prvGetHost(xServer, pcHost, sizeof(pcHost));
+    if ((xKvsApp = KvsApp_create(pcHost, "us-east-1", "kinesisvideo", TEST_STREAM_NAME)) != NULL)
+    {
+        /* The mock server accepts any credential. */
+        KvsApp_setoption(xKvsApp, OPTION_AWS_ACCESS_KEY_ID, "AKIDEXAMPLE");
+        KvsApp_setoption(xKvsApp, OPTION_AWS_SECRET_ACCESS_KEY, "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY");
+    }
+
+    return xKvsApp;
+}
+
+TEST(MockKvs, restful_create_and_describe_stream)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    KvsServiceParameter_t xServicePara;
+    KvsDescribeStreamParameter_t xDescPara;
+    KvsCreateStreamParameter_t xCreatePara;
+    KvsGetDataEndpointParameter_t xGetDataEpPara;
+    unsigned int uHttpStatusCode = 0;
+    char pcHost[64];
+    char *pcDataEndpoint = NULL;
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+    prvGetHost(xServer, pcHost, sizeof(pcHost));
+
+    memset(&xServicePara, 0, sizeof(xServicePara));
+    xServicePara.pcAccessKey = (char *)"AKIDEXAMPLE";
+    xServicePara.pcSecretKey = (char *)"wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY";
+    xServicePara.pcRegion = (char *)"us-east-1";
+    xServicePara.pcService = (char *)"kinesisvideo";
+    xServicePara.pcHost = pcHost;
+    xDescPara.pcStreamName = (char *)TEST_STREAM_NAME;
+    xCreatePara.pcStreamName = (char *)TEST_STREAM_NAME;
+    xCreatePara.uDataRetentionInHours = 2;
+    xGetDataEpPara.pcStreamName = (char *)TEST_STREAM_NAME;
+
+    EXPECT_EQ(0, Kvs_describeStream(&xServicePara, &xDescPara, &uHttpStatusCode));
+    EXPECT_EQ(404, uHttpStatusCode);
+
+    EXPECT_EQ(0, Kvs_createStream(&xServicePara, &xCreatePara, &uHttpStatusCode));
+    EXPECT_EQ(200, uHttpStatusCode);
+
+    EXPECT_EQ(0, Kvs_describeStream(&xServicePara, &xDescPara, &uHttpStatusCode));
+    EXPECT_EQ(200, uHttpStatusCode);
+
+    EXPECT_EQ(0, Kvs_getDataEndpoint(&xServicePara, &xGetDataEpPara, &uHttpStatusCode, &pcDataEndpoint));
+    EXPECT_EQ(200, uHttpStatusCode);
+    ASSERT_NE(nullptr, pcDataEndpoint);
+    EXPECT_STREQ(pcHost, pcDataEndpoint);
+    kvsFree(pcDataEndpoint);
+
+    MockKvsServer_terminate(xServer);
+}
+
+TEST(MockKvs, kvsapp_stream_is_persisted)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    MockKvsServerStats_t xStats;
+    KvsAppHandle xKvsApp = NULL;
+    ePutMediaFragmentAckEventType eAckEventType = eUnknown;
+    uint64_t uFragmentTimecode = 0;
+    unsigned int uErrorId = 0;
+    unsigned int uKeyFrameCount = 0;
+    unsigned int uPersistedAckCount = 0;
+    uint64_t uBaseTimestampMs = 0;
+    uint64_t uDeadline = 0;
+    uint8_t *pData = NULL;
+    size_t uLen = 0;
+    int i = 0;
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+    ASSERT_NE(nullptr, xKvsApp = prvCreateKvsApp(xServer));
+    ASSERT_EQ(0, KvsApp_open(xKvsApp));
+
+    uBaseTimestampMs = getEpochTimestampInMs();
+    for (i = 1; i <= TEST_FRAME_COUNT; i++)
+    {
+        ASSERT_NE(nullptr, pData = prvReadFrame(i, &uLen)) << "frame " << i;
+        uKeyFrameCount += prvIsKeyFrame(pData, uLen) ? 1 : 0;
+
+        /* KvsApp frees the frame. */
+        EXPECT_EQ(0, KvsApp_addFrame(xKvsApp, pData, uLen, uLen + TEST_FRAME_SPARE_BYTES, uBaseTimestampMs + (uint64_t)(i - 1) * TEST_FRAME_INTERVAL_MS, TRACK_VIDEO));
+        EXPECT_EQ(0, KvsApp_doWork(xKvsApp));
+    }
+
+    /* The last fragment is acknowledged after the connection closes, so the rest are expected to be persisted. */
+    uDeadline = getEpochTimestampInMs() + TEST_TIMEOUT_MS;
+    while (uPersistedAckCount + 1 < uKeyFrameCount && getEpochTimestampInMs() < uDeadline)
+    {
+        ASSERT_EQ(0, KvsApp_doWork(xKvsApp));
+        while (KvsApp_readFragmentAck(xKvsApp, &eAckEventType, &uFragmentTimecode, &uErrorId) == 0)
+        {
+            EXPECT_NE(eError, eAckEventType);
+            uPersistedAckCount += (eAckEventType == ePersisted) ? 1 : 0;
+        }
+        sleepInMs(10);
+    }
+    EXPECT_EQ(uKeyFrameCount - 1, uPersistedAckCount);
+
+    EXPECT_EQ(0, KvsApp_close(xKvsApp));
+    KvsApp_terminate(xKvsApp);
+
+    ASSERT_EQ(0, MockKvsServer_getStats(xServer, &xStats));
+    EXPECT_EQ(1, xStats.uCreateStreamCount);
+    EXPECT_EQ(1, xStats.uPutMediaCount);
+    EXPECT_EQ(1, xStats.uEbmlHeaderCount);
+    EXPECT_EQ(0, xStats.uMkvErrorCount);
+    EXPECT_EQ(uKeyFrameCount, xStats.uClusterCount);
+    EXPECT_EQ(uKeyFrameCount, xStats.uKeyFrameCount);
+    EXPECT_EQ(TEST_FRAME_COUNT, xStats.uSimpleBlockCount);
+
+    MockKvsServer_terminate(xServer);
+}
+
+#define TEST_BATCH_FRAME_COUNT (60)
+#define TEST_BATCH_SEND_DELAY_MS (10)
+#define TEST_BATCH_TIME_BUDGET_MS (30)
+
+static int prvOnBatchFrameTerminate(uint8_t *pData, size_t uDataLen, uint64_t uTimestamp, TrackType_t xTrackType, void *pAppData)
+{
+    (void)uDataLen;
+    (void)uTimestamp;
+    (void)xTrackType;
+    free(pData);
+    (*(unsigned int *)pAppData)++;
+
+    return 0;
+}
+
+static int prvOnSlowMkvSent(uint8_t *pData, size_t uDataLen, void *pAppData)
+{
+    (void)pData;
+    (void)uDataLen;
+    (void)pAppData;
+    sleepInMs(TEST_BATCH_SEND_DELAY_MS);
+
+    return 0;
+}
+
+TEST(MockKvs, kvsapp_send_batch_stops_at_budget)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    MockKvsServerStats_t xStats;
+    KvsAppHandle xKvsApp = NULL;
+    DoWorkExParamter_t xDoWorkPara;
+    DataFrameCallbacks_t xCallbacks;
+    unsigned int uSentCount = 0;
+    unsigned int uLastSentCount = 0;
+    uint64_t uBaseTimestampMs = 0;
+    uint8_t *pData = NULL;
+    size_t uLen = 0;
+    int i = 0;
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+    ASSERT_NE(nullptr, xKvsApp = prvCreateKvsApp(xServer));
+    ASSERT_EQ(0, KvsApp_open(xKvsApp));
+
+    /* Queue a backlog, and count frames that are terminated after they are sent. */
+    memset(&xCallbacks, 0, sizeof(xCallbacks));
+    xCallbacks.onDataFrameTerminateInfo.onDataFrameTerminate = prvOnBatchFrameTerminate;
+    xCallbacks.onDataFrameTerminateInfo.pAppData = &uSentCount;
+    uBaseTimestampMs = getEpochTimestampInMs();
+    for (i = 1; i <= TEST_BATCH_FRAME_COUNT; i++)
+    {
+        ASSERT_NE(nullptr, pData = prvReadFrame(i, &uLen)) << "frame " << i;
+        EXPECT_EQ(0, KvsApp_addFrameWithCallbacks(xKvsApp, pData, uLen, uLen + TEST_FRAME_SPARE_BYTES, uBaseTimestampMs + (uint64_t)(i - 1) * TEST_FRAME_INTERVAL_MS,
+                                                  TRACK_VIDEO, &xCallbacks));
+    }
+
+    memset(&xDoWorkPara, 0, sizeof(xDoWorkPara));
+    xDoWorkPara.eType = DO_WORK_SEND_BATCH;
+
+    /* The frame budget */
+    xDoWorkPara.uMaxSendFrames = 5;
+    EXPECT_EQ(0, KvsApp_doWorkEx(xKvsApp, &xDoWorkPara));
+    EXPECT_EQ(5, uSentCount);
+
+    /* The byte budget is reached by the first frame. */
+    xDoWorkPara.uMaxSendFrames = 0;
+    xDoWorkPara.uMaxSendBytes = 1;
+    EXPECT_EQ(0, KvsApp_doWorkEx(xKvsApp, &xDoWorkPara));
+    EXPECT_EQ(6, uSentCount);
+
+    /* The time budget is reached after a few slow frames. */
+    xDoWorkPara.uMaxSendBytes = 0;
+    xDoWorkPara.uTimeBudgetMs = TEST_BATCH_TIME_BUDGET_MS;
+    ASSERT_EQ(0, KvsApp_setOnMkvSentCallback(xKvsApp, prvOnSlowMkvSent, NULL));
+    EXPECT_EQ(0, KvsApp_doWorkEx(xKvsApp, &xDoWorkPara));
+    EXPECT_GT(uSentCount, 6);
+    EXPECT_LT(uSentCount, TEST_BATCH_FRAME_COUNT);
+    ASSERT_EQ(0, KvsApp_setOnMkvSentCallback(xKvsApp, NULL, NULL));
+
+    /* A later call within the frame budget sends exactly the budget, and one without a budget drains the rest. */
+    xDoWorkPara.uTimeBudgetMs = 0;
+    xDoWorkPara.uMaxSendFrames = 3;
+    uLastSentCount = uSentCount;
+    EXPECT_EQ(0, KvsApp_doWorkEx(xKvsApp, &xDoWorkPara));
+    EXPECT_EQ(uLastSentCount + 3, uSentCount);
+
+    xDoWorkPara.uMaxSendFrames = 0;
+    EXPECT_EQ(0, KvsApp_doWorkEx(xKvsApp, &xDoWorkPara));
+    EXPECT_EQ(TEST_BATCH_FRAME_COUNT, uSentCount);
+
+    EXPECT_EQ(0, KvsApp_close(xKvsApp));
+    KvsApp_terminate(xKvsApp);
+
+    ASSERT_EQ(0, MockKvsServer_getStats(xServer, &xStats));
+    EXPECT_EQ(0, xStats.uMkvErrorCount);
+    EXPECT_EQ(TEST_BATCH_FRAME_COUNT, xStats.uSimpleBlockCount);
+
+    MockKvsServer_terminate(xServer);
+}
+
+/* An H.265 frame with 3 bytes start codes, which has VPS, SPS and PPS before an IDR picture in key frames */
+static uint8_t *prvCreateH265Frame(bool bIsKeyFrame, size_t *puLen)
+{
+    static const uint8_t pParameterSets[] = {
+        0x00, 0x00, 0x01, 0x40, 0x01, 0x0C, 0x01, 0xFF, 0xFF, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5D, 0x95,
+        0x98, 0x09, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5D, 0xA0, 0x02,
+        0x80, 0x80, 0x2D, 0x16, 0x59, 0x59, 0xA4, 0x93, 0x2B, 0xC0, 0x00, 0x00, 0x01, 0x44, 0x01, 0xC1, 0x72, 0xB4, 0x62, 0x40};
+    size_t uSliceLen = 1000;
+    size_t uLen = (bIsKeyFrame ? sizeof(pParameterSets) : 0) + 3 + uSliceLen;
+    uint8_t *pData = NULL;
+    uint8_t *pIdx = NULL;
+
+    if ((pData = (uint8_t *)malloc(uLen + TEST_FRAME_SPARE_BYTES)) != NULL)
+    {
+        pIdx = pData;
+        if (bIsKeyFrame)
+        {
+            memcpy(pIdx, pParameterSets, sizeof(pParameterSets));
+            pIdx += sizeof(pParameterSets);
+        }
+        memcpy(pIdx, "\x00\x00\x01", 3);
+        pIdx += 3;
+        /* IDR_W_RADL or TRAIL_R */
+        pIdx[0] = bIsKeyFrame ? 0x26 : 0x02;
+        pIdx[1] = 0x01;
+        memset(pIdx + 2, 0xA5, uSliceLen - 2);
+    }
+    *puLen = (pData == NULL) ? 0 : uLen;
+
+    return pData;
+}
+
+TEST(MockKvs, kvsapp_h265_stream)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    MockKvsServerStats_t xStats;
+    KvsAppHandle xKvsApp = NULL;
+    VideoCodec_t xVideoCodec = VIDEO_CODEC_H265;
+    unsigned int uKeyFrameCount = 0;
+    uint64_t uBaseTimestampMs = 0;
+    uint8_t *pData = NULL;
+    size_t uLen = 0;
+    int i = 0;
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+    ASSERT_NE(nullptr, xKvsApp = prvCreateKvsApp(xServer));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_KVS_VIDEO_CODEC, (const char *)&xVideoCodec));
+    ASSERT_EQ(0, KvsApp_open(xKvsApp));
+
+    uBaseTimestampMs = getEpochTimestampInMs();
+    for (i = 0; i < TEST_FRAME_COUNT / 2; i++)
+    {
+        ASSERT_NE(nullptr, pData = prvCreateH265Frame(i % 30 == 0, &uLen));
+        uKeyFrameCount += (i % 30 == 0) ? 1 : 0;
+
+        /* KvsApp frees the frame. */
+        EXPECT_EQ(0, KvsApp_addFrame(xKvsApp, pData, uLen, uLen + TEST_FRAME_SPARE_BYTES, uBaseTimestampMs + (uint64_t)i * TEST_FRAME_INTERVAL_MS, TRACK_VIDEO));
+        EXPECT_EQ(0, KvsApp_doWork(xKvsApp));
+    }
+
+    EXPECT_EQ(0, KvsApp_close(xKvsApp));
+    KvsApp_terminate(xKvsApp);
+
+    ASSERT_EQ(0, MockKvsServer_getStats(xServer, &xStats));
+    EXPECT_EQ(1, xStats.uEbmlHeaderCount);
+    EXPECT_EQ(0, xStats.uMkvErrorCount);
+    EXPECT_EQ(uKeyFrameCount, xStats.uClusterCount);
+    EXPECT_EQ(uKeyFrameCount, xStats.uKeyFrameCount);
+    EXPECT_EQ(TEST_FRAME_COUNT / 2, xStats.uSimpleBlockCount);
+
+    MockKvsServer_terminate(xServer);
+}
+
+TEST(MockKvs, kvsapp_latency_stats_match_fragment_acks)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    KvsAppHandle xKvsApp = NULL;
+    KvsAppLatencyStats_t xLatencyStats;
+    ePutMediaFragmentAckEventType eAckEventType = eUnknown;
+    uint64_t uFragmentTimecode = 0;
+    unsigned int uErrorId = 0;
+    unsigned int uKeyFrameCount = 0;
+    unsigned int uPersistedAckCount = 0;
+    uint64_t uBaseTimestampMs = 0;
+    uint64_t uDeadline = 0;
+    uint8_t *pData = NULL;
+    size_t uLen = 0;
+    int i = 0;
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    xPara.uPersistedAckDelayMs = 100;
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+    ASSERT_NE(nullptr, xKvsApp = prvCreateKvsApp(xServer));
+    EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, KvsApp_getLatencyStats(xKvsApp, NULL));
+    ASSERT_EQ(0, KvsApp_open(xKvsApp));
+
+    uBaseTimestampMs = getEpochTimestampInMs();
+    for (i = 1; i <= TEST_FRAME_COUNT; i++)
+    {
+        ASSERT_NE(nullptr, pData = prvReadFrame(i, &uLen)) << "frame " << i;
+        uKeyFrameCount += prvIsKeyFrame(pData, uLen) ? 1 : 0;
+        EXPECT_EQ(0, KvsApp_addFrame(xKvsApp, pData, uLen, uLen + TEST_FRAME_SPARE_BYTES, uBaseTimestampMs + (uint64_t)(i - 1) * TEST_FRAME_INTERVAL_MS, TRACK_VIDEO));
+        EXPECT_EQ(0, KvsApp_doWork(xKvsApp));
+    }
+
+    uDeadline = getEpochTimestampInMs() + TEST_TIMEOUT_MS;
+    while (uPersistedAckCount + 1 < uKeyFrameCount && getEpochTimestampInMs() < uDeadline)
+    {
+        ASSERT_EQ(0, KvsApp_doWork(xKvsApp));
+        while (KvsApp_readFragmentAck(xKvsApp, &eAckEventType, &uFragmentTimecode, &uErrorId) == 0)
+        {
+            uPersistedAckCount += (eAckEventType == ePersisted) ? 1 : 0;
+        }
+        sleepInMs(10);
+    }
+    EXPECT_EQ(uKeyFrameCount - 1, uPersistedAckCount);
+
+    ASSERT_EQ(0, KvsApp_getLatencyStats(xKvsApp, &xLatencyStats));
+    EXPECT_EQ(0, KvsApp_close(xKvsApp));
+    KvsApp_terminate(xKvsApp);
+
+    /* Every frame is stamped, and every fragment ACK is matched to a fragment that has been sent. */
+    EXPECT_EQ(TEST_FRAME_COUNT, xLatencyStats.xEnqueueToSendStart.uCount);
+    EXPECT_EQ(TEST_FRAME_COUNT, xLatencyStats.xSendDuration.uCount);
+    EXPECT_EQ(0, xLatencyStats.uUnmatchedAckCount);
+    EXPECT_EQ(0, xLatencyStats.uErrorFragmentCount);
+    EXPECT_EQ(0, xLatencyStats.uUntrackedFragmentCount);
+    EXPECT_EQ(uPersistedAckCount, xLatencyStats.xEnqueueToPersisted.uCount);
+    EXPECT_GE(xLatencyStats.xEnqueueToBuffering.uCount, uPersistedAckCount);
+    EXPECT_GE(xLatencyStats.xEnqueueToReceived.uCount, uPersistedAckCount);
+
+    /* A fragment is persisted only after the server delay, counted from when its first frame was added. */
+    EXPECT_GE(xLatencyStats.xEnqueueToPersisted.uMinMs, xPara.uPersistedAckDelayMs);
+    EXPECT_GE(xLatencyStats.xEnqueueToPersisted.uMinMs, xLatencyStats.xEnqueueToReceived.uMinMs);
+    EXPECT_LE(LatencyHistogram_getPercentile(&(xLatencyStats.xEnqueueToPersisted), 50), xLatencyStats.xEnqueueToPersisted.uMaxMs);
+
+    MockKvsServer_terminate(xServer);
+}
+
+TEST(MockKvs, kvsapp_error_ack_fails_do_work)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    KvsAppHandle xKvsApp = NULL;
+    uint64_t uBaseTimestampMs = 0;
+    uint8_t *pData = NULL;
+    size_t uLen = 0;
+    int res = 0;
+    int i = 0;
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    xPara.bStreamExists = true;
+    xPara.uErrorAckFragmentIndex = 1;
+    xPara.uErrorAckErrorId = MOCK_KVS_ERROR_ID_INVALID_MKV_DATA;
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+    ASSERT_NE(nullptr, xKvsApp = prvCreateKvsApp(xServer));
+    ASSERT_EQ(0, KvsApp_open(xKvsApp));
+
+    uBaseTimestampMs = getEpochTimestampInMs();
+    for (i = 1; i <= TEST_FRAME_COUNT && res == 0; i++)
+    {
+        ASSERT_NE(nullptr, pData = prvReadFrame(i, &uLen)) << "frame " << i;
+        KvsApp_addFrame(xKvsApp, pData, uLen, uLen + TEST_FRAME_SPARE_BYTES, uBaseTimestampMs + (uint64_t)(i - 1) * TEST_FRAME_INTERVAL_MS, TRACK_VIDEO);
+        res = KvsApp_doWork(xKvsApp);
+        sleepInMs(1);
+    }
+    EXPECT_EQ(KVS_GENERATE_PUTMEDIA_ERROR(MOCK_KVS_ERROR_ID_INVALID_MKV_DATA), res);
+
+    KvsApp_close(xKvsApp);
+    KvsApp_terminate(xKvsApp);
+    MockKvsServer_terminate(xServer);
+}
+
+typedef struct SenderResult
+{
+    std::atomic<unsigned int> uPersistedAckCount;
+    std::atomic<unsigned int> uErrorAckCount;
+    std::atomic<unsigned int> uSenderErrorCount;
+} SenderResult_t;
+
+static void prvOnFragmentAck(ePutMediaFragmentAckEventType eAckEventType, uint64_t uFragmentTimecode, unsigned int uErrorId, void *pAppData)
+{
+    SenderResult_t *pxResult = (SenderResult_t *)pAppData;
+
+    pxResult->uPersistedAckCount += (eAckEventType == ePersisted) ? 1 : 0;
+    pxResult->uErrorAckCount += (eAckEventType == eError) ? 1 : 0;
+}
+
+static void prvOnSenderError(int xErrCode, void *pAppData)
+{
+    SenderResult_t *pxResult = (SenderResult_t *)pAppData;
+
+    (void)xErrCode;
+    pxResult->uSenderErrorCount++;
+}
+
+TEST(MockKvs, kvsapp_sender_thread_streams_and_drains)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    MockKvsServerStats_t xStats;
+    KvsAppHandle xKvsApp = NULL;
+    SenderResult_t xResult;
+    SenderCallbacks_t xCallbacks = {prvOnFragmentAck, prvOnSenderError, &xResult};
+    unsigned int uKeyFrameCount = 0;
+    uint64_t uBaseTimestampMs = 0;
+    uint64_t uDeadline = 0;
+    uint8_t *pData = NULL;
+    size_t uLen = 0;
+    int i = 0;
+
+    xResult.uPersistedAckCount = 0;
+    xResult.uErrorAckCount = 0;
+    xResult.uSenderErrorCount = 0;
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    xPara.bStreamExists = true;
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+    ASSERT_NE(nullptr, xKvsApp = prvCreateKvsApp(xServer));
+
+    ASSERT_EQ(0, KvsApp_startSender(xKvsApp, &xCallbacks));
+    EXPECT_EQ(KVS_ERROR_KVSAPP_SENDER_IS_RUNNING, KvsApp_startSender(xKvsApp, &xCallbacks));
+
+    uBaseTimestampMs = getEpochTimestampInMs();
+    for (i = 1; i <= TEST_FRAME_COUNT; i++)
+    {
+        ASSERT_NE(nullptr, pData = prvReadFrame(i, &uLen)) << "frame " << i;
+        uKeyFrameCount += prvIsKeyFrame(pData, uLen) ? 1 : 0;
+
+        /* The application only adds frames. */
+        EXPECT_EQ(0, KvsApp_addFrame(xKvsApp, pData, uLen, uLen + TEST_FRAME_SPARE_BYTES, uBaseTimestampMs + (uint64_t)(i - 1) * TEST_FRAME_INTERVAL_MS, TRACK_VIDEO));
+        sleepInMs(1);
+    }
+
+    /* The last fragment is acknowledged after the connection closes, and the rest are delivered by the sender thread. */
+    uDeadline = getEpochTimestampInMs() + TEST_TIMEOUT_MS;
+    while (xResult.uPersistedAckCount + 1 < uKeyFrameCount && getEpochTimestampInMs() < uDeadline)
+    {
+        sleepInMs(10);
+    }
+    EXPECT_EQ(0, KvsApp_stopSender(xKvsApp, TEST_TIMEOUT_MS));
+    EXPECT_EQ(KVS_ERROR_KVSAPP_SENDER_IS_NOT_RUNNING, KvsApp_stopSender(xKvsApp, 0));
+
+    EXPECT_EQ(uKeyFrameCount - 1, xResult.uPersistedAckCount);
+    EXPECT_EQ(0, xResult.uErrorAckCount);
+    EXPECT_EQ(0, xResult.uSenderErrorCount);
+
+    KvsApp_terminate(xKvsApp);
+
+    ASSERT_EQ(0, MockKvsServer_getStats(xServer, &xStats));
+    EXPECT_EQ(1, xStats.uPutMediaCount);
+    EXPECT_EQ(0, xStats.uMkvErrorCount);
+    EXPECT_EQ(TEST_FRAME_COUNT, xStats.uSimpleBlockCount);
+
+    MockKvsServer_terminate(xServer);
+}
+
+TEST(MockKvs, kvsapp_auto_reconnect_after_error_ack)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    MockKvsServerStats_t xStats;
+    KvsAppHandle xKvsApp = NULL;
+    bool bAutoReconnect = true;
+    unsigned int uBaseDelayMs = 10;
+    unsigned int uJitterPercent = 0;
+    uint64_t uBaseTimestampMs = 0;
+    uint64_t uDeadline = 0;
+    uint8_t *pData = NULL;
+    size_t uLen = 0;
+    int i = 0;
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    xPara.bStreamExists = true;
+    xPara.uErrorAckFragmentIndex = 1;
+    xPara.uErrorAckErrorId = MOCK_KVS_ERROR_ID_INVALID_MKV_DATA;
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+    ASSERT_NE(nullptr, xKvsApp = prvCreateKvsApp(xServer));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_RECONNECT_AUTO, (const char *)&bAutoReconnect));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_RECONNECT_BASE_DELAY, (const char *)&uBaseDelayMs));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_RECONNECT_JITTER, (const char *)&uJitterPercent));
+    ASSERT_EQ(0, KvsApp_open(xKvsApp));
+
+    uBaseTimestampMs = getEpochTimestampInMs();
+    for (i = 1; i <= TEST_FRAME_COUNT; i++)
+    {
+        ASSERT_NE(nullptr, pData = prvReadFrame(i, &uLen)) << "frame " << i;
+        KvsApp_addFrame(xKvsApp, pData, uLen, uLen + TEST_FRAME_SPARE_BYTES, uBaseTimestampMs + (uint64_t)(i - 1) * TEST_FRAME_INTERVAL_MS, TRACK_VIDEO);
+
+        /* The error ACK is handled by re-opening the session instead of failing. */
+        EXPECT_EQ(0, KvsApp_doWork(xKvsApp)) << "frame " << i;
+        sleepInMs(1);
+    }
+
+    uDeadline = getEpochTimestampInMs() + TEST_TIMEOUT_MS;
+    while (MockKvsServer_getStats(xServer, &xStats) == 0 && xStats.uPutMediaCount < 2 && getEpochTimestampInMs() < uDeadline)
+    {
+        EXPECT_EQ(0, KvsApp_doWork(xKvsApp));
+    }
+    EXPECT_LE(2, xStats.uPutMediaCount);
+    EXPECT_EQ(xStats.uPutMediaCount, xStats.uEbmlHeaderCount);
+
+    KvsApp_close(xKvsApp);
+    KvsApp_terminate(xKvsApp);
+    MockKvsServer_terminate(xServer);
+}
+
+TEST(MockKvs, kvsapp_rotation_keeps_every_frame)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    MockKvsServerStats_t xStats;
+    KvsAppHandle xKvsApp = NULL;
+    KvsAppLatencyStats_t xLatencyStats;
+    ePutMediaFragmentAckEventType eAckEventType = eUnknown;
+    uint64_t uFragmentTimecode = 0;
+    unsigned int uErrorId = 0;
+    unsigned int uKeyFrameCount = 0;
+    unsigned int uPersistedAckCount = 0;
+    unsigned int uRotationIntervalSec = 1;
+    uint64_t uBaseTimestampMs = 0;
+    uint64_t uDeadline = 0;
+    uint8_t *pData = NULL;
+    size_t uLen = 0;
+    int i = 0;
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    xPara.bStreamExists = true;
+    xPara.uPersistedAckDelayMs = 100;
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+    ASSERT_NE(nullptr, xKvsApp = prvCreateKvsApp(xServer));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_RECONNECT_ROTATION_INTERVAL, (const char *)&uRotationIntervalSec));
+    ASSERT_EQ(0, KvsApp_open(xKvsApp));
+
+    /* Stream in real time for longer than the rotation interval. */
+    uBaseTimestampMs = getEpochTimestampInMs();
+    for (i = 1; i <= TEST_FRAME_COUNT; i++)
+    {
+        ASSERT_NE(nullptr, pData = prvReadFrame(i, &uLen)) << "frame " << i;
+        uKeyFrameCount += prvIsKeyFrame(pData, uLen) ? 1 : 0;
+        EXPECT_EQ(0, KvsApp_addFrame(xKvsApp, pData, uLen, uLen + TEST_FRAME_SPARE_BYTES, uBaseTimestampMs + (uint64_t)(i - 1) * TEST_FRAME_INTERVAL_MS, TRACK_VIDEO));
+        EXPECT_EQ(0, KvsApp_doWork(xKvsApp));
+        while (KvsApp_readFragmentAck(xKvsApp, &eAckEventType, &uFragmentTimecode, &uErrorId) == 0)
+        {
+            uPersistedAckCount += (eAckEventType == ePersisted) ? 1 : 0;
+        }
+        sleepInMs(10);
+    }
+
+    /* The previous sessions are drained after the switch, so only the last fragment of the last session is not
+     * persisted before closing. */
+    uDeadline = getEpochTimestampInMs() + TEST_TIMEOUT_MS;
+    while (MockKvsServer_getStats(xServer, &xStats) == 0 && (xStats.uSimpleBlockCount < TEST_FRAME_COUNT || uPersistedAckCount + 1 < uKeyFrameCount) &&
+           getEpochTimestampInMs() < uDeadline)
+    {
+        ASSERT_EQ(0, KvsApp_doWork(xKvsApp));
+        while (KvsApp_readFragmentAck(xKvsApp, &eAckEventType, &uFragmentTimecode, &uErrorId) == 0)
+        {
+            uPersistedAckCount += (eAckEventType == ePersisted) ? 1 : 0;
+        }
+        sleepInMs(10);
+    }
+    EXPECT_EQ(uKeyFrameCount - 1, uPersistedAckCount);
+
+    ASSERT_EQ(0, KvsApp_getLatencyStats(xKvsApp, &xLatencyStats));
+    EXPECT_EQ(0, KvsApp_close(xKvsApp));
+    KvsApp_terminate(xKvsApp);
+
+    /* No fragment in flight at a switch loses its ACK. */
+    EXPECT_EQ(0, xLatencyStats.uUntrackedFragmentCount);
+    EXPECT_EQ(uPersistedAckCount, xLatencyStats.xEnqueueToPersisted.uCount);
+
+    /* Every session starts with its own EBML header and a complete cluster, so nothing is dropped. The last opened
+     * session may have been closed before it's switched to. */
+    ASSERT_EQ(0, MockKvsServer_getStats(xServer, &xStats));
+    EXPECT_LE(2, xStats.uEbmlHeaderCount);
+    EXPECT_LE(xStats.uEbmlHeaderCount, xStats.uPutMediaCount);
+    EXPECT_EQ(0, xStats.uMkvErrorCount);
+    EXPECT_EQ(TEST_FRAME_COUNT, xStats.uSimpleBlockCount);
+
+    MockKvsServer_terminate(xServer);
+}
+
+TEST(MockKvs, kvsapp_cached_endpoint_skips_control_plane)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    MockKvsServerStats_t xStats;
+    KvsAppHandle xKvsApp = NULL;
+    int i = 0;
+
+    EndpointCache_invalidate(TEST_ENDPOINT_CACHE_FILE);
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    xPara.bStreamExists = true;
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+
+    /* The first start fills the cache, and the restart uses it. */
+    for (i = 0; i < 2; i++)
+    {
+        ASSERT_NE(nullptr, xKvsApp = prvCreateKvsApp(xServer));
+        ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_KVS_ENDPOINT_CACHE_FILE, TEST_ENDPOINT_CACHE_FILE));
+        EXPECT_EQ(0, KvsApp_open(xKvsApp));
+        EXPECT_EQ(0, KvsApp_close(xKvsApp));
+        KvsApp_terminate(xKvsApp);
+    }
+
+    ASSERT_EQ(0, MockKvsServer_getStats(xServer, &xStats));
+    EXPECT_EQ(1, xStats.uDescribeStreamCount);
+    EXPECT_EQ(1, xStats.uGetDataEndpointCount);
+    EXPECT_EQ(2, xStats.uPutMediaCount);
+
+    MockKvsServer_terminate(xServer);
+    EndpointCache_invalidate(TEST_ENDPOINT_CACHE_FILE);
+}
+
+TEST(MockKvs, kvsapp_stale_cached_endpoint_is_revalidated)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    MockKvsServerStats_t xStats;
+    KvsAppHandle xKvsApp = NULL;
+    char pcHost[64];
+
+    MockKvsServer_getDefaultParameter(&xPara);
+    xPara.bStreamExists = true;
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+
+    /* Nothing listens on the cached endpoint. */
+    prvGetHost(xServer, pcHost, sizeof(pcHost));
+    ASSERT_EQ(0, EndpointCache_store(TEST_ENDPOINT_CACHE_FILE, pcHost, TEST_STREAM_NAME, "127.0.0.1:1", 60));
+
+    ASSERT_NE(nullptr, xKvsApp = prvCreateKvsApp(xServer));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_KVS_ENDPOINT_CACHE_FILE, TEST_ENDPOINT_CACHE_FILE));
+    EXPECT_EQ(0, KvsApp_open(xKvsApp));
+    EXPECT_EQ(0, KvsApp_close(xKvsApp));
+    KvsApp_terminate(xKvsApp);
+
+    ASSERT_EQ(0, MockKvsServer_getStats(xServer, &xStats));
+    EXPECT_EQ(1, xStats.uGetDataEndpointCount);
+    EXPECT_EQ(1, xStats.uPutMediaCount);
+
+    MockKvsServer_terminate(xServer);
+    EndpointCache_invalidate(TEST_ENDPOINT_CACHE_FILE);
+}
+
+#define TEST_IOT_ROLE_ALIAS "mock-kvs-test-role-alias"
+#define TEST_IOT_THING_NAME "mock-kvs-test-thing"
+#define TEST_IOT_REFRESH_MARGIN_SEC (60)
+#define TEST_IOT_CREDENTIAL_LIFETIME_SEC (4)
+
+TEST(MockKvs, kvsapp_iot_credential_is_refreshed_before_expiration)
+{
+    MockKvsServerParameter_t xPara;
+    MockKvsServerHandle xServer = NULL;
+    MockKvsServerStats_t xStats;
+    KvsAppHandle xKvsApp = NULL;
+    char pcHost[64];
+    unsigned int uRefreshMarginSec = TEST_IOT_REFRESH_MARGIN_SEC;
+    unsigned int uCredentialCount = 0;
+    uint64_t uDeadline = 0;
+
+    /* Every credential expires before the refresh margin, so the margin is clamped to half of its lifetime. */
+    MockKvsServer_getDefaultParameter(&xPara);
+    xPara.bStreamExists = true;
+    xPara.uIotCredentialLifetimeSec = TEST_IOT_CREDENTIAL_LIFETIME_SEC;
+    ASSERT_NE(nullptr, xServer = MockKvsServer_create(&xPara));
+    prvGetHost(xServer, pcHost, sizeof(pcHost));
+
+    ASSERT_NE(nullptr, xKvsApp = KvsApp_create(pcHost, "us-east-1", "kinesisvideo", TEST_STREAM_NAME));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_IOT_CREDENTIAL_HOST, pcHost));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_IOT_ROLE_ALIAS, TEST_IOT_ROLE_ALIAS));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_IOT_THING_NAME, TEST_IOT_THING_NAME));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_IOT_X509_ROOTCA, MockKvsServer_getRootCA(xServer)));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_IOT_X509_CERT, MockKvsServer_getClientCertificate(xServer)));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_IOT_X509_KEY, MockKvsServer_getClientPrivateKey(xServer)));
+    ASSERT_EQ(0, KvsApp_setoption(xKvsApp, OPTION_IOT_CREDENTIAL_REFRESH_MARGIN, (const char *)&uRefreshMarginSec));
+    ASSERT_EQ(0, KvsApp_open(xKvsApp));
+
+    /* The expiration is parsed, so the credential from open is not refreshed until the margin is reached. */
+    sleepInMs(500);
+    ASSERT_EQ(0, MockKvsServer_getStats(xServer, &xStats));
+    EXPECT_EQ(1, xStats.uIotCredentialCount);
+
+    /* The background thread refreshes it about 2 seconds after it's fetched, and keeps refreshing the new ones instead
+     * of refetching on every retry. */
+    uDeadline = getEpochTimestampInMs() + TEST_TIMEOUT_MS;
+    while (xStats.uIotCredentialCount < 3 && getEpochTimestampInMs() < uDeadline)
+    {
+        sleepInMs(50);
+        ASSERT_EQ(0, MockKvsServer_getStats(xServer, &xStats));
+    }
+    EXPECT_LE(3, xStats.uIotCredentialCount);
+
+    EXPECT_EQ(0, KvsApp_close(xKvsApp));
+    KvsApp_terminate(xKvsApp);
+
+    /* Nothing is refreshed after the application is terminated. */
+    ASSERT_EQ(0, MockKvsServer_getStats(xServer, &xStats));
+    uCredentialCount = xStats.uIotCredentialCount;
+    sleepInMs(2500);
+    ASSERT_EQ(0, MockKvsServer_getStats(xServer, &xStats));
+    EXPECT_EQ(uCredentialCount, xStats.uIotCredentialCount);
+
+    MockKvsServer_terminate(xServer);
+}
@@ -1,5 +1,6 @@
 #ifdef __cplusplus
 extern "C" {
+#include "kvs/errors.h"
 #include "kvs/nalu.h"
 }
 #endif
@@ -457,4 +458,286 @@ TEST(NALU_getH264VideoResolutionFromSps, invalid_parameter)
     EXPECT_NE(0, NALU_getH264VideoResolutionFromSps(pSps, uSpsLen, NULL, &uHeight));
 
     EXPECT_NE(0, NALU_getH264VideoResolutionFromSps(pSps, uSpsLen, &uWidth, NULL));
-}
\ No newline at end of file
+}
+TEST(NALU_buildIndex, annexb_mixed_start_codes)
+{
+    uint8_t pFrame[] = {
+        /* SPS with 4 bytes start code */
+        0x00, 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x0A,
+        /* PPS with 3 bytes start code */
+        0x00, 0x00, 0x01, 0x68, 0xE8, 0x43,
+        /* I-frame with 3 bytes start code, and an emulation prevention byte */
+        0x00, 0x00, 0x01, 0x65, 0x00, 0x00, 0x03, 0x01, 0xFF
+    };
+    NaluIndex_t xIndex;
+    uint8_t *pNalu = NULL;
+    size_t uNaluLen = 0;
+
+    NALU_initIndex(&xIndex, NULL, 0);
+    ASSERT_EQ(0, NALU_buildIndex(pFrame, sizeof(pFrame), &xIndex));
+    EXPECT_TRUE(xIndex.bIsAnnexB);
+    ASSERT_EQ(3, xIndex.uCount);
+
+    EXPECT_EQ(NALU_TYPE_SPS, xIndex.pxNalus[0].uType);
+    EXPECT_EQ(4, xIndex.pxNalus[0].uOffset);
+    EXPECT_EQ(4, xIndex.pxNalus[0].uLen);
+    EXPECT_EQ(NALU_TYPE_PPS, xIndex.pxNalus[1].uType);
+    EXPECT_EQ(11, xIndex.pxNalus[1].uOffset);
+    EXPECT_EQ(3, xIndex.pxNalus[1].uLen);
+    EXPECT_EQ(NALU_TYPE_IFRAME, xIndex.pxNalus[2].uType);
+    EXPECT_EQ(17, xIndex.pxNalus[2].uOffset);
+    EXPECT_EQ(6, xIndex.pxNalus[2].uLen);
+
+    EXPECT_TRUE(NALU_isKeyFrameInIndex(&xIndex));
+    ASSERT_EQ(0, NALU_getNaluFromIndex(&xIndex, pFrame, NALU_TYPE_PPS, &pNalu, &uNaluLen));
+    EXPECT_EQ(pFrame + 11, pNalu);
+    EXPECT_EQ(3, uNaluLen);
+    EXPECT_EQ(KVS_ERROR_NALU_TYPE_NOT_FOUND, NALU_getNaluFromIndex(&xIndex, pFrame, NALU_TYPE_SEI, &pNalu, &uNaluLen));
+}
+
+TEST(NALU_buildIndex, avcc_nalus)
+{
+    uint8_t pFrame[] = {
+        0x00, 0x00, 0x00, 0x02, 0x41, 0x9A,
+        0x00, 0x00, 0x00, 0x03, 0x01, 0x9E, 0xFF
+    };
+    NaluIndex_t xIndex;
+
+    NALU_initIndex(&xIndex, NULL, 0);
+    ASSERT_EQ(0, NALU_buildIndex(pFrame, sizeof(pFrame), &xIndex));
+    EXPECT_FALSE(xIndex.bIsAnnexB);
+    ASSERT_EQ(2, xIndex.uCount);
+    EXPECT_EQ(NALU_TYPE_NON_IDR_PICTURE, xIndex.pxNalus[0].uType);
+    EXPECT_EQ(4, xIndex.pxNalus[0].uOffset);
+    EXPECT_EQ(2, xIndex.pxNalus[0].uLen);
+    EXPECT_EQ(10, xIndex.pxNalus[1].uOffset);
+    EXPECT_EQ(3, xIndex.pxNalus[1].uLen);
+    EXPECT_FALSE(NALU_isKeyFrameInIndex(&xIndex));
+
+    /* A NALU length that runs over the frame is rejected. */
+    pFrame[9] = 0x04;
+    EXPECT_EQ(KVS_ERROR_AVCC_NALU_IS_BROKEN, NALU_buildIndex(pFrame, sizeof(pFrame), &xIndex));
+}
+
+static void prvFillSliceNalus(uint8_t *pFrame, size_t uNaluCount)
+{
+    for (size_t i = 0; i < uNaluCount; i++)
+    {
+        pFrame[i * 5] = 0x00;
+        pFrame[i * 5 + 1] = 0x00;
+        pFrame[i * 5 + 2] = 0x01;
+        pFrame[i * 5 + 3] = 0x41;
+        pFrame[i * 5 + 4] = 0xFF;
+    }
+}
+
+TEST(NALU_buildIndex, grow_beyond_inline_table)
+{
+    uint8_t pFrame[(NALU_INDEX_INLINE_COUNT * 4 + 1) * 5];
+    NaluIndex_t xIndex;
+
+    prvFillSliceNalus(pFrame, NALU_INDEX_INLINE_COUNT * 4 + 1);
+    NALU_initIndex(&xIndex, NULL, 0);
+
+    ASSERT_EQ(0, NALU_buildIndex(pFrame, NALU_INDEX_INLINE_COUNT * 5, &xIndex));
+    EXPECT_EQ(NALU_INDEX_INLINE_COUNT, xIndex.uCount);
+    EXPECT_FALSE(xIndex.bIsTableAllocated);
+
+    ASSERT_EQ(0, NALU_buildIndex(pFrame, sizeof(pFrame), &xIndex));
+    ASSERT_EQ(NALU_INDEX_INLINE_COUNT * 4 + 1, xIndex.uCount);
+    EXPECT_TRUE(xIndex.bIsTableAllocated);
+    for (size_t i = 0; i < xIndex.uCount; i++)
+    {
+        EXPECT_EQ(i * 5 + 3, xIndex.pxNalus[i].uOffset);
+        EXPECT_EQ(2, xIndex.pxNalus[i].uLen);
+        EXPECT_EQ(NALU_TYPE_NON_IDR_PICTURE, xIndex.pxNalus[i].uType);
+    }
+
+    /* The grown table is kept for the following frames. */
+    ASSERT_EQ(0, NALU_buildIndex(pFrame, 10, &xIndex));
+    EXPECT_EQ(2, xIndex.uCount);
+    EXPECT_TRUE(xIndex.bIsTableAllocated);
+
+    NALU_deinitIndex(&xIndex);
+    EXPECT_FALSE(xIndex.bIsTableAllocated);
+    EXPECT_EQ(NALU_INDEX_INLINE_COUNT, xIndex.uCapacity);
+}
+
+TEST(NALU_buildIndex, caller_provided_table)
+{
+    uint8_t pFrame[(NALU_INDEX_INLINE_COUNT * 2) * 5];
+    NaluIndexEntry_t xTable[NALU_INDEX_INLINE_COUNT * 2];
+    NaluIndex_t xIndex;
+
+    prvFillSliceNalus(pFrame, NALU_INDEX_INLINE_COUNT * 2);
+    NALU_initIndex(&xIndex, xTable, NALU_INDEX_INLINE_COUNT * 2);
+
+    ASSERT_EQ(0, NALU_buildIndex(pFrame, sizeof(pFrame), &xIndex));
+    EXPECT_EQ(NALU_INDEX_INLINE_COUNT * 2, xIndex.uCount);
+    EXPECT_EQ(xTable, xIndex.pxNalus);
+    EXPECT_FALSE(xIndex.bIsTableAllocated);
+    EXPECT_EQ(sizeof(pFrame) - 2, xTable[NALU_INDEX_INLINE_COUNT * 2 - 1].uOffset);
+
+    NALU_deinitIndex(&xIndex);
+}
+
+TEST(NALU_convertAnnexBToAvccInPlace, many_slices)
+{
+    uint8_t pFrame[NALU_INDEX_INLINE_COUNT * 3 * 6];
+    uint32_t uAvccLen = 0;
+
+    /* The 3 bytes start codes become 4 bytes lengths, and the frame grows by 1 byte for each NALU. */
+    prvFillSliceNalus(pFrame, NALU_INDEX_INLINE_COUNT * 3);
+    EXPECT_EQ(KVS_ERROR_NO_ENOUGH_SPACE_FOR_NALU_CONVERSION, NALU_convertAnnexBToAvccInPlace(pFrame, NALU_INDEX_INLINE_COUNT * 3 * 5, sizeof(pFrame) - 1, &uAvccLen));
+    EXPECT_EQ(0, NALU_convertAnnexBToAvccInPlace(pFrame, NALU_INDEX_INLINE_COUNT * 3 * 5, sizeof(pFrame), &uAvccLen));
+    ASSERT_EQ(NALU_INDEX_INLINE_COUNT * 3 * 6, uAvccLen);
+    for (size_t i = 0; i < NALU_INDEX_INLINE_COUNT * 3; i++)
+    {
+        EXPECT_EQ(0, memcmp(pFrame + i * 6, "\x00\x00\x00\x02\x41\xFF", 6));
+    }
+}
+
+TEST(NALU_buildIndex, invalid_parameter)
+{
+    uint8_t pFrame[] = {0x00, 0x00, 0x00, 0x01, 0x65, 0xFF};
+    NaluIndex_t xIndex;
+
+    /* An index that is not initialized has no table. */
+    memset(&xIndex, 0, sizeof(xIndex));
+    EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, NALU_buildIndex(pFrame, sizeof(pFrame), &xIndex));
+
+    NALU_initIndex(&xIndex, NULL, 0);
+    EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, NALU_buildIndex(NULL, sizeof(pFrame), &xIndex));
+    EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, NALU_buildIndex(pFrame, 4, &xIndex));
+    EXPECT_EQ(KVS_ERROR_INVALID_ARGUMENT, NALU_buildIndex(pFrame, sizeof(pFrame), NULL));
+}
+
+TEST(NALU_convertAnnexBToAvccInPlaceWithIndex, index_follows_conversion)
+{
+    uint8_t pFrame[] = {
+        0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x0A,
+        0x00, 0x00, 0x00, 0x01, 0x68, 0xE8, 0x43,
+        0x00, 0x00, 0x01, 0x65, 0xFF,
+        /* Spare bytes for the longer AVCC lengths */
+        0x00, 0x00
+    };
+    uint8_t pExpected[] = {
+        0x00, 0x00, 0x00, 0x04, 0x67, 0x64, 0x00, 0x0A,
+        0x00, 0x00, 0x00, 0x03, 0x68, 0xE8, 0x43,
+        0x00, 0x00, 0x00, 0x02, 0x65, 0xFF
+    };
+    NaluIndex_t xIndex;
+    NaluIndex_t xAvccIndex;
+    uint32_t uAvccLen = 0;
+
+    NALU_initIndex(&xIndex, NULL, 0);
+    NALU_initIndex(&xAvccIndex, NULL, 0);
+    ASSERT_EQ(0, NALU_buildIndex(pFrame, sizeof(pFrame) - 2, &xIndex));
+    EXPECT_EQ(KVS_ERROR_NO_ENOUGH_SPACE_FOR_NALU_CONVERSION, NALU_convertAnnexBToAvccInPlaceWithIndex(pFrame, sizeof(pFrame) - 1, &xIndex, &uAvccLen));
+    ASSERT_EQ(0, NALU_convertAnnexBToAvccInPlaceWithIndex(pFrame, sizeof(pFrame), &xIndex, &uAvccLen));
+    ASSERT_EQ(sizeof(pExpected), uAvccLen);
+    EXPECT_EQ(0, memcmp(pExpected, pFrame, sizeof(pExpected)));
+
+    /* The updated index is the same as indexing the AVCC frame. */
+    EXPECT_FALSE(xIndex.bIsAnnexB);
+    ASSERT_EQ(0, NALU_buildIndex(pFrame, uAvccLen, &xAvccIndex));
+    ASSERT_EQ(xAvccIndex.uCount, xIndex.uCount);
+    for (size_t i = 0; i < xIndex.uCount; i++)
+    {
+        EXPECT_EQ(xAvccIndex.pxNalus[i].uOffset, xIndex.pxNalus[i].uOffset);
+        EXPECT_EQ(xAvccIndex.pxNalus[i].uLen, xIndex.pxNalus[i].uLen);
+        EXPECT_EQ(xAvccIndex.pxNalus[i].uType, xIndex.pxNalus[i].uType);
+    }
+
+    /* An AVCC frame is left as is. */
+    uAvccLen = 0;
+    EXPECT_EQ(0, NALU_convertAnnexBToAvccInPlaceWithIndex(pFrame, sizeof(pFrame), &xIndex, &uAvccLen));
+    EXPECT_EQ(sizeof(pExpected), uAvccLen);
+    EXPECT_EQ(0, memcmp(pExpected, pFrame, sizeof(pExpected)));
+}
+
+TEST(NALU_buildIndex, start_codes_at_every_offset)
+{
+    uint8_t pFrame[80];
+    NaluIndex_t xIndex;
+
+    /* Start codes are found wherever they are, including across the blocks that are scanned at once. */
+    for (uint32_t uPos = 5; uPos + 8 <= sizeof(pFrame); uPos++)
+    {
+        for (uint32_t uStartCodeLen = 3; uStartCodeLen <= 4; uStartCodeLen++)
+        {
+            memset(pFrame, 0xFF, sizeof(pFrame));
+            NALU_initIndex(&xIndex, NULL, 0);
+            memcpy(pFrame, "\x00\x00\x01\x67", 4);
+            memcpy(pFrame + uPos, "\x00\x00\x00\x01", 4);
+            pFrame[uPos + 4] = 0x65;
+
+            /* The 3 bytes start code is the tail of the 4 bytes one. */
+            uint32_t uStartCodePos = uPos + 4 - uStartCodeLen;
+            if (uStartCodeLen == 3)
+            {
+                pFrame[uPos] = 0xFF;
+            }
+
+            ASSERT_EQ(0, NALU_buildIndex(pFrame, sizeof(pFrame), &xIndex)) << "pos " << uPos;
+            ASSERT_EQ(2, xIndex.uCount) << "pos " << uPos;
+            EXPECT_EQ(uStartCodePos - 3, xIndex.pxNalus[0].uLen) << "pos " << uPos;
+            EXPECT_EQ(uPos + 4, xIndex.pxNalus[1].uOffset) << "pos " << uPos;
+            EXPECT_EQ(NALU_TYPE_IFRAME, xIndex.pxNalus[1].uType) << "pos " << uPos;
+        }
+    }
+}
+
+TEST(NALU_buildIndexWithCodec, h265_nalus)
+{
+    uint8_t pFrame[] = {
+        /* VPS */
+        0x00, 0x00, 0x00, 0x01, 0x40, 0x01, 0x0C, 0x01,
+        /* SPS */
+        0x00, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01,
+        /* PPS */
+        0x00, 0x00, 0x00, 0x01, 0x44, 0x01, 0xC1, 0x72,
+        /* CRA picture */
+        0x00, 0x00, 0x01, 0x2A, 0x01, 0xAF, 0x09
+    };
+    uint8_t pTrailFrame[] = {0x00, 0x00, 0x00, 0x01, 0x02, 0x01, 0xD0, 0x09};
+    NaluIndex_t xIndex;
+    uint8_t *pNalu = NULL;
+    size_t uNaluLen = 0;
+
+    NALU_initIndex(&xIndex, NULL, 0);
+    ASSERT_EQ(0, NALU_buildIndexWithCodec(pFrame, sizeof(pFrame), VIDEO_CODEC_H265, &xIndex));
+    ASSERT_EQ(4, xIndex.uCount);
+    EXPECT_EQ(NALU_TYPE_HEVC_VPS, xIndex.pxNalus[0].uType);
+    EXPECT_EQ(NALU_TYPE_HEVC_SPS, xIndex.pxNalus[1].uType);
+    EXPECT_EQ(NALU_TYPE_HEVC_PPS, xIndex.pxNalus[2].uType);
+    EXPECT_EQ(21, xIndex.pxNalus[3].uType);
+    EXPECT_TRUE(NALU_isKeyFrameInIndex(&xIndex));
+    ASSERT_EQ(0, NALU_getNaluFromIndex(&xIndex, pFrame, NALU_TYPE_HEVC_SPS, &pNalu, &uNaluLen));
+    EXPECT_EQ(pFrame + 12, pNalu);
+    EXPECT_EQ(4, uNaluLen);
+
+    /* The same frame is not a H.264 key frame, and H.265 types are not found in a H.264 index. */
+    ASSERT_EQ(0, NALU_buildIndexWithCodec(pFrame, sizeof(pFrame), VIDEO_CODEC_H264, &xIndex));
+    EXPECT_FALSE(NALU_isKeyFrameInIndex(&xIndex));
+    EXPECT_EQ(KVS_ERROR_NALU_TYPE_NOT_FOUND, NALU_getNaluFromIndex(&xIndex, pFrame, NALU_TYPE_HEVC_SPS, &pNalu, &uNaluLen));
+
+    ASSERT_EQ(0, NALU_buildIndexWithCodec(pTrailFrame, sizeof(pTrailFrame), VIDEO_CODEC_H265, &xIndex));
+    EXPECT_EQ(1, xIndex.pxNalus[0].uType);
+    EXPECT_FALSE(NALU_isKeyFrameInIndex(&xIndex));
+}
+
+TEST(NALU_getH265VideoResolutionFromSps, resolution)
+{
+    uint8_t pSps[] = {0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00,
+                      0x03, 0x00, 0x5D, 0xA0, 0x02, 0x80, 0x80, 0x2D, 0x16, 0x59, 0x59, 0xA4, 0x93, 0x2B, 0xC0};
+    uint16_t uWidth = 0;
+    uint16_t uHeight = 0;
+
+    ASSERT_EQ(0, NALU_getH265VideoResolutionFromSps(pSps, sizeof(pSps), &uWidth, &uHeight));
+    EXPECT_EQ(1280, uWidth);
+    EXPECT_EQ(720, uHeight);
+
+    EXPECT_EQ(KVS_ERROR_INVALID_NALU_FORMAT, NALU_getH265VideoResolutionFromSps(pSps, 20, &uWidth, &uHeight));
+    EXPECT_EQ(KVS_ERROR_INVALID_NALU_FORMAT, NALU_getH265VideoResolutionFromSps(pSps + 1, sizeof(pSps) - 1, &uWidth, &uHeight));
+}
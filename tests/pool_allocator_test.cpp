@@ -0,0 +1,163 @@
+#ifdef __cplusplus
+extern "C" {
+#include "kvs/pool_allocator.h"
+}
+#endif
+
+#include <future>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#define TEST_POOL_SIZE (8 * 1024 * 1024)
+#define TEST_BLOCK_COUNT (200)
+
+/* Sizes of every size class of thread caches, and one that is too large to cache */
+static const size_t testBlockSizes[] = {8, 16, 24, 32, 48, 64, 100, 128, 200, 256, 1024};
+
+#define NUM_OF_TEST_BLOCK_SIZES (sizeof(testBlockSizes) / sizeof(testBlockSizes[0]))
+
+static char pMemPool[TEST_POOL_SIZE];
+
+/* This binary links KVS with kvsMalloc wrapped to the pool allocator, so the pool is set up for all tests. */
+class PoolAllocatorEnvironment : public ::testing::Environment
+{
+  public:
+    void SetUp() override
+    {
+        ASSERT_EQ(0, poolAllocatorInit(pMemPool, sizeof(pMemPool)));
+    }
+
+    void TearDown() override
+    {
+        poolAllocatorDeinit();
+    }
+};
+
+static ::testing::Environment *const pxPoolAllocatorEnvironment = ::testing::AddGlobalTestEnvironment(new PoolAllocatorEnvironment);
+
+static void prvGetStats(PoolStats_t *pxStats)
+{
+    memset(pxStats, 0, sizeof(PoolStats_t));
+    poolAllocatorGetStats(pxStats);
+}
+
+TEST(PoolAllocator, stats_are_exact_with_thread_caches)
+{
+    PoolStats_t xBaseStats;
+    PoolStats_t xStats;
+    std::vector<void *> xBlocks(TEST_BLOCK_COUNT, nullptr);
+    std::promise<void> xAllocated;
+    std::promise<void> xFreed;
+    std::future<void> xAllocatedFuture = xAllocated.get_future();
+    std::future<void> xFreedFuture = xFreed.get_future();
+    size_t uRemainingUsedMemory = 0;
+
+    prvGetStats(&xBaseStats);
+
+    /* The worker allocates all blocks, and frees the first half into its own cache. */
+    std::thread xWorker([&]() {
+        for (size_t i = 0; i < TEST_BLOCK_COUNT; i++)
+        {
+            xBlocks[i] = poolAllocatorMalloc(testBlockSizes[i % NUM_OF_TEST_BLOCK_SIZES]);
+        }
+        for (size_t i = 0; i < TEST_BLOCK_COUNT / 2; i++)
+        {
+            poolAllocatorFree(xBlocks[i]);
+        }
+        xAllocated.set_value();
+
+        /* The cache of the worker is alive until the main thread has collected stats. */
+        xFreedFuture.wait();
+    });
+
+    xAllocatedFuture.wait();
+    for (size_t i = 0; i < TEST_BLOCK_COUNT; i++)
+    {
+        ASSERT_TRUE(xBlocks[i] != NULL) << "block " << i;
+    }
+
+    /* Blocks in the cache of the worker are counted as free. */
+    prvGetStats(&xStats);
+    EXPECT_EQ(xBaseStats.uNumberOfAllocations + TEST_BLOCK_COUNT, xStats.uNumberOfAllocations);
+    EXPECT_EQ(xBaseStats.uNumberOfFrees + TEST_BLOCK_COUNT / 2, xStats.uNumberOfFrees);
+    EXPECT_EQ(xBaseStats.uNumberOfUsedBlocks + TEST_BLOCK_COUNT / 2, xStats.uNumberOfUsedBlocks);
+    uRemainingUsedMemory = xStats.uSumOfUsedMemory - xBaseStats.uSumOfUsedMemory;
+    EXPECT_LT(0, uRemainingUsedMemory);
+
+    /* Collecting stats twice doesn't change them. */
+    prvGetStats(&xStats);
+    EXPECT_EQ(xBaseStats.uNumberOfAllocations + TEST_BLOCK_COUNT, xStats.uNumberOfAllocations);
+    EXPECT_EQ(xBaseStats.uNumberOfFrees + TEST_BLOCK_COUNT / 2, xStats.uNumberOfFrees);
+    EXPECT_EQ(xBaseStats.uSumOfUsedMemory + uRemainingUsedMemory, xStats.uSumOfUsedMemory);
+
+    /* The main thread frees the rest into its own cache, while the worker is still alive. */
+    for (size_t i = TEST_BLOCK_COUNT / 2; i < TEST_BLOCK_COUNT; i++)
+    {
+        poolAllocatorFree(xBlocks[i]);
+    }
+
+    prvGetStats(&xStats);
+    EXPECT_EQ(xBaseStats.uNumberOfAllocations + TEST_BLOCK_COUNT, xStats.uNumberOfAllocations);
+    EXPECT_EQ(xBaseStats.uNumberOfFrees + TEST_BLOCK_COUNT, xStats.uNumberOfFrees);
+    EXPECT_EQ(xBaseStats.uNumberOfUsedBlocks, xStats.uNumberOfUsedBlocks);
+    EXPECT_EQ(xBaseStats.uSumOfUsedMemory, xStats.uSumOfUsedMemory);
+
+    /* The counts of the worker are kept after its cache is released. */
+    xFreed.set_value();
+    xWorker.join();
+
+    prvGetStats(&xStats);
+    EXPECT_EQ(xBaseStats.uNumberOfAllocations + TEST_BLOCK_COUNT, xStats.uNumberOfAllocations);
+    EXPECT_EQ(xBaseStats.uNumberOfFrees + TEST_BLOCK_COUNT, xStats.uNumberOfFrees);
+    EXPECT_EQ(xBaseStats.uNumberOfUsedBlocks, xStats.uNumberOfUsedBlocks);
+    EXPECT_EQ(xBaseStats.uSumOfUsedMemory, xStats.uSumOfUsedMemory);
+    EXPECT_EQ(xBaseStats.uSumOfFreeMemory, xStats.uSumOfFreeMemory);
+}
+
+TEST(PoolAllocator, threads_free_blocks_of_each_other)
+{
+    PoolStats_t xBaseStats;
+    PoolStats_t xStats;
+    std::vector<void *> xBlocksA(TEST_BLOCK_COUNT, nullptr);
+    std::vector<void *> xBlocksB(TEST_BLOCK_COUNT, nullptr);
+
+    prvGetStats(&xBaseStats);
+
+    /* Two threads allocate at the same time, and two other threads free the blocks at the same time. */
+    auto allocate = [](std::vector<void *> *pxBlocks) {
+        for (size_t i = 0; i < TEST_BLOCK_COUNT; i++)
+        {
+            (*pxBlocks)[i] = poolAllocatorMalloc(testBlockSizes[i % NUM_OF_TEST_BLOCK_SIZES]);
+        }
+    };
+    auto release = [](std::vector<void *> *pxBlocks) {
+        for (size_t i = 0; i < TEST_BLOCK_COUNT; i++)
+        {
+            poolAllocatorFree((*pxBlocks)[i]);
+        }
+    };
+
+    std::thread xThreadA(allocate, &xBlocksA);
+    std::thread xThreadB(allocate, &xBlocksB);
+    xThreadA.join();
+    xThreadB.join();
+
+    for (size_t i = 0; i < TEST_BLOCK_COUNT; i++)
+    {
+        ASSERT_TRUE(xBlocksA[i] != NULL && xBlocksB[i] != NULL) << "block " << i;
+    }
+
+    std::thread xThreadC(release, &xBlocksB);
+    std::thread xThreadD(release, &xBlocksA);
+    xThreadC.join();
+    xThreadD.join();
+
+    prvGetStats(&xStats);
+    EXPECT_EQ(xBaseStats.uNumberOfAllocations + 2 * TEST_BLOCK_COUNT, xStats.uNumberOfAllocations);
+    EXPECT_EQ(xBaseStats.uNumberOfFrees + 2 * TEST_BLOCK_COUNT, xStats.uNumberOfFrees);
+    EXPECT_EQ(xBaseStats.uNumberOfUsedBlocks, xStats.uNumberOfUsedBlocks);
+    EXPECT_EQ(xBaseStats.uSumOfUsedMemory, xStats.uSumOfUsedMemory);
+}
@@ -0,0 +1,65 @@
+#ifdef __cplusplus
+extern "C" {
+#include "os/slab.h"
+}
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+#define TEST_OBJECT_SIZE (24)
+#define TEST_OBJECT_COUNT (4)
+
+TEST(Slab_create, invalid_argument)
+{
+    EXPECT_EQ(nullptr, Slab_create(TEST_OBJECT_SIZE, 0));
+    EXPECT_EQ(nullptr, Slab_create(SIZE_MAX, TEST_OBJECT_COUNT));
+}
+
+TEST(Slab_alloc, reuses_freed_objects)
+{
+    SlabHandle xSlab = Slab_create(TEST_OBJECT_SIZE, TEST_OBJECT_COUNT);
+    void *pObjects[TEST_OBJECT_COUNT] = {};
+    ASSERT_NE(nullptr, xSlab);
+
+    for (int i = 0; i < TEST_OBJECT_COUNT; i++)
+    {
+        ASSERT_NE(nullptr, pObjects[i] = Slab_alloc(xSlab));
+        EXPECT_EQ(0, (uintptr_t)pObjects[i] % 8);
+        memset(pObjects[i], 0xFF, TEST_OBJECT_SIZE);
+    }
+    EXPECT_GE((uint8_t *)pObjects[1] - (uint8_t *)pObjects[0], TEST_OBJECT_SIZE);
+
+    /* The most recently freed object is handed out first. */
+    Slab_free(xSlab, pObjects[2]);
+    EXPECT_EQ(pObjects[2], Slab_alloc(xSlab));
+
+    for (int i = 0; i < TEST_OBJECT_COUNT; i++)
+    {
+        Slab_free(xSlab, pObjects[i]);
+    }
+    Slab_terminate(xSlab);
+}
+
+TEST(Slab_alloc, falls_back_to_heap)
+{
+    SlabHandle xSlab = Slab_create(TEST_OBJECT_SIZE, 1);
+    void *pObject = NULL;
+    void *pOverflow = NULL;
+    ASSERT_NE(nullptr, xSlab);
+
+    ASSERT_NE(nullptr, pObject = Slab_alloc(xSlab));
+    ASSERT_NE(nullptr, pOverflow = Slab_alloc(xSlab));
+    memset(pOverflow, 0xFF, TEST_OBJECT_SIZE);
+
+    /* The heap object is not put into the slab, so the slab object comes back next. */
+    Slab_free(xSlab, pOverflow);
+    Slab_free(xSlab, pObject);
+    EXPECT_EQ(pObject, Slab_alloc(xSlab));
+
+    Slab_free(xSlab, pObject);
+    Slab_free(xSlab, NULL);
+    Slab_terminate(xSlab);
+}
@@ -0,0 +1,351 @@
+#ifdef __cplusplus
+extern "C" {
+#include "kvs/mkv_generator.h"
+#include "kvs/stream.h"
+}
+#endif
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+/* The offset of delta timestamp from the end of a MKV simple block header, which is followed by 1 byte flags */
+#define SIMPLE_BLOCK_DELTA_TIMESTAMP_OFFSET_FROM_END (3)
+
+static StreamHandle prvCreateStream(void)
+{
+    VideoTrackInfo_t xVideoTrackInfo = {0};
+
+    xVideoTrackInfo.pTrackName = (char *)"kvs video track";
+    xVideoTrackInfo.pCodecName = (char *)"V_MPEG4/ISO/AVC";
+    xVideoTrackInfo.uWidth = 640;
+    xVideoTrackInfo.uHeight = 480;
+
+    return Kvs_streamCreate(&xVideoTrackInfo, NULL);
+}
+
+static DataFrameHandle prvAddDataFrame(StreamHandle xStreamHandle, MkvClusterType_t xClusterType, TrackType_t xTrackType, uint64_t uTimestampMs)
+{
+    static char pData[] = {0x00, 0x01, 0x02, 0x03};
+    DataFrameIn_t xDataFrameIn = {};
+
+    xDataFrameIn.xClusterType = xClusterType;
+    xDataFrameIn.pData = pData;
+    xDataFrameIn.uDataLen = sizeof(pData);
+    xDataFrameIn.uTimestampMs = uTimestampMs;
+    xDataFrameIn.bIsKeyFrame = (xClusterType == MKV_CLUSTER);
+    xDataFrameIn.xTrackType = xTrackType;
+
+    return Kvs_streamAddDataFrame(xStreamHandle, &xDataFrameIn);
+}
+
+static uint64_t prvPopTimestamp(StreamHandle xStreamHandle)
+{
+    uint64_t uTimestampMs = UINT64_MAX;
+    DataFrameHandle xDataFrameHandle = Kvs_streamPop(xStreamHandle);
+
+    if (xDataFrameHandle != NULL)
+    {
+        uTimestampMs = ((DataFrameIn_t *)xDataFrameHandle)->uTimestampMs;
+        Kvs_dataFrameTerminate(xDataFrameHandle);
+    }
+
+    return uTimestampMs;
+}
+
+static uint16_t prvGetDeltaTimestamp(DataFrameHandle xDataFrameHandle)
+{
+    uint8_t *pMkvHeader = NULL;
+    size_t uMkvHeaderLen = 0;
+    uint8_t *pData = NULL;
+    size_t uDataLen = 0;
+    uint8_t *pDeltaTimestamp = NULL;
+
+    EXPECT_EQ(0, Kvs_dataFrameGetContent(xDataFrameHandle, &pMkvHeader, &uMkvHeaderLen, &pData, &uDataLen));
+
+    pDeltaTimestamp = pMkvHeader + uMkvHeaderLen - SIMPLE_BLOCK_DELTA_TIMESTAMP_OFFSET_FROM_END;
+
+    return (uint16_t)((pDeltaTimestamp[0] << 8) | pDeltaTimestamp[1]);
+}
+
+static void prvStreamFlush(StreamHandle xStreamHandle)
+{
+    DataFrameHandle xDataFrameHandle = NULL;
+
+    while ((xDataFrameHandle = Kvs_streamPop(xStreamHandle)) != NULL)
+    {
+        Kvs_dataFrameTerminate(xDataFrameHandle);
+    }
+}
+
+TEST(Kvs_streamAddDataFrame, in_order)
+{
+    StreamHandle xStreamHandle = prvCreateStream();
+    ASSERT_TRUE(xStreamHandle != NULL);
+
+    ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_CLUSTER, TRACK_VIDEO, 1000) != NULL);
+    DataFrameHandle xFrame1 = prvAddDataFrame(xStreamHandle, MKV_SIMPLE_BLOCK, TRACK_VIDEO, 1033);
+    DataFrameHandle xFrame2 = prvAddDataFrame(xStreamHandle, MKV_SIMPLE_BLOCK, TRACK_VIDEO, 1066);
+    ASSERT_TRUE(xFrame1 != NULL && xFrame2 != NULL);
+
+    EXPECT_EQ(33, prvGetDeltaTimestamp(xFrame1));
+    EXPECT_EQ(66, prvGetDeltaTimestamp(xFrame2));
+
+    EXPECT_EQ(1000, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(1033, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(1066, prvPopTimestamp(xStreamHandle));
+    EXPECT_TRUE(Kvs_streamIsEmpty(xStreamHandle));
+
+    Kvs_streamTermintate(xStreamHandle);
+}
+
+TEST(Kvs_streamAddDataFrame, out_of_order)
+{
+    StreamHandle xStreamHandle = prvCreateStream();
+    ASSERT_TRUE(xStreamHandle != NULL);
+
+    ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_CLUSTER, TRACK_VIDEO, 1000) != NULL);
+    ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_SIMPLE_BLOCK, TRACK_VIDEO, 1066) != NULL);
+    ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_CLUSTER, TRACK_VIDEO, 2000) != NULL);
+    DataFrameHandle xAudio = prvAddDataFrame(xStreamHandle, MKV_SIMPLE_BLOCK, TRACK_AUDIO, 1020);
+    ASSERT_TRUE(xAudio != NULL);
+
+    EXPECT_EQ(20, prvGetDeltaTimestamp(xAudio));
+
+    EXPECT_EQ(1000, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(1020, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(1066, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(2000, prvPopTimestamp(xStreamHandle));
+    EXPECT_TRUE(Kvs_streamIsEmpty(xStreamHandle));
+
+    Kvs_streamTermintate(xStreamHandle);
+}
+
+TEST(Kvs_streamAddDataFrame, same_timestamp_video_first)
+{
+    StreamHandle xStreamHandle = prvCreateStream();
+    ASSERT_TRUE(xStreamHandle != NULL);
+
+    ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_SIMPLE_BLOCK, TRACK_AUDIO, 1000) != NULL);
+    DataFrameHandle xVideo = prvAddDataFrame(xStreamHandle, MKV_CLUSTER, TRACK_VIDEO, 1000);
+    ASSERT_TRUE(xVideo != NULL);
+
+    EXPECT_EQ(xVideo, Kvs_streamPeek(xStreamHandle));
+
+    prvStreamFlush(xStreamHandle);
+    Kvs_streamTermintate(xStreamHandle);
+}
+
+TEST(Kvs_streamAddDataFrame, insert_cluster_updates_delta_timestamp)
+{
+    StreamHandle xStreamHandle = prvCreateStream();
+    ASSERT_TRUE(xStreamHandle != NULL);
+
+    ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_CLUSTER, TRACK_VIDEO, 1000) != NULL);
+    DataFrameHandle xAudio1 = prvAddDataFrame(xStreamHandle, MKV_SIMPLE_BLOCK, TRACK_AUDIO, 1500);
+    DataFrameHandle xAudio2 = prvAddDataFrame(xStreamHandle, MKV_SIMPLE_BLOCK, TRACK_AUDIO, 2100);
+    ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_CLUSTER, TRACK_VIDEO, 3000) != NULL);
+    DataFrameHandle xAudio3 = prvAddDataFrame(xStreamHandle, MKV_SIMPLE_BLOCK, TRACK_AUDIO, 3100);
+    ASSERT_TRUE(xAudio1 != NULL && xAudio2 != NULL && xAudio3 != NULL);
+
+    EXPECT_EQ(1100, prvGetDeltaTimestamp(xAudio2));
+
+    /* The late cluster takes over the audio frame that follows it, but not the frames after the next cluster. */
+    ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_CLUSTER, TRACK_VIDEO, 2000) != NULL);
+    EXPECT_EQ(500, prvGetDeltaTimestamp(xAudio1));
+    EXPECT_EQ(100, prvGetDeltaTimestamp(xAudio2));
+    EXPECT_EQ(100, prvGetDeltaTimestamp(xAudio3));
+
+    EXPECT_EQ(1000, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(1500, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(2000, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(2100, prvPopTimestamp(xStreamHandle));
+
+    /* Frames added after the pop use the remaining cluster index. */
+    DataFrameHandle xAudio4 = prvAddDataFrame(xStreamHandle, MKV_SIMPLE_BLOCK, TRACK_AUDIO, 3200);
+    ASSERT_TRUE(xAudio4 != NULL);
+    EXPECT_EQ(200, prvGetDeltaTimestamp(xAudio4));
+
+    prvStreamFlush(xStreamHandle);
+    Kvs_streamTermintate(xStreamHandle);
+}
+
+TEST(Kvs_streamMemStatTotal, add_and_pop)
+{
+    size_t uMemEmpty = 0;
+    size_t uMemOneFrame = 0;
+    size_t uMemTwoFrames = 0;
+    size_t uMemTotal = 0;
+    StreamHandle xStreamHandle = prvCreateStream();
+    ASSERT_TRUE(xStreamHandle != NULL);
+
+    EXPECT_EQ(0, Kvs_streamMemStatTotal(xStreamHandle, &uMemEmpty));
+    EXPECT_FALSE(Kvs_streamAvailOnTrack(xStreamHandle, TRACK_VIDEO));
+    EXPECT_FALSE(Kvs_streamAvailOnTrack(xStreamHandle, TRACK_AUDIO));
+
+    ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_CLUSTER, TRACK_VIDEO, 1000) != NULL);
+    EXPECT_EQ(0, Kvs_streamMemStatTotal(xStreamHandle, &uMemOneFrame));
+    EXPECT_GT(uMemOneFrame, uMemEmpty);
+    EXPECT_TRUE(Kvs_streamAvailOnTrack(xStreamHandle, TRACK_VIDEO));
+    EXPECT_FALSE(Kvs_streamAvailOnTrack(xStreamHandle, TRACK_AUDIO));
+
+    ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_SIMPLE_BLOCK, TRACK_AUDIO, 1010) != NULL);
+    EXPECT_EQ(0, Kvs_streamMemStatTotal(xStreamHandle, &uMemTwoFrames));
+    EXPECT_GT(uMemTwoFrames, uMemOneFrame);
+    EXPECT_TRUE(Kvs_streamAvailOnTrack(xStreamHandle, TRACK_AUDIO));
+
+    /* Peek does not change the statistics. */
+    EXPECT_TRUE(Kvs_streamPeek(xStreamHandle) != NULL);
+    EXPECT_EQ(0, Kvs_streamMemStatTotal(xStreamHandle, &uMemTotal));
+    EXPECT_EQ(uMemTwoFrames, uMemTotal);
+
+    EXPECT_EQ(1000, prvPopTimestamp(xStreamHandle));
+    EXPECT_FALSE(Kvs_streamAvailOnTrack(xStreamHandle, TRACK_VIDEO));
+    EXPECT_TRUE(Kvs_streamAvailOnTrack(xStreamHandle, TRACK_AUDIO));
+
+    EXPECT_EQ(1010, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(0, Kvs_streamMemStatTotal(xStreamHandle, &uMemTotal));
+    EXPECT_EQ(uMemEmpty, uMemTotal);
+    EXPECT_FALSE(Kvs_streamAvailOnTrack(xStreamHandle, TRACK_AUDIO));
+    EXPECT_TRUE(Kvs_streamIsEmpty(xStreamHandle));
+
+    Kvs_streamTermintate(xStreamHandle);
+}
+
+static void prvOnDataFrameEvicted(DataFrameHandle xDataFrameHandle, void *pAppData)
+{
+    std::vector<uint64_t> *pxEvicted = (std::vector<uint64_t> *)pAppData;
+
+    pxEvicted->push_back(((DataFrameIn_t *)xDataFrameHandle)->uTimestampMs);
+    Kvs_dataFrameTerminate(xDataFrameHandle);
+}
+
+static void prvAddGop(StreamHandle xStreamHandle, uint64_t uTimestampMs, int iFrameCount)
+{
+    ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_CLUSTER, TRACK_VIDEO, uTimestampMs) != NULL);
+    for (int i = 1; i < iFrameCount; i++)
+    {
+        ASSERT_TRUE(prvAddDataFrame(xStreamHandle, MKV_SIMPLE_BLOCK, TRACK_VIDEO, uTimestampMs + i * 100) != NULL);
+    }
+}
+
+TEST(Kvs_streamEvictGops, mem_limit_evicts_whole_gops)
+{
+    std::vector<uint64_t> xEvicted;
+    size_t uMemTotal = 0;
+    StreamHandle xStreamHandle = prvCreateStream();
+    ASSERT_TRUE(xStreamHandle != NULL);
+
+    prvAddGop(xStreamHandle, 1000, 3);
+    prvAddGop(xStreamHandle, 2000, 3);
+    ASSERT_EQ(0, Kvs_streamMemStatTotal(xStreamHandle, &uMemTotal));
+
+    /* One byte over the limit evicts the whole oldest GOP. */
+    EXPECT_EQ(0, Kvs_streamEvictGops(xStreamHandle, uMemTotal - 1, 0, prvOnDataFrameEvicted, &xEvicted));
+    EXPECT_EQ(std::vector<uint64_t>({1000, 1100, 1200}), xEvicted);
+    EXPECT_EQ(2000, prvPopTimestamp(xStreamHandle));
+
+    /* The headless run is evicted as one GOP. */
+    xEvicted.clear();
+    EXPECT_EQ(0, Kvs_streamEvictGops(xStreamHandle, 1, 0, prvOnDataFrameEvicted, &xEvicted));
+    EXPECT_EQ(std::vector<uint64_t>({2100, 2200}), xEvicted);
+    EXPECT_TRUE(Kvs_streamIsEmpty(xStreamHandle));
+    EXPECT_FALSE(Kvs_streamAvailOnTrack(xStreamHandle, TRACK_VIDEO));
+
+    /* The cluster index still works after eviction. */
+    prvAddGop(xStreamHandle, 3000, 2);
+    EXPECT_EQ(3000, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(3100, prvPopTimestamp(xStreamHandle));
+
+    Kvs_streamTermintate(xStreamHandle);
+}
+
+TEST(Kvs_streamEvictGops, zero_limits_evict_nothing)
+{
+    std::vector<uint64_t> xEvicted;
+    StreamHandle xStreamHandle = prvCreateStream();
+    ASSERT_TRUE(xStreamHandle != NULL);
+
+    prvAddGop(xStreamHandle, 1000, 3);
+    prvAddGop(xStreamHandle, 2000, 3);
+
+    /* A memory limit of 0 is no limit, not a limit that evicts every GOP. */
+    EXPECT_EQ(0, Kvs_streamEvictGops(xStreamHandle, 0, 0, prvOnDataFrameEvicted, &xEvicted));
+    EXPECT_TRUE(xEvicted.empty());
+    EXPECT_EQ(1000, prvPopTimestamp(xStreamHandle));
+
+    prvStreamFlush(xStreamHandle);
+    Kvs_streamTermintate(xStreamHandle);
+}
+
+TEST(Kvs_streamEvictGops, duration_limit_keeps_newest_gop)
+{
+    std::vector<uint64_t> xEvicted;
+    StreamHandle xStreamHandle = prvCreateStream();
+    ASSERT_TRUE(xStreamHandle != NULL);
+
+    prvAddGop(xStreamHandle, 1000, 10);
+    prvAddGop(xStreamHandle, 2000, 10);
+    prvAddGop(xStreamHandle, 3000, 10);
+
+    /* The latest timestamp is 3900, so GOPs from 2000 still cover 1500ms and the first GOP goes. */
+    EXPECT_EQ(0, Kvs_streamEvictGops(xStreamHandle, 0, 1500, prvOnDataFrameEvicted, &xEvicted));
+    EXPECT_EQ(10, xEvicted.size());
+    EXPECT_EQ(1000, xEvicted.front());
+    EXPECT_EQ(1900, xEvicted.back());
+
+    /* The newest GOP is kept even if it's longer than the limit. */
+    xEvicted.clear();
+    EXPECT_EQ(0, Kvs_streamEvictGops(xStreamHandle, 0, 100, prvOnDataFrameEvicted, &xEvicted));
+    EXPECT_EQ(10, xEvicted.size());
+    EXPECT_EQ(3000, prvPopTimestamp(xStreamHandle));
+
+    prvStreamFlush(xStreamHandle);
+    Kvs_streamTermintate(xStreamHandle);
+}
+
+TEST(Kvs_streamEvictHeadless, evicts_until_next_cluster)
+{
+    std::vector<uint64_t> xEvicted;
+    StreamHandle xStreamHandle = prvCreateStream();
+    ASSERT_TRUE(xStreamHandle != NULL);
+
+    prvAddGop(xStreamHandle, 1000, 3);
+    prvAddGop(xStreamHandle, 2000, 2);
+
+    /* Nothing is evicted while the head is a cluster. */
+    EXPECT_EQ(0, Kvs_streamEvictHeadless(xStreamHandle, prvOnDataFrameEvicted, &xEvicted));
+    EXPECT_TRUE(xEvicted.empty());
+
+    EXPECT_EQ(1000, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(0, Kvs_streamEvictHeadless(xStreamHandle, prvOnDataFrameEvicted, &xEvicted));
+    EXPECT_EQ(std::vector<uint64_t>({1100, 1200}), xEvicted);
+    EXPECT_EQ(2000, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(2100, prvPopTimestamp(xStreamHandle));
+    EXPECT_TRUE(Kvs_streamIsEmpty(xStreamHandle));
+
+    Kvs_streamTermintate(xStreamHandle);
+}
+
+TEST(Kvs_streamReserveDataFrames, frames_beyond_reserve_use_heap)
+{
+    StreamHandle xStreamHandle = prvCreateStream();
+    ASSERT_TRUE(xStreamHandle != NULL);
+
+    EXPECT_NE(0, Kvs_streamReserveDataFrames(xStreamHandle, 0));
+    ASSERT_EQ(0, Kvs_streamReserveDataFrames(xStreamHandle, 2));
+    EXPECT_NE(0, Kvs_streamReserveDataFrames(xStreamHandle, 2));
+
+    prvAddGop(xStreamHandle, 1000, 4);
+    EXPECT_EQ(1000, prvPopTimestamp(xStreamHandle));
+    prvAddGop(xStreamHandle, 2000, 2);
+
+    EXPECT_EQ(1100, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(1200, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(1300, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(2000, prvPopTimestamp(xStreamHandle));
+    EXPECT_EQ(2100, prvPopTimestamp(xStreamHandle));
+    EXPECT_TRUE(Kvs_streamIsEmpty(xStreamHandle));
+
+    Kvs_streamTermintate(xStreamHandle);
+}